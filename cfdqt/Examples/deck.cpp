@@ -0,0 +1,344 @@
+/**
+ * @file deck.cpp
+ * @brief Run the F4 tallies of an MCNP deck with CFD, e.g. ./deckSim output_gamma/singleDet.i 1000000
+ *        Each tally is written to <deck>.f<tally number>.txt, or <deck>.f<tally number>_<cell index>.txt
+ *        if the tally has several cells. The number of histories is optional, options follow as --<name>=<value>:
+ *        --response=<response matrix>: the tallies are also folded into pulse-height spectra in 10 batches,
+ *        written to <deck>.f<tally number>.ph.txt with their errors.
+ *        --windows=<weight windows>: particles are split and rouletted according to the windows instead of being
+ *        killed below the minimum weight.
+ *        --bias=<pilot histories>: source directions and positions are biased towards the first tally, tuned from
+ *        an unbiased pilot run.
+ *        --subsampling=<policy>: see SubsamplingPolicy::parse, e.g. thermal:0.05, or auto:<pilot histories> to tune
+ *        the probabilities of all estimators from a pilot run. The predicted variance and time are printed.
+ *        --stretch=<largest stretching parameter>: flights are stretched towards the first tally by the exponential transform.
+ *        --qmc=<replicates>: the source and the first flight are sampled from an Owen-scrambled Sobol sequence per
+ *        replicate, and the tally totals are printed with their standard errors between replicates.
+ *        --uncollided=<relative tolerance>: the uncollided flux of each tally is integrated deterministically
+ *        and added to it, and only the collisions are scored by Monte Carlo.
+ *        --perturb=<material perturbations>: see MaterialPerturbation::parse, e.g. density:1.01,fraction:0:1.05.
+ *        The tallies of each perturbed material are scored in the same run by correlated sampling, written to
+ *        <deck>.f<tally number>.p<perturbation index>.txt, and the differences to the unperturbed totals are printed.
+ *        --stratify=<source stratification>: see StratifiedSource::parse, e.g. height:4,radius:2,optimal or lhs,height.
+ *        The mean and variance of the sampled tally total of each stratum are printed.
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+#include <map>
+#include <numeric>
+
+#include "mcnpimport.h"
+#include "response.h"
+#include "weightwindow.h"
+#include "sourcebias.h"
+#include "importance.h"
+#include "qmc.h"
+#include "perturbation.h"
+#include "stratified.h"
+
+static const std::vector<std::string> optionNames{"response", "windows", "bias", "subsampling", "stretch", "qmc", "uncollided", "perturb", "stratify"};
+
+static void printUsage(const char* program)
+{
+    std::cerr << "Usage: " << program << " <deck> [number of histories] [--response=<response matrix>] [--windows=<weight windows>]"
+              << " [--bias=<pilot histories>] [--subsampling=<policy or auto:<pilot histories>>] [--stretch=<exponential transform stretching>]"
+              << " [--qmc=<replicates>] [--uncollided=<tolerance>] [--perturb=<material perturbations>] [--stratify=<source stratification>]" << std::endl;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+    const std::string deckPath = argv[1];
+    // named options, --<name>=<value>, and the number of histories
+    std::map<std::string, std::string> arguments;
+    std::string histories;
+    for (int i = 2; i < argc; i++)
+    {
+        const std::string argument = argv[i];
+        const std::size_t equal = argument.find('=');
+        const bool named = argument.rfind("--", 0) == 0;
+        if (named && equal != std::string::npos &&
+            std::find(optionNames.begin(), optionNames.end(), argument.substr(2, equal - 2)) != optionNames.end())
+        {
+            arguments[argument.substr(2, equal - 2)] = argument.substr(equal + 1);
+            continue;
+        }
+        if (named || !histories.empty())
+        {
+            std::cerr << "Unknown argument: " << argument << std::endl;
+            printUsage(argv[0]);
+            return 1;
+        }
+        histories = argument;
+    }
+    auto hasArgument = [&arguments](const std::string& name) {return arguments.count(name) > 0;};
+    std::filesystem::path cwd(std::filesystem::current_path());
+    std::string rootdir = cwd.parent_path().string();
+
+    McnpImporter importer(NuclideLibrary::loadDefault(rootdir));
+    McnpImportOptions options;
+    if (!histories.empty())
+        options.maxN = std::stoi(histories);
+    McnpProblem problem = importer.import(deckPath, options);
+    const MCSettings& config = *problem.config;
+    // pulse-height spectra, the matrix is loaded once
+    std::unique_ptr<PulseHeightFolder> folder;
+    if (hasArgument("response"))
+        folder = std::make_unique<PulseHeightFolder>(std::make_shared<const ResponseMatrix>(ResponseMatrix::load(arguments["response"])));
+    // randomized quasi-Monte Carlo, one scrambled Sobol sequence per batch
+    const int replicates = hasArgument("qmc") ? std::stoi(arguments["qmc"]) : 0;
+    // stratified or Latin-hypercube source, the optimal allocation is estimated from the previous batches
+    std::unique_ptr<StratifiedSource> stratified;
+    if (hasArgument("stratify"))
+        stratified = std::make_unique<StratifiedSource>(StratifiedSource::parse(config.source, arguments["stratify"]));
+    const int nBatches = replicates > 0 ? replicates : (folder || (stratified && stratified->isOptimal()) ? 10 : 1);
+    std::unique_ptr<WeightWindowMesh> windows;
+    if (hasArgument("windows"))
+        windows = std::make_unique<WeightWindowMesh>(WeightWindowMesh::load(arguments["windows"]));
+    // source biased towards the first tally
+    std::unique_ptr<BiasedSource> biased;
+    if (hasArgument("bias") && !problem.tallies.empty())
+    {
+        biased = std::make_unique<BiasedSource>(BiasedSource::tune(config, problem.tallies[0], std::stoi(arguments["bias"])));
+        std::cout << "Source direction exponent " << biased->getExponent() << ", position exponent "
+                  << biased->getPositionExponent() << " cm^-1, predicted variance reduction "
+                  << biased->getPredictedGain() << std::endl;
+    }
+    if (stratified && (biased || replicates > 0))
+        throw std::runtime_error("A stratified source is neither biased nor sampled from a Sobol sequence.");
+    // fraction of the events of each estimator that is scored
+    if (hasArgument("subsampling"))
+    {
+        const std::string spec = arguments["subsampling"];
+        SubsamplingPolicy& policy = SubsamplingPolicy::GetInstance();
+        if (spec.rfind("auto:", 0) == 0)
+        {
+            const SubsamplingPolicy::Pilot pilot = runSubsamplingPilot(config, problem.tallies, std::stoi(spec.substr(5)));
+            const SubsamplingPolicy::Tradeoff previous = policy.predict(pilot);
+            const SubsamplingPolicy::Tradeoff tradeoff = policy.optimize(pilot);
+            std::cout << "Subsampling, relative to scoring every event: default variance x" << previous.varianceRatio
+                      << ", time x" << previous.timeRatio << "; tuned variance x" << tradeoff.varianceRatio
+                      << ", time x" << tradeoff.timeRatio << std::endl;
+        }
+        else
+        {
+            policy = SubsamplingPolicy::parse(spec);
+        }
+        for (int e = 0; e < SubsamplingPolicy::nEstimators; e++)
+        {
+            const SubsamplingPolicy::Estimator estimator = static_cast<SubsamplingPolicy::Estimator>(e);
+            std::cout << SubsamplingPolicy::getName(estimator) << ':';
+            for (auto &&p : policy.getProbabilities(estimator))
+                std::cout << ' ' << p;
+            std::cout << std::endl;
+        }
+    }
+    // flights stretched towards the first tally
+    std::unique_ptr<ExponentialTransform> transform;
+    if (hasArgument("stretch") && !problem.tallies.empty())
+    {
+        transform = std::make_unique<ExponentialTransform>(ExponentialTransform::fromDiffusion(
+            config, problem.tallies[0].getCenter(), ImportanceMap::defaultEnergyEdges(config, 10), std::stod(arguments["stretch"])));
+        std::cout << "Exponential transform stretching:";
+        for (auto &&p : transform->getStretchingParameters())
+            std::cout << ' ' << p;
+        std::cout << std::endl;
+    }
+    // uncollided flux integrated instead of sampled
+    std::vector<UncollidedFlux> uncollided;
+    for (std::size_t t = 0; hasArgument("uncollided") && t < problem.tallies.size(); t++)
+    {
+        uncollided.emplace_back(config, problem.tallies[t], std::stod(arguments["uncollided"]));
+        std::cout << "Tally " << problem.tallyNumbers[t] << " uncollided flux " << uncollided.back().getTotal()
+                  << " +- " << uncollided.back().getErrorEstimate() << " from " << uncollided.back().getEvaluations()
+                  << " source points" << std::endl;
+    }
+
+    // tallies of perturbed materials scored with the same histories
+    std::unique_ptr<PerturbationTallies> perturbation;
+    if (hasArgument("perturb"))
+    {
+        if (windows)
+            throw std::runtime_error("Material perturbations are not scored with weight windows.");
+        perturbation = std::make_unique<PerturbationTallies>(config, problem.tallies, MaterialPerturbation::parse(arguments["perturb"]));
+    }
+    std::vector<std::vector<Tally>> perturbedTallies;
+    // the integrated uncollided fluxes are exact, only the collisions are sampled
+    std::vector<double> uncollidedDifferences;
+    for (int k = 0; perturbation && k < perturbation->getNPerturbations(); k++)
+    {
+        perturbedTallies.push_back(problem.tallies);
+        uncollidedDifferences.push_back(0);
+        for (std::size_t t = 0; t < uncollided.size(); t++)
+        {
+            const UncollidedFlux perturbedFlux(perturbation->getSettings(k), problem.tallies[t], std::stod(arguments["uncollided"]));
+            perturbedFlux.addTo(perturbedTallies[k][t], config.maxN);
+            uncollidedDifferences[k] += perturbedFlux.getTotal() - uncollided[t].getTotal();
+        }
+    }
+
+    // run transport and CFD
+    auto startTime = std::chrono::high_resolution_clock::now();
+    std::vector<Tally> batchTallies(problem.tallies);
+    // sum over the replicates of the tally totals and of their squares
+    std::vector<double> replicateSums(problem.tallies.size(), 0), replicateSquaredSums(problem.tallies.size(), 0);
+    for (int batch = 0; batch < nBatches; batch++)
+    {
+        const int batchN = static_cast<long long>(config.maxN) * (batch + 1) / nBatches - static_cast<long long>(config.maxN) * batch / nBatches;
+        std::unique_ptr<ScrambledSobol> sobol;
+        if (replicates > 0)
+            sobol = std::make_unique<ScrambledSobol>(ScrambledSobol::defaultDimensions(config.source), batch + 1);
+        if (stratified)
+            stratified->startBatch(batchN);
+        auto createSource = [&config, &biased, &stratified](const int i) {
+            if (stratified)
+                return stratified->createParticle(i);
+            return biased ? biased->createParticle() : config.source.createParticle();
+        };
+        // sum of the batch tallies before the history
+        double batchTotal(0);
+        for (int i = 0; i < batchN; i++)
+        {
+            if (sobol)
+                sobol->startHistory(i);
+            if (perturbation)
+            {
+                perturbation->runHistory(createSource(i), batchTallies, transform.get(), uncollided.empty());
+            }
+            else
+            {
+                // create a new particle from source, all tallies in one pass at the source and at every collision
+                transportHistory(createSource(i), config, windows.get(), transform.get(),
+                                 [&batchTallies, &config, &uncollided](Particle& prtl) {
+                                     if (uncollided.empty() || prtl.scatterN > 0)
+                                         forceDetection(prtl, config, batchTallies);
+                                 });
+            }
+            if (stratified)
+            {
+                double total(0);
+                for (auto &&tally : batchTallies)
+                {
+                    for (int b = 0; b < tally.getNBins(); b++)
+                        total += tally.getBinContent(b);
+                }
+                stratified->addScore(i, total - batchTotal);
+                batchTotal = total;
+            }
+        }
+        if (sobol)
+            ScrambledSobol::stopHistory();
+        for (std::size_t t = 0; t < uncollided.size(); t++)
+            uncollided[t].addTo(batchTallies[t], batchN);
+        if (folder)
+            folder->addBatch(batchTallies, batchN);
+        for (std::size_t t = 0; t < batchTallies.size(); t++)
+        {
+            const std::vector<double> counts = batchTallies[t].getBinContents();
+            const double total = std::accumulate(counts.begin(), counts.end(), 0.0) / batchN;
+            replicateSums[t] += total;
+            replicateSquaredSums[t] += total * total;
+            problem.tallies[t].add(batchTallies[t]);
+            batchTallies[t].reset();
+        }
+    }
+
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << "ms" << std::endl;
+    for (std::size_t t = 0; replicates > 1 && t < problem.tallies.size(); t++)
+    {
+        const double mean = replicateSums[t] / replicates;
+        const double variance = std::max(0.0, replicateSquaredSums[t] / replicates - mean * mean) / (replicates - 1);
+        std::cout << "Tally " << problem.tallyNumbers[t] << " total " << mean << " +- " << std::sqrt(variance)
+                  << " from " << replicates << " QMC replicates" << std::endl;
+    }
+    for (int h = 0; stratified && h < stratified->getNStrata(); h++)
+    {
+        std::cout << "Source stratum " << stratified->getStratumName(h) << ": " << stratified->getHistories(h)
+                  << " histories, mean " << stratified->getMean(h) << ", standard deviation " << std::sqrt(stratified->getVariance(h))
+                  << ", variance contribution " << stratified->getVarianceContribution(h) << std::endl;
+    }
+    if (stratified)
+    {
+        std::cout << "Sampled tally total " << stratified->getMean() << " +- " << std::sqrt(stratified->getVarianceOfMean())
+                  << ", unstratified +- " << std::sqrt(stratified->getUnstratifiedVarianceOfMean()) << std::endl;
+    }
+    for (int k = 0; perturbation && k < perturbation->getNPerturbations(); k++)
+    {
+        for (std::size_t t = 0; t < problem.tallies.size(); t++)
+            perturbedTallies[k][t].add(perturbation->getTallies(k)[t]);
+        std::cout << "Perturbation " << k << ' ' << perturbation->getPerturbation(k).getName() << ": tally total difference "
+                  << perturbation->getDifference(k) + uncollidedDifferences[k] << " +- " << perturbation->getDifferenceError(k)
+                  << ", independent runs +- " << perturbation->getIndependentDifferenceError(k) << std::endl;
+    }
+
+    for (std::size_t t = 0; t < problem.tallies.size(); t++)
+    {
+        const Tally& tally = problem.tallies[t];
+        const int number = problem.tallyNumbers[t];
+        std::string fpath = deckPath + ".f" + std::to_string(number);
+        if (std::count(problem.tallyNumbers.begin(), problem.tallyNumbers.end(), number) > 1)
+            fpath += "_" + std::to_string(t - (std::find(problem.tallyNumbers.begin(), problem.tallyNumbers.end(), number) - problem.tallyNumbers.begin()));
+        fpath += ".txt";
+        std::ofstream fileptr;
+        fileptr.open(fpath, std::ios::out);
+        if (!fileptr.is_open())
+        {
+            std::string errMessage = "can't open file: " + fpath;
+            throw std::runtime_error(errMessage);
+        }
+        for (int i = 0; i < tally.getNBins(); i++)
+        {
+            fileptr << tally.getBinCenter(i) << '\t' << tally.getBinContent(i) / config.maxN << '\n';
+        }
+        fileptr.close();
+        for (std::size_t k = 0; k < perturbedTallies.size(); k++)
+        {
+            std::string perturbedPath = fpath;
+            perturbedPath.replace(perturbedPath.size() - 4, 4, ".p" + std::to_string(k) + ".txt");
+            fileptr.open(perturbedPath, std::ios::out);
+            if (!fileptr.is_open())
+            {
+                std::string errMessage = "can't open file: " + perturbedPath;
+                throw std::runtime_error(errMessage);
+            }
+            for (int i = 0; i < tally.getNBins(); i++)
+            {
+                fileptr << tally.getBinCenter(i) << '\t' << perturbedTallies[k][t].getBinContent(i) / config.maxN << '\n';
+            }
+            fileptr.close();
+        }
+
+        if (!folder)
+            continue;
+        fpath.replace(fpath.size() - 4, 4, ".ph.txt");
+        fileptr.open(fpath, std::ios::out);
+        if (!fileptr.is_open())
+        {
+            std::string errMessage = "can't open file: " + fpath;
+            throw std::runtime_error(errMessage);
+        }
+        const std::vector<double>& edges = folder->getResponse().getPulseHeightEdges();
+        const std::vector<double> spectrum = folder->getSpectrum(t);
+        const std::vector<double> errors = folder->getStdError(t);
+        for (std::size_t j = 0; j < spectrum.size(); j++)
+        {
+            fileptr << 0.5 * (edges[j] + edges[j + 1]) << '\t' << spectrum[j] << '\t' << errors[j] << '\n';
+        }
+        fileptr.close();
+    }
+
+    return 0;
+}
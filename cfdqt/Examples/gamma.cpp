@@ -27,8 +27,8 @@ int main(int argc, char** argv)
     std::filesystem::path cwd(std::filesystem::current_path());
     std::string rootdir = cwd.parent_path().string();
     // initialize gemoetry
-    const Cylinder waterCylinder = Cylinder(QVector3D(25, 25, 0), 52, 21.5);
-    const Cylinder sourceCylinder = Cylinder(QVector3D(25, 25, 8.4478), 5.63372, 1.4097);
+    const Cylinder waterCylinder = Cylinder(Vec3d(25, 25, 0), 52, 21.5);
+    const Cylinder sourceCylinder = Cylinder(Vec3d(25, 25, 8.4478), 5.63372, 1.4097);
     // load cross-section tables
     const PhotonCrossSection photonCrossSection(rootdir+"/DATA/H2O.csv");
     const NeutronCrossSection H1NeutronCrossSection(rootdir+"/DATA/H1-total-cross-section.txt",
@@ -55,8 +55,9 @@ int main(int argc, char** argv)
     const double minW = 0.01;
     const MCSettings config = MCSettings(waterCylinder, std::vector<Cell>{waterCell}, source, maxN, maxScatterN, minW, minE);
     // initialize tally F4
-    const Sphere detector = Sphere(QVector3D(100, 100, 10), 2.54);
+    const Sphere detector = Sphere(Vec3d(100, 100, 10), 2.54);
     Tally tally = Tally(detector, 100, 0, 1.0, false);
+    tally.setVolume(1.0); // same as SD4 1 in the MCNP deck
 
     // run photon transport and CFD
     auto startTime = std::chrono::high_resolution_clock::now();
@@ -64,7 +65,7 @@ int main(int argc, char** argv)
     {
         // create a new particle from source
         Particle prtl = config.source.createParticle();
-        assert(config.ROI.contain(prtl.pos));
+        assert(config.ROI->contain(prtl.pos));
 
         // primary contribution
         forceDetection(prtl, config, tally);
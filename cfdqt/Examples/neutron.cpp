@@ -27,8 +27,8 @@ int main(int argc, char** argv)
     std::filesystem::path cwd(std::filesystem::current_path());
     std::string rootdir = cwd.parent_path().string();
     // initialize gemoetry
-    const Cylinder waterCylinder = Cylinder(QVector3D(25, 25, 0), 52, 5);
-    const Cylinder sourceCylinder = Cylinder(QVector3D(25, 25, 8.4478), 5.63372, 1.4097);
+    const Cylinder waterCylinder = Cylinder(Vec3d(25, 25, 0), 52, 5);
+    const Cylinder sourceCylinder = Cylinder(Vec3d(25, 25, 8.4478), 5.63372, 1.4097);
     // load cross-section tables
     const PhotonCrossSection photonCrossSection(rootdir+"/DATA/H2O.csv");
     const NeutronCrossSection H1NeutronCrossSection(rootdir+"/DATA/H1-total-cross-section.txt",
@@ -57,9 +57,12 @@ int main(int argc, char** argv)
     const double minW = 0.01;
     const MCSettings config = MCSettings(waterCylinder, std::vector<Cell>{waterCell}, source, maxN, maxScatterN, minW, minE);
     // initialize tally F2
-    const Sphere detector = Sphere(QVector3D(75, 75, 10), 2.54);
+    const Sphere detector = Sphere(Vec3d(75, 75, 10), 2.54);
     // lethargy
     Tally tally = Tally(detector, 110, 1e-3, 1e8, true);
+    tally.setVolume(1.0); // same as SD4 1 in the MCNP deck
+    // arrival times, 10 ns bins up to 100 us, thermal neutrons diffuse for ~200 us in water
+    tally.setTimeBins(10000, 0, 1e5);
 
     // run neutron transport and CFD
     auto startTime = std::chrono::high_resolution_clock::now();
@@ -71,7 +74,7 @@ int main(int argc, char** argv)
         // }
         // create a new particle from source
         Particle prtl = config.source.createParticle();
-        assert(config.ROI.contain(prtl.pos));
+        assert(config.ROI->contain(prtl.pos));
 
         // primary contribution
         forceDetection(prtl, config, tally);
@@ -105,6 +108,20 @@ int main(int argc, char** argv)
         fileptr << tally.getBinCenter(i) << '\t' << tally.getBinContent(i) / config.maxN << '\n';
     }
     fileptr.close();
+
+    fpath = "output_neutron/time.txt";
+    fileptr.open(fpath, std::ios::out);
+    if (!fileptr.is_open())
+    {
+        std::string errMessage = "can't open file: " + fpath;
+        throw std::runtime_error(errMessage);
+    }
+    const std::vector<double> timeSpectrum = tally.getTimeSpectrum();
+    for (int i = 0; i < tally.getNTimeBins(); i++)
+    {
+        fileptr << tally.getTimeBinCenter(i) << '\t' << timeSpectrum[i] / config.maxN << '\n';
+    }
+    fileptr.close();
     
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,44 @@
+import numpy as np
+import matplotlib.pyplot as plt
+plt.rcParams.update({'font.size': 18})
+
+
+def readScan(path):
+    # layout written by DetectorScan::save
+    with open(path, 'rb') as f:
+        if f.read(8) != b'CFDSCAN1':
+            raise ValueError(path + ' is not a detector scan')
+        nx, ny, nz, nbins, nps = np.fromfile(f, dtype=np.int32, count=5)
+        grid = np.fromfile(f, dtype=np.float64, count=6)
+        ergbins = np.fromfile(f, dtype=np.float64, count=nbins)
+        spectra = np.fromfile(f, dtype=np.float64, count=nx*ny*nz*nbins).reshape((nx, ny, nz, nbins))
+        integrals = np.fromfile(f, dtype=np.float64, count=nx*ny*nz).reshape((nx, ny, nz))
+    x = grid[0] + grid[3] * np.arange(nx)
+    y = grid[1] + grid[4] * np.arange(ny)
+    z = grid[2] + grid[5] * np.arange(nz)
+    return x, y, z, ergbins, spectra, integrals
+
+
+x, y, z, ergbins, spectra, integrals = readScan('scan.bin')
+
+fig, (ax1, ax2) = plt.subplots(1, 2, figsize=(14, 6))
+# integral flux in the first z plane
+im = ax1.pcolormesh(x, y, np.transpose(integrals[:, :, 0]), shading='nearest', norm='log')
+fig.colorbar(im, ax=ax1, label='Fluence per unit NPS')
+ax1.set_xlabel('X (cm)')
+ax1.set_ylabel('Y (cm)')
+ax1.set_title('Z = {:g} cm'.format(z[0]))
+ax1.set_aspect('equal')
+
+# spectra at the nearest and farthest nodes
+imax = np.unravel_index(np.argmax(integrals), integrals.shape)
+imin = np.unravel_index(np.argmin(integrals), integrals.shape)
+for idx in [imax, imin]:
+    ax2.step(ergbins, spectra[idx], where='mid', linewidth=2,
+             label='({:g}, {:g}, {:g}) cm'.format(x[idx[0]], y[idx[1]], z[idx[2]]))
+ax2.set_xlabel('Energy (MeV)')
+ax2.set_ylabel('Fluence per unit NPS')
+ax2.set_yscale('log')
+ax2.legend()
+
+plt.show()
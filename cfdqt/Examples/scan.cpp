@@ -0,0 +1,79 @@
+/**
+ * @file scan.cpp
+ * @brief Scan a detector over a grid of positions around the Cs source in a water barrel.
+ *        The spectra and integral fluxes are written to output_scan/scan.bin, see DetectorScan::save.
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @author Ming Fang
+ * 
+ */
+#include <chrono>
+#include <iostream>
+#include <filesystem>
+
+#include "geometry.h"
+#include "data.h"
+#include "material.h"
+#include "cell.h"
+#include "tracking.h"
+#include "cfd.h"
+#include "bank.h"
+#include "scan.h"
+
+int main()
+{
+    // create directories to save the output files
+    std::filesystem::create_directories("output_scan");
+    std::filesystem::path cwd(std::filesystem::current_path());
+    std::string rootdir = cwd.parent_path().string();
+    // initialize gemoetry
+    const Cylinder waterCylinder = Cylinder(Vec3d(25, 25, 0), 52, 21.5);
+    const Cylinder sourceCylinder = Cylinder(Vec3d(25, 25, 8.4478), 5.63372, 1.4097);
+    // load cross-section tables
+    const PhotonCrossSection photonCrossSection(rootdir+"/DATA/H2O.csv");
+    const NeutronCrossSection H1NeutronCrossSection(rootdir+"/DATA/H1-total-cross-section.txt",
+                                                    rootdir+"/DATA/H1-elastic-scattering-cross-section.txt");
+    const NeutronCrossSection O16NeutronCrossSection(rootdir+"/DATA/O16-total-cross-section.txt",
+                                                     rootdir+"/DATA/O16-elastic-scattering-cross-section.txt",
+                                                     rootdir+"/DATA/O16-elastic-scattering-PDF.txt",
+                                                     rootdir+"/DATA/O16-elastic-scattering-CDF.txt");
+    // create nuclides
+    const Nuclide H1(1, 1, H1NeutronCrossSection, photonCrossSection);
+    const Nuclide O16(8, 16, O16NeutronCrossSection, photonCrossSection);
+    // initialize material
+    const double waterDensity = 0.99; // g cm^-3
+    const Material water = Material(waterDensity, 18, {{2, H1}, {1, O16}});
+    // initialize cell
+    const Cell waterCell = Cell(water, waterDensity, waterCylinder);
+    // initialize source, eV for neutron, MeV for gamma
+    std::vector<double> srcEnergyCDF{0.661}; // Cs137
+    const Source source = Source(sourceCylinder, srcEnergyCDF, Particle::Photon);
+    // initialize settings
+    const int maxN = 100000;
+    const double maxScatterN = 5;
+    const double minE = 0.1;  // eV for neutron, MeV for gamma
+    const double minW = 0.01;
+    const MCSettings config = MCSettings(waterCylinder, std::vector<Cell>{waterCell}, source, maxN, maxScatterN, minW, minE);
+    // 21 x 21 detector positions in the plane z = 10 cm, outside the barrel
+    const Tally prototype = Tally(Sphere(Vec3d(100, 100, 10), 2.54), 100, 0, 1.0, false);
+    DetectorScan scan(prototype, Vec3d(50, 50, 10), Vec3d(150, 150, 10), 21, 21, 1);
+
+    // transport once
+    auto startTime = std::chrono::high_resolution_clock::now();
+    CollisionBank bank;
+    bank.transport(config, config.maxN);
+    auto transportTime = std::chrono::high_resolution_clock::now();
+    std::cout << "transport: " << std::chrono::duration_cast<std::chrono::milliseconds>(transportTime - startTime).count() << "ms, " 
+              << bank.size() << " events" << std::endl;
+
+    // CFD at all positions
+    scan.run(config, bank);
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout << "scan of " << scan.getNumberOfNodes() << " positions: " 
+              << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - transportTime).count() << "ms" << std::endl;
+
+    scan.save("output_scan/scan.bin");
+    
+    return 0;
+}
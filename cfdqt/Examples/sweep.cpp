@@ -0,0 +1,82 @@
+/**
+ * @file sweep.cpp
+ * @brief Sweep the source of an MCNP deck, e.g. ./sweepSim output_gamma/broad.i 1000000 output_gamma/singleDet.i
+ *        The reference deck, whose source should have a broad continuous spectrum, is transported once and
+ *        its histories are kept, see HistoryBank. The tallies of the reference deck are then reweighted to the
+ *        source of each target deck, ./sweepSim <reference deck> <histories> <target deck> [<target deck> ...],
+ *        and written to <target deck>.f<tally number>.txt. Only the SDEF card of the target decks is used.
+ *        The effective sample size of each target is printed, with a warning if it is too small.
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <filesystem>
+
+#include "mcnpimport.h"
+#include "bank.h"
+
+int main(int argc, char** argv)
+{
+    if (argc < 4)
+    {
+        std::cerr << "Usage: " << argv[0] << " <reference deck> <number of histories> <target deck> [<target deck> ...]" << std::endl;
+        return 1;
+    }
+    std::filesystem::path cwd(std::filesystem::current_path());
+    std::string rootdir = cwd.parent_path().string();
+
+    McnpImporter importer(NuclideLibrary::loadDefault(rootdir));
+    McnpImportOptions options;
+    options.maxN = std::stoi(argv[2]);
+    McnpProblem problem = importer.import(argv[1], options);
+    const MCSettings& config = *problem.config;
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    HistoryBank bank(problem.tallies);
+    bank.transport(config, config.maxN);
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout << "Reference: " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << "ms" << std::endl;
+
+    for (int i = 3; i < argc; i++)
+    {
+        const std::string deckPath = argv[i];
+        const McnpProblem target = importer.import(deckPath, options);
+        startTime = std::chrono::high_resolution_clock::now();
+        std::vector<Tally> tallies(problem.tallies);
+        const HistoryBank::Diagnostics diagnostics = bank.reweight(target.config->source, tallies);
+        endTime = std::chrono::high_resolution_clock::now();
+        std::cout << deckPath << ": " << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count()
+                  << "ms, tally total " << diagnostics.total << " +- " << diagnostics.totalError << ", effective sample size "
+                  << diagnostics.effectiveSampleSize << " of " << diagnostics.histories << ", coverage " << diagnostics.coverage << std::endl;
+
+        for (std::size_t t = 0; t < tallies.size(); t++)
+        {
+            const Tally& tally = tallies[t];
+            const int number = problem.tallyNumbers[t];
+            std::string fpath = deckPath + ".f" + std::to_string(number);
+            if (std::count(problem.tallyNumbers.begin(), problem.tallyNumbers.end(), number) > 1)
+                fpath += "_" + std::to_string(t - (std::find(problem.tallyNumbers.begin(), problem.tallyNumbers.end(), number) - problem.tallyNumbers.begin()));
+            fpath += ".txt";
+            std::ofstream fileptr;
+            fileptr.open(fpath, std::ios::out);
+            if (!fileptr.is_open())
+            {
+                std::string errMessage = "can't open file: " + fpath;
+                throw std::runtime_error(errMessage);
+            }
+            for (std::size_t j = 0; j < static_cast<std::size_t>(tally.getNBins()); j++)
+            {
+                fileptr << tally.getBinCenter(j) << '\t' << tally.getBinContent(j) / config.maxN << '\n';
+            }
+            fileptr.close();
+        }
+    }
+
+    return 0;
+}
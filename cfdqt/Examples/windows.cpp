@@ -0,0 +1,60 @@
+/**
+ * @file windows.cpp
+ * @brief Generate weight windows for one tally of an MCNP deck from a coarse adjoint diffusion calculation,
+ *        e.g. ./wwgen output_gamma/singleDet.i 14 singleDet.ww.txt, then ./deckSim output_gamma/singleDet.i 1000000 --windows=singleDet.ww.txt
+ *        The mesh over the ROI has 20 x 20 x 20 elements and 10 energy groups unless given,
+ *        ./wwgen <deck> <tally number> <weight windows> [nx ny nz [number of groups]]
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <filesystem>
+
+#include "mcnpimport.h"
+#include "importance.h"
+
+int main(int argc, char** argv)
+{
+    // the mesh is given in full or not at all
+    if (argc != 4 && argc != 7 && argc != 8)
+    {
+        std::cerr << "Usage: " << argv[0] << " <deck> <tally number> <weight windows> [nx ny nz [number of groups]]" << std::endl;
+        return 1;
+    }
+    const std::string deckPath = argv[1];
+    const int tallyNumber = std::stoi(argv[2]);
+    int nodes[3] = {20, 20, 20};
+    if (argc >= 7)
+    {
+        for (int d = 0; d < 3; d++)
+            nodes[d] = std::stoi(argv[4 + d]);
+    }
+    const int ngroups = argc == 8 ? std::stoi(argv[7]) : 10;
+    std::filesystem::path cwd(std::filesystem::current_path());
+    std::string rootdir = cwd.parent_path().string();
+
+    McnpImporter importer(NuclideLibrary::loadDefault(rootdir));
+    McnpProblem problem = importer.import(deckPath, McnpImportOptions());
+    const MCSettings& config = *problem.config;
+    const auto found = std::find(problem.tallyNumbers.begin(), problem.tallyNumbers.end(), tallyNumber);
+    if (found == problem.tallyNumbers.end())
+    {
+        std::cerr << "No tally F" << tallyNumber << " in " << deckPath << std::endl;
+        return 1;
+    }
+    const Tally& tally = problem.tallies[found - problem.tallyNumbers.begin()];
+
+    auto startTime = std::chrono::high_resolution_clock::now();
+    const ImportanceMap map(config, tally, ImportanceMap::defaultEnergyEdges(config, ngroups), nodes[0], nodes[1], nodes[2]);
+    map.toWeightWindows().save(argv[3]);
+    auto endTime = std::chrono::high_resolution_clock::now();
+    std::cout << std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime).count() << "ms" << std::endl;
+    std::cout << "Estimated tally total: " << map.getResponse() << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,222 @@
+/**
+ * @file bank.h
+ * @brief record source and collision events once, re-score them for any detector or source
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cfd.h"
+#include "weightwindow.h"
+
+/**
+ * @brief State of a particle at a source or collision site, before scattering.
+ *        The detector-independent cross sections of the event are recomputed from it on replay.
+ *
+ */
+struct BankedEvent
+{
+    Vec3d pos;
+    Vec3d dir;
+    double ergE;
+    double weight;
+    // time since the source particle was created, ns
+    double time;
+    int scatterN;
+    Particle::ParticleType particleType;
+
+    /**
+     * @brief Rebuild the particle of the event, keeping the recorded direction bit for bit
+     * 
+     * @return Particle 
+     */
+    Particle toParticle() const
+    {
+        Particle particle(pos, dir, ergE, weight, particleType, scatterN, false);
+        particle.dir = dir;
+        particle.time = time;
+        return particle;
+    }
+};
+
+/**
+ * @brief Source and collision events of a transport run. CFD does not change the transport,
+ *        so the events do not depend on the detectors and can be re-scored for any detector
+ *        position or radius without transporting again.
+ *        Thermal neutron collisions are sub-sampled when recorded, exactly as forceDetection does,
+ *        so that replaying a bank gives the same tallies as scoring during transport.
+ */
+class CollisionBank
+{
+private:
+    std::vector<BankedEvent> events;
+    // number of histories
+    int NPS=0;
+public:
+    /**
+     * @brief Record an event if it is selected by sampleEventScoring
+     *
+     * @param particle Particle at the source or collision site, before scattering
+     */
+    void record(const Particle& particle);
+    /**
+     * @brief Count a finished history
+     */
+    void endHistory() {NPS++;}
+    /**
+     * @brief Transport histories from the source of config and record their events
+     *
+     * @param config MC run settings
+     * @param nps Number of histories
+     * @param windows Weight windows, nullptr to kill particles lighter than config.minW
+     */
+    void transport(const MCSettings& config, const int nps, const WeightWindowMesh* windows=nullptr);
+
+    /**
+     * @brief Score all events in the tallies, in parallel across events if OpenMP is enabled.
+     *        Tallies are not reset, counts are added to them.
+     *        The threads share the tallies through SharedTallyStorage, so memory does not grow
+     *        with the number of threads, unless a tally has time bins: then every thread scores in its own copy.
+     *
+     * @param config MC run settings used to record the bank
+     * @param tallies Tallies to be updated
+     */
+    void replay(const MCSettings& config, std::vector<Tally>& tallies) const;
+    /**
+     * @brief Score all events in one tally
+     *
+     * @param config MC run settings used to record the bank
+     * @param tally Tally to be updated
+     */
+    void replay(const MCSettings& config, Tally& tally) const;
+
+    /**
+     * @brief Write the bank to a binary file
+     *
+     * @param fpath File path
+     */
+    void save(const std::string& fpath) const;
+    /**
+     * @brief Read a bank written by save()
+     *
+     * @param fpath File path
+     * @return CollisionBank
+     */
+    static CollisionBank load(const std::string& fpath);
+
+    void clear() {events.clear(); NPS=0;}
+    std::size_t size() const {return events.size();}
+    int getNPS() const {return NPS;}
+    const std::vector<BankedEvent>& getEvents() const {return events;}
+};
+
+/**
+ * @brief Source energies and positions, and tally scores, of the histories of a run from a broad reference source.
+ *        Directions are isotropic for all sources, and the scores of a history are proportional to its source weight,
+ *        so the tallies of another source of the same particle type are the scores of each history times its
+ *        likelihood ratio, the density of its source energy and position for the target over the reference.
+ *        A spectrum sweep is then a sum over the bank per target instead of a run.
+ *        The reference spectrum must be continuous and span the target spectra, its shape must contain the target shapes.
+ *        The further a target is from the reference, the fewer histories carry its weight: when the effective sample size
+ *        (sum of the ratios)^2 / (sum of their squares) is below a tenth of the histories, a warning is printed.
+ */
+class HistoryBank
+{
+public:
+    /**
+     * @brief Quality of the likelihood ratios of a target source
+     */
+    struct Diagnostics
+    {
+        int histories = 0;
+        // mean likelihood ratio, close to 1 when the reference covers the target
+        double meanWeight = 0;
+        double maxWeight = 0;
+        // (sum of the ratios)^2 / (sum of their squares), the number of reference histories worth
+        double effectiveSampleSize = 0;
+        // probability of the target source inside the support of the reference, 1 if covered
+        double coverage = 0;
+        // mean per history of the reweighted total over all bins of all tallies and its standard error, set by reweight
+        double total = 0;
+        double totalError = 0;
+        /**
+         * @brief Check if the ratios are carried by too few histories
+         *
+         * @param minFraction Smallest effective sample size, in fraction of the histories
+         */
+        bool isDegenerate(const double minFraction=0.1) const {return !(effectiveSampleSize >= minFraction * histories);}
+    };
+
+    /**
+     * @brief Construct an empty bank
+     *
+     * @param tallies Tallies to be scored, their bins are copied. Time bins are not supported.
+     * @param lineWidth_ Monoenergetic sources are taken as uniform within this relative width around their energy
+     */
+    HistoryBank(const std::vector<Tally>& tallies, const double lineWidth_=0.01);
+    /**
+     * @brief Transport histories from the source of config, the reference, and keep their source energies,
+     *        positions and tally scores. Histories recorded before are dropped.
+     *
+     * @param config MC run settings
+     * @param nps Number of histories
+     * @param windows Weight windows, nullptr to kill particles lighter than config.minW
+     */
+    void transport(const MCSettings& config, const int nps, const WeightWindowMesh* windows=nullptr);
+    /**
+     * @brief Get the likelihood ratio of each history for a target source
+     *
+     * @param target Source to be reweighted to
+     * @return std::vector<double>
+     */
+    std::vector<double> getWeights(const Source& target) const;
+    /**
+     * @brief Get the quality of the likelihood ratios of a target source
+     */
+    Diagnostics diagnose(const Source& target) const;
+    /**
+     * @brief Add the scores of all histories times their likelihood ratios to the tallies, which then hold the
+     *        sums over getNPS() histories of the target source, as after a run. Prints a warning if the ratios
+     *        are degenerate or the reference does not cover the target.
+     *
+     * @param target Source to be reweighted to
+     * @param tallies Tallies to be updated, same bins as those of the constructor
+     * @return Diagnostics
+     */
+    Diagnostics reweight(const Source& target, std::vector<Tally>& tallies) const;
+    /**
+     * @brief Get the probability density of an energy in a source spectrum
+     *
+     * @param invCDF Inverse CDF of the spectrum, see Source
+     * @param energy Energy
+     * @param lineWidth Relative width of a monoenergetic spectrum
+     * @return double
+     */
+    static double getEnergyDensity(const std::vector<double>& invCDF, const double energy, const double lineWidth);
+
+    int getNPS() const {return energies.size();}
+    double getLineWidth() const {return lineWidth;}
+
+private:
+    Diagnostics diagnose(const Source& target, const std::vector<double>& weights) const;
+
+    double lineWidth;
+    // scores of the current history
+    std::vector<Tally> historyTallies;
+    // index of the first bin of each tally in the scores
+    std::vector<int> binOffsets;
+    std::unique_ptr<Source> reference;
+    std::vector<Vec3d> positions;
+    std::vector<double> energies;
+    // scores of history i are scores[firstScores[i]] to scores[firstScores[i + 1] - 1], with their bins
+    std::vector<std::size_t> firstScores{0};
+    std::vector<int> scoreBins;
+    std::vector<double> scores;
+};
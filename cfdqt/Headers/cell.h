@@ -10,6 +10,7 @@
 
 #pragma once
 
+#include <memory>
 #include "geometry.h"
 #include "data.h"
 #include "material.h"
@@ -19,6 +20,10 @@ class Particle
 {
 private:
 public:
+    // cm/ns
+    static constexpr double speedOfLight = 29.9792458;
+    // neutron rest energy, eV
+    static constexpr double neutronMass = 939.56542052e6;
     enum ParticleType {Photon, Neutron};
     /**
      * @brief Construct a new Particle
@@ -31,7 +36,7 @@ public:
      * @param n initial number of scatterings
      * @param b whether particle is outside of ROI
      */
-    Particle(const QVector3D& p, const QVector3D& d, const double erg, const double w,  const ParticleType t, const int n, const bool b)
+    Particle(const Vec3d& p, const Vec3d& d, const double erg, const double w,  const ParticleType t, const int n, const bool b)
         : pos(p), dir(d.normalized()), ergE(erg), weight(w), particleType(t), scatterN(n), escaped(b) 
     {
         initpos = pos;
@@ -45,16 +50,16 @@ public:
      * @param w initial weight
      * @param t particle type
      */
-    Particle(const QVector3D& p, const QVector3D& d, const double erg, const double w, const ParticleType t)
+    Particle(const Vec3d& p, const Vec3d& d, const double erg, const double w, const ParticleType t)
         : Particle(p, d, erg, w, t, 0, false) {}
     // particle type
     ParticleType particleType;
     // initial position
-    QVector3D initpos; // for debugging
+    Vec3d initpos; // for debugging
     // current position
-    QVector3D pos;
+    Vec3d pos;
     // current moving direction, unit vector
-    QVector3D dir;
+    Vec3d dir;
     // whether particle is outside of ROI
     bool escaped=false;
     // current particle weight
@@ -63,13 +68,40 @@ public:
     double ergE;
     // total number of scattering since creation
     int scatterN=0;
+    // time since creation, ns
+    double time=0;
 
     /**
-     * @brief Update particle position when it moves along current direction with given distance
+     * @brief Get the speed of a particle at given energy
+     * 
+     * @param erg Energy, MeV for gamma, eV for neutron
+     * @param t Particle type
+     * @return double Speed, cm/ns
+     */
+    static double speed(const double erg, const ParticleType t)
+    {
+        if (t == Photon)
+            return speedOfLight;
+        // relativistic, sqrt(T(T+2m)) / (T+m) avoids the cancellation in 1 - 1/gamma^2 at low energies
+        return speedOfLight * std::sqrt(erg * (erg + 2 * neutronMass)) / (erg + neutronMass);
+    }
+    /**
+     * @brief Get the current speed of the particle
+     * 
+     * @return double Speed, cm/ns
+     */
+    double getSpeed() const {return speed(ergE, particleType);}
+
+    /**
+     * @brief Update particle position and time when it moves along current direction with given distance
      * 
      * @param length Distance the particle should travel
      */
-    void move(const double length) {pos = pos + length * dir;}
+    void move(const double length) 
+    {
+        pos = pos + length * dir;
+        time += length / getSpeed();
+    }
 
     /**
      * @brief Update moving direction when the particle scatters with given scattering angle
@@ -85,19 +117,31 @@ private:
     // density of the material in cell, g/cc
     const double density;
     // shape of the cell
-    const Cylinder cylinder;
+    const std::shared_ptr<const Shape> shape;
 public:
     /**
      * @brief Construct a new Cell object
      * 
      * @param mat material in the cell
      * @param d density of the material, g/cc
-     * @param cyl shape of the cell
+     * @param s shape of the cell
      */
-    Cell(const Material& mat, const double d, const Cylinder& cyl)
+    Cell(const Material& mat, const double d, const std::shared_ptr<const Shape>& s)
         : material(mat),
           density(d),
-          cylinder(cyl)
+          shape(s)
+        {}
+    Cell(const Material& mat, const double d, const Cylinder& cyl)
+        : Cell(mat, d, std::make_shared<Cylinder>(cyl))
+        {}
+    /**
+     * @brief Construct a cell of the same shape filled with another material
+     * 
+     * @param cell Cell whose shape is shared
+     * @param mat material in the cell
+     */
+    Cell(const Cell& cell, const Material& mat)
+        : Cell(mat, mat.getDensity(), cell.shape)
         {}
     
     const Material material;
@@ -109,13 +153,22 @@ public:
      * @return true if the particle is in this cell.
      * @return false else
      */
-    bool contains(const Particle& p) const {return cylinder.contain(p.pos);}
+    bool contains(const Particle& p) const {return shape->contain(p.pos);}
+    const Shape& getShape() const {return *shape;}
+    /**
+     * @brief Get the length of a ray inside this cell, up to a given distance from the ray origin
+     * 
+     * @param ray 
+     * @param maxLength Only the part of the ray with t < maxLength is counted
+     * @return double Track length in this cell
+     */
+    double trackLength(const Ray& ray, const double maxLength) const;
 };
 
 class Source
 {
 private:
-    const Cylinder cylinder;
+    const std::shared_ptr<const Shape> shape;
     // inverse function of the cumulative probabilistic energy distribution
     const std::vector<double> invCDF;
     // width of the CDF bin
@@ -126,15 +179,15 @@ public:
     /**
      * @brief Construct a new Source object
      * 
-     * @param cyl Source shape. In this case it is a cylinder
+     * @param s Source shape. Positions are sampled uniformly in it
      * @param ergCDF Inverse function of the cumulative probabilistic energy distribution.
      *               A vector of energies. If only one element, the source is monoergetic.
      *               If N elements, there are N-1 equal-probable bins and 
      *               each elment E_i satifies P(E<E_i) = i/(N-1), i=0, ..., N-1
      * @param t Source particle type.
      */
-    Source(const Cylinder& cyl, const std::vector<double>& ergCDF, const Particle::ParticleType t)
-        : cylinder(cyl), invCDF(ergCDF), particleType(t)
+    Source(const std::shared_ptr<const Shape>& s, const std::vector<double>& ergCDF, const Particle::ParticleType t)
+        : shape(s), invCDF(ergCDF), particleType(t)
         {
             if (invCDF.size() > 1)
             {
@@ -142,8 +195,22 @@ public:
                 CDFBinWidth = 1.0 / (invCDF.size() - 1);
             }
         }
+    Source(const Cylinder& cyl, const std::vector<double>& ergCDF, const Particle::ParticleType t)
+        : Source(std::make_shared<Cylinder>(cyl), ergCDF, t)
+        {}
     // ~Source();
 
+    const Shape& getShape() const {return *shape;}
+    /**
+     * @brief Get the number of random numbers createParticle draws, the dimension of a source point
+     */
+    int getDimensions() const {return invCDF.size() == 1 ? 5 : 6;}
+    /**
+     * @brief Get the inverse of the cumulative energy distribution, see the constructor
+     */
+    const std::vector<double>& getEnergyCDF() const {return invCDF;}
+    Particle::ParticleType getParticleType() const {return particleType;}
+
     /**
      * @brief Create a Particle object. Position and direction uniformly sampled.
      *        Energy sampled based on the source energy CDF. Weight set to 1.
@@ -203,7 +270,7 @@ public:
     /**
      * @brief Construct a new MCSettings object
      * 
-     * @param cyl ROI, including all cells
+     * @param roi ROI, including all cells. Must be bounded.
      * @param cels List of cells
      * @param src Particle source
      * @param maxn Number of particles to run (NPS).
@@ -214,9 +281,9 @@ public:
      * @param mine Minimum particle energy allowed. 
      *             Stop tracking current particle if energy is smaller than this and go to next particle.
      */
-    MCSettings(const Cylinder& cyl, std::vector<Cell> cels, const Source& src, const int maxn, 
+    MCSettings(const std::shared_ptr<const Shape>& roi, std::vector<Cell> cels, const Source& src, const int maxn, 
                const int maxscattern, const double minw, const double mine)
-        : ROI(cyl), cells(cels), source(src), maxN(maxn), maxScatterN(maxscattern),
+        : ROI(roi), cells(cels), source(src), maxN(maxn), maxScatterN(maxscattern),
           minW(minw), minE(mine)
     {
         std::vector<double> maxatten;
@@ -238,8 +305,13 @@ public:
         }
         maxAtten = MaxAtten(ergs, maxatten);
     }
+    MCSettings(const Cylinder& cyl, std::vector<Cell> cels, const Source& src, const int maxn, 
+               const int maxscattern, const double minw, const double mine)
+        : MCSettings(std::make_shared<Cylinder>(cyl), cels, src, maxn, maxscattern, minw, mine)
+    {
+    }
     // region of interest
-    const Cylinder ROI;
+    const std::shared_ptr<const Shape> ROI;
     // list of cells
     const std::vector<Cell> cells;
     const Source source;
@@ -255,4 +327,14 @@ public:
      * @return double Max total attenuation coefficient.
      */
     double getMuMax(const double erg) const {return maxAtten.getMaxAtten(erg);}
+
+    /**
+     * @brief Get the length of the straight path between two points inside each cell.
+     *        Cells are assumed not to overlap.
+     * 
+     * @param from Start point
+     * @param to End point
+     * @param lengths Path length in each cell, same order as cells
+     */
+    void getCellPathLengths(const Vec3d& from, const Vec3d& to, std::vector<double>& lengths) const;
 };
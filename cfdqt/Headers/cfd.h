@@ -12,49 +12,74 @@
 #include "geometry.h"
 #include "data.h"
 #include "tracking.h"
+#include "pathfield.h"
+#include "detector.h"
+#include "sharedtally.h"
+#include "subsampling.h"
+#include <limits>
+#include <memory>
+#include <stdexcept>
 
 /**
- * @brief F2 tally. Spherical shape
+ * @brief F4 tally on a spherical, cylindrical or box-shaped detector, or F5 tally on a point detector
  * 
  */
 class Tally
 {
 private:
-    Sphere detector;
+    Detector detector;
+    // volume the flux is divided by, the detector volume if <= 0
+    double volume=0;
     Histogram hist;
     // true if using letharg bins
     bool letharg;
+    // energy x time counts, only filled if time bins are set
+    SparseHistogram2D timeHist;
+    bool timeBinned=false;
     int NPS=0;
+    // optional precomputed path lengths to the detector center
+    std::shared_ptr<const PathLengthField> pathField;
+    // if set, energy counts go to this storage shared by all threads instead of hist
+    std::shared_ptr<SharedTallyStorage> sharedCounts;
 public:
     /**
      * @brief Construct a new Tally object
      * 
-     * @param s Detector shape
+     * @param s Detector, a Sphere, a Cylinder, a Box or a point
      * @param nbins_ Number of energy bins
      * @param lower_ Lower energy limit
      * @param upper_ Upper energy limit
      */
-    Tally(const Sphere s, const int nbins_, const double lower_, const double upper_)
+    Tally(const Detector& s, const int nbins_, const double lower_, const double upper_)
         : Tally(s, nbins_, lower_, upper_, false) {}
-    Tally() : Tally(Sphere(QVector3D(0,0,0), 1),100,0,1) {}
+    Tally() : Tally(Sphere(Vec3d(0,0,0), 1),100,0,1) {}
     
     /**
      * @brief Construct a new Tally object
      * 
-     * @param s Detector shape
+     * @param s Detector, a Sphere, a Cylinder, a Box or a point
      * @param nbins_ Number of energy bins
      * @param lower_ Lower energy limit
      * @param upper_ Upper energy limit
      * @param letharg_ Whether using lethargy bins
      */
-    Tally(const Sphere s, const int nbins_, const double lower_, const double upper_, bool letharg_)
+    Tally(const Detector& s, const int nbins_, const double lower_, const double upper_, bool letharg_)
         : detector(s), letharg(letharg_) 
         {
             if(letharg)
-                hist = Histogram(nbins_, std::log10(lower_), std::log10(upper_));
+                hist = Histogram::logarithmic(nbins_, lower_, upper_);
             else
                 hist = Histogram(nbins_, lower_, upper_);
         }
+    /**
+     * @brief Construct a new Tally object with arbitrary energy bins, e.g. from an MCNP E card
+     * 
+     * @param s Detector, a Sphere, a Cylinder, a Box or a point
+     * @param edges Increasing energy bin edges
+     * @param letharg_ Whether the bins are meant to be shown on a log energy axis
+     */
+    Tally(const Detector& s, const std::vector<double>& edges, bool letharg_)
+        : detector(s), hist(edges), letharg(letharg_) {}
     
     /**
      * @brief Update tally counts when the particle will be detected with a given probability.
@@ -66,10 +91,41 @@ public:
     {
         if (isnan(prob))
             return;
-        if (letharg)
-            hist.fill(std::log10(particle.ergE), particle.weight * prob);
-        else
-            hist.fill(particle.ergE, particle.weight * prob);
+        const int binIdx = hist.findBin(particle.ergE);
+        if (binIdx < 0)
+            return;
+        if (sharedCounts)
+        {
+            sharedCounts->add(binIdx, particle.weight * prob);
+            return;
+        }
+        hist.fillBin(binIdx, particle.weight * prob);
+        if (timeBinned)
+            timeHist.fillBin(binIdx, particle.time, particle.weight * prob);
+    }
+    /**
+     * @brief Add contributions to energy bins that are already known, e.g. when scoring at the bin centers,
+     *        without searching for the bins again.
+     * 
+     * @param binIdx Energy bin indices, 0 <= binIdx[i] < getNBins()
+     * @param weights Contribution to each bin, particle weight included
+     * @param times Arrival time for each bin, only used with time bins
+     */
+    void scoreBins(const std::vector<int>& binIdx, const std::vector<double>& weights, const std::vector<double>& times={})
+    {
+        for (std::size_t i = 0; i < binIdx.size(); i++)
+        {
+            if (isnan(weights[i]))
+                continue;
+            if (sharedCounts)
+            {
+                sharedCounts->add(binIdx[i], weights[i]);
+                continue;
+            }
+            hist.fillBin(binIdx[i], weights[i]);
+            if (timeBinned)
+                timeHist.fillBin(binIdx[i], times[i], weights[i]);
+        }
     }
 
     /**
@@ -81,92 +137,258 @@ public:
     double trackLength(const Particle& particle) const
     {
         Ray ray = Ray(particle.pos, particle.dir);
-        return detector.intersection(ray);
+        return detector.chordLength(ray);
+    }
+    /**
+     * @brief Get the integral of the chord length over all directions from a point outside of the detector,
+     *        divided by 2 pi. See Detector::chordIntegral.
+     * 
+     * @param pos Particle position
+     * @return double 
+     */
+    double chordIntegral(const Vec3d& pos) const {return detector.chordIntegral(pos);}
+    /**
+     * @brief Get the flux per unit probability of scattering into 1 / (2 pi) sr towards the detector:
+     *        chordIntegral(pos) / getVolume() for a volume detector, Detector::pointFactor(pos) for a point.
+     * 
+     * @param pos Particle position
+     * @return double cm^-2
+     */
+    double geometryFactor(const Vec3d& pos) const
+    {
+        if (detector.getType() == Detector::PointDetector)
+            return detector.pointFactor(pos);
+        return detector.chordIntegral(pos) / getVolume();
     }
+    bool isPointDetector() const {return detector.getType() == Detector::PointDetector;}
 
-    QVector3D getCenter() const 
+    Vec3d getCenter() const 
     {
         return detector.getCenter();
     }
     int getNBins() const {return hist.getNBins();}
-    double getBinCenter(int binIdx) const 
+    /**
+     * @brief Get the center of an energy bin, the geometric mean of its edges for lethargy bins
+     */
+    double getBinCenter(int binIdx) const {return hist.getBinCenter(binIdx);}
+    std::vector<double> getBinCenters() const {return hist.getBinCenters();}
+    const std::vector<double>& getBinEdges() const {return hist.getBinEdges();}
+    /**
+     * @brief Get the counts of the energy bins, including those in the shared storage while the counts are shared.
+     *        Not to be called while threads are filling the shared storage.
+     */
+    std::vector<double> getBinContents() const
     {
-        if (letharg)
-            return std::pow(10, hist.getBinCenter(binIdx));
-        else
-            return hist.getBinCenter(binIdx);
+        std::vector<double> counts = hist.getBinContents();
+        if (sharedCounts)
+        {
+            const std::vector<double> shared = sharedCounts->getBinContents();
+            for (std::size_t i = 0; i < counts.size(); i++)
+                counts[i] += shared[i];
+        }
+        return counts;
     }
-    std::vector<double> getBinCenters() const
+    double getBinContent(int binIdx) const
     {
-        std::vector<double> tmp = hist.getBinCenters();
-        if (letharg) {
-            for(int i=0;i<tmp.size();i++)
-                tmp[i] = std::pow(10, tmp[i]);
-        }
-        return tmp;
+        return sharedCounts ? hist.getBinContent(binIdx) + sharedCounts->getBinContent(binIdx) : hist.getBinContent(binIdx);
     }
-    std::vector<double> getBinContents() const {return hist.getBinContents();}
-    double getBinContent(int binIdx) const {return hist.getBinContent(binIdx);}
     /**
-     * @brief Get the lower energy limit of tally
+     * @brief Get the lower energy limit of tally, the lower edge of the first bin
      * 
      * @return double 
      */
-    double getMinE() const 
-    {
-        if (letharg)
-            return std::pow(10, hist.getBinCenter(0));
-        else
-            return hist.getBinCenter(0);
-    }
+    double getMinE() const {return hist.getBinEdges().front();}
     /**
-     * @brief Get the upper energy limit of tally
+     * @brief Get the upper energy limit of tally, the upper edge of the last bin
      * 
      * @return double 
      */
-    double getMaxE() const 
-    {
-        if (letharg)
-            return std::pow(10, hist.getBinCenter(hist.getNBins() - 1));
-        else
-            return hist.getBinCenter(hist.getNBins() - 1);
-    }
+    double getMaxE() const {return hist.getBinEdges().back();}
     /**
      * @brief Get the width of the i-th energy bin
      * 
      * @param binIdx Index of energy bin
      * @return double Energy bin width
      */
-    double getBinWidth(int binIdx) const
-    {
-        if (letharg)
-            return std::pow(10, hist.getBinCenter(binIdx) + hist.getBinWidth() / 2.0) - std::pow(10, hist.getBinCenter(binIdx) - hist.getBinWidth() / 2.0);
-        else
-            return hist.getBinWidth();
-    }
+    double getBinWidth(int binIdx) const {return hist.getBinWidth(binIdx);}
     double getArea() const {return 1.0;}
     /**
-     * @brief Get the detector volume
+     * @brief Get the volume the flux is divided by, the detector volume unless set by setVolume.
+     *        Not used by point detectors.
      * 
      * @return double 
      */
-    double getVolume() const {return 1.0;}
+    double getVolume() const {return volume > 0 ? volume : detector.getVolume();}
     /**
-     * @brief Get the detector radius
+     * @brief Divide the flux by another volume, e.g. 1 to get the track length like SD 1 in MCNP
+     * 
+     * @param v Volume, cm^3. The detector volume is used again if v <= 0
+     */
+    void setVolume(const double v) {volume = v;}
+    /**
+     * @brief Get the detector radius, the radius of the sphere bounding a cylinder or a box,
+     *        or the exclusion radius of a point detector
      * 
      * @return double 
      */
     double getRadius() const {return detector.getRadius();}
+    const Detector& getDetector() const {return detector;}
 
     int getNPS() const {return NPS;}
 
     bool isLethargyBin() const {return letharg;}
 
     void setNPS(const int n) {NPS=n;}
-    void setCenter(const QVector3D& newc) {detector.setCenter(newc);}
+    /**
+     * @brief Use precomputed path lengths to the detector center instead of tracing the geometry.
+     *        The field is dropped when the detector moves away from its target.
+     * 
+     * @param field Path length field whose target is the detector center
+     */
+    void setPathLengthField(std::shared_ptr<const PathLengthField> field) {pathField = field;}
+    const PathLengthField* getPathLengthField() const {return pathField.get();}
+
+    void setCenter(const Vec3d& newc) 
+    {
+        detector.setCenter(newc);
+        if (pathField && pathField->getTarget() != newc)
+            pathField.reset();
+    }
     void setRadius(const double newr) {detector.setRadius(newr);}
-    void reset() {hist.clear();}
-    void scaling(const double f) {hist.scaling(f);}
+    /**
+     * @brief Send the energy counts to a storage shared by all threads instead of the bins of this tally,
+     *        so that several threads can score in this tally at the same time.
+     *        Not available with time bins.
+     * 
+     * @param storage Storage with the number of energy bins of this tally
+     */
+    void shareCounts(std::shared_ptr<SharedTallyStorage> storage)
+    {
+        if (timeBinned)
+            throw std::runtime_error("Tallies with time bins cannot share their counts.");
+        if (storage->getNBins() != hist.getNBins())
+            throw std::runtime_error("Shared storage does not match the energy bins of the tally.");
+        sharedCounts = storage;
+    }
+    bool hasSharedCounts() const {return static_cast<bool>(sharedCounts);}
+    /**
+     * @brief Add the counts of the shared storage to the bins of this tally, and stop sharing
+     */
+    void collectSharedCounts()
+    {
+        if (!sharedCounts)
+            return;
+        hist.addBinContents(sharedCounts->getBinContents());
+        sharedCounts.reset();
+    }
+    /**
+     * @brief Set all counts to 0. Shared counts must be collected first.
+     */
+    void reset()
+    {
+        if (sharedCounts)
+            throw std::runtime_error("Collect the shared counts before resetting the tally.");
+        hist.clear();
+        timeHist.clear();
+    }
+    /**
+     * @brief Scale all counts. Shared counts must be collected first.
+     */
+    void scaling(const double f)
+    {
+        if (sharedCounts)
+            throw std::runtime_error("Collect the shared counts before scaling the tally.");
+        hist.scaling(f);
+        timeHist.scaling(f);
+    }
+    /**
+     * @brief Add the counts of a tally with the same energy bins, e.g. scored by another thread,
+     *        including those in its shared storage
+     * 
+     * @param other Tally to be added
+     */
+    void add(const Tally& other) 
+    {
+        hist.add(other.hist);
+        if (other.sharedCounts)
+            hist.addBinContents(other.sharedCounts->getBinContents());
+        if (timeBinned)
+            timeHist.add(other.timeHist);
+    }
+
+    /**
+     * @brief Also tally the flux against the time the particles arrive at the detector center,
+     *        in equal-size time bins. Counts of the new bins start at 0. 
+     *        Bins that are never filled take no memory.
+     * 
+     * @param nbins_ Number of time bins
+     * @param lower_ Lower time limit, ns
+     * @param upper_ Upper time limit, ns
+     */
+    void setTimeBins(const int nbins_, const double lower_, const double upper_)
+    {
+        if (sharedCounts)
+            throw std::runtime_error("Tallies with shared counts cannot have time bins.");
+        // x is the energy bin index
+        timeHist = SparseHistogram2D(hist.getNBins(), 0, hist.getNBins(), nbins_, lower_, upper_);
+        timeBinned = true;
+    }
+    bool hasTimeBins() const {return timeBinned;}
+    int getNTimeBins() const {return timeBinned ? timeHist.getNBinsY() : 0;}
+    double getTimeBinCenter(const int timeIdx) const {return timeHist.getBinCenterY(timeIdx);}
+    double getTimeBinWidth() const {return timeHist.getBinWidthY();}
+    /**
+     * @brief Get the counts of an energy bin and a time bin
+     */
+    double getBinContent(const int binIdx, const int timeIdx) const {return timeHist.getBinContent(binIdx, timeIdx);}
+    /**
+     * @brief Get the counts of each time bin, summed over all energy bins
+     */
+    std::vector<double> getTimeSpectrum() const {return timeHist.projectionY();}
+    const SparseHistogram2D& getTimeHistogram() const {return timeHist;}
+};
+
+/**
+ * @brief Detector-independent quantities of a source or collision event.
+ *        Computed once per event and shared by all tallies scored from it.
+ * 
+ */
+struct CollisionContext
+{
+    /**
+     * @brief Construct a new Collision Context object
+     * 
+     * @param particle Particle at the source or collision site, before scattering
+     * @param config MC run settings
+     */
+    CollisionContext(const Particle& particle, const MCSettings& config);
+
+    /**
+     * @brief Get the probability that a newly-created particle travels a distance along its direction 
+     *        without interacting, through every cell. The segments of the ray in each cell are found on first use
+     *        and reused for all detectors.
+     * 
+     * @param particle The particle this context was built for
+     * @param config MC run settings
+     * @param distance Distance along the direction, cm. By default the whole ray
+     * @return double 
+     */
+    double getPrimaryTransmission(const Particle& particle, const MCSettings& config,
+                                  const double distance=std::numeric_limits<double>::infinity()) const;
+
+    // photon, integral of the Klein-Nishina cross section at the incoming energy
+    double comptonIntegral = 0;
+    // neutron, total microscopic cross section of the material (weighted by composition), barn
+    double totalCrossSection = 0;
+    // neutron, composition times elastic microscopic cross section of each nuclide, barn
+    std::vector<double> elasticCrossSections;
+    // thermal neutron, normalization of the free-gas scattering kernel of each nuclide
+    std::vector<double> thermalNormalizations;
+private:
+    // segments of the ray along the particle direction in each cell
+    mutable std::vector<std::vector<Segment>> primarySegments;
+    // attenuation coefficient of each cell at the particle energy, cm^-1
+    mutable std::vector<double> primaryAtten;
 };
 
 /**
@@ -178,59 +400,176 @@ public:
  * @return int
  */
 int forceDetection(Particle& particle, const MCSettings& config, Tally& tally);
+/**
+ * @brief Update the counts of several tallies when the particle is forced to travel towards each detector.
+ *        Detector-independent work is done once for all tallies.
+ *
+ * @param particle Current particle
+ * @param config MC run settings
+ * @param tallies Tallies to be updated
+ * @return int
+ */
+int forceDetection(Particle& particle, const MCSettings& config, std::vector<Tally>& tallies);
+
+/**
+ * @brief Decide whether an event is scored, with the probability given by SubsamplingPolicy::GetInstance(),
+ *        by default 1% of the thermal neutron collisions and all other events.
+ *        Draws a random number only for events scored with a probability below 1.
+ * 
+ * @param particle Particle at the source or collision site
+ * @return true if the event is scored
+ */
+bool sampleEventScoring(const Particle& particle);
+/**
+ * @brief Update the counts of several tallies for an event that has been selected by sampleEventScoring.
+ *        Events are weighted by the inverse of their probability of being selected.
+ *        Draws no random numbers, so it can be called from several threads.
+ * 
+ * @param particle Particle at the source or collision site
+ * @param config MC run settings
+ * @param tallies Tallies to be updated
+ * @return int 
+ */
+int forceDetectionSampled(const Particle& particle, const MCSettings& config, std::vector<Tally>& tallies);
+/**
+ * @brief Update the counts of several tallies for a selected event whose context has already been computed,
+ *        e.g. to score one event in many groups of tallies.
+ * 
+ * @param particle Particle at the source or collision site
+ * @param config MC run settings
+ * @param context Detector-independent quantities of the event
+ * @param tallies Tallies to be updated
+ * @return int 
+ */
+int forceDetectionSampled(const Particle& particle, const MCSettings& config, const CollisionContext& context, std::vector<Tally>& tallies);
+/**
+ * @brief Run histories where every event is scored, and measure per estimator and energy band of the current
+ *        SubsamplingPolicy the scores and time of the events, to tune the policy with SubsamplingPolicy::optimize.
+ *        Scores are summed over all bins of all tallies. Particles are tracked as in the history loops,
+ *        down to config.minW.
+ *
+ * @param config MC run settings
+ * @param tallies Tallies to be converged, copied
+ * @param pilotN Number of pilot histories
+ * @return SubsamplingPolicy::Pilot
+ */
+SubsamplingPolicy::Pilot runSubsamplingPilot(const MCSettings& config, std::vector<Tally> tallies, const int pilotN);
 
 /**
  * @brief Update tally counts contributed by a newly-created photon (primary contribution)
  * 
  * @param particle A newly-created photon
  * @param config MC run settings
- * @param tally Energy tally
+ * @param context Detector-independent quantities of the event
+ * @param tallies Energy tallies
  * @return int 
  */
-int primaryContributionPhoton(const Particle& particle, const MCSettings& config, Tally& tally);
+int primaryContributionPhoton(const Particle& particle, const MCSettings& config, const CollisionContext& context, std::vector<Tally>& tallies);
 /**
  * @brief Update tally counts if a photon were scattered towards the detector
  * 
  * @param particle Photon to be scattered
  * @param config MC run settings
- * @param tally Tally to be updated
+ * @param context Detector-independent quantities of the collision
+ * @param tallies Tallies to be updated
  * @return int 
  */
-int scatterContributionPhoton(Particle particle, const MCSettings& config, Tally& tally);
+int scatterContributionPhoton(const Particle& particle, const MCSettings& config, const CollisionContext& context, std::vector<Tally>& tallies);
 
 /**
  * @brief Update tally counts when the neutron is forced to travel towards the detector
  * 
  * @param particle Current neutron
  * @param config MC run settings
- * @param tally Tally to be updated
+ * @param tallies Tallies to be updated
  * @return int 
  */
-int forceDetectionNeutron(Particle& particle, const MCSettings& config, Tally& tally);
+int forceDetectionNeutron(Particle& particle, const MCSettings& config, std::vector<Tally>& tallies);
 /**
  * @brief Update tally counts contributed by a newly-created neutron (primary contribution)
  * 
  * @param particle A newly-created neutron
  * @param config MC run settings
- * @param tally Tally to be updated
+ * @param context Detector-independent quantities of the event
+ * @param tallies Tallies to be updated
  * @return int 
  */
-int primaryContributionNeutron(const Particle& particle, const MCSettings& config, Tally& tally);
+int primaryContributionNeutron(const Particle& particle, const MCSettings& config, const CollisionContext& context, std::vector<Tally>& tallies);
 /**
  * @brief Update tally counts if a fast neutron were scattered towards the detector
  * 
  * @param particle Fast neutron to be scattered
  * @param config MC run settings
- * @param tally Tally to be updated
+ * @param context Detector-independent quantities of the collision
+ * @param tallies Tallies to be updated
  * @return int 
  */
-int scatterContributionNeutron(Particle particle, const MCSettings& config, Tally& tally);
+int scatterContributionNeutron(const Particle& particle, const MCSettings& config, const CollisionContext& context, std::vector<Tally>& tallies);
 /**
  * @brief Update tally counts if a thermal neutron were scattered towards the detector
  * 
  * @param particle Thermal neutron to be scattered
  * @param config MC run settings
- * @param tally Tally to be updated
+ * @param context Detector-independent quantities of the collision
+ * @param tallies Tallies to be updated
  * @return int 
  */
-int scatterContributionThermalNeutron(Particle particle, const MCSettings& config, Tally& tally);
+int scatterContributionThermalNeutron(const Particle& particle, const MCSettings& config, const CollisionContext& context, std::vector<Tally>& tallies);
+
+/**
+ * @brief Deterministic uncollided flux of the source in the detector of a tally, per source particle,
+ *        to be added to the tally instead of sampling the primary contribution.
+ *        The unit cube mapped to the source by Shape::samplePoint is split adaptively into boxes, each integrated
+ *        with the 3-point Gauss-Legendre product rule and its error estimated with the 2-point rule, until the
+ *        estimated error is below the tolerance. At each point the flux in a volume detector is integrated over
+ *        the cone of directions bounding the detector, each ray scoring its chord length attenuated through
+ *        every cell up to where it enters the detector, as the sampled primary contribution does;
+ *        a point detector is scored like the primary contribution. Source energies are integrated at equal-probable points of the source spectrum.
+ */
+class UncollidedFlux
+{
+public:
+    /**
+     * @brief Integrate the uncollided flux
+     *
+     * @param config MC run settings
+     * @param tally Tally whose detector, energy and time bins are used, not filled
+     * @param relTolerance Relative error of the integral over all energies to reach
+     * @param maxBoxes Largest number of boxes the source is split into
+     * @param directionOrder Number of Gauss-Legendre points in the cone angle, twice as many azimuths
+     */
+    UncollidedFlux(const MCSettings& config, const Tally& tally, const double relTolerance=1e-4,
+                   const int maxBoxes=2000, const int directionOrder=8);
+
+    /**
+     * @brief Add the uncollided flux of a number of source particles to a tally with the same bins
+     *
+     * @param tally Tally the flux was integrated for, or a copy of it
+     * @param nps Number of source particles
+     */
+    void addTo(Tally& tally, const double nps) const;
+    /**
+     * @brief Get the flux per source particle, in the bins of the tally
+     */
+    const Tally& getFlux() const {return flux;}
+    /**
+     * @brief Get the flux per source particle summed over all energies
+     */
+    double getTotal() const {return total;}
+    /**
+     * @brief Get the estimated error of getTotal()
+     */
+    double getErrorEstimate() const {return errorEstimate;}
+    int getNBoxes() const {return nBoxes;}
+    /**
+     * @brief Get the number of source points the flux was evaluated at
+     */
+    int getEvaluations() const {return evaluations;}
+
+private:
+    Tally flux;
+    double total=0;
+    double errorEstimate=0;
+    int nBoxes=0;
+    int evaluations=0;
+};
@@ -14,11 +14,22 @@
 #include <string>
 #include <fstream>
 #include <sstream>
+#include <unordered_map>
+#include <cmath>
+#include <algorithm>
 // #include <filesystem>
 
+/**
+ * @brief 1D histogram with equal-size, logarithmic or arbitrary bins.
+ *        Bin edges, centers and widths are computed once. Evenly spaced edges, linearly or logarithmically,
+ *        are found in O(1), optionally after a first bin starting at 0 like the bins of MCNP E cards.
+ *        Irregular edges are found by a branchless binary search.
+ */
 class Histogram
 {
 public:
+    enum Spacing {Uniform, Logarithmic, Irregular};
+
     Histogram() {}
     /**
      * @brief Construct a new Histogram object
@@ -34,22 +45,82 @@ public:
     {
         rebin(nbins, lowerEdge, upperEdge);
     }
+    /**
+     * @brief Construct a new Histogram object with given bin edges.
+     *        Edges evenly spaced within a relative tolerance of 1e-9 use the O(1) bin search,
+     *        corrected against the given edges so that bins match them exactly.
+     * 
+     * @param edges_ Increasing bin edges, nbins + 1 values
+     */
+    explicit Histogram(const std::vector<double>& edges_);
+    /**
+     * @brief Construct a new Histogram object with bins of equal width in log(x)
+     * 
+     * @param nbins_ Number of bins
+     * @param lower_ Left edge of first bin, > 0
+     * @param upper_ Right edge of last bin
+     * @return Histogram 
+     */
+    static Histogram logarithmic(const int nbins_, const double lower_, const double upper_);
 
     // getters
     int getNBins() const;
     double getBinContent(const int& binIndex) const;
+    /**
+     * @brief Get the bin center, the geometric mean of the edges for logarithmic bins
+     */
     double getBinCenter(const int& binIndex) const;
     std::vector<double> getBinCenters() const;
     std::vector<double> getBinContents() const;
     int getTotalCounts() const;
+    /**
+     * @brief Get the width of equal-size bins
+     */
     double getBinWidth() const {return binwidth;}
+    double getBinWidth(const int binIndex) const {return binWidths[binIndex];}
+    double getLowerEdge() const {return lowerEdge;}
+    double getUpperEdge() const {return upperEdge;}
+    const std::vector<double>& getBinEdges() const {return edges;}
+    Spacing getSpacing() const {return spacing;}
+
+    /**
+     * @brief Find the bin that contains x, edges[i] <= x < edges[i + 1]
+     * 
+     * @param x Value
+     * @return int Bin index, -1 if x is out of range
+     */
+    int findBin(const double x) const
+    {
+        if (!(x >= lowerEdge && x < upperEdge))
+            return -1;
+        if (spacing == Irregular || x < edges[regularFrom])
+            return searchBin(x);
+        // O(1) estimate, then corrected against the edges
+        const double t = spacing == Uniform ? (x - regularLower) * invRegularWidth : (std::log(x) - regularLower) * invRegularWidth;
+        int binIndex = regularFrom + std::min(static_cast<int>(t), nbins - 1 - regularFrom);
+        if (x < edges[binIndex])
+            binIndex--;
+        else if (x >= edges[binIndex + 1])
+            binIndex++;
+        return binIndex;
+    }
 
     // setters
     void setBinContents(const std::vector<double> counts);
     void scaling(const double f);
+    // add the counts of a histogram with the same bin edges
+    void add(const Histogram& other);
+    // add counts to every bin
+    void addBinContents(const std::vector<double>& counts);
     
     // fill new data
     bool fill(const double item, const double weight=1);
+    // add weight to a bin found by findBin
+    void fillBin(const int binIndex, const double weight=1)
+    {
+        binCounts[binIndex] += weight;
+        totalCounts += weight;
+    }
 
     // clear bin data
     void clear();
@@ -58,13 +129,93 @@ public:
     void rebin(const int nbins_, const double lower_, const double upper_);
 
 private:
-    int nbins;
-    double lowerEdge;
-    double upperEdge;
-    double binwidth;
+    int nbins=0;
+    double lowerEdge=0;
+    double upperEdge=0;
+    double binwidth=0;
+    Spacing spacing=Uniform;
+    std::vector<double> edges;
     std::vector<double> binCenters;
+    std::vector<double> binWidths;
     std::vector<double> binCounts;
-    int totalCounts;
+    int totalCounts=0;
+    // the O(1) search applies from edges[regularFrom], 1 if only the first bin breaks the spacing
+    int regularFrom=0;
+    // edges[regularFrom], or its log, and inverse of the regular bin width in x or log(x)
+    double regularLower=0;
+    double invRegularWidth=0;
+
+    int searchBin(const double x) const;
+    // detect the spacing of the edges and cache the bin centers and widths
+    void setEdges(const std::vector<double>& edges_, const bool keepCenters);
+};
+
+/**
+ * @brief 2D histogram with equal-size bins along each axis that only stores the bins filled so far,
+ *        e.g. energy x time tallies where most bins of a fine time grid stay empty.
+ * 
+ */
+class SparseHistogram2D
+{
+public:
+    SparseHistogram2D() {}
+    /**
+     * @brief Construct a new Sparse Histogram 2D object
+     * 
+     * @param nx_ Number of bins along x
+     * @param xlower_ Left edge of first x bin
+     * @param xupper_ Right edge of last x bin
+     * @param ny_ Number of bins along y
+     * @param ylower_ Left edge of first y bin
+     * @param yupper_ Right edge of last y bin
+     */
+    SparseHistogram2D(const int nx_, const double xlower_, const double xupper_,
+                      const int ny_, const double ylower_, const double yupper_);
+
+    int getNBinsX() const {return nx;}
+    int getNBinsY() const {return ny;}
+    double getBinCenterX(const int ix) const {return xlower + (ix + 0.5) * xwidth;}
+    double getBinCenterY(const int iy) const {return ylower + (iy + 0.5) * ywidth;}
+    double getBinWidthX() const {return xwidth;}
+    double getBinWidthY() const {return ywidth;}
+    double getBinContent(const int ix, const int iy) const;
+    /**
+     * @brief Get the number of bins that have been filled, i.e. stored
+     */
+    std::size_t getNFilledBins() const {return counts.size();}
+    /**
+     * @brief Get the counts summed over x, for each y bin
+     */
+    std::vector<double> projectionY() const;
+    /**
+     * @brief Get the counts summed over y, for each x bin
+     */
+    std::vector<double> projectionX() const;
+    /**
+     * @brief Get all bins, row-major, counts[ix * ny + iy]
+     */
+    std::vector<double> getDenseContents() const;
+
+    // fill new data, returns false if (x, y) is out of range
+    bool fill(const double x, const double y, const double weight=1);
+    // fill new data in a known x bin, returns false if y is out of range
+    bool fillBin(const int ix, const double y, const double weight=1);
+    void scaling(const double f);
+    // add the counts of a histogram with the same binning
+    void add(const SparseHistogram2D& other);
+    void clear() {counts.clear();}
+
+private:
+    int nx=0;
+    int ny=0;
+    double xlower=0;
+    double xupper=0;
+    double xwidth=1;
+    double ylower=0;
+    double yupper=0;
+    double ywidth=1;
+    // bin (ix, iy) is stored at key ix * ny + iy
+    std::unordered_map<long long, double> counts;
 };
 
 // std::string getRootDir();
\ No newline at end of file
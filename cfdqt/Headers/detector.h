@@ -0,0 +1,171 @@
+/**
+ * @file detector.h
+ * @brief detectors of the CFD tallies: spheres, right circular cylinders, boxes and points
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "geometry.h"
+
+/**
+ * @brief Integral of the chord length over all directions from a point, G(p) = \int chord(p, \Omega) d\Omega,
+ *        which equals the integral of 1/r^2 over the detector volume.
+ *        The F4 estimators need G / (2 pi V) for a particle scattered at p towards the detector.
+ *
+ *        For a cylinder, f = G L^2 / V is tabulated against s = Rb / L and |cos(theta)|, where L is the distance
+ *        from p to the center, Rb the radius of the bounding sphere and theta the angle between p and the axis.
+ *        f is 1 for a point detector (s = 0). Points within the bounding sphere (s > 1) are integrated directly.
+ */
+class GeometryFactorTable
+{
+private:
+    // local cylinder, centered at the origin
+    std::shared_ptr<const Cylinder> shape;
+    // bounding sphere radius
+    double boundRadius;
+    double volume;
+    // number of nodes along s and |cos(theta)|
+    int nodes[2];
+    // values[i * nmu + j] is f at node (s_i, mu_j)
+    std::vector<double> values;
+public:
+    /**
+     * @brief Tabulate the geometry factor of a cylinder
+     *
+     * @param s Cylinder centered at the origin
+     * @param ns Number of nodes along s
+     * @param nmu Number of nodes along |cos(theta)|
+     */
+    GeometryFactorTable(const std::shared_ptr<const Cylinder>& s, const int ns, const int nmu);
+
+    /**
+     * @brief Get G at a point, interpolated in the table
+     *
+     * @param p Point relative to the detector center
+     * @return double G, cm * sr
+     */
+    double getIntegral(const Vec3d& p) const;
+
+    /**
+     * @brief Integrate the chord length of a shape over the cone of directions from p that contains
+     *        its bounding sphere, with Gauss-Legendre nodes in cos(angle to the cone axis) and uniform azimuths.
+     *
+     * @param shape Shape
+     * @param p Start point of the chords
+     * @param center Center of the bounding sphere
+     * @param boundRadius Radius of the bounding sphere
+     * @param npolar Number of polar nodes
+     * @param nazimuth Number of azimuthal nodes
+     * @return double G, cm * sr
+     */
+    static double integrateChordLengths(const Shape& shape, const Vec3d& p, const Vec3d& center, const double boundRadius,
+                                        const int npolar=32, const int nazimuth=48);
+};
+
+/**
+ * @brief Detector of a tally. The detector center is the point the CFD particles are forced towards.
+ *        Volume detectors score the average flux in the volume (F4), point detectors the flux at the center
+ *        with a next-event estimator (F5).
+ *
+ */
+class Detector
+{
+public:
+    enum DetectorType {SphereDetector, CylinderDetector, BoxDetector, PointDetector};
+private:
+    DetectorType type;
+    Vec3d center;
+    // sphere radius, bounding sphere radius of a cylinder or a box, or exclusion radius of a point
+    double radius;
+    // cylinder or box centered at the origin
+    std::shared_ptr<const TransformedShape> localShape;
+    // cylinders only
+    std::shared_ptr<const GeometryFactorTable> table;
+
+    /**
+     * @brief G of the box for p relative to its center. The divergence theorem with div(r / r^2) = 1 / r^2
+     *        turns the volume integral into a sum over the faces of d * \int dS / r^2, d being the signed distance
+     *        from p to the face plane, and each face integral reduces to 1D integrals over the polar angle
+     *        around the foot of p, (1 / 2) \int ln(1 + R(phi)^2 / d^2) dphi.
+     */
+    double boxIntegral(const Vec3d& p) const;
+public:
+    /**
+     * @brief Construct a new spherical Detector
+     */
+    Detector(const Sphere& s) : type(SphereDetector), center(s.getCenter()), radius(s.getRadius()) {}
+    /**
+     * @brief Construct a new cylindrical Detector, along any axis. The geometry factor table is built here.
+     */
+    Detector(const Cylinder& c);
+    /**
+     * @brief Construct a new box Detector. The box must not be scaled or sheared by its transform.
+     */
+    Detector(const Box& b);
+    /**
+     * @brief Construct a new point Detector. Within the exclusion radius R0 of the point, where 1 / L^2 is unbounded,
+     *        the collision density is assumed uniform and 1 / L^2 is replaced by its average over the sphere, 3 / R0^2.
+     *
+     * @param c Detector point
+     * @param exclusionRadius R0, cm. 0 for no exclusion sphere, which gives an infinite variance
+     *                        if collisions occur around the point.
+     */
+    Detector(const Vec3d& c, const double exclusionRadius) : type(PointDetector), center(c), radius(exclusionRadius) {}
+
+    DetectorType getType() const {return type;}
+    Vec3d getCenter() const {return center;}
+    /**
+     * @brief Get the sphere radius, the radius of the sphere bounding a cylinder or a box, 
+     *        or the exclusion radius of a point
+     */
+    double getRadius() const {return radius;}
+    /**
+     * @brief Get the detector volume, 0 for a point
+     */
+    double getVolume() const;
+    /**
+     * @brief Get the shape of the detector at its current position, the exclusion sphere for a point
+     */
+    std::shared_ptr<const Shape> getShape() const;
+
+    /**
+     * @brief Get the length of a ray inside the detector, 0 for a point
+     */
+    double chordLength(const Ray& ray) const;
+    /**
+     * @brief Get the entry and exit distances of a ray through the detector, see Shape::intersect.
+     *        False if the ray misses it, and always for a point.
+     */
+    bool intersect(const Ray& ray, Segment& seg) const;
+    /**
+     * @brief Get the integral of the chord length over all directions from p, divided by 2 pi, G(p) / (2 pi),
+     *        for a particle at p outside of the detector.
+     *        For a sphere it is L * (r - (1 - r^2) / 2 * ln((1 + r) / (1 - r))), r = R / L.
+     *        Boxes are integrated over their faces, cylinders are interpolated in a geometry factor table.
+     *
+     * @param p Particle position
+     * @return double cm
+     */
+    double chordIntegral(const Vec3d& p) const;
+    /**
+     * @brief Get the point detector equivalent of chordIntegral(p) / volume, 1 / (2 pi L^2) for a particle at p,
+     *        L being the distance to the point, or 3 / (2 pi R0^2) within the exclusion radius R0.
+     *
+     * @param p Particle position
+     * @return double cm^-2
+     */
+    double pointFactor(const Vec3d& p) const;
+
+    void setCenter(const Vec3d& c) {center = c;}
+    /**
+     * @brief Set the radius of a spherical detector, or the exclusion radius of a point
+     */
+    void setRadius(const double r);
+};
@@ -11,10 +11,10 @@
 #ifndef GEOMETRY_H
 #define GEOMETRY_H
 
-#include <QtMath>
-#include <QVector2D>
-#include <QVector3D>
-#include <QVector>
+#include <cmath>
+#include <limits>
+#include <vector>
+#include "vec3d.h"
 
 /**
  * @brief single-end ray is represented as x_i = origin + t * direction, t > 0
@@ -23,8 +23,8 @@
 class Ray
 {
 private:
-    QVector3D origin;
-    QVector3D direction; // unit vector
+    Vec3d origin;
+    Vec3d direction; // unit vector
 public:
     /**
      * @brief Construct a new Ray object
@@ -32,19 +32,34 @@ public:
      * @param p Origin of the ray
      * @param d Direction of the ray
      */
-    Ray(const QVector3D& p, const QVector3D& d)
+    Ray(const Vec3d& p, const Vec3d& d)
        : origin(p), 
          direction(d.normalized()) 
     {}
-    Ray(): Ray(QVector3D(0,0,0), QVector3D(0,0,1)) {}
+    Ray(): Ray(Vec3d(0,0,0), Vec3d(0,0,1)) {}
 
-    const QVector3D getOrigin() const {return origin;}
-    const QVector3D getDirection() const {return direction;}
+    const Vec3d getOrigin() const {return origin;}
+    const Vec3d getDirection() const {return direction;}
+};
+
+/**
+ * @brief Portion of a ray that lies inside a solid, x_i = origin + t * direction, tIn <= t <= tOut
+ * 
+ */
+struct Segment
+{
+    // distance from the ray origin to the entry point
+    double tIn;
+    // distance from the ray origin to the exit point
+    double tOut;
+
+    double length() const {return tOut - tIn;}
 };
 
 class Shape
 {
 public:
+    virtual ~Shape() = default;
     /**
      * @brief Check if a point is in this object
      * 
@@ -52,7 +67,7 @@ public:
      * @return true if point is in this object.
      * @return false else
      */
-    virtual bool contain(const QVector3D& point) const = 0;
+    virtual bool contain(const Vec3d& point) const = 0;
     /**
      * @brief Get the length of intersection between this object and a given ray
      * 
@@ -60,14 +75,160 @@ public:
      * @return double 
      */
     virtual double intersection(const Ray& ray) const = 0;
+    /**
+     * @brief Get the entry and exit distances of a ray through this (convex) object.
+     *        Computed in double precision. The ray origin may be inside or outside the object,
+     *        the returned segment is clipped to t >= 0.
+     * 
+     * @param ray 
+     * @param seg Entry/exit distances along the ray, only valid if true is returned
+     * @return true if the ray passes through the object
+     * @return false else
+     */
+    virtual bool intersect(const Ray& ray, Segment& seg) const = 0;
+    /**
+     * @brief Get the list of segments of a given ray inside this object, sorted by entry distance.
+     * 
+     * @param ray 
+     * @return std::vector<Segment> Empty if the ray misses the object
+     */
+    virtual std::vector<Segment> segments(const Ray& ray) const;
+    /**
+     * @brief Get the volume of this object, cm^3. Infinite for unbounded objects.
+     * 
+     * @return double 
+     */
+    virtual double getVolume() const = 0;
+    /**
+     * @brief Get the axis-aligned box that encloses this object
+     * 
+     * @param lower Corner with the smallest coordinates
+     * @param upper Corner with the largest coordinates
+     */
+    virtual void getBoundingBox(Vec3d& lower, Vec3d& upper) const = 0;
+    /**
+     * @brief Map a point of the unit cube to a point in this object, 
+     *        such that uniform points in the cube give uniform points in the object.
+     * 
+     * @param u1 First coordinate, [0, 1)
+     * @param u2 Second coordinate, [0, 1)
+     * @param u3 Third coordinate, [0, 1)
+     * @return Vec3d 
+     */
+    virtual Vec3d samplePoint(const double u1, const double u2, const double u3) const = 0;
+};
+
+/**
+ * @brief Affine map from the local frame of an object to the world frame, x_world = M * x_local + t.
+ *        The inverse matrix is computed once so world-to-local conversions cost one matrix-vector product,
+ *        and nothing but a subtraction for pure translations.
+ * 
+ */
+class Transform
+{
+private:
+    Mat3 linear;
+    Mat3 inverse;
+    Vec3d translation;
+    // true if the linear part is the identity
+    bool translationOnly;
+public:
+    /**
+     * @brief Construct a new Transform object
+     * 
+     * @param m Linear part, rotation and scaling, must not be singular
+     * @param t Translation, position of the local origin in the world frame
+     */
+    Transform(const Mat3& m, const Vec3d& t);
+    /**
+     * @brief Construct a new Transform object, pure translation
+     * 
+     * @param t Position of the local origin in the world frame
+     */
+    explicit Transform(const Vec3d& t) : Transform(Mat3(), t) {}
+    Transform() : Transform(Mat3(), Vec3d(0, 0, 0)) {}
+
+    /**
+     * @brief Get the rotation that takes the local +z axis onto a given direction
+     * 
+     * @param axis Direction of the local z axis in the world frame
+     * @return Mat3 
+     */
+    static Mat3 alignZ(const Vec3d& axis);
+    /**
+     * @brief Get the rotation by a given angle around a given axis
+     * 
+     * @param axis Rotation axis
+     * @param angle Rotation angle, rad
+     * @return Mat3 
+     */
+    static Mat3 rotation(const Vec3d& axis, const double angle);
+
+    Vec3d toLocal(const Vec3d& p) const {return translationOnly ? p - translation : inverse * (p - translation);}
+    Vec3d toLocalDirection(const Vec3d& d) const {return translationOnly ? d : inverse * d;}
+    Vec3d toWorld(const Vec3d& p) const {return translationOnly ? p + translation : linear * p + translation;}
+    Vec3d toWorldDirection(const Vec3d& d) const {return translationOnly ? d : linear * d;}
+
+    const Mat3& getLinear() const {return linear;}
+    Vec3d getTranslation() const {return translation;}
+    bool isTranslation() const {return translationOnly;}
+    /**
+     * @brief Get the ratio between world and local volumes
+     * 
+     * @return double 
+     */
+    double getVolumeScale() const {return std::abs(linear.determinant());}
+};
+
+/**
+ * @brief Object defined in a local frame and placed in the world with an affine transform.
+ *        Inside and intersection tests are done in the local frame. 
+ *        Rays are mapped with the unnormalized local direction, so distances along the ray
+ *        are the same in both frames.
+ * 
+ */
+class TransformedShape : public Shape
+{
+protected:
+    Transform transform;
+
+    virtual bool containLocal(const Vec3d& p) const = 0;
+    /**
+     * @brief Get the entry and exit distances of a ray in the local frame
+     * 
+     * @param o Ray origin in the local frame
+     * @param d Ray direction in the local frame, not normalized
+     * @param tIn Entry distance, unclipped
+     * @param tOut Exit distance, unclipped
+     * @return true if the line x = o + t * d crosses the object
+     * @return false else
+     */
+    virtual bool intersectLocal(const Vec3d& o, const Vec3d& d, double& tIn, double& tOut) const = 0;
+public:
+    explicit TransformedShape(const Transform& t) : transform(t) {}
+
+    const Transform& getTransform() const {return transform;}
+
+    bool contain(const Vec3d& point) const override {return containLocal(transform.toLocal(point));}
+    /**
+     * @brief Get the length of intersection between this object and a given ray, 
+     *        measured from the ray origin.
+     * 
+     * @param ray 
+     * @return double 
+     */
+    double intersection(const Ray& ray) const override;
+    bool intersect(const Ray& ray, Segment& seg) const override;
 };
 
-class Cylinder : public Shape
+class Cylinder : public TransformedShape
 {
 private:
-    QVector3D baseCenter;
     double height;
     double radius;
+protected:
+    bool containLocal(const Vec3d& p) const override;
+    bool intersectLocal(const Vec3d& o, const Vec3d& d, double& tIn, double& tOut) const override;
 public:
     /**
      * @brief Construct a new Cylinder object. The axis direction is (0, 0, 1)
@@ -76,28 +237,149 @@ public:
      * @param h height of the cylinder
      * @param r radius of the cylinder
      */
-    Cylinder(const QVector3D& p, const double h, const double& r)
-        : baseCenter(p),
+    Cylinder(const Vec3d& p, const double h, const double& r)
+        : TransformedShape(Transform(p)),
           height(h),
           radius(r)
     {
     }
+    /**
+     * @brief Construct a new Cylinder object with an arbitrary axis (MCNP RCC)
+     * 
+     * @param p center of the bottom surface
+     * @param axis vector from the center of the bottom surface to the center of the top surface
+     * @param r radius of the cylinder
+     */
+    Cylinder(const Vec3d& p, const Vec3d& axis, const double r)
+        : TransformedShape(Transform(Transform::alignZ(axis), p)),
+          height(axis.length()),
+          radius(r)
+    {
+    }
 
-    QVector3D getBaseCenter() const {return baseCenter;}
-    QVector3D getAxis() const {return QVector3D(0, 0, height);}
+    Vec3d getBaseCenter() const {return transform.getTranslation();}
+    Vec3d getAxis() const {return transform.toWorldDirection(Vec3d(0, 0, height));}
     double getRadius() const {return radius;}
     double getHeight() const {return height;}
 
-    bool contain(const QVector3D& point) const override;
+    double getVolume() const override {return M_PI * radius * radius * height;}
+    void getBoundingBox(Vec3d& lower, Vec3d& upper) const override;
+    /**
+     * @brief Map a point of the unit cube to a point in the cylinder.
+     *        u1 and u2 give the radius and angle, u3 gives the height.
+     */
+    Vec3d samplePoint(const double u1, const double u2, const double u3) const override;
+};
 
-    double intersection(const Ray& ray) const override;
+/**
+ * @brief Rectangular parallelepiped, [-h_x, h_x] x [-h_y, h_y] x [-h_z, h_z] in the local frame
+ * 
+ */
+class Box : public TransformedShape
+{
+private:
+    Vec3d halfWidths;
+protected:
+    bool containLocal(const Vec3d& p) const override;
+    bool intersectLocal(const Vec3d& o, const Vec3d& d, double& tIn, double& tOut) const override;
+public:
+    /**
+     * @brief Construct a new axis-aligned Box object (MCNP RPP)
+     * 
+     * @param lower Corner with the smallest coordinates
+     * @param upper Corner with the largest coordinates
+     */
+    Box(const Vec3d& lower, const Vec3d& upper)
+        : TransformedShape(Transform(0.5 * (lower + upper))),
+          halfWidths(0.5 * (upper - lower))
+    {
+    }
+    /**
+     * @brief Construct a new Box object
+     * 
+     * @param t Transform from the local frame, whose origin is the box center
+     * @param h Half widths along the local axes
+     */
+    Box(const Transform& t, const Vec3d& h)
+        : TransformedShape(t), halfWidths(h) {}
+
+    Vec3d getHalfWidths() const {return halfWidths;}
+
+    double getVolume() const override {return 8 * halfWidths.x() * halfWidths.y() * halfWidths.z() * transform.getVolumeScale();}
+    void getBoundingBox(Vec3d& lower, Vec3d& upper) const override;
+    Vec3d samplePoint(const double u1, const double u2, const double u3) const override;
+};
+
+/**
+ * @brief Region between two parallel planes, 0 < z < thickness in the local frame
+ * 
+ */
+class Slab : public TransformedShape
+{
+private:
+    double thickness;
+protected:
+    bool containLocal(const Vec3d& p) const override;
+    bool intersectLocal(const Vec3d& o, const Vec3d& d, double& tIn, double& tOut) const override;
+public:
+    /**
+     * @brief Construct a new Slab object
+     * 
+     * @param p A point on the first plane
+     * @param normal Normal of the planes, pointing from the first plane into the slab
+     * @param t Distance between the planes
+     */
+    Slab(const Vec3d& p, const Vec3d& normal, const double t)
+        : TransformedShape(Transform(Transform::alignZ(normal), p)), thickness(t) {}
+
+    double getThickness() const {return thickness;}
+
+    double getVolume() const override {return std::numeric_limits<double>::infinity();}
+    void getBoundingBox(Vec3d& lower, Vec3d& upper) const override;
+    /**
+     * @brief A slab is unbounded and has no uniform points, the numbers are ignored and std::runtime_error is thrown
+     */
+    Vec3d samplePoint(const double, const double, const double) const override;
+};
+
+/**
+ * @brief Ellipsoid, unit sphere in the local frame
+ * 
+ */
+class Ellipsoid : public TransformedShape
+{
+protected:
+    bool containLocal(const Vec3d& p) const override;
+    bool intersectLocal(const Vec3d& o, const Vec3d& d, double& tIn, double& tOut) const override;
+public:
+    /**
+     * @brief Construct a new Ellipsoid object
+     * 
+     * @param c Center
+     * @param semiAxes Lengths of the semi-axes along the local x, y, z axes
+     * @param rotation Orientation of the local axes in the world frame
+     */
+    Ellipsoid(const Vec3d& c, const Vec3d& semiAxes, const Mat3& rotation)
+        : TransformedShape(Transform(rotation * Mat3::diagonal(semiAxes), c)) {}
+    /**
+     * @brief Construct a new Ellipsoid object with semi-axes along the world axes
+     * 
+     * @param c Center
+     * @param semiAxes Lengths of the semi-axes along x, y, z
+     */
+    Ellipsoid(const Vec3d& c, const Vec3d& semiAxes)
+        : Ellipsoid(c, semiAxes, Mat3()) {}
+
+    double getVolume() const override {return 4.0 / 3.0 * M_PI * transform.getVolumeScale();}
+    void getBoundingBox(Vec3d& lower, Vec3d& upper) const override;
+    Vec3d samplePoint(const double u1, const double u2, const double u3) const override;
 };
 
 
 class Sphere : public Shape
 {
 private:
-    QVector3D center;
+    Vec3d center;
     double radius;
 public:
     /**
@@ -106,18 +388,22 @@ public:
      * @param c Center of the sphere
      * @param r Radius of the sphere
      */
-    Sphere(const QVector3D& c, const double r) 
+    Sphere(const Vec3d& c, const double r) 
         : center(c), radius(r) {}
     // ~Sphere();
 
-    QVector3D getCenter() const {return center;}
+    Vec3d getCenter() const {return center;}
     double getRadius() const {return radius;}
 
-    void setCenter(const QVector3D& newc) {center=newc;}
+    void setCenter(const Vec3d& newc) {center=newc;}
     void setRadius(const double newr) {radius=newr;}
     
-    bool contain(const QVector3D& point) const override;
+    bool contain(const Vec3d& point) const override;
     double intersection(const Ray& ray) const override;
+    bool intersect(const Ray& ray, Segment& seg) const override;
+    double getVolume() const override {return 4.0 / 3.0 * M_PI * radius * radius * radius;}
+    void getBoundingBox(Vec3d& lower, Vec3d& upper) const override;
+    Vec3d samplePoint(const double u1, const double u2, const double u3) const override;
 };
 
 #endif // GEOMETRY_H
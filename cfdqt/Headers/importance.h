@@ -0,0 +1,107 @@
+/**
+ * @file importance.h
+ * @brief importance maps and weight windows from a coarse adjoint diffusion calculation
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <vector>
+
+#include "cfd.h"
+#include "weightwindow.h"
+
+/**
+ * @brief Importance of particles for a tally, from a multigroup adjoint diffusion calculation
+ *        on a regular mesh over the bounding box of the ROI, and weight windows derived from it (CADIS).
+ *
+ *        Collisions are scored by forced detection, so the adjoint source of a mesh element is the expected score
+ *        of the collisions in it: total cross section x scattering probability x transmission to the detector
+ *        center x geometry factor of the tally. Group-to-group scattering probabilities are sampled with
+ *        the scattering routine of the transport, for photons and neutrons alike.
+ *        Elements whose center is outside the ROI are treated as vacuum, with Marshak boundary conditions.
+ *        Diffusion is a coarse approximation of transport: the map is only meant to drive variance reduction,
+ *        which stays unbiased whatever its accuracy.
+ */
+class ImportanceMap
+{
+public:
+    /**
+     * @brief Run the adjoint calculation
+     *
+     * @param config MC run settings, the material of the first cell fills the ROI
+     * @param tally Tally whose importance is computed
+     * @param energyEdges_ Increasing group edges, must cover the source energies
+     * @param nx Number of mesh elements along x
+     * @param ny Number of mesh elements along y
+     * @param nz Number of mesh elements along z
+     * @param scatterSamples Number of scatterings sampled per group for the transfer probabilities
+     */
+    ImportanceMap(const MCSettings& config, const Tally& tally, const std::vector<double>& energyEdges_,
+                  const int nx, const int ny, const int nz, const int scatterSamples=1000);
+    /**
+     * @brief Get group edges from the cutoff energy to the largest source energy, sampled from the source,
+     *        evenly spaced for photons and logarithmically for neutrons
+     *
+     * @param config MC run settings
+     * @param ngroups Number of groups
+     * @return std::vector<double>
+     */
+    static std::vector<double> defaultEnergyEdges(const MCSettings& config, const int ngroups);
+
+    int getNumberOfElements() const {return nodes[0] * nodes[1] * nodes[2];}
+    int getNGroups() const {return static_cast<int>(energyEdges.size()) - 1;}
+    const std::vector<double>& getEnergyEdges() const {return energyEdges;}
+    /**
+     * @brief Get the probability that a scattering in group g ends in group h, sampled
+     */
+    double getTransferProbability(const int g, const int h) const {return transfer[g * getNGroups() + h];}
+    /**
+     * @brief Get the adjoint flux of mesh element (i, j, k) in group g
+     */
+    double getImportance(const int i, const int j, const int k, const int g) const
+    {
+        return importance[((g * nodes[0] + i) * nodes[1] + j) * nodes[2] + k];
+    }
+    /**
+     * @brief Get the adjoint flux at a position and energy, 0 outside the mesh or the groups
+     */
+    double getImportance(const Vec3d& pos, const double ergE) const;
+    /**
+     * @brief Get the tally estimated by the adjoint calculation, the mean importance of source particles
+     */
+    double getResponse() const {return response;}
+    /**
+     * @brief Get the number of sweeps the last group solve took
+     */
+    int getIterations() const {return iterations;}
+
+    /**
+     * @brief Build weight windows whose survival weight is response / importance,
+     *        the weight a particle should have to contribute the response on average.
+     *        Elements without importance are not controlled.
+     *
+     * @param upperRatio Upper bound over lower bound
+     * @param survivalRatio Survival weight over lower bound
+     * @return WeightWindowMesh
+     */
+    WeightWindowMesh toWeightWindows(const double upperRatio=5, const double survivalRatio=3) const;
+
+private:
+    Vec3d lowerCorner;
+    Vec3d upperCorner;
+    int nodes[3];
+    double spacing[3];
+    std::vector<double> energyEdges;
+    // transfer[g * ngroups + h]
+    std::vector<double> transfer;
+    // adjoint flux, same layout as the weight window bounds
+    std::vector<double> importance;
+    double response=0;
+    int iterations=0;
+
+    int findElement(const Vec3d& pos) const;
+};
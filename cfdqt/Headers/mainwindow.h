@@ -2,6 +2,7 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QVector3D>
 #include <QThread>
 #include "ui_mainwindow.h"
 #include "qcustomcanvas.h"
@@ -257,6 +257,7 @@ public:
     Material(const double d, const int id, const std::vector<std::pair<double, Nuclide>>& comp);
 
     double getDensity() const {return density;}
+    int getID() const {return matID;}
     /**
      * @brief Get macroscopic total neutron cross section at the given energy, cm^-1
      * 
@@ -290,4 +291,21 @@ public:
      * @return const Nuclide& 
      */
     const Nuclide& selectInteractionTarget(const double energy, const double r) const;
+    /**
+     * @brief Given random number r, sample the index in the composition of the nuclide that the neutron is going to interact with.
+     * 
+     * @param energy Neutron energy
+     * @param r A random number
+     * @return int 
+     */
+    int selectInteractionTargetIndex(const double energy, const double r) const;
+    /**
+     * @brief Get the probability that a neutron interacts with a nuclide of the composition, 
+     *        from the same table as selectInteractionTarget.
+     * 
+     * @param energy Neutron energy
+     * @param index Index of the nuclide in the composition
+     * @return double 
+     */
+    double getInteractionProbability(const double energy, const int index) const;
 };
\ No newline at end of file
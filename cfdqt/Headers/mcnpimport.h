@@ -0,0 +1,231 @@
+/**
+ * @file mcnpimport.h
+ * @brief import the geometry, materials, source and F4 / F5 tallies of an MCNP input deck
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <filesystem>
+#include <istream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cell.h"
+#include "cfd.h"
+
+/**
+ * @brief Cards of an MCNP input deck that are understood by the importer.
+ *        Parsing only splits and expands the cards, shapes and materials are built on import.
+ *
+ *        Supported subset:
+ *        - cells: "j m d geom params", geometry as an intersection of signed surface numbers
+ *        - surfaces: macrobodies RCC, RPP, BOX and spheres S, SO, SPH, with an optional TR number
+ *        - data: MODE, NPS, CUT, TRn / *TRn, Mn, SDEF, SIn, SPn, Fn (type 4), En, SDn
+ *        - horizontal and vertical (#) data input, continuation lines, "$" and "c" comments,
+ *          and the shortcuts nR, nI, nILOG, nJ
+ *        All other cards are skipped.
+ */
+struct McnpDeck
+{
+    struct CellCard
+    {
+        int id;
+        // material number, 0 for void
+        int material;
+        // > 0 atoms/b-cm, < 0 g/cc
+        double density;
+        // signed surface numbers, all intersected
+        std::vector<int> surfaces;
+        // true if the geometry uses unions, complements or parentheses
+        bool complexGeometry;
+    };
+    struct SurfaceCard
+    {
+        int id;
+        // transformation number, 0 if none
+        int transform;
+        // upper case mnemonic, e.g. RCC
+        std::string type;
+        std::vector<double> params;
+    };
+    struct MaterialCard
+    {
+        int id;
+        // ZAID without library suffix and fraction, > 0 atom fraction, < 0 weight fraction
+        std::vector<std::pair<int, double>> components;
+    };
+    struct Distribution
+    {
+        // SI option, H (histogram) if omitted
+        std::string siOption;
+        std::vector<double> si;
+        // SP option, D if omitted, or the built-in function number (e.g. -21)
+        std::string spOption;
+        std::vector<double> sp;
+    };
+    struct TallyCard
+    {
+        // tally number, e.g. 4, 14
+        int number;
+        // particle designator, 'N' or 'P'
+        char particle;
+        // F4, cells
+        std::vector<int> cells;
+        // F5, x y z R0 of each point
+        std::vector<double> points;
+    };
+
+    std::string title;
+    // 'N' or 'P'
+    char mode = 'P';
+    // NPS card, 0 if absent
+    long long nps = 0;
+    // particle designator -> energy cutoff from CUT cards, MeV
+    std::map<char, double> cutoffEnergies;
+    std::vector<CellCard> cells;
+    std::map<int, SurfaceCard> surfaces;
+    std::map<int, Transform> transforms;
+    std::map<int, MaterialCard> materials;
+    // SDEF keywords (upper case) and their values
+    std::map<std::string, std::vector<std::string>> source;
+    std::map<int, Distribution> distributions;
+    std::vector<TallyCard> tallies;
+    // tally number -> energy bin upper bounds, MeV. Key 0 applies to all tallies.
+    std::map<int, std::vector<double>> energyBins;
+    // tally number -> segment divisors
+    std::map<int, std::vector<double>> segmentDivisors;
+
+    /**
+     * @brief Parse an MCNP input deck
+     *
+     * @param input Deck content
+     * @return McnpDeck
+     */
+    static McnpDeck parse(std::istream& input);
+    /**
+     * @brief Parse an MCNP input deck file
+     *
+     * @param fpath Path of the deck
+     * @return McnpDeck
+     */
+    static McnpDeck parseFile(const std::string& fpath);
+};
+
+/**
+ * @brief Nuclide data available to imported materials, keyed by ZZAAA (e.g. 1001, 8016).
+ *
+ */
+class NuclideLibrary
+{
+private:
+    std::map<int, Nuclide> nuclides;
+public:
+    void addNuclide(const int zaid, const Nuclide& nuclide) {nuclides.erase(zaid); nuclides.emplace(zaid, nuclide);}
+    bool contains(const int zaid) const {return nuclides.count(zaid) > 0;}
+    const Nuclide& getNuclide(const int zaid) const;
+    /**
+     * @brief Load the nuclides shipped in the DATA directory, H-1 and O-16.
+     *        Both use the photon cross section of water.
+     *
+     * @param rootdir Project root directory, which contains DATA/
+     * @return NuclideLibrary
+     */
+    static NuclideLibrary loadDefault(const std::string& rootdir);
+};
+
+/**
+ * @brief Run settings for an imported deck that MCNP decks do not specify
+ *
+ */
+struct McnpImportOptions
+{
+    // number of histories, overrides NPS if > 0
+    int maxN = 0;
+    int maxScatterN = 100;
+    double minW = 0.01;
+};
+
+/**
+ * @brief MC run settings and tallies built from a deck, ready to run.
+ *        Energies are in MeV for photons and eV for neutrons, as everywhere else.
+ *
+ */
+struct McnpProblem
+{
+    std::shared_ptr<const MCSettings> config;
+    std::vector<Tally> tallies;
+    // MCNP tally number of each tally. F4 tallies are divided by the SD value if given, by the detector volume otherwise
+    std::vector<int> tallyNumbers;
+};
+
+/**
+ * @brief Build MCSettings and tallies from MCNP decks.
+ *        Parsed decks are cached by path and re-parsed only when the file changes;
+ *        materials are cached by composition and density, so that running many variants
+ *        of a deck only pays for parsing and cross-section preprocessing once.
+ *
+ *        Limitations, reported with std::runtime_error:
+ *        - tracking uses a single material region, so the cells with a material must reduce to one cell.
+ *          A cell that excludes another cell of the same material and density is merged with it.
+ *        - F4 tallies must be on cells bounded by a single sphere or macrobody RCC, RPP or BOX.
+ *          F5 exclusion radii must be given in cm (R0 >= 0), and the ND option is not supported.
+ *        - the source is a point (no RAD), a sphere (RAD with SP -21 2) or a cylinder
+ *          (RAD with SP -21 1 and EXT with SP -21 0, along AXS). CEL rejection is not applied.
+ *        - ERG is a constant, a single line or an SI H / SP D histogram.
+ *
+ *        E card bounds are used as given, any spacing, with the MCNP bin from 0 to the first bound.
+ */
+class McnpImporter
+{
+private:
+    struct CachedDeck
+    {
+        std::filesystem::file_time_type writeTime;
+        std::shared_ptr<const McnpDeck> deck;
+    };
+    NuclideLibrary library;
+    std::map<std::string, CachedDeck> decks;
+    std::map<std::string, std::shared_ptr<const Material>> materials;
+
+    std::shared_ptr<const Material> getMaterial(const McnpDeck& deck, const int id, const double density, double& massDensity);
+public:
+    explicit McnpImporter(const NuclideLibrary& lib) : library(lib) {}
+
+    /**
+     * @brief Get the parsed deck, from the cache if the file has not changed since it was parsed
+     *
+     * @param fpath Path of the deck
+     * @return std::shared_ptr<const McnpDeck>
+     */
+    std::shared_ptr<const McnpDeck> getDeck(const std::string& fpath);
+    /**
+     * @brief Build the run settings and tallies of a deck file
+     *
+     * @param fpath Path of the deck
+     * @param options Settings not given by the deck
+     * @return McnpProblem
+     */
+    McnpProblem import(const std::string& fpath, const McnpImportOptions& options = McnpImportOptions());
+    /**
+     * @brief Build the run settings and tallies of a parsed deck
+     *
+     * @param deck Parsed deck
+     * @param options Settings not given by the deck
+     * @return McnpProblem
+     */
+    McnpProblem build(const McnpDeck& deck, const McnpImportOptions& options = McnpImportOptions());
+    /**
+     * @brief Build the shape bounded by a surface, in the world frame
+     *
+     * @param deck Parsed deck
+     * @param id Surface number
+     * @return std::shared_ptr<const Shape>
+     */
+    static std::shared_ptr<const Shape> buildShape(const McnpDeck& deck, const int id);
+};
@@ -0,0 +1,73 @@
+/**
+ * @file pathfield.h
+ * @brief precomputed path lengths from a spatial grid to a fixed detector
+ * @version 0.1
+ * @date 2026-10-19
+ * 
+ * @author Ming Fang
+ * 
+ */
+#pragma once
+
+#include "cell.h"
+
+/**
+ * @brief Path length in each cell along the straight line from every node of 
+ *        a regular grid over the ROI to a fixed target point (the detector center).
+ *        Path lengths at arbitrary points are obtained by trilinear interpolation.
+ * 
+ *        Error bound: where the path length is twice differentiable, trilinear interpolation 
+ *        on a grid of spacing (hx, hy, hz) has error at most (hx^2 Mxx + hy^2 Myy + hz^2 Mzz) / 8,
+ *        where Mii bounds the second derivative along axis i. Everywhere else the error is bounded 
+ *        by the variation of the path length over one grid cell. For a convex cell with largest 
+ *        radius of curvature R this is at most 2 * sqrt(2 * R * d), d being the grid cell diagonal, 
+ *        and is only reached where the line to the target grazes the cell boundary.
+ *        Use getMaxError() to check the actual error against exact tracing before using a field.
+ */
+class PathLengthField
+{
+private:
+    // point the paths end at
+    Vec3d target;
+    // corner of the grid with the smallest coordinates
+    Vec3d lowerCorner;
+    // grid spacing along x, y, z
+    double spacing[3];
+    // number of nodes along x, y, z
+    int nodes[3];
+    int cellsNum;
+    // node-major, lengths[((i * ny + j) * nz + k) * cellsNum + c] is the path length in cell c
+    std::vector<double> lengths;
+public:
+    /**
+     * @brief Construct a new Path Length Field object. The grid covers the bounding box of the ROI.
+     * 
+     * @param config MC run settings, provides the ROI and the cells
+     * @param t Target point, usually the detector center
+     * @param nx Number of grid nodes along x
+     * @param ny Number of grid nodes along y
+     * @param nz Number of grid nodes along z
+     */
+    PathLengthField(const MCSettings& config, const Vec3d& t, const int nx, const int ny, const int nz);
+
+    /**
+     * @brief Get the interpolated path length in each cell from a given point to the target
+     * 
+     * @param pos Start point, clamped to the grid
+     * @param lengthsOut Path length in each cell, same order as cells in MCSettings
+     */
+    void getPathLengths(const Vec3d& pos, std::vector<double>& lengthsOut) const;
+
+    /**
+     * @brief Get the largest difference between interpolated and exactly traced path lengths,
+     *        evaluated at points uniformly sampled in the ROI.
+     * 
+     * @param config MC run settings used to build this field
+     * @param samples Number of sampled points
+     * @return double Maximum absolute error, cm
+     */
+    double getMaxError(const MCSettings& config, const int samples) const;
+
+    Vec3d getTarget() const {return target;}
+    int getNumberOfCells() const {return cellsNum;}
+};
@@ -0,0 +1,159 @@
+/**
+ * @file perturbation.h
+ * @brief correlated-sampling tallies of the response to perturbations of the material density and composition
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cfd.h"
+
+/**
+ * @brief A perturbation of the material transported in, config.cells[0]:
+ *        its mass density and the atom fractions of its nuclides are multiplied by factors.
+ *        Changing a fraction keeps the mass density, so the atom density follows the molecular mass.
+ *        Photon cross sections are tabulated for the whole material, only its density affects photons.
+ */
+class MaterialPerturbation
+{
+public:
+    /**
+     * @brief Construct a new Material Perturbation object
+     *
+     * @param densityFactor_ Factor of the mass density
+     * @param fractionFactors_ Factor of the atom fraction of each nuclide of the composition, empty for none
+     */
+    MaterialPerturbation(const double densityFactor_=1, const std::vector<double>& fractionFactors_={});
+    /**
+     * @brief Parse perturbations separated by commas. Each one is a list of changes joined by '+',
+     *        density:<factor> or fraction:<nuclide index>:<factor>, e.g. density:1.01,fraction:0:0.98+density:1.02
+     *
+     * @param spec Perturbations
+     * @return std::vector<MaterialPerturbation>
+     */
+    static std::vector<MaterialPerturbation> parse(const std::string& spec);
+
+    /**
+     * @brief Get the perturbed material
+     *
+     * @param material Unperturbed material
+     * @return Material
+     */
+    Material apply(const Material& material) const;
+    /**
+     * @brief Get the perturbed run settings, config.cells[0] is filled with the perturbed material
+     */
+    std::unique_ptr<MCSettings> apply(const MCSettings& config) const;
+    double getDensityFactor() const {return densityFactor;}
+    const std::vector<double>& getFractionFactors() const {return fractionFactors;}
+    /**
+     * @brief Get a description, in the format of parse
+     */
+    std::string getName() const;
+
+private:
+    double densityFactor;
+    std::vector<double> fractionFactors;
+};
+
+/**
+ * @brief Tallies scored in one run for the unperturbed material and for several perturbed ones.
+ *        Histories are sampled in the unperturbed material; each perturbation carries the likelihood ratio
+ *        of the history in the perturbed material, updated by the flight to every collision,
+ *        mu'/mu exp(-(mu' - mu) s) with the attenuation coefficients of the material whatever the majorant of
+ *        delta tracking, and by the choice of the target nuclide of every neutron scattering.
+ *        Every event is scored for the perturbed materials with its weight times the ratio, by CFD in the
+ *        perturbed material. The tallies are unbiased for any perturbation, and since the same histories are used,
+ *        the differences to the unperturbed tallies have a much smaller variance than between independent runs.
+ *        Large perturbations make the ratios fluctuate and the perturbed tallies converge slowly.
+ */
+class PerturbationTallies
+{
+public:
+    /**
+     * @brief Construct a new Perturbation Tallies object
+     *
+     * @param config_ MC run settings, kept by reference
+     * @param tallies Tallies, copied for the perturbed materials
+     * @param perturbations_ Perturbations of config.cells[0].material
+     */
+    PerturbationTallies(const MCSettings& config_, const std::vector<Tally>& tallies, const std::vector<MaterialPerturbation>& perturbations_);
+
+    /**
+     * @brief Transport a source particle like transportHistory without weight windows and score it,
+     *        with the same random numbers, so the unperturbed tallies are those of the usual history loops
+     *
+     * @param source Particle created by the source
+     * @param tallies Unperturbed tallies to be updated, same binning as those of the constructor
+     * @param transform Exponential transform of the flight distances, nullptr for none
+     * @param scoreSource Whether the source event is scored, e.g. not if the uncollided flux is integrated
+     */
+    void runHistory(Particle source, std::vector<Tally>& tallies, const ExponentialTransform* transform=nullptr, const bool scoreSource=true);
+
+    int getNPerturbations() const {return perturbations.size();}
+    const MaterialPerturbation& getPerturbation(const int k) const {return perturbations[k];}
+    /**
+     * @brief Get the run settings with the perturbed material k
+     */
+    const MCSettings& getSettings(const int k) const {return *configs[k];}
+    /**
+     * @brief Get the tallies of the perturbed material k, summed over the histories
+     */
+    const std::vector<Tally>& getTallies(const int k) const {return perturbedTallies[k];}
+    long long getHistories() const {return histories;}
+    /**
+     * @brief Get the mean per history of the total over all bins of all unperturbed tallies
+     */
+    double getTotal() const;
+    /**
+     * @brief Get the mean per history of the total over all bins of all tallies of the perturbed material k
+     */
+    double getTotal(const int k) const;
+    /**
+     * @brief Get the standard error of getTotal(k)
+     */
+    double getTotalError(const int k) const;
+    /**
+     * @brief Get the mean total of the perturbed material k minus the unperturbed one
+     */
+    double getDifference(const int k) const;
+    /**
+     * @brief Get the standard error of getDifference, from the differences of each history
+     */
+    double getDifferenceError(const int k) const;
+    /**
+     * @brief Get the standard error the difference would have between two independent runs of as many histories
+     */
+    double getIndependentDifferenceError(const int k) const;
+    /**
+     * @brief Clear the perturbed tallies and the statistics
+     */
+    void reset();
+
+private:
+    static double getVarianceOfMean(const double sum, const double squaredSum, const long long n);
+
+    const MCSettings& config;
+    std::vector<MaterialPerturbation> perturbations;
+    std::vector<std::unique_ptr<MCSettings>> configs;
+    std::vector<std::vector<Tally>> perturbedTallies;
+    // scores of the current history, unperturbed first
+    std::vector<std::vector<Tally>> historyTallies;
+    // likelihood ratio of the current particle in each perturbed material
+    std::vector<double> ratios;
+    long long histories = 0;
+    // sums over the histories of the total, of its square, of the difference to the unperturbed total and of its square
+    double sum = 0;
+    double squaredSum = 0;
+    std::vector<double> perturbedSums;
+    std::vector<double> perturbedSquaredSums;
+    std::vector<double> differenceSums;
+    std::vector<double> differenceSquaredSums;
+};
@@ -0,0 +1,72 @@
+/**
+ * @file qmc.h
+ * @brief randomized quasi-Monte Carlo sampling of the source and the first flight with scrambled Sobol points
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "cell.h"
+
+/**
+ * @brief Owen-scrambled Sobol sequence.
+ *        Every point of a scrambled sequence is uniformly distributed in the unit cube, so a history started from it
+ *        is unbiased, while the points of one sequence stratify the cube much better than pseudo-random ones.
+ *        Independent scramblings, different seeds, are the replicates from which the error is estimated.
+ *        The first 2^m points of a sequence are best balanced, use a power of 2 histories per replicate.
+ */
+class ScrambledSobol
+{
+public:
+    static constexpr int maxDimensions = 16;
+
+    /**
+     * @brief Construct a new Scrambled Sobol object
+     *
+     * @param dimensions_ Number of coordinates of a point, 1 to maxDimensions
+     * @param seed_ Seed of the scrambling, one per replicate
+     */
+    ScrambledSobol(const int dimensions_, const std::uint64_t seed_);
+    /**
+     * @brief Get the number of dimensions used for a source: the source point, the first flight distance
+     *        and the virtual collision test that follows it
+     */
+    static int defaultDimensions(const Source& source) {return source.getDimensions() + 2;}
+
+    int getDimensions() const {return dimensions;}
+    std::uint64_t getSeed() const {return seed;}
+    /**
+     * @brief Get a point of the scrambled sequence
+     *
+     * @param index Index of the point in the sequence
+     * @param point Coordinates of the point, in (0, 1)
+     */
+    void getPoint(const std::uint32_t index, std::vector<double>& point) const;
+    /**
+     * @brief Start a history from a point: the next random numbers drawn by the global generator are its coordinates,
+     *        in the order the source and delta tracking draw them, followed by pseudo-random numbers
+     *
+     * @param index Index of the point in the sequence, usually the history index in the replicate
+     */
+    void startHistory(const std::uint32_t index);
+    /**
+     * @brief Go back to pseudo-random numbers only, drop the coordinates not drawn yet
+     */
+    static void stopHistory();
+
+private:
+    int dimensions;
+    std::uint64_t seed;
+    // direction numbers of each dimension, one per bit of the index
+    std::vector<std::array<std::uint32_t, 32>> directions;
+    // seed of the scrambling of each dimension
+    std::vector<std::uint64_t> dimensionSeeds;
+    std::vector<double> buffer;
+};
@@ -0,0 +1,153 @@
+/**
+ * @file response.h
+ * @brief fold incident flux spectra into detector pulse-height spectra
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "cfd.h"
+
+/**
+ * @brief Detector response matrix R, pulse-height spectrum = R * incident flux spectrum.
+ *        R[j][i] is the pulse-height distribution in bin j per unit flux in incident energy bin i.
+ *        Non-zero entries are stored in compressed rows, split into blocks of incident bins
+ *        so that the part of the flux spectra read by a block stays in cache.
+ *        Several spectra are folded in one pass over the matrix.
+ */
+class ResponseMatrix
+{
+public:
+    /**
+     * @brief Non-zero entry of the matrix
+     */
+    struct Entry
+    {
+        // incident energy bin
+        int incidentIdx;
+        // pulse-height bin
+        int pulseHeightIdx;
+        double value;
+    };
+
+    ResponseMatrix() {}
+    /**
+     * @brief Construct a new Response Matrix object
+     *
+     * @param incidentEdges_ Incident energy bin edges, must match the tally bins
+     * @param pulseHeightEdges_ Pulse-height bin edges
+     * @param entries Non-zero entries, entries of the same bins are added
+     * @param blockSize_ Number of incident bins per block
+     */
+    ResponseMatrix(const std::vector<double>& incidentEdges_, const std::vector<double>& pulseHeightEdges_,
+                   const std::vector<Entry>& entries, const int blockSize_=256);
+    /**
+     * @brief Load a response matrix from a text file. Lines starting with # are comments.
+     *        The first line lists the incident energy bin edges, the second one the pulse-height bin edges,
+     *        each following line is a non-zero entry: incident bin index, pulse-height bin index, value.
+     *
+     * @param fpath Path of the file
+     * @param blockSize_ Number of incident bins per block
+     * @return ResponseMatrix
+     */
+    static ResponseMatrix load(const std::string& fpath, const int blockSize_=256);
+
+    int getNIncidentBins() const {return static_cast<int>(incidentEdges.size()) - 1;}
+    int getNPulseHeightBins() const {return static_cast<int>(pulseHeightEdges.size()) - 1;}
+    const std::vector<double>& getIncidentEdges() const {return incidentEdges;}
+    const std::vector<double>& getPulseHeightEdges() const {return pulseHeightEdges;}
+    std::size_t getNNonZeros() const {return values.size();}
+    /**
+     * @brief Whether the energy bins of a tally are the incident bins of the matrix, within a relative tolerance of 1e-6
+     */
+    bool matches(const Tally& tally) const;
+
+    /**
+     * @brief Fold a flux spectrum
+     *
+     * @param spectrum Flux in each incident energy bin
+     * @return std::vector<double> Counts in each pulse-height bin
+     */
+    std::vector<double> fold(const std::vector<double>& spectrum) const;
+    /**
+     * @brief Fold several flux spectra in one pass over the matrix
+     *
+     * @param spectra Flux in each incident energy bin, for each spectrum
+     * @return std::vector<std::vector<double>> Counts in each pulse-height bin, for each spectrum
+     */
+    std::vector<std::vector<double>> fold(const std::vector<std::vector<double>>& spectra) const;
+    /**
+     * @brief Fold the counts of tallies, throws std::runtime_error if a tally does not match the incident bins
+     *
+     * @param tallies Tallies, not normalized
+     * @return std::vector<std::vector<double>> Counts in each pulse-height bin, for each tally
+     */
+    std::vector<std::vector<double>> fold(const std::vector<Tally>& tallies) const;
+
+private:
+    std::vector<double> incidentEdges;
+    std::vector<double> pulseHeightEdges;
+    int blockSize=256;
+    // block b holds the entries of incident bins [b * blockSize, (b + 1) * blockSize),
+    // its row j is values[rowStarts[b * (nrows + 1) + j] ... rowStarts[b * (nrows + 1) + j + 1])
+    std::vector<std::size_t> rowStarts;
+    std::vector<int> columns;
+    std::vector<double> values;
+
+    // y[j * n + s] += sum_i R[j][i] * x[i * n + s], spectra interleaved
+    void multiply(const std::vector<double>& x, const int n, std::vector<double>& y) const;
+};
+
+/**
+ * @brief Fold the tallies of each batch of histories as the run goes, and estimate the uncertainty
+ *        of the pulse-height spectra from the spread of the batch results.
+ *        The matrix is shared, so that it is loaded once for any number of runs.
+ */
+class PulseHeightFolder
+{
+public:
+    /**
+     * @brief Construct a new Pulse Height Folder object
+     *
+     * @param response_ Response matrix, must match the bins of all the folded tallies
+     */
+    explicit PulseHeightFolder(std::shared_ptr<const ResponseMatrix> response_) : response(response_) {}
+
+    /**
+     * @brief Fold the tallies of one batch. The tallies must only hold the counts of this batch,
+     *        e.g. reset after the previous batch.
+     *
+     * @param tallies Tallies of the batch, the same tallies in the same order for every batch
+     * @param nps Number of histories of the batch
+     */
+    void addBatch(const std::vector<Tally>& tallies, const int nps);
+
+    int getNBatches() const {return nBatches;}
+    int getNPS() const {return NPS;}
+    const ResponseMatrix& getResponse() const {return *response;}
+    /**
+     * @brief Get the pulse-height spectrum of a tally, per history over all batches
+     */
+    std::vector<double> getSpectrum(const int tallyIdx) const;
+    /**
+     * @brief Get the standard error of the pulse-height spectrum of a tally,
+     *        from the spread of the batch spectra, assuming batches of about the same size.
+     *        0 with less than 2 batches.
+     */
+    std::vector<double> getStdError(const int tallyIdx) const;
+
+private:
+    std::shared_ptr<const ResponseMatrix> response;
+    int nBatches=0;
+    int NPS=0;
+    // sum of the batch counts, and of the squared batch spectra per history, for each tally
+    std::vector<std::vector<double>> sums;
+    std::vector<std::vector<double>> squaredSums;
+};
@@ -10,6 +10,7 @@
 
 
 #include <random>
+#include <vector>
 
 /**
  * @brief Global random number generator.
@@ -20,6 +21,9 @@ class GlobalUniformRandNumGenerator
 private:
     std::default_random_engine generator;
     std::uniform_real_distribution<double> distribution;
+    // numbers returned before the pseudo-random ones, e.g. a quasi-random point
+    std::vector<double> leadingValues;
+    std::size_t nextLeadingValue = 0;
     GlobalUniformRandNumGenerator() = default;
 
     // Delete copy/move so extra instances can't be created/moved.
@@ -40,8 +44,21 @@ public:
      * @return double 
      */
     double generateDouble() {
+        if (nextLeadingValue < leadingValues.size())
+            return leadingValues[nextLeadingValue++];
         return distribution(generator);
     }
+
+    /**
+     * @brief Return the given numbers, in [0, 1), from the next calls of generateDouble before going on
+     *        with the pseudo-random sequence. Numbers left from a previous call are dropped.
+     * 
+     * @param values Numbers to return, empty for none
+     */
+    void setLeadingValues(const std::vector<double>& values) {
+        leadingValues.assign(values.begin(), values.end());
+        nextLeadingValue = 0;
+    }
 };
 
 /**
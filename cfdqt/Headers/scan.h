@@ -0,0 +1,92 @@
+/**
+ * @file scan.h
+ * @brief spectra of a detector scanned over a 3D grid of positions
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "bank.h"
+
+/**
+ * @brief Energy spectrum and integral count rate of a detector centered at every node of a regular grid,
+ *        all scored from the events of one collision bank.
+ *        Events are processed in blocks: the detector-independent quantities of a block are computed once
+ *        and reused by all grid nodes, and the tallies are swept in blocks small enough to stay in cache.
+ */
+class DetectorScan
+{
+private:
+    // grid node with the smallest coordinates
+    Vec3d lowerCorner;
+    // grid spacing along x, y, z
+    double spacing[3];
+    // number of nodes along x, y, z
+    int nodes[3];
+    int detectorsPerBlock;
+    // node n = (i * ny + j) * nz + k is blocks[n / detectorsPerBlock][n % detectorsPerBlock]
+    std::vector<std::vector<Tally>> blocks;
+    // number of histories scored
+    int NPS=0;
+
+    const Tally& getTally(const int nodeIdx) const {return blocks[nodeIdx / detectorsPerBlock][nodeIdx % detectorsPerBlock];}
+public:
+    /**
+     * @brief Construct a new Detector Scan object
+     *
+     * @param prototype Tally copied to every node, provides the detector radius and energy bins
+     * @param lower Grid node with the smallest coordinates
+     * @param upper Grid node with the largest coordinates
+     * @param nx Number of grid nodes along x
+     * @param ny Number of grid nodes along y
+     * @param nz Number of grid nodes along z
+     * @param detectorsPerBlock_ Number of tallies updated together for each event
+     */
+    DetectorScan(const Tally& prototype, const Vec3d& lower, const Vec3d& upper,
+                 const int nx, const int ny, const int nz, const int detectorsPerBlock_=16);
+
+    /**
+     * @brief Score all events of a bank at all grid nodes, in parallel across tally blocks if OpenMP is enabled.
+     *        Counts are added to the previous ones.
+     *
+     * @param config MC run settings used to record the bank
+     * @param bank Recorded events
+     * @param eventsPerBlock Number of events whose context is computed together
+     */
+    void run(const MCSettings& config, const CollisionBank& bank, const int eventsPerBlock=1024);
+
+    int getNumberOfNodes() const {return nodes[0] * nodes[1] * nodes[2];}
+    int getNPS() const {return NPS;}
+    Vec3d getNodeCenter(const int i, const int j, const int k) const
+    {
+        return lowerCorner + Vec3d(i * spacing[0], j * spacing[1], k * spacing[2]);
+    }
+    /**
+     * @brief Get the tally of the detector centered at a grid node, counts are not normalized
+     */
+    const Tally& getTally(const int i, const int j, const int k) const {return getTally((i * nodes[1] + j) * nodes[2] + k);}
+    /**
+     * @brief Get the flux spectrum at a grid node, per history
+     */
+    std::vector<double> getSpectrum(const int i, const int j, const int k) const;
+    /**
+     * @brief Get the flux integrated over all energy bins at a grid node, per history
+     */
+    double getIntegral(const int i, const int j, const int k) const;
+
+    /**
+     * @brief Write the map to a binary file, all numbers in native byte order:
+     *        char[8] "CFDSCAN1"; int32 nx, ny, nz, number of energy bins, NPS;
+     *        float64 lower corner[3], spacing[3], energy bin centers[nbins];
+     *        float64 spectra[nx][ny][nz][nbins] and integrals[nx][ny][nz], per history.
+     *
+     * @param fpath File path
+     */
+    void save(const std::string& fpath) const;
+};
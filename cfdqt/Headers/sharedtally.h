@@ -0,0 +1,101 @@
+/**
+ * @file sharedtally.h
+ * @brief tally counts shared by all threads, without a copy of the tallies per thread
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Bin counts filled concurrently by several threads.
+ *        Hot bins, filled often, are accumulated in a stripe per thread, each stripe padded to whole cache lines
+ *        so that threads never write to the same line. The other bins are shared by all threads
+ *        and accumulated with lock-free atomic additions, so their memory does not grow with the number of threads.
+ *        Stripes are merged in thread order with Kahan compensation, so that the counts of hot bins only depend on
+ *        which events each thread scored, not on timing. Atomic bins are exact up to the order of the additions.
+ */
+class SharedTallyStorage
+{
+public:
+    /**
+     * @brief Construct a new Shared Tally Storage object, all counts 0
+     *
+     * @param nbins_ Number of bins
+     * @param nThreads_ Number of threads that fill the bins, threads numbered from 0
+     * @param hotBins Bins accumulated in a stripe per thread
+     */
+    SharedTallyStorage(const int nbins_, const int nThreads_, const std::vector<int>& hotBins);
+    SharedTallyStorage(const SharedTallyStorage&) = delete;
+    SharedTallyStorage& operator=(const SharedTallyStorage&) = delete;
+
+    /**
+     * @brief Index of the calling thread, the OpenMP thread number, 0 without OpenMP
+     */
+    static int threadIndex();
+    /**
+     * @brief Pick hot bins from the counts of a previous run, e.g. a pilot run
+     *
+     * @param counts Bin counts
+     * @param maxBins Maximum number of hot bins
+     * @return std::vector<int> Indices of the largest non-zero counts, in increasing bin order
+     */
+    static std::vector<int> hottestBins(const std::vector<double>& counts, const int maxBins);
+
+    /**
+     * @brief Add weight to a bin, thread-safe. Threads beyond the number given on construction use atomic additions.
+     *
+     * @param thread Index of the calling thread
+     * @param binIdx Bin index
+     * @param weight Weight
+     */
+    void add(const int thread, const int binIdx, const double weight)
+    {
+        const int slot = slots[binIdx];
+        if (slot >= 0 && thread < nThreads)
+            stripes[static_cast<std::size_t>(thread) * stripeSize + slot] += weight;
+        else
+            atomicAdd(shared[binIdx], weight);
+    }
+    void add(const int binIdx, const double weight) {add(threadIndex(), binIdx, weight);}
+
+    int getNBins() const {return nbins;}
+    int getNThreads() const {return nThreads;}
+    int getNHotBins() const {return nHotBins;}
+    /**
+     * @brief Get the counts of all bins. Not to be called while threads are filling the bins.
+     */
+    std::vector<double> getBinContents() const;
+    double getBinContent(const int binIdx) const;
+    /**
+     * @brief Set all counts to 0
+     */
+    void clear();
+
+private:
+    int nbins;
+    int nThreads;
+    int nHotBins;
+    // doubles per stripe, a multiple of a cache line
+    std::size_t stripeSize;
+    // slot of each bin in the stripes, -1 for atomic bins
+    std::vector<int> slots;
+    // stripe of thread i starts at stripes[i * stripeSize], aligned to a cache line
+    std::unique_ptr<double[]> stripeBuffer;
+    double* stripes;
+    // counts of all bins, only the atomic bins are used
+    std::unique_ptr<std::atomic<double>[]> shared;
+
+    static void atomicAdd(std::atomic<double>& target, const double weight)
+    {
+        double current = target.load(std::memory_order_relaxed);
+        while (!target.compare_exchange_weak(current, current + weight, std::memory_order_relaxed))
+            ;
+    }
+};
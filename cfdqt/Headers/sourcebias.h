@@ -0,0 +1,108 @@
+/**
+ * @file sourcebias.h
+ * @brief source direction and position biasing towards a detector, tuned from a pilot run
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <vector>
+
+#include "cfd.h"
+
+/**
+ * @brief A source whose particles are emitted preferentially towards a target point, usually a detector center.
+ *        The cosine mu between the direction and the target is sampled from a cone around the target mixed with
+ *        the isotropic distribution, or from the exponential distribution exp(k mu).
+ *        Positions can be biased along the source-to-target axis with exp(b s), s the distance along the axis,
+ *        by choosing among a few positions sampled by the source with probabilities proportional to exp(b s).
+ *        Weights are multiplied by the unbiased over the biased probability, so tallies keep their expectation.
+ */
+class BiasedSource
+{
+public:
+    enum DirectionBias {Isotropic, Cone, Exponential};
+    /**
+     * @brief Construct an unbiased source, see setCone, setExponential and setPositionExponent
+     *
+     * @param source_ Source being biased
+     * @param target_ Point particles are biased towards
+     */
+    BiasedSource(const Source& source_, const Vec3d& target_);
+    /**
+     * @brief Tune the exponents of the direction and position biasing towards the tally center from a pilot run.
+     *        The history scores of the unbiased pilot give the second moment of the tally for any exponents,
+     *        the exponents minimizing it are kept.
+     *
+     * @param config MC run settings
+     * @param tally Tally to be converged
+     * @param pilotN Number of pilot histories
+     * @return BiasedSource
+     */
+    static BiasedSource tune(const MCSettings& config, const Tally& tally, const int pilotN);
+
+    /**
+     * @brief Emit a fraction of the particles uniformly in a cone around the target
+     *
+     * @param cosine Cosine of the cone half angle, in [-1, 1)
+     * @param probability Probability of emitting into the cone, in [0, 1]
+     */
+    void setCone(const double cosine, const double probability);
+    /**
+     * @brief Sample the cosine to the target from exp(k mu), k = 0 is isotropic
+     */
+    void setExponential(const double k);
+    /**
+     * @brief Bias positions by exp(b s) along the source-to-target axis
+     *
+     * @param b Exponent, cm^-1, 0 for no position biasing
+     * @param candidates Number of positions sampled by the source to choose from
+     */
+    void setPositionExponent(const double b, const int candidates=8);
+
+    /**
+     * @brief Create a particle, its weight is the unbiased over the biased probability
+     *
+     * @return Particle
+     */
+    Particle createParticle() const;
+    /**
+     * @brief Get the weight of a particle emitted with a cosine mu to the target, the isotropic over the biased density
+     */
+    double directionWeight(const double mu) const;
+    /**
+     * @brief Get the position along the source-to-target axis used by the position biasing, cm
+     */
+    double axialPosition(const Vec3d& pos) const {return Vec3d::dotProduct(pos - sourceCenter, axis);}
+
+    const Source& getSource() const {return source;}
+    const Vec3d& getTarget() const {return target;}
+    DirectionBias getDirectionBias() const {return directionBias;}
+    double getExponent() const {return exponent;}
+    double getPositionExponent() const {return positionExponent;}
+    /**
+     * @brief Get the second moment of the tally predicted by the pilot run without biasing over with biasing,
+     *        1 if not tuned
+     */
+    double getPredictedGain() const {return predictedGain;}
+
+private:
+    Source source;
+    Vec3d target;
+    // mean source position and unit vector to the target, for position biasing
+    Vec3d sourceCenter;
+    Vec3d axis;
+    DirectionBias directionBias=Isotropic;
+    // k of exp(k mu)
+    double exponent=0;
+    double coneCosine=1;
+    double coneProbability=0;
+    double positionExponent=0;
+    int positionCandidates=1;
+    double predictedGain=1;
+
+    double sampleCosine(double& weight) const;
+};
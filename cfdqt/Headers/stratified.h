@@ -0,0 +1,182 @@
+/**
+ * @file stratified.h
+ * @brief stratified and Latin-hypercube sampling of the source position and energy
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "cell.h"
+
+/**
+ * @brief Source whose uniform random numbers are stratified.
+ *        Source::createParticle maps 6 uniform numbers to a particle; the unit cube of the stratified ones is divided
+ *        into equal strata, and every batch samples a fixed number of histories in each stratum, with a weight of
+ *        N p_h / n_h for n_h of the N histories in stratum h of probability p_h. The tallies are unbiased and their
+ *        variance lacks the part from the differences between the stratum means.
+ *        Histories are allocated proportionally to p_h, or, optimally, proportionally to p_h sigma_h with the standard
+ *        deviation sigma_h of the scores of stratum h estimated from the previous batches (Neyman allocation).
+ *        The Latin-hypercube mode instead divides each stratified number into as many intervals as histories in
+ *        a batch, and samples each interval once, with independent permutations between the numbers.
+ */
+class StratifiedSource
+{
+public:
+    /**
+     * @brief Random numbers of Source::createParticle in the order they are drawn.
+     *        The position is sampled by Shape::samplePoint: for a cylinder, the numbers are mapped so that the strata
+     *        are rings of equal area, sectors and slices of the height; for a sphere or an ellipsoid, they are shells of
+     *        equal volume, bands of the polar cosine and sectors; for a box, slices along x, y and z.
+     *        Azimuth and Polar are of the direction, Energy is the cumulative probability of the spectrum.
+     */
+    enum Dimension {Radius, Angle, Height, Azimuth, Polar, Energy};
+    static constexpr int nDimensions = 6;
+    enum Mode {Stratified, LatinHypercube};
+
+    /**
+     * @brief Construct a new Stratified Source object
+     *
+     * @param source_ Source, kept by reference
+     * @param divisions_ Number of strata of each dimension, 1 for none. In the Latin-hypercube mode, the dimensions
+     *                   with more than 1 are stratified, by the histories of the batch
+     * @param mode_ Stratified or Latin-hypercube sampling
+     * @param optimal_ Whether histories are allocated from the estimated variances of the strata, stratified mode only
+     */
+    StratifiedSource(const Source& source_, const std::array<int, nDimensions>& divisions_, const Mode mode_=Stratified, const bool optimal_=false);
+    /**
+     * @brief Parse a stratification, entries separated by commas: <dimension>:<strata>, with the dimension one of
+     *        radius, angle, height, azimuth, polar and energy, lhs for the Latin-hypercube mode, in which the number of
+     *        strata is omitted, and optimal for the Neyman allocation, e.g. height:4,radius:2,energy:4,optimal or lhs,height,energy
+     *
+     * @param source Source, kept by reference
+     * @param spec Stratification
+     * @return StratifiedSource
+     */
+    static StratifiedSource parse(const Source& source, const std::string& spec);
+
+    Mode getMode() const {return mode;}
+    bool isOptimal() const {return optimal;}
+    int getDivisions(const Dimension d) const {return divisions[d];}
+    /**
+     * @brief Get the number of strata, 1 in the Latin-hypercube mode
+     */
+    int getNStrata() const {return nStrata;}
+    /**
+     * @brief Get the probability of a stratum, all strata are of equal probability
+     */
+    double getProbability(const int) const {return 1.0 / nStrata;}
+    /**
+     * @brief Get the index of a stratum along a dimension, from 0 to getDivisions(d) - 1
+     */
+    int getStratumIndex(const int stratum, const Dimension d) const;
+    /**
+     * @brief Get a description of a stratum, e.g. height 2/4 energy 1/3
+     */
+    std::string getStratumName(const int stratum) const;
+    /**
+     * @brief Get the numbers of histories of each stratum in a batch. At least one history is sampled in every stratum;
+     *        the others are allocated proportionally to p_h, or to p_h sigma_h if optimal and every stratum has
+     *        two scored histories, with the largest remainders rounded up
+     *
+     * @param histories Number of histories of the batch, at least the number of strata
+     * @return std::vector<int>
+     */
+    std::vector<int> allocate(const int histories) const;
+
+    /**
+     * @brief Start a batch: allocate its histories, or draw the permutations of the Latin hypercube.
+     *        The scores of all histories of the previous batch must have been added
+     *
+     * @param histories Number of histories of the batch
+     */
+    void startBatch(const int histories);
+    int getBatchHistories() const {return batchHistories;}
+    /**
+     * @brief Get the stratum of a history of the batch
+     */
+    int getStratum(const int history) const {return historyStrata[history];}
+    /**
+     * @brief Create the source particle of a history of the batch, weighted by N p_h / n_h
+     *
+     * @param history Index of the history in the batch, from 0 to getBatchHistories() - 1
+     * @return Particle
+     */
+    Particle createParticle(const int history) const;
+    /**
+     * @brief Add the score of a history of the batch, e.g. the sum over the bins of its tallies, to the statistics of its stratum
+     *
+     * @param history Index of the history in the batch
+     * @param score Score of the history, with the weight of createParticle
+     */
+    void addScore(const int history, const double score);
+
+    /**
+     * @brief Get the number of histories scored in a stratum
+     */
+    long long getHistories(const int stratum) const {return counts[stratum];}
+    /**
+     * @brief Get the mean score of a stratum, per history of unit weight
+     */
+    double getMean(const int stratum) const;
+    /**
+     * @brief Get the variance of the scores of a stratum, per history of unit weight
+     */
+    double getVariance(const int stratum) const;
+    /**
+     * @brief Get the contribution of a stratum to the variance of the mean, p_h^2 sigma_h^2 / n_h
+     *        for n_h of the N histories in every batch, and the sum over the batches of (N_b / N)^2 p_h^2 sigma_h^2 / n_bh
+     *        if the allocation changes
+     */
+    double getVarianceContribution(const int stratum) const;
+    /**
+     * @brief Get the stratified estimate of the mean score per history, the weighted scores over the histories.
+     *        The stratum means pooled over batches of changing allocations are biased, as the allocation depends on
+     *        the scores; this is the mean of the unbiased batch estimates, sum of p_h mu_bh, weighted by their histories
+     */
+    double getMean() const;
+    /**
+     * @brief Get the estimated variance of the mean, sum of the contributions of the strata.
+     *        Latin-hypercube sampling is not worse than independent histories, for which this is the variance
+     */
+    double getVarianceOfMean() const;
+    /**
+     * @brief Get the estimated variance of the mean of as many independent, unstratified histories
+     */
+    double getUnstratifiedVarianceOfMean() const;
+    /**
+     * @brief Clear the statistics
+     */
+    void reset();
+
+private:
+    const Source& source;
+    std::array<int, nDimensions> divisions;
+    Mode mode;
+    bool optimal;
+    int nStrata = 1;
+    // whether the first two numbers give the radius and the angle of a cylinder
+    bool cylinder = false;
+
+    int batchHistories = 0;
+    std::vector<int> historyStrata;
+    // weight of a history of each stratum in the batch, N p_h / n_h
+    std::vector<double> batchWeights;
+    // interval of each history for each dimension of the Latin hypercube
+    std::array<std::vector<int>, nDimensions> permutations;
+
+    // number of scored histories, sums of the scores per unit weight and of their squares, per stratum
+    std::vector<long long> counts;
+    std::vector<double> sums;
+    std::vector<double> squaredSums;
+    // histories of the started batches, sum of their weighted scores, and sum of N_b^2 / n_bh per stratum
+    long long totalHistories = 0;
+    double weightedSum = 0;
+    std::vector<double> allocationSums;
+};
@@ -0,0 +1,128 @@
+/**
+ * @file subsampling.h
+ * @brief probabilities with which the CFD estimators score events, tuned against their cost
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <array>
+#include <string>
+#include <vector>
+
+#include "cell.h"
+
+/**
+ * @brief Probability with which each type of event is scored by CFD, in energy bands.
+ *        Selected events are scored with their weight divided by the probability, so tallies are not biased.
+ *        By default 1% of the thermal neutron collisions are scored and all other events are.
+ *        Events must be scored with the probabilities they were selected with:
+ *        change the policy between runs, not between recording and replaying a collision bank.
+ */
+class SubsamplingPolicy
+{
+public:
+    enum Estimator {Primary, PhotonScatter, FastNeutronScatter, ThermalNeutronScatter};
+    static constexpr int nEstimators = 4;
+
+    /**
+     * @brief Statistics of a pilot run where every event is scored, per estimator and energy band of a policy
+     */
+    struct Pilot
+    {
+        int histories=0;
+        // mean and variance of the history scores, summed over all tally bins
+        double mean=0;
+        double variance=0;
+        // time per history not spent scoring, s
+        double transportSeconds=0;
+        // per history: number of events, sum of the squared event scores, time spent scoring, s
+        std::array<std::vector<double>, nEstimators> events;
+        std::array<std::vector<double>, nEstimators> squaredScores;
+        std::array<std::vector<double>, nEstimators> seconds;
+    };
+    /**
+     * @brief Variance and time per history predicted from a pilot run, relative to scoring every event
+     */
+    struct Tradeoff
+    {
+        double varianceRatio=1;
+        double timeRatio=1;
+        /**
+         * @brief Get the figure of merit, 1 / (variance x time), relative to scoring every event
+         */
+        double getEfficiency() const {return 1 / (varianceRatio * timeRatio);}
+    };
+
+    /**
+     * @brief Construct the default policy, 1% of the thermal neutron collisions
+     */
+    SubsamplingPolicy();
+    /**
+     * @brief Get the policy used by the CFD estimators
+     */
+    static SubsamplingPolicy& GetInstance()
+    {
+        static SubsamplingPolicy* policy = new SubsamplingPolicy();
+        return *policy;
+    }
+    /**
+     * @brief Parse a policy from comma-separated entries <estimator>:<probability>, estimators being
+     *        primary, photon, fast and thermal, or <estimator>:<p0>:<E1>:<p1>:...:<En>:<pn> for probabilities
+     *        in energy bands separated by E1 < ... < En. Estimators not given keep the default.
+     *        e.g. thermal:0.001:0.1:0.05 scores 0.1% of the collisions below 0.1 eV and 5% of the other thermal ones.
+     */
+    static SubsamplingPolicy parse(const std::string& spec);
+    /**
+     * @brief Get the estimator that scores an event
+     */
+    static Estimator classify(const Particle& particle);
+    static std::string getName(const Estimator estimator);
+
+    /**
+     * @brief Score events of one type with a fixed probability, in (0, 1]
+     */
+    void setProbability(const Estimator estimator, const double probability);
+    /**
+     * @brief Score events of one type with a probability per energy band
+     *
+     * @param estimator Event type
+     * @param boundaries Increasing energies separating the bands, MeV for photons and eV for neutrons
+     * @param probabilities_ Probability of each band, in (0, 1], one more than boundaries
+     */
+    void setBands(const Estimator estimator, const std::vector<double>& boundaries, const std::vector<double>& probabilities_);
+    const std::vector<double>& getBoundaries(const Estimator estimator) const {return bandBoundaries[estimator];}
+    const std::vector<double>& getProbabilities(const Estimator estimator) const {return probabilities[estimator];}
+    int findBand(const Estimator estimator, const double ergE) const;
+    double getProbability(const Estimator estimator, const double ergE) const
+    {
+        const std::vector<double>& p = probabilities[estimator];
+        return p.size() == 1 ? p[0] : p[findBand(estimator, ergE)];
+    }
+    /**
+     * @brief Get the probability that the event of a particle is scored
+     */
+    double getProbability(const Particle& particle) const {return getProbability(classify(particle), particle.ergE);}
+
+    /**
+     * @brief Predict the variance and time per history of this policy from a pilot run with the same bands
+     */
+    Tradeoff predict(const Pilot& pilot) const;
+    /**
+     * @brief Set the probabilities of all bands to those maximizing the figure of merit predicted from a pilot run.
+     *        Scoring an event with probability p adds (1 / p - 1) x its squared score to the variance and saves
+     *        (1 - p) x its scoring time, the optimum of each band is found in turn until they no longer change.
+     *
+     * @param pilot Pilot run with the same bands
+     * @param minProbability Smallest probability allowed
+     * @return Tradeoff Predicted variance and time of the optimized policy
+     */
+    Tradeoff optimize(const Pilot& pilot, const double minProbability=1e-4);
+
+private:
+    std::array<std::vector<double>, nEstimators> bandBoundaries;
+    std::array<std::vector<double>, nEstimators> probabilities;
+};
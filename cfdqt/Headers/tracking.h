@@ -12,23 +12,86 @@
 #define TRACKING_H
 
 #include <iostream>
+#include <vector>
 #include "cell.h"
 
+/**
+ * @brief Exponential transform of delta tracking: flight distances are sampled from the majorant
+ *        stretched to mu_max (1 - p cos(theta)), theta the angle between the particle direction and a target point,
+ *        so that particles fly further towards the target and less away from it.
+ *        The weight is multiplied by the unbiased over the stretched density of each flight.
+ *        The stretching parameter p is set per energy bin, 0 outside the bins.
+ */
+class ExponentialTransform
+{
+public:
+    /**
+     * @brief Construct a new Exponential Transform object
+     *
+     * @param target_ Point particles are pushed towards, usually a detector center
+     * @param energyEdges_ Increasing energy bin edges, MeV for photons and eV for neutrons
+     * @param stretching_ Stretching parameter p of each energy bin, in [0, 1)
+     */
+    ExponentialTransform(const Vec3d& target_, const std::vector<double>& energyEdges_, const std::vector<double>& stretching_);
+    /**
+     * @brief Get stretching parameters from diffusion theory, p = 1 - kappa / mu_t with the asymptotic attenuation
+     *        kappa = mu_t sqrt(3 (1 - c)), c the scattering probability of a collision, at the center of each bin.
+     *        This is the transform that flattens the importance of a deep-penetration problem.
+     *
+     * @param config MC run settings, the material of the first cell is used
+     * @param target_ Point particles are pushed towards
+     * @param energyEdges_ Increasing energy bin edges
+     * @param maxStretching Largest stretching parameter, in [0, 1)
+     * @return ExponentialTransform
+     */
+    static ExponentialTransform fromDiffusion(const MCSettings& config, const Vec3d& target_,
+                                              const std::vector<double>& energyEdges_, const double maxStretching=0.7);
+
+    const Vec3d& getTarget() const {return target;}
+    const std::vector<double>& getEnergyEdges() const {return energyEdges;}
+    const std::vector<double>& getStretchingParameters() const {return stretching;}
+    /**
+     * @brief Get the stretching parameter at an energy, 0 outside the energy bins
+     */
+    double getStretching(const double ergE) const;
+    /**
+     * @brief Get p cos(theta) for a particle, the majorant is multiplied by 1 minus it
+     */
+    double getStretching(const Particle& particle) const;
+
+private:
+    Vec3d target;
+    std::vector<double> energyEdges;
+    std::vector<double> stretching;
+};
+
+/**
+ * @brief Get the probability that a collision is a scattering, the factor delta tracking and scattering
+ *        multiply the weight by on average
+ *
+ * @param material Material
+ * @param ergE Energy, MeV for photons and eV for neutrons
+ * @param type Particle type
+ * @return double
+ */
+double scatteringProbability(const Material& material, const double ergE, const Particle::ParticleType type);
+
 /**
  * @brief Perform delta tracking of a particle
  *
  * @param particle Particle to be updated
  * @param config MC run settings
+ * @param transform Exponential transform of the flight distances, nullptr for none
  * @return true if photon stays within ROI
  * @return false if photon leaves ROI
  */
-bool deltaTracking(Particle& particle, const MCSettings& config);
+bool deltaTracking(Particle& particle, const MCSettings& config, const ExponentialTransform* transform=nullptr);
 
 /**
  * @brief Simulate particle scattering.
  * @param particle Particle to be updated.
  * @param config MC run settings
- * @return
+ * @return int Index in the material composition of the nuclide a neutron scattered on, 0 for a photon
  */
 int scattering(Particle& particle, const MCSettings& config);
 
@@ -39,10 +102,11 @@ int scattering(Particle& particle, const MCSettings& config);
  * 
  * @param particle Particle to be updated.
  * @param config MC run settings 
+ * @param transform Exponential transform of the flight distances, nullptr for none
  * @return true if photon stays within ROI
  * @return false if photon leaves ROI
  */
-bool deltaTrackingPhoton(Particle& particle, const MCSettings& config);
+bool deltaTrackingPhoton(Particle& particle, const MCSettings& config, const ExponentialTransform* transform=nullptr);
 
 /**
  * @brief Perform delta tracking of a neutron. Photon travels along the current direction, 
@@ -51,10 +115,11 @@ bool deltaTrackingPhoton(Particle& particle, const MCSettings& config);
  * 
  * @param particle Photon to be updated.
  * @param config MC run settings 
+ * @param transform Exponential transform of the flight distances, nullptr for none
  * @return true if neutron stays within ROI
  * @return false if neutron leaves ROI
  */
-bool deltaTrackingNeutron(Particle& particle, const MCSettings& config);
+bool deltaTrackingNeutron(Particle& particle, const MCSettings& config, const ExponentialTransform* transform=nullptr);
 
 /**
  * @brief Perform Compton scattering of a photon. 
@@ -73,7 +138,7 @@ int ComptonScattering(Particle& particle, const MCSettings& config);
  * 
  * @param particle Neutron to be scattered.
  * @param config 
- * @return int 
+ * @return int Index in the material composition of the nuclide the neutron scattered on
  */
 int neutronElasticScattering(Particle& particle, const MCSettings& config);
 
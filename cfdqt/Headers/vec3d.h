@@ -0,0 +1,184 @@
+/**
+ * @file vec3d.h
+ * @brief double-precision 3D vector used by the physics libraries
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <cmath>
+
+/**
+ * @brief 3D vector of doubles. Components are stored contiguously as (x, y, z, 0)
+ *        in a 32-byte aligned block so that element-wise arithmetic maps onto packed SIMD operations.
+ *        The interface follows QVector3D so the GUI can convert at the boundary.
+ */
+class alignas(32) Vec3d
+{
+private:
+    // x, y, z and a padding element that is always 0
+    double v[4];
+public:
+    Vec3d() : v{0, 0, 0, 0} {}
+    Vec3d(const double x, const double y, const double z) : v{x, y, z, 0} {}
+
+    double x() const {return v[0];}
+    double y() const {return v[1];}
+    double z() const {return v[2];}
+    void setX(const double x) {v[0] = x;}
+    void setY(const double y) {v[1] = y;}
+    void setZ(const double z) {v[2] = z;}
+    double operator[](const int i) const {return v[i];}
+    double& operator[](const int i) {return v[i];}
+
+    double lengthSquared() const {return v[0] * v[0] + v[1] * v[1] + v[2] * v[2];}
+    double length() const {return std::sqrt(lengthSquared());}
+    /**
+     * @brief Get the unit vector along this vector. The zero vector is returned unchanged.
+     *
+     * @return Vec3d
+     */
+    Vec3d normalized() const
+    {
+        const double len = length();
+        if (len == 0)
+            return *this;
+        return Vec3d(v[0] / len, v[1] / len, v[2] / len);
+    }
+    void normalize() {*this = normalized();}
+
+    static double dotProduct(const Vec3d& a, const Vec3d& b)
+    {
+        return a.v[0] * b.v[0] + a.v[1] * b.v[1] + a.v[2] * b.v[2];
+    }
+    static Vec3d crossProduct(const Vec3d& a, const Vec3d& b)
+    {
+        return Vec3d(a.v[1] * b.v[2] - a.v[2] * b.v[1],
+                     a.v[2] * b.v[0] - a.v[0] * b.v[2],
+                     a.v[0] * b.v[1] - a.v[1] * b.v[0]);
+    }
+    /**
+     * @brief Get the distance from this point to a line
+     *
+     * @param point A point on the line
+     * @param direction Unit direction of the line
+     * @return double
+     */
+    double distanceToLine(const Vec3d& point, const Vec3d& direction) const
+    {
+        Vec3d diff(v[0] - point.v[0], v[1] - point.v[1], v[2] - point.v[2]);
+        const double proj = dotProduct(diff, direction);
+        return Vec3d(diff.v[0] - proj * direction.v[0],
+                     diff.v[1] - proj * direction.v[1],
+                     diff.v[2] - proj * direction.v[2]).length();
+    }
+    double distanceToPoint(const Vec3d& point) const
+    {
+        return Vec3d(v[0] - point.v[0], v[1] - point.v[1], v[2] - point.v[2]).length();
+    }
+
+    Vec3d& operator+=(const Vec3d& b)
+    {
+        for (int i = 0; i < 4; i++)
+            v[i] += b.v[i];
+        return *this;
+    }
+    Vec3d& operator-=(const Vec3d& b)
+    {
+        for (int i = 0; i < 4; i++)
+            v[i] -= b.v[i];
+        return *this;
+    }
+    Vec3d& operator*=(const double f)
+    {
+        for (int i = 0; i < 4; i++)
+            v[i] *= f;
+        return *this;
+    }
+    Vec3d& operator/=(const double f)
+    {
+        for (int i = 0; i < 4; i++)
+            v[i] /= f;
+        return *this;
+    }
+
+    friend Vec3d operator+(Vec3d a, const Vec3d& b) {return a += b;}
+    friend Vec3d operator-(Vec3d a, const Vec3d& b) {return a -= b;}
+    friend Vec3d operator-(const Vec3d& a) {return Vec3d(-a.v[0], -a.v[1], -a.v[2]);}
+    friend Vec3d operator*(Vec3d a, const double f) {return a *= f;}
+    friend Vec3d operator*(const double f, Vec3d a) {return a *= f;}
+    friend Vec3d operator/(Vec3d a, const double f) {return a /= f;}
+    friend bool operator==(const Vec3d& a, const Vec3d& b)
+    {
+        return a.v[0] == b.v[0] && a.v[1] == b.v[1] && a.v[2] == b.v[2];
+    }
+    friend bool operator!=(const Vec3d& a, const Vec3d& b) {return !(a == b);}
+};
+
+/**
+ * @brief 3x3 matrix of doubles, row-major
+ */
+class Mat3
+{
+private:
+    double m[3][3];
+public:
+    /**
+     * @brief Construct a new Mat3 object, identity matrix
+     */
+    Mat3() : m{{1, 0, 0}, {0, 1, 0}, {0, 0, 1}} {}
+    /**
+     * @brief Construct a new Mat3 object from its columns
+     *
+     * @param c0 First column
+     * @param c1 Second column
+     * @param c2 Third column
+     */
+    Mat3(const Vec3d& c0, const Vec3d& c1, const Vec3d& c2)
+        : m{{c0.x(), c1.x(), c2.x()}, {c0.y(), c1.y(), c2.y()}, {c0.z(), c1.z(), c2.z()}} {}
+
+    static Mat3 diagonal(const Vec3d& d)
+    {
+        return Mat3(Vec3d(d.x(), 0, 0), Vec3d(0, d.y(), 0), Vec3d(0, 0, d.z()));
+    }
+
+    double operator()(const int row, const int col) const {return m[row][col];}
+    Vec3d column(const int col) const {return Vec3d(m[0][col], m[1][col], m[2][col]);}
+    Vec3d row(const int r) const {return Vec3d(m[r][0], m[r][1], m[r][2]);}
+
+    double determinant() const
+    {
+        return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1])
+             - m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0])
+             + m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    }
+    /**
+     * @brief Get the inverse of this matrix. The matrix must not be singular.
+     *
+     * @return Mat3
+     */
+    Mat3 inverse() const
+    {
+        // columns of the inverse are the cross products of the rows, divided by the determinant
+        const double det = determinant();
+        const Vec3d r0 = row(0), r1 = row(1), r2 = row(2);
+        Mat3 inv;
+        const Vec3d c[3] = {Vec3d::crossProduct(r1, r2), Vec3d::crossProduct(r2, r0), Vec3d::crossProduct(r0, r1)};
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                inv.m[i][j] = c[j][i] / det;
+        return inv;
+    }
+
+    friend Vec3d operator*(const Mat3& a, const Vec3d& v)
+    {
+        return Vec3d(Vec3d::dotProduct(a.row(0), v), Vec3d::dotProduct(a.row(1), v), Vec3d::dotProduct(a.row(2), v));
+    }
+    friend Mat3 operator*(const Mat3& a, const Mat3& b)
+    {
+        return Mat3(a * b.column(0), a * b.column(1), a * b.column(2));
+    }
+};
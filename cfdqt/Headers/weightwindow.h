@@ -0,0 +1,155 @@
+/**
+ * @file weightwindow.h
+ * @brief weight windows: splitting and Russian roulette on a space-energy mesh
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cell.h"
+#include "tracking.h"
+
+/**
+ * @brief Weight windows on a regular x-y-z mesh times energy bins.
+ *        A particle heavier than the upper bound of its window is split into particles of lower weights,
+ *        a particle lighter than the lower bound plays Russian roulette and survives with the survival weight.
+ *        Both keep the expected weight, so tallies are not biased, unlike a hard weight cutoff.
+ *        Mesh elements with a lower bound of 0, and particles outside the mesh, are not controlled.
+ */
+class WeightWindowMesh
+{
+public:
+    /**
+     * @brief Construct a new Weight Window Mesh object
+     *
+     * @param lower_ Mesh corner with the smallest coordinates
+     * @param upper_ Mesh corner with the largest coordinates
+     * @param nx Number of mesh elements along x
+     * @param ny Number of mesh elements along y
+     * @param nz Number of mesh elements along z
+     * @param energyEdges_ Increasing energy bin edges, MeV for photons and eV for neutrons
+     * @param lowerBounds_ Lower weight bound of element (i, j, k) and energy bin e at ((e * nx + i) * ny + j) * nz + k
+     * @param upperRatio_ Upper bound over lower bound
+     * @param survivalRatio_ Weight of the particles surviving roulette over lower bound,
+     *                       between 1 and upperRatio_
+     * @param maxSplit_ Maximum number of particles a particle is split into at once
+     */
+    WeightWindowMesh(const Vec3d& lower_, const Vec3d& upper_, const int nx, const int ny, const int nz,
+                     const std::vector<double>& energyEdges_, const std::vector<double>& lowerBounds_,
+                     const double upperRatio_=5, const double survivalRatio_=3, const int maxSplit_=5);
+    /**
+     * @brief Load weight windows from a text file. Lines starting with # are comments.
+     *        Line 1: lower corner x y z, upper corner x y z, nx ny nz.
+     *        Line 2: energy bin edges.
+     *        Then the lower bounds, in the order of the constructor, any number per line.
+     *
+     * @param fpath File path
+     * @return WeightWindowMesh
+     */
+    static WeightWindowMesh load(const std::string& fpath);
+    /**
+     * @brief Write the weight windows in the format read by load
+     *
+     * @param fpath File path
+     */
+    void save(const std::string& fpath) const;
+
+    int getNumberOfElements() const {return nodes[0] * nodes[1] * nodes[2];}
+    int getNEnergyBins() const {return static_cast<int>(energyEdges.size()) - 1;}
+    const std::vector<double>& getEnergyEdges() const {return energyEdges;}
+    const std::vector<double>& getLowerBounds() const {return lowerBounds;}
+    double getUpperRatio() const {return upperRatio;}
+    double getSurvivalRatio() const {return survivalRatio;}
+    /**
+     * @brief Get the center of mesh element (i, j, k)
+     */
+    Vec3d getElementCenter(const int i, const int j, const int k) const;
+    /**
+     * @brief Get the window index of a position and an energy, -1 outside the mesh
+     */
+    int findWindow(const Vec3d& pos, const double ergE) const;
+    /**
+     * @brief Get the lower bound at a position and an energy, 0 outside the mesh
+     */
+    double getLowerBound(const Vec3d& pos, const double ergE) const;
+
+    /**
+     * @brief Split or roulette a particle according to its window.
+     *        Split particles are appended to a bank, to be transported after the current one.
+     *
+     * @param particle Particle, its weight is updated
+     * @param bank Particles split from this one are appended to it
+     * @return int Number of particles left, 0 if the particle was killed by roulette, its weight is then 0
+     */
+    int apply(Particle& particle, std::vector<Particle>& bank) const;
+
+private:
+    Vec3d lowerCorner;
+    Vec3d upperCorner;
+    // number of elements along x, y, z
+    int nodes[3];
+    // element size along x, y, z
+    double spacing[3];
+    std::vector<double> energyEdges;
+    std::vector<double> lowerBounds;
+    double upperRatio;
+    double survivalRatio;
+    int maxSplit;
+};
+
+/**
+ * @brief Transport a source particle, and the particles split from it by weight windows.
+ *        score(particle) is called at the source and at every collision, before scattering,
+ *        like forceDetection or CollisionBank::record in the history loops.
+ *        Without weight windows particles lighter than config.minW are killed, as before;
+ *        with weight windows roulette replaces that cutoff and windows are applied after every scattering.
+ *
+ * @param source Particle created by the source
+ * @param config MC run settings
+ * @param windows Weight windows, nullptr for none
+ * @param transform Exponential transform of the flight distances, nullptr for none
+ * @param score Called with each particle to be scored
+ */
+template <typename Score>
+void transportHistory(Particle source, const MCSettings& config, const WeightWindowMesh* windows,
+                      const ExponentialTransform* transform, Score&& score)
+{
+    std::vector<Particle> bank;
+    // primary contribution
+    score(source);
+    if (!windows || windows->apply(source, bank) > 0)
+        bank.push_back(source);
+    while (!bank.empty())
+    {
+        Particle prtl = bank.back();
+        bank.pop_back();
+        // transport
+        while (prtl.scatterN < config.maxScatterN &&
+               prtl.ergE > config.minE &&
+               (windows || prtl.weight > config.minW) &&
+               deltaTracking(prtl, config, transform))
+        {
+            prtl.scatterN += 1;
+            score(prtl);
+            scattering(prtl, config);
+            if (windows && windows->apply(prtl, bank) == 0)
+                break;
+        }
+    }
+}
+
+/**
+ * @brief Transport a source particle without exponential transform, see above
+ */
+template <typename Score>
+void transportHistory(Particle source, const MCSettings& config, const WeightWindowMesh* windows, Score&& score)
+{
+    transportHistory(source, config, windows, nullptr, std::forward<Score>(score));
+}
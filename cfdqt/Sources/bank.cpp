@@ -0,0 +1,363 @@
+#include "bank.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <numeric>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// file signature and layout version of saved banks
+static const char bankMagic[8] = {'C', 'F', 'D', 'B', 'A', 'N', 'K', '2'};
+// bins of all tallies accumulated in a stripe per thread on replay, 256 kB per thread
+static const int stripedBinsPerThread = 32768;
+// points per dimension of the stratified check that a target source shape is inside the reference shape
+static const int coveragePoints = 8;
+
+void CollisionBank::record(const Particle& particle)
+{
+    if (!sampleEventScoring(particle))
+        return;
+    events.push_back({particle.pos, particle.dir, particle.ergE, particle.weight, particle.time,
+                      particle.scatterN, particle.particleType});
+}
+
+void CollisionBank::transport(const MCSettings& config, const int nps, const WeightWindowMesh* windows)
+{
+    for (int i = 0; i < nps; i++)
+    {
+        // create a new particle from source, record it and its collisions, and those of the particles split from it
+        transportHistory(config.source.createParticle(), config, windows, [this](const Particle& prtl) {record(prtl);});
+        endHistory();
+    }
+}
+
+void CollisionBank::replay(const MCSettings& config, std::vector<Tally>& tallies) const
+{
+    const long long eventsNum = events.size();
+#ifdef _OPENMP
+    const bool timeBinned = std::any_of(tallies.begin(), tallies.end(), [](const Tally& tally) {return tally.hasTimeBins();});
+    if (!timeBinned)
+    {
+        // all threads score in the same tallies, whose counts are shared: bins are striped per thread
+        // while the budget allows, the bins with the largest counts so far first, the others are atomic
+        const int nThreads = omp_get_max_threads();
+        int budget = stripedBinsPerThread;
+        for (auto &&tally : tallies)
+        {
+            std::vector<int> hotBins;
+            if (tally.getNBins() <= budget)
+            {
+                hotBins.resize(tally.getNBins());
+                std::iota(hotBins.begin(), hotBins.end(), 0);
+            }
+            else
+            {
+                hotBins = SharedTallyStorage::hottestBins(tally.getBinContents(), budget);
+            }
+            budget -= hotBins.size();
+            tally.shareCounts(std::make_shared<SharedTallyStorage>(tally.getNBins(), nThreads, hotBins));
+        }
+        #pragma omp parallel for schedule(static)
+        for (long long i = 0; i < eventsNum; i++)
+        {
+            forceDetectionSampled(events[i].toParticle(), config, tallies);
+        }
+        for (auto &&tally : tallies)
+            tally.collectSharedCounts();
+        return;
+    }
+    // time bins are not shared: every thread scores its share of the events in its own copy of the tallies,
+    // copies are added in thread order so that results do not depend on timing
+    std::vector<std::vector<Tally>> threadTallies(omp_get_max_threads());
+    #pragma omp parallel
+    {
+        std::vector<Tally>& local = threadTallies[omp_get_thread_num()];
+        local = tallies;
+        for (auto &&tally : local)
+            tally.reset();
+        #pragma omp for schedule(static)
+        for (long long i = 0; i < eventsNum; i++)
+        {
+            forceDetectionSampled(events[i].toParticle(), config, local);
+        }
+    }
+    for (auto &&local : threadTallies)
+    {
+        for (std::size_t t = 0; t < local.size(); t++)
+            tallies[t].add(local[t]);
+    }
+#else
+    for (long long i = 0; i < eventsNum; i++)
+    {
+        forceDetectionSampled(events[i].toParticle(), config, tallies);
+    }
+#endif
+}
+
+void CollisionBank::replay(const MCSettings& config, Tally& tally) const
+{
+    std::vector<Tally> tallies{tally};
+    replay(config, tallies);
+    tally = tallies[0];
+}
+
+void CollisionBank::save(const std::string& fpath) const
+{
+    std::ofstream fileptr(fpath, std::ios::out | std::ios::binary);
+    if (!fileptr.is_open())
+    {
+        std::string errMessage = "can't open file: " + fpath;
+        throw std::runtime_error(errMessage);
+    }
+    const std::int32_t nps = NPS;
+    const std::uint64_t eventsNum = events.size();
+    fileptr.write(bankMagic, sizeof(bankMagic));
+    fileptr.write(reinterpret_cast<const char*>(&nps), sizeof(nps));
+    fileptr.write(reinterpret_cast<const char*>(&eventsNum), sizeof(eventsNum));
+    // fixed field order, independent of the struct padding
+    for (auto &&event : events)
+    {
+        const double values[9] = {event.pos.x(), event.pos.y(), event.pos.z(),
+                                  event.dir.x(), event.dir.y(), event.dir.z(),
+                                  event.ergE, event.weight, event.time};
+        const std::int32_t ints[2] = {event.scatterN, static_cast<std::int32_t>(event.particleType)};
+        fileptr.write(reinterpret_cast<const char*>(values), sizeof(values));
+        fileptr.write(reinterpret_cast<const char*>(ints), sizeof(ints));
+    }
+    if (!fileptr)
+        throw std::runtime_error("can't write file: " + fpath);
+}
+
+CollisionBank CollisionBank::load(const std::string& fpath)
+{
+    std::ifstream fileptr(fpath, std::ios::in | std::ios::binary);
+    if (!fileptr.is_open())
+    {
+        std::string errMessage = "can't open file: " + fpath;
+        throw std::runtime_error(errMessage);
+    }
+    char magic[sizeof(bankMagic)];
+    std::int32_t nps(0);
+    std::uint64_t eventsNum(0);
+    fileptr.read(magic, sizeof(magic));
+    fileptr.read(reinterpret_cast<char*>(&nps), sizeof(nps));
+    fileptr.read(reinterpret_cast<char*>(&eventsNum), sizeof(eventsNum));
+    if (!fileptr || std::memcmp(magic, bankMagic, sizeof(bankMagic)) != 0)
+        throw std::runtime_error(fpath + " is not a collision bank.");
+
+    CollisionBank bank;
+    bank.NPS = nps;
+    bank.events.reserve(eventsNum);
+    double values[9];
+    std::int32_t ints[2];
+    for (std::uint64_t i = 0; i < eventsNum; i++)
+    {
+        fileptr.read(reinterpret_cast<char*>(values), sizeof(values));
+        fileptr.read(reinterpret_cast<char*>(ints), sizeof(ints));
+        if (!fileptr)
+            throw std::runtime_error(fpath + " is truncated.");
+        bank.events.push_back({Vec3d(values[0], values[1], values[2]), Vec3d(values[3], values[4], values[5]),
+                               values[6], values[7], values[8], ints[0], static_cast<Particle::ParticleType>(ints[1])});
+    }
+    return bank;
+}
+
+/**
+ * @brief Energy range of a spectrum, a monoenergetic one is widened by lineWidth
+ */
+static void getSpectrumRange(const std::vector<double>& invCDF, const double lineWidth, double& lower, double& upper)
+{
+    lower = invCDF.size() == 1 ? invCDF[0] * (1 - 0.5 * lineWidth) : invCDF.front();
+    upper = invCDF.size() == 1 ? invCDF[0] * (1 + 0.5 * lineWidth) : invCDF.back();
+}
+
+/**
+ * @brief Probability of a spectrum between two energies
+ */
+static double getProbability(const std::vector<double>& invCDF, const double lineWidth, const double lower, const double upper)
+{
+    std::vector<double> edges(invCDF);
+    if (invCDF.size() == 1)
+    {
+        edges.resize(2);
+        getSpectrumRange(invCDF, lineWidth, edges[0], edges[1]);
+    }
+    double probability(0);
+    for (std::size_t i = 0; i + 1 < edges.size(); i++)
+    {
+        const double width = edges[i + 1] - edges[i];
+        if (width > 0)
+            probability += std::max(0.0, std::min(upper, edges[i + 1]) - std::max(lower, edges[i])) / width;
+        else
+            probability += edges[i] >= lower && edges[i] <= upper;
+    }
+    return probability / (edges.size() - 1);
+}
+
+double HistoryBank::getEnergyDensity(const std::vector<double>& invCDF, const double energy, const double lineWidth)
+{
+    if (invCDF.size() == 1)
+    {
+        const double width = lineWidth * invCDF[0];
+        return std::abs(energy - invCDF[0]) <= 0.5 * width ? 1 / width : 0;
+    }
+    if (energy < invCDF.front() || energy > invCDF.back())
+        return 0;
+    const std::size_t bins = invCDF.size() - 1;
+    const std::size_t bin = std::min<std::size_t>(std::upper_bound(invCDF.begin(), invCDF.end(), energy) - invCDF.begin() - 1, bins - 1);
+    const double width = invCDF[bin + 1] - invCDF[bin];
+    return width > 0 ? 1 / (bins * width) : 0;
+}
+
+HistoryBank::HistoryBank(const std::vector<Tally>& tallies, const double lineWidth_)
+    : lineWidth(lineWidth_), historyTallies(tallies)
+{
+    if (!(lineWidth > 0))
+        throw std::runtime_error("The width of monoenergetic sources must be positive.");
+    int offset(0);
+    for (auto &&tally : historyTallies)
+    {
+        if (tally.hasTimeBins())
+            throw std::runtime_error("Time bins are not supported by the history bank.");
+        tally.reset();
+        binOffsets.push_back(offset);
+        offset += tally.getNBins();
+    }
+}
+
+void HistoryBank::transport(const MCSettings& config, const int nps, const WeightWindowMesh* windows)
+{
+    if (!std::isfinite(config.source.getShape().getVolume()))
+        throw std::runtime_error("The reference source of a history bank must be bounded.");
+    reference = std::make_unique<Source>(config.source);
+    positions.clear();
+    energies.clear();
+    firstScores = {0};
+    scoreBins.clear();
+    scores.clear();
+    for (int i = 0; i < nps; i++)
+    {
+        const Particle source = config.source.createParticle();
+        positions.push_back(source.pos);
+        energies.push_back(source.ergE);
+        // all tallies in one pass at the source and at every collision
+        transportHistory(source, config, windows, [this, &config](Particle& prtl) {forceDetection(prtl, config, historyTallies);});
+        for (std::size_t t = 0; t < historyTallies.size(); t++)
+        {
+            for (int b = 0; b < historyTallies[t].getNBins(); b++)
+            {
+                const double score = historyTallies[t].getBinContent(b);
+                if (score == 0)
+                    continue;
+                scoreBins.push_back(binOffsets[t] + b);
+                scores.push_back(score);
+            }
+            historyTallies[t].reset();
+        }
+        firstScores.push_back(scores.size());
+    }
+}
+
+std::vector<double> HistoryBank::getWeights(const Source& target) const
+{
+    if (!reference)
+        throw std::runtime_error("The history bank is empty.");
+    if (target.getParticleType() != reference->getParticleType())
+        throw std::runtime_error("The target source emits other particles than the reference.");
+    const double volumeRatio = reference->getShape().getVolume() / target.getShape().getVolume();
+    std::vector<double> weights(energies.size(), 0);
+    for (std::size_t i = 0; i < energies.size(); i++)
+    {
+        const double referenceDensity = getEnergyDensity(reference->getEnergyCDF(), energies[i], lineWidth);
+        if (referenceDensity > 0 && target.getShape().contain(positions[i]))
+            weights[i] = getEnergyDensity(target.getEnergyCDF(), energies[i], lineWidth) / referenceDensity * volumeRatio;
+    }
+    return weights;
+}
+
+HistoryBank::Diagnostics HistoryBank::diagnose(const Source& target) const
+{
+    return diagnose(target, getWeights(target));
+}
+
+HistoryBank::Diagnostics HistoryBank::diagnose(const Source& target, const std::vector<double>& weights) const
+{
+    Diagnostics diagnostics;
+    diagnostics.histories = weights.size();
+    double sum(0), squaredSum(0);
+    for (auto &&w : weights)
+    {
+        sum += w;
+        squaredSum += w * w;
+        diagnostics.maxWeight = std::max(diagnostics.maxWeight, w);
+    }
+    diagnostics.meanWeight = weights.empty() ? 0 : sum / weights.size();
+    diagnostics.effectiveSampleSize = squaredSum > 0 ? sum * sum / squaredSum : 0;
+    // energies of the target outside the reference spectrum, positions outside the reference shape
+    double lower, upper;
+    getSpectrumRange(reference->getEnergyCDF(), lineWidth, lower, upper);
+    const double energyCoverage = getProbability(target.getEnergyCDF(), lineWidth, lower, upper);
+    int inside(0);
+    for (int i = 0; i < coveragePoints; i++)
+    {
+        for (int j = 0; j < coveragePoints; j++)
+        {
+            for (int k = 0; k < coveragePoints; k++)
+            {
+                const Vec3d point = target.getShape().samplePoint((i + 0.5) / coveragePoints, (j + 0.5) / coveragePoints, (k + 0.5) / coveragePoints);
+                inside += reference->getShape().contain(point);
+            }
+        }
+    }
+    diagnostics.coverage = energyCoverage * inside / std::pow(coveragePoints, 3);
+    return diagnostics;
+}
+
+HistoryBank::Diagnostics HistoryBank::reweight(const Source& target, std::vector<Tally>& tallies) const
+{
+    bool differ = tallies.size() != historyTallies.size();
+    for (std::size_t t = 0; !differ && t < tallies.size(); t++)
+        differ = tallies[t].getNBins() != historyTallies[t].getNBins() || tallies[t].hasTimeBins();
+    if (differ)
+        throw std::runtime_error("The tallies to reweight differ from those of the history bank.");
+    const std::vector<double> weights = getWeights(target);
+    Diagnostics diagnostics = diagnose(target, weights);
+    if (diagnostics.isDegenerate())
+        std::cerr << "Warning: the source weights are degenerate, effective sample size " << diagnostics.effectiveSampleSize
+                  << " of " << diagnostics.histories << " histories." << std::endl;
+    if (diagnostics.coverage < 0.999)
+        std::cerr << "Warning: the reference source covers " << diagnostics.coverage
+                  << " of the target source only, the tallies are underestimated." << std::endl;
+    std::vector<double> counts(binOffsets.empty() ? 0 : binOffsets.back() + historyTallies.back().getNBins(), 0);
+    double sum(0), squaredSum(0);
+    for (std::size_t i = 0; i < weights.size(); i++)
+    {
+        if (weights[i] == 0)
+            continue;
+        double total(0);
+        for (std::size_t j = firstScores[i]; j < firstScores[i + 1]; j++)
+        {
+            counts[scoreBins[j]] += weights[i] * scores[j];
+            total += weights[i] * scores[j];
+        }
+        sum += total;
+        squaredSum += total * total;
+    }
+    if (!weights.empty())
+    {
+        diagnostics.total = sum / weights.size();
+        diagnostics.totalError = std::sqrt(std::max(0.0, squaredSum / weights.size() - diagnostics.total * diagnostics.total) / weights.size());
+    }
+    for (std::size_t t = 0; t < tallies.size(); t++)
+    {
+        std::vector<int> bins(historyTallies[t].getNBins());
+        std::iota(bins.begin(), bins.end(), 0);
+        tallies[t].scoreBins(bins, std::vector<double>(counts.begin() + binOffsets[t], counts.begin() + binOffsets[t] + bins.size()));
+    }
+    return diagnostics;
+}
@@ -5,20 +5,15 @@ Particle Source::createParticle() const
     // uniform, [0. 1)
     double a = GlobalUniformRandNumGenerator::GetInstance().generateDouble();
     double b = GlobalUniformRandNumGenerator::GetInstance().generateDouble();
-    if (b < a)
-        std::swap(a, b);
-    
-    double initX = b * cylinder.getRadius() * qCos(2 * M_PI * a /b);
-    double initY = b * cylinder.getRadius() * qSin(2 * M_PI * a /b);
-    double initZ = GlobalUniformRandNumGenerator::GetInstance().generateDouble() * cylinder.getHeight();
-    QVector3D initPos = QVector3D(initX, initY, initZ) + cylinder.getBaseCenter();
-    // QVector3D initPos = cylinder.getBaseCenter();
+    double c = GlobalUniformRandNumGenerator::GetInstance().generateDouble();
+    Vec3d initPos = shape->samplePoint(a, b, c);
+    // Vec3d initPos = cylinder.getBaseCenter();
     // initPos.setZ(10);
 
     double phi= 2 * M_PI * GlobalUniformRandNumGenerator::GetInstance().generateDouble();
     double costheta = 1 - 2 * GlobalUniformRandNumGenerator::GetInstance().generateDouble();
-    double sintheta = qSqrt(1-costheta*costheta);
-    QVector3D initDir = QVector3D(sintheta * qCos(phi), sintheta * qSin(phi), costheta);
+    double sintheta = std::sqrt(1-costheta*costheta);
+    Vec3d initDir = Vec3d(sintheta * std::cos(phi), sintheta * std::sin(phi), costheta);
 
     double initE = 0;
     // monoenergetic
@@ -60,4 +55,27 @@ void Particle::scatter(const double cosAng)
         dir.setY(sinAng * std::sin(alpha));
         dir.setZ(cosAng * R3);
     }
+}
+
+double Cell::trackLength(const Ray& ray, const double maxLength) const
+{
+    double length(0);
+    for (auto &&seg : shape->segments(ray))
+    {
+        if (seg.tIn >= maxLength)
+            break;
+        length += std::min(seg.tOut, maxLength) - seg.tIn;
+    }
+    return length;
+}
+
+void MCSettings::getCellPathLengths(const Vec3d& from, const Vec3d& to, std::vector<double>& lengths) const
+{
+    const Ray ray(from, to - from);
+    const double distance = (to - from).length();
+    lengths.resize(cells.size());
+    for (std::size_t i = 0; i < cells.size(); i++)
+    {
+        lengths[i] = cells[i].trackLength(ray, distance);
+    }
 }
\ No newline at end of file
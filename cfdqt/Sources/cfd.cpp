@@ -1,69 +1,206 @@
 #include "cfd.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
 #include <iostream>
+#include <numeric>
+#include <queue>
+
+/**
+ * @brief Get the scratch buffer of the path lengths to a detector, one per thread,
+ *        reused by every event and tally and resized in place
+ */
+static std::vector<double>& getPathLengthBuffer()
+{
+    thread_local std::vector<double> lengths;
+    return lengths;
+}
 
-int forceDetection(Particle& particle, const MCSettings& config, Tally& tally)
+/**
+ * @brief Bins, scores and arrival times of the thermal neutrons scattered towards a detector
+ */
+struct ThermalScratch
+{
+    std::vector<int> bins;
+    std::vector<double> weights;
+    std::vector<double> times;
+};
+
+/**
+ * @brief Get the scratch storage of the thermal neutron scores, one per thread, resized in place
+ */
+static ThermalScratch& getThermalScratch()
+{
+    thread_local ThermalScratch scratch;
+    return scratch;
+}
+
+/**
+ * @brief Get the path length in each cell from the particle to the detector center.
+ *        Interpolated from the tally's path length field if one is set, traced exactly otherwise.
+ * 
+ * @param particle Particle to be detected
+ * @param config MC run settings
+ * @param tally Tally that provides the detector
+ * @param lengths Path length in each cell
+ */
+static void getPathLengthsToDetector(const Particle& particle, const MCSettings& config, const Tally& tally, std::vector<double>& lengths)
+{
+    if (tally.getPathLengthField())
+        tally.getPathLengthField()->getPathLengths(particle.pos, lengths);
+    else
+        config.getCellPathLengths(particle.pos, tally.getCenter(), lengths);
+}
+
+static double photonOpticalDepth(const std::vector<double>& lengths, const MCSettings& config, const double erg)
 {
+    double depth(0);
+    for (std::size_t i = 0; i < lengths.size(); i++)
+    {
+        if (lengths[i] > 0)
+            depth += lengths[i] * config.cells[i].material.getPhotonTotalAtten(erg);
+    }
+    return depth;
+}
+
+static double neutronOpticalDepth(const std::vector<double>& lengths, const MCSettings& config, const double erg)
+{
+    double depth(0);
+    for (std::size_t i = 0; i < lengths.size(); i++)
+    {
+        if (lengths[i] > 0)
+            depth += lengths[i] * config.cells[i].material.getNeutronTotalAtten(erg);
+    }
+    return depth;
+}
+
+static const double kT = 0.0253; // eV, 293.6K
+
+CollisionContext::CollisionContext(const Particle& particle, const MCSettings& config)
+{
+    // source events only need the primary transmission
+    if (particle.scatterN == 0)
+        return;
+    const Material& material = config.cells[0].material;
     if (particle.particleType == Particle::Photon)
     {
-        if (particle.scatterN == 0)
-        {
-            primaryContributionPhoton(particle, config, tally);
-        }
-        else
+        comptonIntegral = material.getPhotonCrossSection().getTotalComptonIntegral(particle.ergE);
+        return;
+    }
+    totalCrossSection = material.getNeutronTotalMicroscopicCrossSection(particle.ergE);
+    for (auto &&comp : material.getNuclideComposition())
+    {
+        const Nuclide& nuclide = comp.second;
+        elasticCrossSections.push_back(comp.first * 
+                nuclide.getNeutronCrossSection().getElasticMicroscopicCrossSectionAt(particle.ergE));
+        if (particle.ergE < 1)
         {
-            scatterContributionPhoton(particle, config, tally);
+            const double a = std::sqrt(nuclide.getAtomicWeight() * particle.ergE / kT);
+            thermalNormalizations.push_back(2 / ((1+0.5/(a*a))*std::erf(a) + std::exp(-a*a) / (a*2)*M_2_SQRTPI));
         }
     }
-    else if (particle.particleType == Particle::Neutron)
+}
+
+double CollisionContext::getPrimaryTransmission(const Particle& particle, const MCSettings& config, const double distance) const
+{
+    if (primarySegments.size() != config.cells.size())
     {
-        if (particle.scatterN == 0)
+        const Ray ray(particle.pos, particle.dir);
+        primarySegments.clear();
+        primaryAtten.clear();
+        for (auto &&cell : config.cells)
         {
-            primaryContributionNeutron(particle, config, tally);
+            primarySegments.push_back(cell.getShape().segments(ray));
+            primaryAtten.push_back(particle.particleType == Particle::Photon ? 
+                                   cell.material.getPhotonTotalAtten(particle.ergE) : 
+                                   cell.material.getNeutronTotalAtten(particle.ergE));
         }
-        else
+    }
+    // track length in each cell up to the distance, as Cell::trackLength
+    double atten(0);
+    for (std::size_t i = 0; i < primarySegments.size(); i++)
+    {
+        for (auto &&seg : primarySegments[i])
         {
-            scatterContributionNeutron(particle, config, tally);
+            if (seg.tIn >= distance)
+                break;
+            atten += (std::min(seg.tOut, distance) - seg.tIn) * primaryAtten[i];
         }
     }
-    return 0;
+    return std::exp(-atten);
 }
 
-int primaryContributionPhoton(const Particle& particle, const MCSettings& config, Tally& tally)
+/**
+ * @brief Time a particle leaving its current position at its current energy takes to reach the detector center
+ */
+static double flightTime(const Particle& particle, const Tally& tally)
 {
-    QVector3D prtl2det = tally.getCenter() - particle.pos;
-    double proj = QVector3D::dotProduct(prtl2det, particle.dir);
-    if(proj <= 0)
-        return 0;
-    
-    double d = tally.getCenter().distanceToLine(particle.pos, particle.dir);
-    if (d >= tally.getRadius())
-        return 0;
+    return (tally.getCenter() - particle.pos).length() / particle.getSpeed();
+}
+
+/**
+ * @brief Score the uncollided flux of a newly-created particle at a point detector,
+ *        forced towards the point from the isotropic source
+ */
+static void scorePrimaryPoint(const Particle& particle, const MCSettings& config, Tally& tally)
+{
+    std::vector<double>& pathLengths = getPathLengthBuffer();
+    getPathLengthsToDetector(particle, config, tally, pathLengths);
+    const double atten = particle.particleType == Particle::Photon ? 
+                         photonOpticalDepth(pathLengths, config, particle.ergE) :
+                         neutronOpticalDepth(pathLengths, config, particle.ergE);
+    // F5 tally, isotropic emission, 1 / (4 pi L^2)
+    const double score = 0.5 * tally.geometryFactor(particle.pos);
+
+    Particle arriving(particle);
+    arriving.time += flightTime(particle, tally);
+    tally.Fill(arriving, std::exp(-atten) * score);
+}
+
+/**
+ * @brief Score the uncollided flux of a newly-created particle in one detector
+ */
+static void scorePrimary(const Particle& particle, const MCSettings& config, const CollisionContext& context, Tally& tally)
+{
+    if (tally.isPointDetector())
+    {
+        scorePrimaryPoint(particle, config, tally);
+        return;
+    }
+    // track length in the detector, attenuated through the cells up to where the particle enters it
+    Segment seg;
+    if (!tally.getDetector().intersect(Ray(particle.pos, particle.dir), seg))
+        return;
+    const double chord = seg.tOut - seg.tIn;
+    const double transmission = context.getPrimaryTransmission(particle, config, seg.tIn);
 
     // // F1 tally
     // double score = 1;
     // // F2 tally
     // double score = 1 / (tally.getArea() * std::sqrt(1-std::pow(d / tally.getRadius(), 2.0)));
     // F4 tally
-    double score = 2 * std::sqrt(std::pow(tally.getRadius(), 2.0) - std::pow(d, 2.0)) / tally.getVolume();
-    
-    
-    // attenuation along the ray
-    Ray ray = Ray(particle.pos, particle.dir);
-    double atten = config.ROI.intersection(ray) * config.cells[0].material.getPhotonTotalAtten(particle.ergE);
+    double score = chord / tally.getVolume();
 
-    tally.Fill(particle, std::exp(-atten)*score);
-    
-    return 0;
+    if (tally.hasTimeBins())
+    {
+        Particle arriving(particle);
+        arriving.time += flightTime(particle, tally);
+        tally.Fill(arriving, transmission*score);
+        return;
+    }
+    tally.Fill(particle, transmission*score);
 }
 
-int scatterContributionPhoton(Particle particle, const MCSettings& config, Tally& tally)
+/**
+ * @brief Score a photon scattered towards one detector
+ */
+static void scoreScatterPhoton(Particle particle, const MCSettings& config, const CollisionContext& context, Tally& tally)
 {
     // determine the scattering angle if the particle
     // were scattered towards the detector
-    QVector3D prtl2det = tally.getCenter() - particle.pos;
-    double length = prtl2det.length();
+    Vec3d prtl2det = tally.getCenter() - particle.pos;
     prtl2det.normalize();
-    double cosAng = QVector3D::dotProduct(particle.dir, prtl2det);
+    double cosAng = Vec3d::dotProduct(particle.dir, prtl2det);
 
     // new energy / pre energy
     double beta = 1 / (1+particle.ergE / 0.511 * (1-cosAng));
@@ -71,105 +208,52 @@ int scatterContributionPhoton(Particle particle, const MCSettings& config, Tally
     if (newErg < tally.getMinE() ||
         newErg > tally.getMaxE())
     {
-        return 0;
+        return;
     }
     
     // attenuation along the ray
-    Ray ray = Ray(particle.pos, prtl2det);
-    double atten = config.ROI.intersection(ray) * config.cells[0].material.getPhotonTotalAtten(newErg);
+    std::vector<double>& pathLengths = getPathLengthBuffer();
+    getPathLengthsToDetector(particle, config, tally, pathLengths);
+    double atten = photonOpticalDepth(pathLengths, config, newErg);
 
     // K-N equation 
-    double sigma = std::pow(beta, 2) * (beta + 1/beta + std::pow(cosAng, 2) - 1) / config.cells[0].material.getPhotonCrossSection().getTotalComptonIntegral(newErg);
-
-    double ratio = tally.getRadius() / length;
+    double sigma = std::pow(beta, 2) * (beta + 1/beta + std::pow(cosAng, 2) - 1) / context.comptonIntegral;
 
-
-    // // contribution to tally F1
+    // // contribution to tally F1, ratio = R / length for a sphere
     // double score = 2 * sigma * (1-std::sqrt(1-ratio*ratio));
     // // contribution to tally F2, integrated over the spherical surface
     // double score = 1 / tally.getArea() * sigma * ratio * std::log((1+ratio) / (1-ratio));
     // contribution to tally F4
     // double avgTrackLength = 4*tally.getRadius()/3.0;
     // double score = 2 * sigma * (1-std::sqrt(1-ratio*ratio)) * avgTrackLength / tally.getVolume();
-    double lbda= ratio - 0.5 * (1-ratio*ratio) * std::log((1+ratio) / (1-ratio));
-    double score = 2 * sigma * length * lbda / tally.getVolume();
+    // chord length integrated over the solid angle subtended by the detector / 2pi,
+    // or 1 / (2 pi L^2) for a point detector (F5)
+    double score = 2 * sigma * tally.geometryFactor(particle.pos);
 
     particle.ergE *= beta;
+    if (tally.hasTimeBins())
+        particle.time += flightTime(particle, tally);
     tally.Fill(particle, std::exp(-atten)* score);
-
-    return 0;
 }
 
-int forceDetectionNeutron(Particle& particle, const MCSettings& config, Tally& tally)
-{
-    if (particle.scatterN == 0)
-    {
-        primaryContributionNeutron(particle, config, tally);
-    }
-    else
-    {
-        scatterContributionNeutron(particle, config, tally);
-    }
-    return 0;
-}
-
-
-int primaryContributionNeutron(const Particle& particle, const MCSettings& config, Tally& tally)
+/**
+ * @brief Score a fast neutron scattered towards one detector
+ */
+static void scoreScatterNeutron(Particle particle, const MCSettings& config, const CollisionContext& context, Tally& tally)
 {
-    QVector3D prtl2det = tally.getCenter() - particle.pos;
-    double proj = QVector3D::dotProduct(prtl2det, particle.dir);
-    if(proj <= 0)
-        return 0;
-    
-    double d = tally.getCenter().distanceToLine(particle.pos, particle.dir);
-    if (d >= tally.getRadius())
-        return 0;
-
-    // // F1 tally
-    // double score = 1;
-    // // F2 tally
-    // double score = 1 / (tally.getArea() * std::sqrt(1-std::pow(d / tally.getRadius(), 2.0)));
-    // F4 tally
-    double score = 2 * std::sqrt(std::pow(tally.getRadius(), 2.0) - std::pow(d, 2.0)) / tally.getVolume();
-    
-    
-    // attenuation along the ray
-    Ray ray = Ray(particle.pos, particle.dir);
-    double atten = config.ROI.intersection(ray) * config.cells[0].material.getNeutronTotalAtten(particle.ergE);
-
-    tally.Fill(particle, std::exp(-atten)*score);
-    
-    return 0;
-}
-
-int scatterContributionNeutron(Particle particle, const MCSettings& config, Tally& tally)
-{
-    if (particle.ergE < 1)
-    {
-        if (GlobalUniformRandNumGenerator::GetInstance().generateDouble() < 0.01)
-        {
-            // to reduce computation time, we do cfd for 1e4 thermal neutrons, which corresponds to 1% thermal neutrons if nps is 1e6
-            scatterContributionThermalNeutron(particle, config, tally);
-        }
-        
-        return 0;
-    }
-        
     // determine the scattering angle if the particle
     // were scattered towards the detector
-    QVector3D prtl2det = tally.getCenter() - particle.pos;
-    const double length = prtl2det.length();
+    Vec3d prtl2det = tally.getCenter() - particle.pos;
     prtl2det.normalize();
-    const double cosAng = QVector3D::dotProduct(particle.dir, prtl2det); // mu_lab
+    const double cosAng = Vec3d::dotProduct(particle.dir, prtl2det); // mu_lab
     
-    // attenuation along the ray
-    Ray ray = Ray(particle.pos, prtl2det);
-    const double attenLength = config.ROI.intersection(ray);
-
-    const double ratio = tally.getRadius() / length;
+    // path lengths in each cell along the ray
+    std::vector<double>& pathLengths = getPathLengthBuffer();
+    getPathLengthsToDetector(particle, config, tally, pathLengths);
 
     // // average F1 integrated over the solid angle subtended by detector = 2pi * averageScore,
     // // the factor 2pi cancels out with the factor 1/2pi in pdf of angular distribution
+    // // ratio = R / length for a sphere
     // const double averageScore = 1 - std::sqrt(1 - ratio * ratio);
 
     // average F2 integrated over the solid angle subtended by detector = 2pi * averageScore,
@@ -177,13 +261,12 @@ int scatterContributionNeutron(Particle particle, const MCSettings& config, Tall
     // const double averageScore = 0.5 * ratio * std::log((1+ratio)/(1-ratio));
 
     // average F4 integrated over the solid angle subtended by detector = 2pi * averageScore,
-    // the factor 2pi cancels out with the factor 1/2pi in pdf of angular distribution
-    const double averageScore = length / tally.getVolume() * 
-                        (ratio - 0.5 * (1-ratio*ratio) * std::log((1+ratio)/(1-ratio)));
+    // the factor 2pi cancels out with the factor 1/2pi in pdf of angular distribution.
+    // For a point detector (F5) averageScore = 1 / (2 pi L^2)
+    const double averageScore = tally.geometryFactor(particle.pos);
 
     // iterate all nuclides that the neutron can interact with
     const int nuclidesNum = config.cells[0].material.getNumberOfNuclides();
-    std::vector<double> scatterNuclideProbs(nuclidesNum, 0);
     std::vector<double> unattenProbs(nuclidesNum, 0);
     std::vector<double> scores(nuclidesNum, 0);
     std::vector<double> E_labs(nuclidesNum, 0);
@@ -247,46 +330,46 @@ int scatterContributionNeutron(Particle particle, const MCSettings& config, Tall
             dmu_cm_over_du_lab = std::sqrt(E_lab / E_cms) / (1-cosAng / (A+1) * std::sqrt(1/E_lab));
 
         }
-        // probability that neutron scatters by nuclide i 
-        scatterNuclideProbs[nuclideIdx] = comp.first * 
-                nuclide.getNeutronCrossSection().getElasticMicroscopicCrossSectionAt(particle.ergE);
         // energy of scattered neutron in lab system
         E_lab *= particle.ergE;
         E_labs[nuclideIdx] = E_lab;
         // probablity that neutron can reach detector without being attenuated
-        unattenProbs[nuclideIdx] = std::exp(-attenLength * config.cells[0].material.getNeutronTotalAtten(E_lab));
+        unattenProbs[nuclideIdx] = std::exp(-neutronOpticalDepth(pathLengths, config, E_lab));
         // F4 tally, PDF(u_cm) * du_cm / du_lab * average constribution integrated over detector sphere
         scores[nuclideIdx] = pdf * dmu_cm_over_du_lab * averageScore;
     }
 
-    // for normalizing probablities of scattering with each nuclide
-    // double totalElasticCrossSection = std::accumulate(scatterNuclideProbs.begin(), scatterNuclideProbs.end(), 0);
-    double totalTotalCrossSection = config.cells[0].material.getNeutronTotalMicroscopicCrossSection(particle.ergE);
+    // probablities of scattering with each nuclide are normalized by the total cross section
+    const double collisionTime = particle.time;
     for (int i = 0; i < nuclidesNum; i++)
     {
+        if (scores[i] == 0)
+            continue;
         particle.ergE = E_labs[i];
-        tally.Fill(particle, scatterNuclideProbs[i] / totalTotalCrossSection * unattenProbs[i] * scores[i]);
+        if (tally.hasTimeBins())
+            particle.time = collisionTime + flightTime(particle, tally);
+        tally.Fill(particle, context.elasticCrossSections[i] / context.totalCrossSection * unattenProbs[i] * scores[i]);
     }
-    return 0;
 }
 
-int scatterContributionThermalNeutron(Particle particle, const MCSettings& config, Tally& tally)
+/**
+ * @brief Score a thermal neutron scattered towards one detector, using the free-gas kernel
+ */
+static void scoreScatterThermalNeutron(Particle particle, const MCSettings& config, const CollisionContext& context, Tally& tally)
 {
     // determine the scattering angle if the particle
     // were scattered towards the detector
-    QVector3D prtl2det = tally.getCenter() - particle.pos;
-    const double length = prtl2det.length();
+    Vec3d prtl2det = tally.getCenter() - particle.pos;
     prtl2det.normalize();
-    const double cosAng = QVector3D::dotProduct(particle.dir, prtl2det); // mu_lab
+    const double cosAng = Vec3d::dotProduct(particle.dir, prtl2det); // mu_lab
     
-    // attenuation along the ray
-    Ray ray = Ray(particle.pos, prtl2det);
-    const double attenLength = config.ROI.intersection(ray);
-
-    const double ratio = tally.getRadius() / length;
+    // path lengths in each cell along the ray
+    std::vector<double>& pathLengths = getPathLengthBuffer();
+    getPathLengthsToDetector(particle, config, tally, pathLengths);
 
     // // average F1 integrated over the solid angle subtended by detector = 2pi * averageScore,
     // // the factor 2pi cancels out with the factor 1/2pi in pdf of angular distribution
+    // // ratio = R / length for a sphere
     // const double averageScore = 1 - std::sqrt(1 - ratio * ratio);
 
     // average F2 integrated over the solid angle subtended by detector = 2pi * averageScore,
@@ -294,65 +377,636 @@ int scatterContributionThermalNeutron(Particle particle, const MCSettings& confi
     // const double averageScore = 0.5 * ratio * std::log((1+ratio)/(1-ratio));
 
     // average F4 integrated over the solid angle subtended by detector = 2pi * averageScore,
-    // the factor 2pi cancels out with the factor 1/2pi in pdf of angular distribution
-    const double averageScore = length / tally.getVolume() * 
-                        (ratio - 0.5 * (1-ratio*ratio) * std::log((1+ratio)/(1-ratio)));
-
-    // iterate all nuclides and all thermal erg bins
-    std::vector<double> scatterNuclideProbs;
-    std::vector<double> unattenProbs;
-    std::vector<double> scores;
-    std::vector<double> E_labs;
-    static const double kT = 0.0253; // eV, 293.6K
-    static std::vector<std::pair<double, double>> thermalErgBins; // bin center, width
-    if (thermalErgBins.size() == 0)
-    {
-        for (int i = 0; i < tally.getNBins(); i++)
+    // the factor 2pi cancels out with the factor 1/2pi in pdf of angular distribution.
+    // For a point detector (F5) averageScore = 1 / (2 pi L^2)
+    const double averageScore = tally.geometryFactor(particle.pos);
+
+    // thermal energy bins of this tally, bin centers increase
+    ThermalScratch& scratch = getThermalScratch();
+    std::vector<int>& thermalBins = scratch.bins;
+    thermalBins.clear();
+    for (int i = 0; i < tally.getNBins() && tally.getBinCenter(i) < 1; i++)
+        thermalBins.push_back(i);
+    std::vector<double>& weights = scratch.weights;
+    weights.assign(thermalBins.size(), 0);
+    std::vector<double>& times = scratch.times;
+    times.clear();
+    if (tally.hasTimeBins())
+        times.resize(thermalBins.size());
+
+    // iterate all thermal erg bins and all nuclides
+    const double initErg = particle.ergE;
+    const double collisionTime = particle.time;
+    const auto& composition = config.cells[0].material.getNuclideComposition();
+    for (std::size_t i = 0; i < thermalBins.size(); i++)
+    {
+        // energy of scattered neutron in lab system
+        const double E_lab = tally.getBinCenter(thermalBins[i]);
+        const double binWidth = tally.getBinWidth(thermalBins[i]);
+        const double epsilon_squared = 2 * (initErg + E_lab - 2*cosAng*std::sqrt(initErg*E_lab));
+        // probablity that neutron can reach detector without being attenuated, the same for all nuclides
+        const double unattenProb = std::exp(-neutronOpticalDepth(pathLengths, config, E_lab));
+        double dpEbinSum(0);
+        for (std::size_t nuclideIdx = 0; nuclideIdx < composition.size(); nuclideIdx++)
+        {
+            const double A = composition[nuclideIdx].second.getAtomicWeight();
+            const double normalization_const = context.thermalNormalizations[nuclideIdx];
+            // probability that neutron scatters by nuclide i 
+            const double scatterProbNuclidei = context.elasticCrossSections[nuclideIdx] / context.totalCrossSection;
+            double M_2kTe2 = A/(2*kT*epsilon_squared);
+            const double dpEbin = normalization_const * std::sqrt(E_lab / initErg) * std::sqrt(M_2kTe2/M_PI) * std::exp(-M_2kTe2 * std::pow(E_lab - initErg + epsilon_squared / (2*A), 2)) * binWidth;
+            dpEbinSum += scatterProbNuclidei * dpEbin;
+        }
+        // F4 tally, dpEbin * average constribution integrated over detector sphere
+        weights[i] = particle.weight * dpEbinSum * unattenProb * averageScore;
+        if (tally.hasTimeBins())
+        {
+            particle.ergE = E_lab;
+            times[i] = collisionTime + flightTime(particle, tally);
+        }
+    }
+    tally.scoreBins(thermalBins, weights, times);
+}
+
+/**
+ * @brief Score an event selected by sampleEventScoring in one detector, its weight already compensated
+ */
+static void scoreEvent(const Particle& particle, const MCSettings& config, const CollisionContext& context, Tally& tally)
+{
+    if (particle.scatterN == 0)
+        scorePrimary(particle, config, context, tally);
+    else if (particle.particleType == Particle::Photon)
+        scoreScatterPhoton(particle, config, context, tally);
+    else if (particle.ergE < 1)
+        scoreScatterThermalNeutron(particle, config, context, tally);
+    else
+        scoreScatterNeutron(particle, config, context, tally);
+}
+
+bool sampleEventScoring(const Particle& particle)
+{
+    const double probability = SubsamplingPolicy::GetInstance().getProbability(particle);
+    if (probability >= 1)
+        return true;
+    return GlobalUniformRandNumGenerator::GetInstance().generateDouble() < probability;
+}
+
+int forceDetection(Particle& particle, const MCSettings& config, Tally& tally)
+{
+    const double probability = SubsamplingPolicy::GetInstance().getProbability(particle);
+    if (probability >= 1)
+    {
+        scoreEvent(particle, config, CollisionContext(particle, config), tally);
+        return 0;
+    }
+    // only a fraction of these events is scored, the cross sections are looked up for those only
+    if (GlobalUniformRandNumGenerator::GetInstance().generateDouble() >= probability)
+        return 0;
+    const CollisionContext context(particle, config);
+    Particle compensated(particle);
+    compensated.weight /= probability;
+    scoreEvent(compensated, config, context, tally);
+    return 0;
+}
+
+int forceDetection(Particle& particle, const MCSettings& config, std::vector<Tally>& tallies)
+{
+    if (sampleEventScoring(particle))
+        forceDetectionSampled(particle, config, tallies);
+    return 0;
+}
+
+int forceDetectionSampled(const Particle& particle, const MCSettings& config, std::vector<Tally>& tallies)
+{
+    return forceDetectionSampled(particle, config, CollisionContext(particle, config), tallies);
+}
+
+int forceDetectionSampled(const Particle& particle, const MCSettings& config, const CollisionContext& context, std::vector<Tally>& tallies)
+{
+    const double probability = SubsamplingPolicy::GetInstance().getProbability(particle);
+    if (probability < 1)
+    {
+        // only a fraction of these events is scored
+        Particle compensated(particle);
+        compensated.weight /= probability;
+        for (auto &&tally : tallies)
+            scoreEvent(compensated, config, context, tally);
+        return 0;
+    }
+    if (particle.scatterN == 0)
+    {
+        for (auto &&tally : tallies)
+            scorePrimary(particle, config, context, tally);
+    }
+    else if (particle.particleType == Particle::Photon)
+    {
+        scatterContributionPhoton(particle, config, context, tallies);
+    }
+    else if (particle.ergE < 1)
+    {
+        scatterContributionThermalNeutron(particle, config, context, tallies);
+    }
+    else
+    {
+        scatterContributionNeutron(particle, config, context, tallies);
+    }
+    return 0;
+}
+
+int primaryContributionPhoton(const Particle& particle, const MCSettings& config, const CollisionContext& context, std::vector<Tally>& tallies)
+{
+    for (auto &&tally : tallies)
+        scorePrimary(particle, config, context, tally);
+    return 0;
+}
+
+int scatterContributionPhoton(const Particle& particle, const MCSettings& config, const CollisionContext& context, std::vector<Tally>& tallies)
+{
+    for (auto &&tally : tallies)
+        scoreScatterPhoton(particle, config, context, tally);
+    return 0;
+}
+
+int forceDetectionNeutron(Particle& particle, const MCSettings& config, std::vector<Tally>& tallies)
+{
+    if (sampleEventScoring(particle))
+        forceDetectionSampled(particle, config, tallies);
+    return 0;
+}
+
+int primaryContributionNeutron(const Particle& particle, const MCSettings& config, const CollisionContext& context, std::vector<Tally>& tallies)
+{
+    for (auto &&tally : tallies)
+        scorePrimary(particle, config, context, tally);
+    return 0;
+}
+
+int scatterContributionNeutron(const Particle& particle, const MCSettings& config, const CollisionContext& context, std::vector<Tally>& tallies)
+{
+    for (auto &&tally : tallies)
+        scoreScatterNeutron(particle, config, context, tally);
+    return 0;
+}
+
+int scatterContributionThermalNeutron(const Particle& particle, const MCSettings& config, const CollisionContext& context, std::vector<Tally>& tallies)
+{
+    for (auto &&tally : tallies)
+        scoreScatterThermalNeutron(particle, config, context, tally);
+    return 0;
+}
+
+/**
+ * @brief Get the sum of all bins of several tallies
+ */
+static double tallyTotal(const std::vector<Tally>& tallies)
+{
+    double total(0);
+    for (auto &&tally : tallies)
+    {
+        const std::vector<double> counts = tally.getBinContents();
+        total += std::accumulate(counts.begin(), counts.end(), 0.0);
+    }
+    return total;
+}
+
+SubsamplingPolicy::Pilot runSubsamplingPilot(const MCSettings& config, std::vector<Tally> tallies, const int pilotN)
+{
+    if (pilotN < 2)
+        throw std::runtime_error("The subsampling pilot run needs at least 2 histories.");
+    typedef std::chrono::steady_clock Clock;
+    SubsamplingPolicy& policy = SubsamplingPolicy::GetInstance();
+    const SubsamplingPolicy bands(policy);
+    SubsamplingPolicy::Pilot pilot;
+    pilot.histories = pilotN;
+    for (int e = 0; e < SubsamplingPolicy::nEstimators; e++)
+    {
+        const std::size_t nbands = bands.getProbabilities(static_cast<SubsamplingPolicy::Estimator>(e)).size();
+        pilot.events[e].assign(nbands, 0);
+        pilot.squaredScores[e].assign(nbands, 0);
+        pilot.seconds[e].assign(nbands, 0);
+    }
+    // score every event
+    for (int e = 0; e < SubsamplingPolicy::nEstimators; e++)
+        policy.setProbability(static_cast<SubsamplingPolicy::Estimator>(e), 1);
+
+    double sum(0), squaredSum(0), totalSeconds(0), bookkeepingSeconds(0);
+    auto score = [&](const Particle& prtl)
+    {
+        const SubsamplingPolicy::Estimator estimator = SubsamplingPolicy::classify(prtl);
+        const int band = bands.findBand(estimator, prtl.ergE);
+        const auto start = Clock::now();
+        const double before = tallyTotal(tallies);
+        const auto scoring = Clock::now();
+        forceDetectionSampled(prtl, config, tallies);
+        const auto scored = Clock::now();
+        const double eventScore = tallyTotal(tallies) - before;
+        pilot.events[estimator][band] += 1;
+        pilot.squaredScores[estimator][band] += eventScore * eventScore;
+        pilot.seconds[estimator][band] += std::chrono::duration<double>(scored - scoring).count();
+        bookkeepingSeconds += std::chrono::duration<double>(scoring - start).count() +
+                              std::chrono::duration<double>(Clock::now() - scored).count();
+    };
+    try
+    {
+        for (int i = 0; i < pilotN; i++)
         {
-            if (tally.getBinCenter(i) < 1)
+            const auto start = Clock::now();
+            const double before = tallyTotal(tallies);
+            Particle prtl = config.source.createParticle();
+            score(prtl);
+            while (prtl.scatterN < config.maxScatterN &&
+                   prtl.ergE > config.minE &&
+                   prtl.weight > config.minW &&
+                   deltaTracking(prtl, config))
             {
-                thermalErgBins.push_back({tally.getBinCenter(i), tally.getBinWidth(i)});
+                prtl.scatterN += 1;
+                score(prtl);
+                scattering(prtl, config);
             }
+            const double historyScore = tallyTotal(tallies) - before;
+            sum += historyScore;
+            squaredSum += historyScore * historyScore;
+            totalSeconds += std::chrono::duration<double>(Clock::now() - start).count();
         }
     }
+    catch (...)
+    {
+        // the bands of the caller are kept whatever happens to the pilot
+        policy = bands;
+        throw;
+    }
+    policy = bands;
 
-    double epsilon_squared(0);
-    double E_lab(0);
-    double dpEbin(0);
-    for (auto &&comp : config.cells[0].material.getNuclideComposition())
+    pilot.mean = sum / pilotN;
+    pilot.variance = std::max(0.0, (squaredSum - sum * pilot.mean) / (pilotN - 1));
+    double scoringSeconds(0);
+    for (int e = 0; e < SubsamplingPolicy::nEstimators; e++)
     {
-        const Nuclide& nuclide = comp.second;
-        const double A = nuclide.getAtomicWeight();
-        double a = std::sqrt(A * particle.ergE / kT);
-        double normalization_const = 2 / ((1+0.5/(a*a))*std::erf(a) + std::exp(-a*a) / (a*2)*M_2_SQRTPI);
-        // probability that neutron scatters by nuclide i 
-        double scatterProbNuclidei = comp.first * 
-                nuclide.getNeutronCrossSection().getElasticMicroscopicCrossSectionAt(particle.ergE);
-        // iterate over thermal erg bins
-        for (int i = 0; i < thermalErgBins.size(); i++)
+        for (std::size_t b = 0; b < pilot.events[e].size(); b++)
         {
-            E_lab = thermalErgBins[i].first;
-            epsilon_squared = 2 * (particle.ergE + E_lab - 2*cosAng*std::sqrt(particle.ergE*E_lab));
-            double M_2kTe2 = A/(2*kT*epsilon_squared);
-            dpEbin = normalization_const * std::sqrt(E_lab / particle.ergE) * std::sqrt(M_2kTe2/M_PI) * std::exp(-M_2kTe2 * std::pow(E_lab - particle.ergE + epsilon_squared / (2*A), 2)) * thermalErgBins[i].second;
-
-            // energy of scattered neutron in lab system
-            E_labs.push_back(E_lab);
-            scatterNuclideProbs.push_back(scatterProbNuclidei);
-            // probablity that neutron can reach detector without being attenuated
-            unattenProbs.push_back(std::exp(-attenLength * config.cells[0].material.getNeutronTotalAtten(E_lab)));
-            // F4 tally, dpEbin * average constribution integrated over detector sphere
-            scores.push_back(dpEbin * averageScore);
+            scoringSeconds += pilot.seconds[e][b];
+            pilot.events[e][b] /= pilotN;
+            pilot.squaredScores[e][b] /= pilotN;
+            pilot.seconds[e][b] /= pilotN;
         }
     }
+    pilot.transportSeconds = std::max(0.0, totalSeconds - scoringSeconds - bookkeepingSeconds) / pilotN;
+    return pilot;
+}
+
+// at least this many source energies are integrated, several per bin of a coarse source spectrum
+static const int minUncollidedEnergies = 100;
 
-    // for normalizing probablities of scattering with each nuclide
-    double totalTotalCrossSection = config.cells[0].material.getNeutronTotalMicroscopicCrossSection(particle.ergE);
-    for (int i = 0; i < scatterNuclideProbs.size(); i++)
+/**
+ * @brief Get the Gauss-Legendre points and weights of order n on [0, 1]
+ */
+static void gaussLegendre(const int n, std::vector<double>& nodes, std::vector<double>& weights)
+{
+    nodes.resize(n);
+    weights.resize(n);
+    for (int i = 0; i < n; i++)
     {
-        particle.ergE = E_labs[i];
-        // 100 is added because we only considered 1% thermal neutrons
-        tally.Fill(particle, scatterNuclideProbs[i] / totalTotalCrossSection * unattenProbs[i] * scores[i]*100);
+        // Newton iterations on P_n from an approximation of its i-th root
+        double x = std::cos(M_PI * (i + 0.75) / (n + 0.5));
+        double derivative(1);
+        for (int iteration = 0; iteration < 100; iteration++)
+        {
+            double previous(1), current(x);
+            for (int k = 2; k <= n; k++)
+            {
+                const double next = ((2 * k - 1) * x * current - (k - 1) * previous) / k;
+                previous = current;
+                current = next;
+            }
+            derivative = n * (x * current - previous) / (x * x - 1);
+            const double step = current / derivative;
+            x -= step;
+            if (std::abs(step) < 1e-15)
+                break;
+        }
+        nodes[i] = 0.5 * (1 - x);
+        weights[i] = 1 / ((1 - x * x) * derivative * derivative);
     }
-    return 0;
+}
+
+/**
+ * @brief Uncollided flux in a detector from a source point, at each source energy
+ */
+struct UncollidedIntegrand
+{
+    UncollidedIntegrand(const MCSettings& config_, const Tally& tally_, const int directionOrder)
+        : config(config_), tally(tally_), type(config_.source.getParticleType()), detectorShape(tally_.getDetector().getShape())
+    {
+        const std::vector<double>& cdf = config.source.getEnergyCDF();
+        if (cdf.size() == 1)
+        {
+            energies.push_back(cdf[0]);
+            energyWeights.push_back(1);
+        }
+        else
+        {
+            const int nbins = cdf.size() - 1;
+            const int perBin = std::max(1, (minUncollidedEnergies + nbins - 1) / nbins);
+            for (int i = 0; i < nbins; i++)
+            {
+                for (int k = 0; k < perBin; k++)
+                {
+                    energies.push_back(cdf[i] + (k + 0.5) / perBin * (cdf[i + 1] - cdf[i]));
+                    energyWeights.push_back(1.0 / (nbins * perBin));
+                }
+            }
+        }
+        for (auto &&cell : config.cells)
+        {
+            std::vector<double> mu;
+            for (auto &&ergE : energies)
+                mu.push_back(type == Particle::Photon ? cell.material.getPhotonTotalAtten(ergE) : cell.material.getNeutronTotalAtten(ergE));
+            atten.push_back(mu);
+        }
+        gaussLegendre(directionOrder, angleNodes, angleWeights);
+        nAzimuths = 2 * directionOrder;
+        // chords of boxes and cylinders have kinks at their edges, their volumes are integrated instead
+        const Detector& detector = tally.getDetector();
+        if (detector.getType() != Detector::BoxDetector && detector.getType() != Detector::CylinderDetector)
+            return;
+        const double scale = detector.getVolume() / tally.getVolume();
+        for (int i = 0; i < directionOrder; i++)
+        {
+            for (int j = 0; j < nAzimuths; j++)
+            {
+                for (int k = 0; k < directionOrder; k++)
+                {
+                    if (detector.getType() == Detector::BoxDetector)
+                    {
+                        if (j >= directionOrder)
+                            continue;
+                        volumePoints.push_back(detectorShape->samplePoint(angleNodes[i], angleNodes[j], angleNodes[k]));
+                        volumeWeights.push_back(scale * angleWeights[i] * angleWeights[j] * angleWeights[k]);
+                        continue;
+                    }
+                    // radius fraction angleNodes[i] and azimuth fraction t, Cylinder::samplePoint takes (t r, r, z)
+                    const double t = (j + 0.5) / nAzimuths;
+                    volumePoints.push_back(detectorShape->samplePoint(t * angleNodes[i], angleNodes[i], angleNodes[k]));
+                    volumeWeights.push_back(scale * 2 * angleNodes[i] * angleWeights[i] / nAzimuths * angleWeights[k]);
+                }
+            }
+        }
+    }
+
+    /**
+     * @brief Get the optical depth of the path lengths in each cell, at the e-th energy
+     */
+    double getOpticalDepth(const std::vector<double>& lengths, const std::size_t e) const
+    {
+        double depth(0);
+        for (std::size_t i = 0; i < lengths.size(); i++)
+        {
+            if (lengths[i] > 0)
+                depth += lengths[i] * atten[i][e];
+        }
+        return depth;
+    }
+
+    /**
+     * @brief Add the score of a ray, attenuated through the cells up to where it enters the detector, at each energy
+     */
+    void addAttenuated(const Ray& ray, const double score, std::vector<double>& values) const
+    {
+        std::vector<double>& lengths = getPathLengthBuffer();
+        Segment seg;
+        if (tally.getDetector().intersect(ray, seg) && seg.tIn > 0)
+            config.getCellPathLengths(ray.getOrigin(), ray.getOrigin() + ray.getDirection() * seg.tIn, lengths);
+        else
+            lengths.assign(config.cells.size(), 0);
+        for (std::size_t e = 0; e < energies.size(); e++)
+            values[e] += energyWeights[e] * score * std::exp(-getOpticalDepth(lengths, e));
+    }
+
+    /**
+     * @brief Get the flux per source particle emitted at pos, at each energy
+     */
+    void evaluate(const Vec3d& pos, std::vector<double>& values) const
+    {
+        values.assign(energies.size(), 0);
+        if (tally.isPointDetector())
+        {
+            std::vector<double>& lengths = getPathLengthBuffer();
+            getPathLengthsToDetector(Particle(pos, Vec3d(0, 0, 1), energies[0], 1, type), config, tally, lengths);
+            const double score = 0.5 * tally.geometryFactor(pos);
+            for (std::size_t e = 0; e < energies.size(); e++)
+                values[e] = energyWeights[e] * std::exp(-getOpticalDepth(lengths, e)) * score;
+            return;
+        }
+        // directions around the axis to the detector center
+        const Vec3d axis = tally.getCenter() - pos;
+        const double distance = axis.length();
+        const double radius = tally.getRadius();
+        const Vec3d w = distance > 0 ? axis / distance : Vec3d(0, 0, 1);
+        const Vec3d u = Vec3d::crossProduct(w, std::abs(w.x()) < 0.9 ? Vec3d(1, 0, 0) : Vec3d(0, 1, 0)).normalized();
+        const Vec3d v = Vec3d::crossProduct(w, u);
+        const bool outside = distance > radius;
+        if (outside && !volumePoints.empty())
+        {
+            // average of exp(-tau) / (4 pi s^2) over the detector volume
+            for (std::size_t i = 0; i < volumePoints.size(); i++)
+            {
+                const Vec3d toPoint = volumePoints[i] - pos;
+                const double squaredDistance = toPoint.lengthSquared();
+                addAttenuated(Ray(pos, toPoint), volumeWeights[i] / (4 * M_PI * squaredDistance), values);
+            }
+            return;
+        }
+        const double scale = 1 / (4 * M_PI * tally.getVolume());
+        for (std::size_t i = 0; i < angleNodes.size(); i++)
+        {
+            double cosTheta, sinTheta, weight;
+            if (outside)
+            {
+                // impact parameter b = R sin(alpha) on the bounding sphere, dOmega = R^2 sin(alpha) cos(alpha) / (d^2 cos(theta))
+                const double alpha = 0.5 * M_PI * angleNodes[i];
+                sinTheta = radius * std::sin(alpha) / distance;
+                cosTheta = std::sqrt(1 - sinTheta * sinTheta);
+                weight = 0.5 * M_PI * angleWeights[i] * radius * radius * std::sin(alpha) * std::cos(alpha) / (distance * distance * cosTheta);
+            }
+            else
+            {
+                // all directions
+                cosTheta = 1 - 2 * angleNodes[i];
+                sinTheta = std::sqrt(std::max(0.0, 1 - cosTheta * cosTheta));
+                weight = 2 * angleWeights[i];
+            }
+            for (int j = 0; j < nAzimuths; j++)
+            {
+                const double phi = 2 * M_PI * (j + 0.5) / nAzimuths;
+                const Ray ray(pos, w * cosTheta + (u * std::cos(phi) + v * std::sin(phi)) * sinTheta);
+                const double chord = tally.getDetector().chordLength(ray);
+                if (chord <= 0)
+                    continue;
+                addAttenuated(ray, weight * 2 * M_PI / nAzimuths * chord * scale, values);
+            }
+        }
+    }
+
+    const MCSettings& config;
+    const Tally& tally;
+    const Particle::ParticleType type;
+    // shape of the detector, the exclusion sphere of a point
+    const std::shared_ptr<const Shape> detectorShape;
+    std::vector<double> energies;
+    // probability of each energy
+    std::vector<double> energyWeights;
+    // attenuation coefficient of each cell at each energy, cm^-1
+    std::vector<std::vector<double>> atten;
+    // cone angle rule on [0, 1]
+    std::vector<double> angleNodes;
+    std::vector<double> angleWeights;
+    int nAzimuths;
+    // points of a box or cylinder detector, and their weights relative to the tally volume
+    std::vector<Vec3d> volumePoints;
+    std::vector<double> volumeWeights;
+};
+
+/**
+ * @brief Box of the unit cube mapped to the source, with its integral at each energy and its error estimate
+ */
+struct CubatureBox
+{
+    std::array<double, 3> lower;
+    std::array<double, 3> upper;
+    std::vector<double> value;
+    double error=0;
+    bool operator<(const CubatureBox& other) const {return error < other.error;}
+};
+
+/**
+ * @brief Integrate a box with the 3-point Gauss-Legendre product rule, and estimate its error with the 2-point rule
+ *
+ * @return int Number of source points evaluated
+ */
+static int integrateBox(const UncollidedIntegrand& integrand, CubatureBox& box)
+{
+    std::vector<double> nodes[2], weights[2];
+    gaussLegendre(3, nodes[0], weights[0]);
+    gaussLegendre(2, nodes[1], weights[1]);
+    const double volume = (box.upper[0] - box.lower[0]) * (box.upper[1] - box.lower[1]) * (box.upper[2] - box.lower[2]);
+    std::vector<double> lower(integrand.energies.size(), 0), values;
+    box.value.assign(integrand.energies.size(), 0);
+    int evaluations(0);
+    for (int rule = 0; rule < 2; rule++)
+    {
+        std::vector<double>& sum = rule == 0 ? box.value : lower;
+        const int n = nodes[rule].size();
+        for (int i = 0; i < n * n * n; i++)
+        {
+            const int idx[3] = {i % n, (i / n) % n, i / (n * n)};
+            double u[3], weight(volume);
+            for (int k = 0; k < 3; k++)
+            {
+                u[k] = box.lower[k] + (box.upper[k] - box.lower[k]) * nodes[rule][idx[k]];
+                weight *= weights[rule][idx[k]];
+            }
+            integrand.evaluate(integrand.config.source.getShape().samplePoint(u[0], u[1], u[2]), values);
+            evaluations++;
+            for (std::size_t e = 0; e < values.size(); e++)
+                sum[e] += weight * values[e];
+        }
+    }
+    box.error = 0;
+    for (std::size_t e = 0; e < lower.size(); e++)
+        box.error += std::abs(box.value[e] - lower[e]);
+    return evaluations;
+}
+
+UncollidedFlux::UncollidedFlux(const MCSettings& config, const Tally& tally, const double relTolerance,
+                               const int maxBoxes, const int directionOrder)
+    : flux(tally)
+{
+    if (tally.hasSharedCounts())
+        throw std::runtime_error("The uncollided flux cannot be integrated for a tally with shared counts.");
+    if (!(relTolerance > 0) || maxBoxes < 1 || directionOrder < 1)
+        throw std::runtime_error("The uncollided flux needs a positive tolerance, number of boxes and direction order.");
+    flux.reset();
+    const UncollidedIntegrand integrand(config, tally, directionOrder);
+
+    // split the box with the largest error until the total error is small enough
+    std::priority_queue<CubatureBox> boxes;
+    CubatureBox root;
+    root.lower = {0, 0, 0};
+    root.upper = {1, 1, 1};
+    evaluations += integrateBox(integrand, root);
+    boxes.push(root);
+    double sum = std::accumulate(root.value.begin(), root.value.end(), 0.0);
+    double error = root.error;
+    while (static_cast<int>(boxes.size()) < maxBoxes && error > relTolerance * std::abs(sum))
+    {
+        const CubatureBox parent = boxes.top();
+        boxes.pop();
+        sum -= std::accumulate(parent.value.begin(), parent.value.end(), 0.0);
+        error -= parent.error;
+        int widest(0);
+        for (int k = 1; k < 3; k++)
+        {
+            if (parent.upper[k] - parent.lower[k] > parent.upper[widest] - parent.lower[widest])
+                widest = k;
+        }
+        CubatureBox halves[2] = {parent, parent};
+        halves[0].upper[widest] = halves[1].lower[widest] = 0.5 * (parent.lower[widest] + parent.upper[widest]);
+        for (auto &&half : halves)
+        {
+            evaluations += integrateBox(integrand, half);
+            sum += std::accumulate(half.value.begin(), half.value.end(), 0.0);
+            error += half.error;
+            boxes.push(half);
+        }
+    }
+    nBoxes = boxes.size();
+
+    // sum the boxes again, and fill the bins
+    std::vector<double> values(integrand.energies.size(), 0), nodes, weights;
+    if (tally.hasTimeBins())
+        gaussLegendre(3, nodes, weights);
+    std::vector<double> pointValues;
+    for (; !boxes.empty(); boxes.pop())
+    {
+        const CubatureBox& box = boxes.top();
+        errorEstimate += box.error;
+        for (std::size_t e = 0; e < values.size(); e++)
+            values[e] += box.value[e];
+        if (!tally.hasTimeBins())
+            continue;
+        // arrival times differ between the source points
+        const double volume = (box.upper[0] - box.lower[0]) * (box.upper[1] - box.lower[1]) * (box.upper[2] - box.lower[2]);
+        for (int i = 0; i < 27; i++)
+        {
+            const int idx[3] = {i % 3, (i / 3) % 3, i / 9};
+            double u[3], weight(volume);
+            for (int k = 0; k < 3; k++)
+            {
+                u[k] = box.lower[k] + (box.upper[k] - box.lower[k]) * nodes[idx[k]];
+                weight *= weights[idx[k]];
+            }
+            const Vec3d pos = config.source.getShape().samplePoint(u[0], u[1], u[2]);
+            integrand.evaluate(pos, pointValues);
+            for (std::size_t e = 0; e < pointValues.size(); e++)
+            {
+                Particle arriving(pos, Vec3d(0, 0, 1), integrand.energies[e], 1, integrand.type);
+                arriving.time += flightTime(arriving, tally);
+                flux.Fill(arriving, weight * pointValues[e]);
+            }
+        }
+    }
+    total = std::accumulate(values.begin(), values.end(), 0.0);
+    if (tally.hasTimeBins())
+        return;
+    for (std::size_t e = 0; e < values.size(); e++)
+        flux.Fill(Particle(tally.getCenter(), Vec3d(0, 0, 1), integrand.energies[e], 1, integrand.type), values[e]);
+}
+
+void UncollidedFlux::addTo(Tally& tally, const double nps) const
+{
+    if (tally.getNBins() != flux.getNBins() || tally.hasTimeBins() != flux.hasTimeBins())
+        throw std::runtime_error("The uncollided flux was integrated for other bins.");
+    Tally scaled(flux);
+    scaled.scaling(nps);
+    tally.add(scaled);
 }
@@ -1,4 +1,105 @@
 #include "data.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+Histogram::Histogram(const std::vector<double>& edges_)
+{
+    if (edges_.size() < 2)
+        throw std::runtime_error("A histogram needs at least 2 bin edges.");
+    for (std::size_t i = 1; i < edges_.size(); i++)
+    {
+        if (!(edges_[i] > edges_[i - 1]))
+            throw std::runtime_error("Histogram bin edges must be increasing.");
+    }
+    setEdges(edges_, false);
+}
+
+Histogram Histogram::logarithmic(const int nbins_, const double lower_, const double upper_)
+{
+    if (nbins_ < 1 || !(lower_ > 0) || !(upper_ > lower_))
+        throw std::runtime_error("Invalid logarithmic binning.");
+    Histogram hist;
+    const double logLower = std::log10(lower_);
+    const double logWidth = (std::log10(upper_) - logLower) / nbins_;
+    std::vector<double> edges_(nbins_ + 1);
+    hist.binCenters.resize(nbins_);
+    double logCenter = logLower + 0.5 * logWidth;
+    for (int i = 0; i < nbins_; i++)
+    {
+        edges_[i] = std::pow(10, logLower + i * logWidth);
+        hist.binCenters[i] = std::pow(10, logCenter);
+        logCenter += logWidth;
+    }
+    edges_[0] = lower_;
+    edges_[nbins_] = upper_;
+    hist.setEdges(edges_, true);
+    return hist;
+}
+
+void Histogram::setEdges(const std::vector<double>& edges_, const bool keepCenters)
+{
+    edges = edges_;
+    nbins = edges.size() - 1;
+    lowerEdge = edges.front();
+    upperEdge = edges.back();
+    binCounts = std::vector<double>(nbins, 0);
+    totalCounts = 0;
+    binWidths.resize(nbins);
+    for (int i = 0; i < nbins; i++)
+        binWidths[i] = edges[i + 1] - edges[i];
+
+    // evenly spaced in x or log(x), from the first or the second edge
+    auto isEven = [this](const int from, const bool logScale)
+    {
+        if (nbins - from < 1 || (logScale && !(edges[from] > 0)))
+            return false;
+        auto f = [logScale](const double x) {return logScale ? std::log(x) : x;};
+        const double range = f(upperEdge) - f(edges[from]);
+        const double width = range / (nbins - from);
+        for (int i = from + 1; i < nbins; i++)
+        {
+            if (std::abs(f(edges[i]) - f(edges[from]) - (i - from) * width) > 1e-9 * std::abs(range))
+                return false;
+        }
+        regularFrom = from;
+        regularLower = f(edges[from]);
+        invRegularWidth = 1 / width;
+        return true;
+    };
+    if (isEven(0, false))
+        spacing = Uniform;
+    else if (isEven(0, true) || isEven(1, true))
+        spacing = Logarithmic;
+    else
+        spacing = Irregular;
+    binwidth = spacing == Uniform ? (upperEdge - lowerEdge) / nbins : 0;
+
+    if (keepCenters)
+        return;
+    binCenters.resize(nbins);
+    for (int i = 0; i < nbins; i++)
+    {
+        if (spacing == Logarithmic && i >= regularFrom)
+            binCenters[i] = std::sqrt(edges[i] * edges[i + 1]);
+        else
+            binCenters[i] = 0.5 * (edges[i] + edges[i + 1]);
+    }
+}
+
+int Histogram::searchBin(const double x) const
+{
+    // last of edges[0, nbins) that is <= x, the comparison compiles to a conditional move
+    const double* base = edges.data();
+    int len = nbins;
+    while (len > 1)
+    {
+        const int half = len / 2;
+        base = base[half] <= x ? base + half : base;
+        len -= half;
+    }
+    return static_cast<int>(base - edges.data());
+}
 
 // getters
 int Histogram::getNBins() const
@@ -38,15 +139,12 @@ void Histogram::setBinContents(const std::vector<double> counts)
 // fill new data
 bool Histogram::fill(const double item, const double weight)
 {
-    if (item >= upperEdge || item < lowerEdge)
+    const int binIndex = findBin(item);
+    if (binIndex < 0)
     {
         return false;
     }
-    int binIndex = (item - lowerEdge) / binwidth;
-//        if(binIndex < 0 || binIndex >= nbins)
-//            return false;
-    binCounts[binIndex] += weight;
-    totalCounts += weight;
+    fillBin(binIndex, weight);
     return true;
 }
 
@@ -66,21 +164,120 @@ void Histogram::scaling(const double f)
     }
 }
 
+// add
+void Histogram::add(const Histogram& other)
+{
+    if (other.edges != edges)
+        throw std::runtime_error("Cannot add histograms with different binning.");
+    for (int i=0;i<nbins;i++)
+    {
+        binCounts[i] += other.binCounts[i];
+    }
+    totalCounts += other.totalCounts;
+}
+
+void Histogram::addBinContents(const std::vector<double>& counts)
+{
+    if (counts.size() != binCounts.size())
+        throw std::runtime_error("Cannot add counts of a different binning.");
+    for (int i=0;i<nbins;i++)
+    {
+        binCounts[i] += counts[i];
+        totalCounts += counts[i];
+    }
+}
+
 // rebin
 void Histogram::rebin(const int nbins_, const double lower_, const double upper_)
 {
-    totalCounts=0;
-    nbins = nbins_;
-    lowerEdge = lower_;
-    upperEdge = upper_;
-    binCounts = std::vector<double>(nbins, 0);
-    binCenters = std::vector<double>(nbins, 0);
-    binwidth = (upperEdge-lowerEdge) / nbins;
-    binCenters[0] = lowerEdge + 0.5 * binwidth;
-    for (int i=1;i<nbins;i++)
+    const double width = (upper_ - lower_) / nbins_;
+    std::vector<double> edges_(nbins_ + 1);
+    binCenters = std::vector<double>(nbins_, 0);
+    binCenters[0] = lower_ + 0.5 * width;
+    for (int i=0;i<nbins_;i++)
     {
-        binCenters[i] = binCenters[i-1]+binwidth;
+        edges_[i] = lower_ + i * width;
+        if (i > 0)
+            binCenters[i] = binCenters[i-1]+width;
     }
+    edges_[nbins_] = upper_;
+    setEdges(edges_, true);
+    binwidth = width;
+}
+
+SparseHistogram2D::SparseHistogram2D(const int nx_, const double xlower_, const double xupper_,
+                                     const int ny_, const double ylower_, const double yupper_)
+    : nx(nx_), ny(ny_), xlower(xlower_), xupper(xupper_), ylower(ylower_), yupper(yupper_)
+{
+    if (nx < 1 || ny < 1 || !(xupper > xlower) || !(yupper > ylower))
+        throw std::runtime_error("Invalid binning of a 2D histogram.");
+    xwidth = (xupper - xlower) / nx;
+    ywidth = (yupper - ylower) / ny;
+}
+
+double SparseHistogram2D::getBinContent(const int ix, const int iy) const
+{
+    auto found = counts.find(static_cast<long long>(ix) * ny + iy);
+    return found == counts.end() ? 0 : found->second;
+}
+
+std::vector<double> SparseHistogram2D::projectionY() const
+{
+    std::vector<double> projection(ny, 0);
+    for (auto &&bin : counts)
+        projection[bin.first % ny] += bin.second;
+    return projection;
+}
+
+std::vector<double> SparseHistogram2D::projectionX() const
+{
+    std::vector<double> projection(nx, 0);
+    for (auto &&bin : counts)
+        projection[bin.first / ny] += bin.second;
+    return projection;
+}
+
+std::vector<double> SparseHistogram2D::getDenseContents() const
+{
+    std::vector<double> dense(static_cast<std::size_t>(nx) * ny, 0);
+    for (auto &&bin : counts)
+        dense[bin.first] = bin.second;
+    return dense;
+}
+
+bool SparseHistogram2D::fill(const double x, const double y, const double weight)
+{
+    if (x >= xupper || x < xlower || y >= yupper || y < ylower)
+        return false;
+    // rounding can put a value just below the upper edge in bin n
+    const int ix = std::min(static_cast<int>((x - xlower) / xwidth), nx - 1);
+    const int iy = std::min(static_cast<int>((y - ylower) / ywidth), ny - 1);
+    counts[static_cast<long long>(ix) * ny + iy] += weight;
+    return true;
+}
+
+bool SparseHistogram2D::fillBin(const int ix, const double y, const double weight)
+{
+    if (y >= yupper || y < ylower)
+        return false;
+    const int iy = std::min(static_cast<int>((y - ylower) / ywidth), ny - 1);
+    counts[static_cast<long long>(ix) * ny + iy] += weight;
+    return true;
+}
+
+void SparseHistogram2D::scaling(const double f)
+{
+    for (auto &&bin : counts)
+        bin.second *= f;
+}
+
+void SparseHistogram2D::add(const SparseHistogram2D& other)
+{
+    if (other.nx != nx || other.ny != ny || other.xlower != xlower || other.ylower != ylower ||
+        other.xupper != xupper || other.yupper != yupper)
+        throw std::runtime_error("Cannot add histograms with different binning.");
+    for (auto &&bin : other.counts)
+        counts[bin.first] += bin.second;
 }
 
 // std::string getRootDir()
@@ -0,0 +1,269 @@
+#include "detector.h"
+#include <algorithm>
+#include <stdexcept>
+
+/**
+ * @brief Nodes and weights of the n-point Gauss-Legendre rule on [-1, 1]
+ */
+static void gaussLegendre(const int n, std::vector<double>& x, std::vector<double>& w)
+{
+    x.resize(n);
+    w.resize(n);
+    for (int i = 0; i < (n + 1) / 2; i++)
+    {
+        // Newton iterations from the Tricomi approximation of the i-th root
+        double z = std::cos(M_PI * (i + 0.75) / (n + 0.5));
+        double dp(0);
+        for (int iter = 0; iter < 100; iter++)
+        {
+            double p0(1), p1(z);
+            for (int k = 2; k <= n; k++)
+            {
+                const double p2 = ((2 * k - 1) * z * p1 - (k - 1) * p0) / k;
+                p0 = p1;
+                p1 = p2;
+            }
+            if (n == 1)
+                p0 = 1;
+            dp = n * (z * p1 - p0) / (z * z - 1);
+            const double dz = p1 / dp;
+            z -= dz;
+            if (std::abs(dz) < 1e-15)
+                break;
+        }
+        x[i] = -z;
+        x[n - 1 - i] = z;
+        w[i] = w[n - 1 - i] = 2 / ((1 - z * z) * dp * dp);
+    }
+}
+
+double GeometryFactorTable::integrateChordLengths(const Shape& shape, const Vec3d& p, const Vec3d& center, const double boundRadius,
+                                                  const int npolar, const int nazimuth)
+{
+    // frame whose z axis points from p to the center of the bounding sphere
+    Vec3d w = center - p;
+    const double L = w.length();
+    w.normalize();
+    const Mat3 frame = Transform::alignZ(w);
+    const Vec3d u = frame.column(0);
+    const Vec3d v = frame.column(1);
+    // cosine of the half angle of the cone that contains the bounding sphere
+    const double cosAlpha = L > boundRadius ? std::sqrt(1 - std::pow(boundRadius / L, 2)) : -1;
+
+    std::vector<double> x, weights;
+    gaussLegendre(npolar, x, weights);
+    double G(0);
+    for (int i = 0; i < npolar; i++)
+    {
+        const double mu = 0.5 * (1 - cosAlpha) * x[i] + 0.5 * (1 + cosAlpha);
+        const double sinTheta = std::sqrt(std::max(0.0, 1 - mu * mu));
+        double sum(0);
+        for (int j = 0; j < nazimuth; j++)
+        {
+            const double phi = 2 * M_PI * (j + 0.5) / nazimuth;
+            const Vec3d dir = mu * w + sinTheta * (std::cos(phi) * u + std::sin(phi) * v);
+            sum += shape.intersection(Ray(p, dir));
+        }
+        G += 0.5 * (1 - cosAlpha) * weights[i] * sum * 2 * M_PI / nazimuth;
+    }
+    return G;
+}
+
+GeometryFactorTable::GeometryFactorTable(const std::shared_ptr<const Cylinder>& s, const int ns, const int nmu)
+    : shape(s), nodes{ns, nmu}
+{
+    if (nodes[0] < 2 || nodes[1] < 2)
+        throw std::runtime_error("Geometry factor table needs at least 2 nodes along each axis.");
+    volume = shape->getVolume();
+    boundRadius = std::sqrt(std::pow(shape->getRadius(), 2) + std::pow(shape->getHeight() / 2, 2));
+
+    values.resize(std::size_t(nodes[0]) * nodes[1]);
+    // point detector limit
+    std::fill(values.begin(), values.begin() + nodes[1], 1.0);
+    for (int i = 1; i < nodes[0]; i++)
+    {
+        const double L = boundRadius * (nodes[0] - 1) / i;
+        for (int j = 0; j < nodes[1]; j++)
+        {
+            const double mu = double(j) / (nodes[1] - 1);
+            const Vec3d p = shape->getTransform().toWorldDirection(Vec3d(L * std::sqrt(1 - mu * mu), 0, L * mu));
+            values[std::size_t(i) * nodes[1] + j] = integrateChordLengths(*shape, p, Vec3d(0, 0, 0), boundRadius, 24, 32) * L * L / volume;
+        }
+    }
+}
+
+double GeometryFactorTable::getIntegral(const Vec3d& p) const
+{
+    const double L = p.length();
+    if (L <= boundRadius)
+        return integrateChordLengths(*shape, p, Vec3d(0, 0, 0), boundRadius);
+
+    // bilinear interpolation in s and |cos(theta)|
+    const double coords[2] = {boundRadius / L, std::abs(shape->getTransform().toLocalDirection(p).z()) / L};
+    int idx[2];
+    double frac[2];
+    for (int a = 0; a < 2; a++)
+    {
+        const double x = std::min(coords[a], 1.0) * (nodes[a] - 1);
+        idx[a] = std::min(int(x), nodes[a] - 2);
+        frac[a] = x - idx[a];
+    }
+    const double* f = &values[std::size_t(idx[0]) * nodes[1] + idx[1]];
+    const double f0 = (1 - frac[1]) * f[0] + frac[1] * f[1];
+    const double f1 = (1 - frac[1]) * f[nodes[1]] + frac[1] * f[nodes[1] + 1];
+    return ((1 - frac[0]) * f0 + frac[0] * f1) * volume / (L * L);
+}
+
+/**
+ * @brief \int\int_{[0, a] x [0, b]} du dv / (d^2 + u^2 + v^2) for a, b >= 0, d > 0,
+ *        split by the diagonal into two right triangles with a 16-point Gauss-Legendre rule in phi each
+ */
+static double rectangleIntegral(const double a, const double b, const double d)
+{
+    static std::vector<double> x, w;
+    static const bool initialized = (gaussLegendre(16, x, w), true);
+    (void)initialized;
+    if (a <= 0 || b <= 0)
+        return 0;
+    // the triangle with the leg a along phi = 0, then the one with the leg b along phi = pi / 2
+    const double diagonal = std::atan2(b, a);
+    const double legs[2] = {a, b};
+    const double angles[2] = {diagonal, 0.5 * M_PI - diagonal};
+    double sum(0);
+    for (int t = 0; t < 2; t++)
+    {
+        const double c = legs[t] * legs[t] / (d * d);
+        for (std::size_t i = 0; i < x.size(); i++)
+        {
+            const double phi = 0.5 * angles[t] * (1 + x[i]);
+            const double cosPhi = std::cos(phi);
+            sum += 0.5 * angles[t] * w[i] * std::log1p(c / (cosPhi * cosPhi));
+        }
+    }
+    return 0.5 * sum;
+}
+
+double Detector::boxIntegral(const Vec3d& p) const
+{
+    const Vec3d local = localShape->getTransform().toLocalDirection(p);
+    const Vec3d h = dynamic_cast<const Box&>(*localShape).getHalfWidths();
+    // integral over [u0, u1] x [v0, v1] from the quadrants around the foot of p
+    auto signedIntegral = [](const double u, const double v, const double d)
+    {
+        const double sign = (u < 0) == (v < 0) ? 1 : -1;
+        return sign * rectangleIntegral(std::abs(u), std::abs(v), d);
+    };
+    double G(0);
+    for (int a = 0; a < 3; a++)
+    {
+        const int b = (a + 1) % 3, c = (a + 2) % 3;
+        const double u0 = -h[b] - local[b], u1 = h[b] - local[b];
+        const double v0 = -h[c] - local[c], v1 = h[c] - local[c];
+        // faces at +h and -h along axis a, with outward normals +e_a and -e_a
+        for (const double side : {1.0, -1.0})
+        {
+            const double d = side * (side * h[a] - local[a]);
+            if (d == 0)
+                continue;
+            const double I = signedIntegral(u1, v1, std::abs(d)) - signedIntegral(u0, v1, std::abs(d)) -
+                             signedIntegral(u1, v0, std::abs(d)) + signedIntegral(u0, v0, std::abs(d));
+            G += d * I;
+        }
+    }
+    return G;
+}
+
+Detector::Detector(const Cylinder& c)
+    : type(CylinderDetector), center(c.getBaseCenter() + 0.5 * c.getAxis()),
+      radius(std::sqrt(std::pow(c.getRadius(), 2) + std::pow(c.getHeight() / 2, 2)))
+{
+    std::shared_ptr<const Cylinder> cylinder = std::make_shared<Cylinder>(-0.5 * c.getAxis(), c.getAxis(), c.getRadius());
+    localShape = cylinder;
+    table = std::make_shared<GeometryFactorTable>(cylinder, 65, 33);
+}
+
+Detector::Detector(const Box& b)
+    : type(BoxDetector), center(b.getTransform().getTranslation()), radius(b.getHalfWidths().length())
+{
+    // the face integrals rely on distances being the same in the box frame
+    const Mat3& m = b.getTransform().getLinear();
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 3; j++)
+        {
+            if (std::abs(Vec3d::dotProduct(m.column(i), m.column(j)) - (i == j ? 1 : 0)) > 1e-9)
+                throw std::runtime_error("Box detectors must not be scaled or sheared.");
+        }
+    }
+    localShape = std::make_shared<Box>(Transform(m, Vec3d(0, 0, 0)), b.getHalfWidths());
+}
+
+double Detector::getVolume() const
+{
+    if (type == SphereDetector)
+        return 4.0 / 3.0 * M_PI * radius * radius * radius;
+    if (type == PointDetector)
+        return 0;
+    return localShape->getVolume();
+}
+
+std::shared_ptr<const Shape> Detector::getShape() const
+{
+    if (type == SphereDetector || type == PointDetector)
+        return std::make_shared<Sphere>(center, radius);
+    if (type == CylinderDetector)
+    {
+        const Cylinder& cylinder = dynamic_cast<const Cylinder&>(*localShape);
+        return std::make_shared<Cylinder>(center - 0.5 * cylinder.getAxis(), cylinder.getAxis(), cylinder.getRadius());
+    }
+    const Box& box = dynamic_cast<const Box&>(*localShape);
+    return std::make_shared<Box>(Transform(box.getTransform().getLinear(), center), box.getHalfWidths());
+}
+
+double Detector::chordLength(const Ray& ray) const
+{
+    if (type == SphereDetector)
+        return Sphere(center, radius).intersection(ray);
+    if (type == PointDetector)
+        return 0;
+    return localShape->intersection(Ray(ray.getOrigin() - center, ray.getDirection()));
+}
+
+bool Detector::intersect(const Ray& ray, Segment& seg) const
+{
+    if (type == SphereDetector)
+        return Sphere(center, radius).intersect(ray, seg);
+    if (type == PointDetector)
+        return false;
+    return localShape->intersect(Ray(ray.getOrigin() - center, ray.getDirection()), seg);
+}
+
+double Detector::chordIntegral(const Vec3d& p) const
+{
+    if (type == SphereDetector)
+    {
+        const double length = (center - p).length();
+        const double ratio = radius / length;
+        return length * (ratio - 0.5 * (1-ratio*ratio) * std::log((1+ratio)/(1-ratio)));
+    }
+    if (type == BoxDetector)
+        return boxIntegral(p - center) / (2 * M_PI);
+    if (type == PointDetector)
+        return 0;
+    return table->getIntegral(p - center) / (2 * M_PI);
+}
+
+double Detector::pointFactor(const Vec3d& p) const
+{
+    const double lengthSquared = (center - p).lengthSquared();
+    if (lengthSquared < radius * radius)
+        return 3 / (2 * M_PI * radius * radius);
+    return 1 / (2 * M_PI * lengthSquared);
+}
+
+void Detector::setRadius(const double r)
+{
+    if (type != SphereDetector && type != PointDetector)
+        throw std::runtime_error("Only spherical detectors and exclusion spheres can be resized.");
+    radius = r;
+}
@@ -1,42 +1,319 @@
 #include "geometry.h"
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
 
-bool Cylinder::contain(const QVector3D& point) const 
+/**
+ * @brief Solve a*t^2 + 2*b*t + c = 0 for the two roots t1 <= t2, using the numerically stable form.
+ * 
+ * @return true if two distinct real roots exist
+ * @return false else
+ */
+static bool solveQuadratic(const double a, const double b, const double c, double& t1, double& t2)
 {
-    if(point.z() <= baseCenter.z() || 
-        point.z() >= baseCenter.z() + height)
+    const double disc = b * b - a * c;
+    if (disc <= 0)
         return false;
+    const double q = -(b + std::copysign(std::sqrt(disc), b));
+    t1 = q / a;
+    t2 = c / q;
+    if (t1 > t2)
+        std::swap(t1, t2);
+    return true;
+}
+
+/**
+ * @brief Intersect the line x = o + t * d with the slab lower < x_i < upper along one axis
+ * 
+ * @return false if the line is parallel to the slab and outside of it
+ */
+static bool clipAxis(const double o, const double d, const double lower, const double upper, double& tIn, double& tOut)
+{
+    if (d == 0)
+        return o > lower && o < upper;
+    double t1 = (lower - o) / d;
+    double t2 = (upper - o) / d;
+    if (t1 > t2)
+        std::swap(t1, t2);
+    tIn = std::max(tIn, t1);
+    tOut = std::min(tOut, t2);
+    return true;
+}
+
+std::vector<Segment> Shape::segments(const Ray& ray) const
+{
+    Segment seg;
+    if (intersect(ray, seg))
+        return {seg};
+    return {};
+}
+
+Transform::Transform(const Mat3& m, const Vec3d& t)
+    : linear(m), inverse(m.inverse()), translation(t)
+{
+    translationOnly = true;
+    for (int i = 0; i < 3; i++)
+        for (int j = 0; j < 3; j++)
+            if (m(i, j) != (i == j ? 1 : 0))
+                translationOnly = false;
+}
 
-    if(qPow(point.x()-baseCenter.x(), 2) + qPow(point.y()-baseCenter.y(), 2) >= qPow(radius, 2))
+Mat3 Transform::alignZ(const Vec3d& axis)
+{
+    const Vec3d w = axis.normalized();
+    if (w == Vec3d(0, 0, 1))
+        return Mat3();
+    // pick a world axis far from w to build an orthonormal frame
+    const Vec3d helper = std::abs(w.x()) < 0.9 ? Vec3d(1, 0, 0) : Vec3d(0, 1, 0);
+    const Vec3d u = Vec3d::crossProduct(helper, w).normalized();
+    const Vec3d v = Vec3d::crossProduct(w, u);
+    return Mat3(u, v, w);
+}
+
+Mat3 Transform::rotation(const Vec3d& axis, const double angle)
+{
+    // Rodrigues' rotation formula, applied to the basis vectors
+    const Vec3d k = axis.normalized();
+    const double c = std::cos(angle);
+    const double s = std::sin(angle);
+    Vec3d cols[3];
+    const Vec3d basis[3] = {Vec3d(1, 0, 0), Vec3d(0, 1, 0), Vec3d(0, 0, 1)};
+    for (int i = 0; i < 3; i++)
+    {
+        const Vec3d& e = basis[i];
+        cols[i] = c * e + s * Vec3d::crossProduct(k, e) + (1 - c) * Vec3d::dotProduct(k, e) * k;
+    }
+    return Mat3(cols[0], cols[1], cols[2]);
+}
+
+double TransformedShape::intersection(const Ray& ray) const
+{
+    Segment seg;
+    if (!intersect(ray, seg))
+        return 0;
+    return seg.length();
+}
+
+bool TransformedShape::intersect(const Ray& ray, Segment& seg) const
+{
+    double tIn, tOut;
+    if (!intersectLocal(transform.toLocal(ray.getOrigin()), transform.toLocalDirection(ray.getDirection()), tIn, tOut))
         return false;
+    tIn = std::max(tIn, 0.0);
+    if (tOut <= tIn)
+        return false;
+    seg = Segment{tIn, tOut};
+    return true;
+}
+
+bool Cylinder::containLocal(const Vec3d& p) const 
+{
+    if(p.z() <= 0 || p.z() >= height)
+        return false;
+
+    if(p.x() * p.x() + p.y() * p.y() >= radius * radius)
+        return false;
+
+    return true;
+}
 
+bool Cylinder::intersectLocal(const Vec3d& o, const Vec3d& d, double& tIn, double& tOut) const
+{
+    tIn = -std::numeric_limits<double>::infinity();
+    tOut = std::numeric_limits<double>::infinity();
+    // end caps, z = 0 and z = height
+    if (!clipAxis(o.z(), d.z(), 0, height, tIn, tOut))
+        return false;
+    // side surface, x^2 + y^2 = r^2
+    const double a = d.x() * d.x() + d.y() * d.y();
+    const double c = o.x() * o.x() + o.y() * o.y() - radius * radius;
+    if (a == 0)
+    {
+        // parallel to the axis
+        if (c >= 0)
+            return false;
+    }
+    else
+    {
+        double t1, t2;
+        if (!solveQuadratic(a, o.x() * d.x() + o.y() * d.y(), c, t1, t2))
+            return false;
+        tIn = std::max(tIn, t1);
+        tOut = std::min(tOut, t2);
+    }
+    return tOut > tIn;
+}
+
+void Cylinder::getBoundingBox(Vec3d& lower, Vec3d& upper) const
+{
+    const Vec3d base = getBaseCenter();
+    const Vec3d top = base + getAxis();
+    const Vec3d w = getAxis().normalized();
+    for (int i = 0; i < 3; i++)
+    {
+        // extent of the end circles along world axis i
+        const double extent = radius * std::sqrt(std::max(0.0, 1 - w[i] * w[i]));
+        lower[i] = std::min(base[i], top[i]) - extent;
+        upper[i] = std::max(base[i], top[i]) + extent;
+    }
+}
+
+Vec3d Cylinder::samplePoint(const double u1, const double u2, const double u3) const
+{
+    double a = u1;
+    double b = u2;
+    if (b < a)
+        std::swap(a, b);
+    // max(u1, u2) has a linear density, which gives uniform points on the disk
+    const Vec3d local(b * radius * std::cos(2 * M_PI * a / b), 
+                      b * radius * std::sin(2 * M_PI * a / b), 
+                      u3 * height);
+    return transform.toWorld(local);
+}
+
+bool Box::containLocal(const Vec3d& p) const
+{
+    for (int i = 0; i < 3; i++)
+    {
+        if (p[i] <= -halfWidths[i] || p[i] >= halfWidths[i])
+            return false;
+    }
     return true;
 }
 
-double Cylinder::intersection(const Ray& ray) const
+bool Box::intersectLocal(const Vec3d& o, const Vec3d& d, double& tIn, double& tOut) const
 {
-    // in this case the origin must reside in the cylinder
-    // project the setup onto the xy plane
-    QVector2D diffXY = baseCenter.toVector2D() - ray.getOrigin().toVector2D();
-    QVector2D dirXY = ray.getDirection().toVector2D();
-    double dirXYLen = dirXY.length();
-    dirXY = dirXY / dirXYLen;
-    double cosine = QVector2D::dotProduct(diffXY, dirXY);
-    return 1 / dirXYLen * (cosine + qSqrt(radius * radius + cosine * cosine - diffXY.lengthSquared()));
+    tIn = -std::numeric_limits<double>::infinity();
+    tOut = std::numeric_limits<double>::infinity();
+    for (int i = 0; i < 3; i++)
+    {
+        if (!clipAxis(o[i], d[i], -halfWidths[i], halfWidths[i], tIn, tOut))
+            return false;
+    }
+    return tOut > tIn;
 }
 
-bool Sphere::contain(const QVector3D& point) const
+void Box::getBoundingBox(Vec3d& lower, Vec3d& upper) const
+{
+    const Vec3d center = transform.getTranslation();
+    const Mat3& m = transform.getLinear();
+    for (int i = 0; i < 3; i++)
+    {
+        double extent(0);
+        for (int j = 0; j < 3; j++)
+            extent += std::abs(m(i, j)) * halfWidths[j];
+        lower[i] = center[i] - extent;
+        upper[i] = center[i] + extent;
+    }
+}
+
+Vec3d Box::samplePoint(const double u1, const double u2, const double u3) const
+{
+    const Vec3d local((2 * u1 - 1) * halfWidths.x(), 
+                      (2 * u2 - 1) * halfWidths.y(), 
+                      (2 * u3 - 1) * halfWidths.z());
+    return transform.toWorld(local);
+}
+
+bool Slab::containLocal(const Vec3d& p) const
+{
+    return p.z() > 0 && p.z() < thickness;
+}
+
+bool Slab::intersectLocal(const Vec3d& o, const Vec3d& d, double& tIn, double& tOut) const
+{
+    tIn = -std::numeric_limits<double>::infinity();
+    tOut = std::numeric_limits<double>::infinity();
+    if (!clipAxis(o.z(), d.z(), 0, thickness, tIn, tOut))
+        return false;
+    return tOut > tIn;
+}
+
+void Slab::getBoundingBox(Vec3d& lower, Vec3d& upper) const
+{
+    const double inf = std::numeric_limits<double>::infinity();
+    lower = Vec3d(-inf, -inf, -inf);
+    upper = Vec3d(inf, inf, inf);
+}
+
+Vec3d Slab::samplePoint(const double, const double, const double) const
+{
+    throw std::runtime_error("can't sample points in an unbounded slab");
+}
+
+bool Ellipsoid::containLocal(const Vec3d& p) const
+{
+    return p.lengthSquared() < 1;
+}
+
+bool Ellipsoid::intersectLocal(const Vec3d& o, const Vec3d& d, double& tIn, double& tOut) const
+{
+    return solveQuadratic(d.lengthSquared(), Vec3d::dotProduct(o, d), o.lengthSquared() - 1, tIn, tOut);
+}
+
+void Ellipsoid::getBoundingBox(Vec3d& lower, Vec3d& upper) const
+{
+    const Vec3d center = transform.getTranslation();
+    for (int i = 0; i < 3; i++)
+    {
+        // support function of the unit sphere mapped by M along world axis i is |row i of M|
+        const double extent = transform.getLinear().row(i).length();
+        lower[i] = center[i] - extent;
+        upper[i] = center[i] + extent;
+    }
+}
+
+Vec3d Ellipsoid::samplePoint(const double u1, const double u2, const double u3) const
+{
+    // uniform point in the unit ball
+    const double r = std::cbrt(u1);
+    const double costheta = 1 - 2 * u2;
+    const double sintheta = std::sqrt(1 - costheta * costheta);
+    const double phi = 2 * M_PI * u3;
+    return transform.toWorld(Vec3d(r * sintheta * std::cos(phi), r * sintheta * std::sin(phi), r * costheta));
+}
+
+bool Sphere::contain(const Vec3d& point) const
 {
     return (point-center).length() < radius;
 }
 double Sphere::intersection(const Ray& ray) const
 {
-    QVector3D prtl2det = center - ray.getOrigin();
-    double proj = QVector3D::dotProduct(prtl2det, ray.getDirection());
+    Vec3d prtl2det = center - ray.getOrigin();
+    double proj = Vec3d::dotProduct(prtl2det, ray.getDirection());
     if(proj <= 0)
         return 0;
     
     double d = center.distanceToLine(ray.getOrigin(), ray.getDirection());
     if(d >= radius)
         return 0;
-    return 2 * qSqrt(radius*radius - d * d);
-}
\ No newline at end of file
+    return 2 * std::sqrt(radius*radius - d * d);
+}
+
+bool Sphere::intersect(const Ray& ray, Segment& seg) const
+{
+    // origin relative to the center
+    const Vec3d o = ray.getOrigin() - center;
+    double t1, t2;
+    if (!solveQuadratic(1, Vec3d::dotProduct(o, ray.getDirection()), o.lengthSquared() - radius * radius, t1, t2))
+        return false;
+    if (t2 <= 0)
+        return false;
+    seg = Segment{std::max(t1, 0.0), t2};
+    return true;
+}
+
+void Sphere::getBoundingBox(Vec3d& lower, Vec3d& upper) const
+{
+    lower = center - Vec3d(radius, radius, radius);
+    upper = center + Vec3d(radius, radius, radius);
+}
+
+Vec3d Sphere::samplePoint(const double u1, const double u2, const double u3) const
+{
+    const double r = radius * std::cbrt(u1);
+    const double costheta = 1 - 2 * u2;
+    const double sintheta = std::sqrt(1 - costheta * costheta);
+    const double phi = 2 * M_PI * u3;
+    return center + Vec3d(r * sintheta * std::cos(phi), r * sintheta * std::sin(phi), r * costheta);
+}
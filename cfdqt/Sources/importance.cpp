@@ -0,0 +1,290 @@
+#include "importance.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+// Gauss-Seidel over-relaxation factor and convergence of the group solves
+static const double relaxation = 1.5;
+static const double tolerance = 1e-6;
+static const int maxSweeps = 20000;
+// outer iterations over the groups, only needed with upscattering
+static const int maxOuterIterations = 50;
+
+/**
+ * @brief Get the energy representing a group, the geometric mean of its edges for neutrons
+ */
+static double groupEnergy(const double low, const double high, const Particle::ParticleType type)
+{
+    if (type == Particle::Neutron && low > 0)
+        return std::sqrt(low * high);
+    return 0.5 * (low + high);
+}
+
+static int findGroup(const std::vector<double>& edges, const double ergE)
+{
+    if (!(ergE >= edges.front()))
+        return -1;
+    if (ergE >= edges.back())
+        return static_cast<int>(edges.size()) - 2;
+    return std::upper_bound(edges.begin(), edges.end(), ergE) - edges.begin() - 1;
+}
+
+ImportanceMap::ImportanceMap(const MCSettings& config, const Tally& tally, const std::vector<double>& energyEdges_,
+                             const int nx, const int ny, const int nz, const int scatterSamples)
+    : nodes{nx, ny, nz}, energyEdges(energyEdges_)
+{
+    config.ROI->getBoundingBox(lowerCorner, upperCorner);
+    for (int d = 0; d < 3; d++)
+    {
+        if (nodes[d] < 1)
+            throw std::runtime_error("Invalid importance mesh.");
+        spacing[d] = (upperCorner[d] - lowerCorner[d]) / nodes[d];
+    }
+    if (energyEdges.size() < 2)
+        throw std::runtime_error("Importance maps need at least 2 energy group edges.");
+    for (std::size_t i = 1; i < energyEdges.size(); i++)
+    {
+        if (!(energyEdges[i] > energyEdges[i - 1]))
+            throw std::runtime_error("Importance energy group edges must be increasing.");
+    }
+    const int ngroups = getNGroups();
+    const int nelements = getNumberOfElements();
+    const Particle::ParticleType type = config.source.createParticle().particleType;
+    const Material& material = config.cells[0].material;
+
+    // group constants
+    std::vector<double> totalAtten(ngroups), scatterRatio(ngroups);
+    for (int g = 0; g < ngroups; g++)
+    {
+        const double ergE = groupEnergy(energyEdges[g], energyEdges[g + 1], type);
+        totalAtten[g] = type == Particle::Photon ? material.getPhotonTotalAtten(ergE) : material.getNeutronTotalAtten(ergE);
+        scatterRatio[g] = scatteringProbability(material, ergE, type);
+    }
+
+    // transfer probabilities, scatterings sampled uniformly in the group, in lethargy for neutrons
+    transfer.assign(ngroups * ngroups, 0);
+    const Vec3d center = 0.5 * (lowerCorner + upperCorner);
+    for (int g = 0; g < ngroups; g++)
+    {
+        const bool logarithmic = type == Particle::Neutron && energyEdges[g] > 0;
+        for (int s = 0; s < scatterSamples; s++)
+        {
+            const double u = (s + 0.5) / scatterSamples;
+            const double ergE = logarithmic ? energyEdges[g] * std::pow(energyEdges[g + 1] / energyEdges[g], u) :
+                                              energyEdges[g] + u * (energyEdges[g + 1] - energyEdges[g]);
+            Particle prtl(center, Vec3d(1, 0, 0), ergE, 1, type);
+            scattering(prtl, config);
+            const int h = findGroup(energyEdges, prtl.ergE);
+            if (h >= 0)
+                transfer[g * ngroups + h] += 1.0 / scatterSamples;
+        }
+    }
+    bool upscatter(false);
+    for (int g = 0; g < ngroups; g++)
+    {
+        for (int h = g + 1; h < ngroups; h++)
+            upscatter = upscatter || transfer[g * ngroups + h] > 0;
+    }
+
+    // adjoint source: expected forced detection score of a collision at the element center
+    std::vector<bool> inside(nelements);
+    std::vector<double> source(ngroups * nelements, 0);
+    std::vector<double> pathLengths;
+    const double tallyMinE = tally.getBinEdges().front();
+    for (int i = 0; i < nx; i++)
+    {
+        for (int j = 0; j < ny; j++)
+        {
+            for (int k = 0; k < nz; k++)
+            {
+                const int e = (i * ny + j) * nz + k;
+                const Vec3d pos = lowerCorner + Vec3d((i + 0.5) * spacing[0], (j + 0.5) * spacing[1], (k + 0.5) * spacing[2]);
+                inside[e] = config.ROI->contain(pos);
+                if (!inside[e])
+                    continue;
+                const double geometry = tally.geometryFactor(pos);
+                if (!std::isfinite(geometry))
+                    continue;
+                config.getCellPathLengths(pos, tally.getCenter(), pathLengths);
+                for (int g = 0; g < ngroups; g++)
+                {
+                    if (energyEdges[g + 1] < tallyMinE)
+                        continue;
+                    const double ergE = groupEnergy(energyEdges[g], energyEdges[g + 1], type);
+                    double depth(0);
+                    for (std::size_t c = 0; c < pathLengths.size(); c++)
+                    {
+                        if (pathLengths[c] > 0)
+                            depth += pathLengths[c] * (type == Particle::Photon ?
+                                                       config.cells[c].material.getPhotonTotalAtten(ergE) :
+                                                       config.cells[c].material.getNeutronTotalAtten(ergE));
+                    }
+                    source[g * nelements + e] = totalAtten[g] * scatterRatio[g] * geometry * std::exp(-depth);
+                }
+            }
+        }
+    }
+
+    // multigroup adjoint diffusion, finite volumes with Marshak vacuum conditions outside the ROI.
+    // Groups are solved from low to high energy, as the importance of a group depends on the groups it scatters to.
+    importance.assign(ngroups * nelements, 0);
+    const int strides[3] = {ny * nz, nz, 1};
+    std::vector<double> previous;
+    for (int outer = 0; outer < (upscatter ? maxOuterIterations : 1); outer++)
+    {
+        for (int g = 0; g < ngroups; g++)
+        {
+            const double diffusion = 1 / (3 * totalAtten[g]);
+            const double scatterAtten = totalAtten[g] * scatterRatio[g];
+            const double removal = totalAtten[g] - scatterAtten * transfer[g * ngroups + g];
+            double coupling[3], leakage[3];
+            for (int d = 0; d < 3; d++)
+            {
+                coupling[d] = diffusion / (spacing[d] * spacing[d]);
+                leakage[d] = diffusion / (spacing[d] * (0.5 * spacing[d] + 2 * diffusion));
+            }
+            // sources from the other groups
+            std::vector<double> rhs(source.begin() + g * nelements, source.begin() + (g + 1) * nelements);
+            for (int h = 0; h < ngroups; h++)
+            {
+                const double p = transfer[g * ngroups + h];
+                if (h == g || p == 0)
+                    continue;
+                for (int e = 0; e < nelements; e++)
+                    rhs[e] += scatterAtten * p * importance[h * nelements + e];
+            }
+            double* phi = importance.data() + g * nelements;
+            double maxPhi(0);
+            for (iterations = 0; iterations < maxSweeps; iterations++)
+            {
+                double maxChange(0);
+                maxPhi = 0;
+                for (int i = 0; i < nx; i++)
+                {
+                    for (int j = 0; j < ny; j++)
+                    {
+                        for (int k = 0; k < nz; k++)
+                        {
+                            const int e = (i * ny + j) * nz + k;
+                            if (!inside[e])
+                                continue;
+                            const int idx[3] = {i, j, k};
+                            double diagonal(removal), neighbors(0);
+                            for (int d = 0; d < 3; d++)
+                            {
+                                for (int side = -1; side <= 1; side += 2)
+                                {
+                                    const int n = idx[d] + side;
+                                    if (n >= 0 && n < nodes[d] && inside[e + side * strides[d]])
+                                    {
+                                        diagonal += coupling[d];
+                                        neighbors += coupling[d] * phi[e + side * strides[d]];
+                                    }
+                                    else
+                                        diagonal += leakage[d];
+                                }
+                            }
+                            const double updated = phi[e] + relaxation * ((rhs[e] + neighbors) / diagonal - phi[e]);
+                            maxChange = std::max(maxChange, std::abs(updated - phi[e]));
+                            phi[e] = std::max(0.0, updated);
+                            maxPhi = std::max(maxPhi, phi[e]);
+                        }
+                    }
+                }
+                if (maxChange <= tolerance * maxPhi)
+                    break;
+            }
+            if (iterations == maxSweeps)
+                throw std::runtime_error("Adjoint diffusion did not converge.");
+        }
+        if (!upscatter)
+            break;
+        // stop when the upscattered importance no longer changes
+        if (outer > 0)
+        {
+            double maxDiff(0), maxValue(0);
+            for (std::size_t e = 0; e < importance.size(); e++)
+            {
+                maxDiff = std::max(maxDiff, std::abs(importance[e] - previous[e]));
+                maxValue = std::max(maxValue, importance[e]);
+            }
+            if (maxDiff <= 10 * tolerance * maxValue)
+                break;
+        }
+        previous = importance;
+    }
+
+    // response, the mean importance of source particles
+    const int sourceSamples = std::max(1, scatterSamples);
+    for (int s = 0; s < sourceSamples; s++)
+    {
+        const Particle prtl = config.source.createParticle();
+        response += getImportance(prtl.pos, prtl.ergE) * prtl.weight;
+    }
+    response /= sourceSamples;
+}
+
+std::vector<double> ImportanceMap::defaultEnergyEdges(const MCSettings& config, const int ngroups)
+{
+    if (ngroups < 1)
+        throw std::runtime_error("Importance maps need at least 1 energy group.");
+    double maxE(0);
+    Particle::ParticleType type(Particle::Photon);
+    for (int s = 0; s < 1000; s++)
+    {
+        const Particle prtl = config.source.createParticle();
+        maxE = std::max(maxE, prtl.ergE);
+        type = prtl.particleType;
+    }
+    // source energies must be below the last edge
+    maxE *= 1 + 1e-6;
+    const bool logarithmic = type == Particle::Neutron;
+    // thermal neutrons need groups of their own
+    const double minE = logarithmic ? std::max(config.minE, 1e-3) : config.minE;
+    if (!(maxE > minE))
+        throw std::runtime_error("Source energies are below the minimum energy.");
+    std::vector<double> edges(ngroups + 1);
+    for (int g = 0; g <= ngroups; g++)
+    {
+        const double u = static_cast<double>(g) / ngroups;
+        edges[g] = logarithmic ? minE * std::pow(maxE / minE, u) : minE + u * (maxE - minE);
+    }
+    edges.back() = maxE;
+    return edges;
+}
+
+int ImportanceMap::findElement(const Vec3d& pos) const
+{
+    int idx[3];
+    for (int d = 0; d < 3; d++)
+    {
+        const double t = (pos[d] - lowerCorner[d]) / spacing[d];
+        if (!(t >= 0 && t < nodes[d]))
+            return -1;
+        idx[d] = std::min(static_cast<int>(t), nodes[d] - 1);
+    }
+    return (idx[0] * nodes[1] + idx[1]) * nodes[2] + idx[2];
+}
+
+double ImportanceMap::getImportance(const Vec3d& pos, const double ergE) const
+{
+    const int e = findElement(pos);
+    if (e < 0 || !(ergE >= energyEdges.front() && ergE < energyEdges.back()))
+        return 0;
+    const int g = std::upper_bound(energyEdges.begin(), energyEdges.end(), ergE) - energyEdges.begin() - 1;
+    return importance[g * getNumberOfElements() + e];
+}
+
+WeightWindowMesh ImportanceMap::toWeightWindows(const double upperRatio, const double survivalRatio) const
+{
+    if (!(response > 0))
+        throw std::runtime_error("The source has no importance for the tally, no weight windows.");
+    std::vector<double> lowerBounds(importance.size(), 0);
+    for (std::size_t i = 0; i < importance.size(); i++)
+    {
+        if (importance[i] > 0)
+            lowerBounds[i] = response / (importance[i] * survivalRatio);
+    }
+    return WeightWindowMesh(lowerCorner, upperCorner, nodes[0], nodes[1], nodes[2], energyEdges, lowerBounds,
+                            upperRatio, survivalRatio);
+}
@@ -388,7 +388,7 @@ void MainWindow::handleClear(int id)
     if (id==ui->spectrum->getID())
     {
         canvas = ui->spectrum->getCanvas();
-        Tally tally(Sphere(QVector3D(0,0,0), 1),100, 0,1.0);
+        Tally tally(Sphere(Vec3d(0,0,0), 1),100, 0,1.0);
         updateSpectrum(canvas, tally);
     }
     else
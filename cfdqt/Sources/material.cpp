@@ -272,13 +272,25 @@ Material::Material(const double d, const int id, const std::vector<std::pair<dou
 }
 
 const Nuclide& Material::selectInteractionTarget(const double energy, const double r) const
+{
+    return compositions[selectInteractionTargetIndex(energy, r)].second;
+}
+
+int Material::selectInteractionTargetIndex(const double energy, const double r) const
 {
     const std::vector<double>& entry = getClosestEntry(energy, nuclideInvCDF);
     for (int i = 0; i < compositions.size(); i++)
     {
         if (r < entry[i+1])
         {
-            return compositions[i].second;
+            return i;
         }
     }
-}
\ No newline at end of file
+    return compositions.size() - 1;
+}
+
+double Material::getInteractionProbability(const double energy, const int index) const
+{
+    const std::vector<double>& entry = getClosestEntry(energy, nuclideInvCDF);
+    return entry[index+1] - entry[index];
+}
@@ -0,0 +1,897 @@
+#include "mcnpimport.h"
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <limits>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+
+namespace
+{
+// Avogadro's number / 1e24
+const double avogadro = 0.60221409;
+
+std::string toUpper(std::string s)
+{
+    for (auto &&c : s)
+        c = std::toupper(static_cast<unsigned char>(c));
+    return s;
+}
+
+std::vector<std::string> split(const std::string& s)
+{
+    std::istringstream iss(s);
+    std::vector<std::string> tokens;
+    std::string token;
+    while (iss >> token)
+        tokens.push_back(token);
+    return tokens;
+}
+
+bool isNumber(const std::string& s)
+{
+    if (s.empty())
+        return false;
+    char* end;
+    std::strtod(s.c_str(), &end);
+    return *end == '\0';
+}
+
+double toDouble(const std::string& s, const std::string& card)
+{
+    if (!isNumber(s))
+        throw std::runtime_error("can't read number '" + s + "' in card: " + card);
+    return std::strtod(s.c_str(), nullptr);
+}
+
+/**
+ * @brief Expand the MCNP shortcuts nR, nI, nILOG (nLOG), nJ and xM in a list of numbers.
+ *        Jumped entries are NaN.
+ */
+std::vector<double> expandNumbers(const std::vector<std::string>& tokens, const std::size_t first, const std::string& card)
+{
+    static const std::regex shortcut("^([0-9]*)(R|I|ILOG|LOG|J)$");
+    static const std::regex multiply("^([0-9.eE+-]+)M$");
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    std::vector<double> values;
+    // pending interpolation, number of points and whether logarithmic
+    int interpN(0);
+    bool interpLog(false);
+    for (std::size_t i = first; i < tokens.size(); i++)
+    {
+        const std::string token = toUpper(tokens[i]);
+        std::smatch m;
+        if (std::regex_match(token, m, shortcut))
+        {
+            const int n = m[1].str().empty() ? 1 : std::stoi(m[1].str());
+            const std::string op = m[2].str();
+            if (op == "J")
+            {
+                values.insert(values.end(), n, nan);
+            }
+            else if (op == "R")
+            {
+                if (values.empty())
+                    throw std::runtime_error("nothing to repeat in card: " + card);
+                values.insert(values.end(), n, values.back());
+            }
+            else
+            {
+                interpN = n;
+                interpLog = op != "I";
+            }
+            continue;
+        }
+        if (std::regex_match(token, m, multiply))
+        {
+            if (values.empty())
+                throw std::runtime_error("nothing to multiply in card: " + card);
+            values.push_back(values.back() * toDouble(m[1].str(), card));
+            continue;
+        }
+        const double v = toDouble(token, card);
+        if (interpN > 0)
+        {
+            if (values.empty())
+                throw std::runtime_error("nothing to interpolate from in card: " + card);
+            const double v0 = values.back();
+            for (int k = 1; k <= interpN; k++)
+            {
+                const double f = double(k) / (interpN + 1);
+                if (interpLog)
+                    values.push_back(v0 * std::pow(v / v0, f));
+                else
+                    values.push_back(v0 + (v - v0) * f);
+            }
+            interpN = 0;
+        }
+        values.push_back(v);
+    }
+    return values;
+}
+
+/**
+ * @brief ZAID without the library suffix, "1001.70c" -> 1001
+ */
+int readZaid(const std::string& token, const std::string& card)
+{
+    const std::string zz = token.substr(0, token.find('.'));
+    if (zz.empty() || !std::all_of(zz.begin(), zz.end(), ::isdigit))
+        throw std::runtime_error("can't read ZAID '" + token + "' in card: " + card);
+    return std::stoi(zz);
+}
+
+void parseCell(McnpDeck& deck, const std::string& card)
+{
+    std::vector<std::string> tokens = split(card);
+    if (tokens.size() < 2)
+        throw std::runtime_error("incomplete cell card: " + card);
+    if (toUpper(tokens[1]) == "LIKE")
+        throw std::runtime_error("LIKE n BUT cells are not supported: " + card);
+    McnpDeck::CellCard cell;
+    cell.id = std::stoi(tokens[0]);
+    cell.material = std::stoi(tokens[1]);
+    cell.density = 0;
+    cell.complexGeometry = false;
+    std::size_t i = 2;
+    if (cell.material != 0)
+    {
+        if (tokens.size() < 3)
+            throw std::runtime_error("missing density in cell card: " + card);
+        cell.density = toDouble(tokens[2], card);
+        i = 3;
+    }
+    // geometry ends at the first parameter, e.g. imp:n=1
+    for (; i < tokens.size() && !std::isalpha(static_cast<unsigned char>(tokens[i][0])); i++)
+    {
+        const std::string& token = tokens[i];
+        if (token.find_first_of(":()#") != std::string::npos)
+        {
+            cell.complexGeometry = true;
+            continue;
+        }
+        cell.surfaces.push_back(std::stoi(token));
+    }
+    deck.cells.push_back(cell);
+}
+
+void parseSurface(McnpDeck& deck, const std::string& card)
+{
+    std::vector<std::string> tokens = split(card);
+    if (tokens.size() < 2)
+        throw std::runtime_error("incomplete surface card: " + card);
+    McnpDeck::SurfaceCard surface;
+    // '*' and '+' mark reflecting and white boundaries
+    std::string id = tokens[0];
+    if (id[0] == '*' || id[0] == '+')
+        id = id.substr(1);
+    surface.id = std::stoi(id);
+    surface.transform = 0;
+    std::size_t i = 1;
+    if (isNumber(tokens[1]))
+    {
+        surface.transform = std::stoi(tokens[1]);
+        i = 2;
+    }
+    if (i >= tokens.size())
+        throw std::runtime_error("missing surface mnemonic: " + card);
+    surface.type = toUpper(tokens[i]);
+    surface.params = expandNumbers(tokens, i + 1, card);
+    deck.surfaces[surface.id] = surface;
+}
+
+void parseTransform(McnpDeck& deck, const std::vector<std::string>& tokens, const std::string& card)
+{
+    std::string name = toUpper(tokens[0]);
+    const bool degrees = name[0] == '*';
+    if (degrees)
+        name = name.substr(1);
+    const int id = name.size() > 2 ? std::stoi(name.substr(2)) : 1;
+    std::vector<double> values = expandNumbers(tokens, 1, card);
+    values.resize(13, std::numeric_limits<double>::quiet_NaN());
+    Vec3d displacement;
+    for (int i = 0; i < 3; i++)
+        displacement[i] = std::isnan(values[i]) ? 0 : values[i];
+    int given(0);
+    for (int i = 3; i < 12; i++)
+        given += !std::isnan(values[i]);
+    Mat3 rotation;
+    if (given == 9)
+    {
+        Vec3d columns[3];
+        for (int i = 0; i < 9; i++)
+        {
+            // xx' yx' zx' xy' ..., cosines between the main and the auxiliary axes
+            const double v = degrees ? std::cos(values[3 + i] * M_PI / 180) : values[3 + i];
+            columns[i / 3][i % 3] = v;
+        }
+        rotation = Mat3(columns[0], columns[1], columns[2]);
+    }
+    else if (given != 0)
+    {
+        throw std::runtime_error("partial rotation matrices are not supported: " + card);
+    }
+    // m = -1: the displacement is the main origin in the auxiliary frame
+    if (!std::isnan(values[12]) && values[12] == -1)
+        displacement = -(rotation * displacement);
+    deck.transforms.erase(id);
+    deck.transforms.emplace(id, Transform(rotation, displacement));
+}
+
+void parseMaterial(McnpDeck& deck, const std::vector<std::string>& tokens, const std::string& card)
+{
+    McnpDeck::MaterialCard material;
+    material.id = std::stoi(tokens[0].substr(1));
+    std::vector<std::string> pairs;
+    for (std::size_t i = 1; i < tokens.size(); i++)
+    {
+        // library keywords, e.g. nlib=70c
+        if (tokens[i].find('=') == std::string::npos)
+            pairs.push_back(tokens[i]);
+    }
+    if (pairs.size() % 2 != 0)
+        throw std::runtime_error("unpaired ZAID and fraction: " + card);
+    for (std::size_t i = 0; i < pairs.size(); i += 2)
+    {
+        material.components.push_back({readZaid(pairs[i], card), toDouble(pairs[i + 1], card)});
+    }
+    deck.materials[material.id] = material;
+}
+
+void parseSource(McnpDeck& deck, std::string card)
+{
+    static const std::vector<std::string> keywords{"CEL", "SUR", "ERG", "TME", "DIR", "VEC", "NRM", "POS", "RAD",
+                                                   "EXT", "AXS", "X", "Y", "Z", "CCC", "ARA", "WGT", "TR", "EFF", "PAR"};
+    std::replace(card.begin(), card.end(), '=', ' ');
+    std::vector<std::string> tokens = split(card);
+    std::string key;
+    for (std::size_t i = 1; i < tokens.size(); i++)
+    {
+        const std::string token = toUpper(tokens[i]);
+        if (std::find(keywords.begin(), keywords.end(), token) != keywords.end())
+        {
+            key = token;
+            deck.source[key];
+        }
+        else if (!key.empty())
+        {
+            deck.source[key].push_back(token);
+        }
+    }
+}
+
+void parseDistribution(McnpDeck& deck, const std::vector<std::string>& tokens, const std::string& card, const bool probability)
+{
+    McnpDeck::Distribution& dist = deck.distributions[std::stoi(tokens[0].substr(2))];
+    std::string option;
+    std::size_t first = 1;
+    if (tokens.size() > 1 && std::isalpha(static_cast<unsigned char>(tokens[1][0])))
+    {
+        option = toUpper(tokens[1]);
+        first = 2;
+    }
+    else if (probability && tokens.size() > 1 && tokens[1][0] == '-')
+    {
+        // built-in function
+        option = tokens[1];
+        first = 2;
+    }
+    if (probability)
+    {
+        dist.spOption = option;
+        dist.sp = expandNumbers(tokens, first, card);
+    }
+    else
+    {
+        dist.siOption = option;
+        dist.si = expandNumbers(tokens, first, card);
+    }
+}
+
+void parseData(McnpDeck& deck, const std::string& card)
+{
+    static const std::regex materialCard("^M([0-9]+)$");
+    static const std::regex distributionCard("^S([IP])([0-9]+)$");
+    static const std::regex tallyCard("^F([0-9]+):([A-Z,]+)$");
+    static const std::regex energyCard("^E([0-9]+)$");
+    static const std::regex divisorCard("^SD([0-9]+)$");
+    static const std::regex transformCard("^\\*?TR([0-9]*)$");
+    static const std::regex cutCard("^CUT:([A-Z,]+)$");
+    std::vector<std::string> tokens = split(card);
+    if (tokens.empty())
+        return;
+    const std::string name = toUpper(tokens[0]);
+    std::smatch m;
+    if (name == "MODE")
+    {
+        if (tokens.size() > 1)
+            deck.mode = toUpper(tokens[1])[0];
+    }
+    else if (name == "NPS")
+    {
+        if (tokens.size() > 1)
+            deck.nps = static_cast<long long>(toDouble(tokens[1], card));
+    }
+    else if (std::regex_match(name, m, cutCard))
+    {
+        std::vector<double> values = expandNumbers(tokens, 1, card);
+        if (values.size() > 1 && !std::isnan(values[1]))
+        {
+            for (auto &&particle : m[1].str())
+            {
+                if (particle != ',')
+                    deck.cutoffEnergies[particle] = values[1];
+            }
+        }
+    }
+    else if (std::regex_match(name, m, transformCard))
+    {
+        parseTransform(deck, tokens, card);
+    }
+    else if (std::regex_match(name, m, materialCard))
+    {
+        parseMaterial(deck, tokens, card);
+    }
+    else if (name == "SDEF")
+    {
+        parseSource(deck, card);
+    }
+    else if (std::regex_match(name, m, distributionCard))
+    {
+        parseDistribution(deck, tokens, card, m[1].str() == "P");
+    }
+    else if (std::regex_match(name, m, tallyCard))
+    {
+        McnpDeck::TallyCard tally;
+        tally.number = std::stoi(m[1].str());
+        tally.particle = m[2].str()[0];
+        const bool pointTally = tally.number % 10 == 5;
+        for (std::size_t i = 1; i < tokens.size(); i++)
+        {
+            if (!isNumber(tokens[i]))
+                throw std::runtime_error((pointTally ? "only lists of points are supported in tally card: " : 
+                                                       "only lists of cells are supported in tally card: ") + card);
+            if (pointTally)
+                tally.points.push_back(std::stod(tokens[i]));
+            else
+                tally.cells.push_back(std::stoi(tokens[i]));
+        }
+        if (pointTally && (tally.points.empty() || tally.points.size() % 4 != 0))
+            throw std::runtime_error("F5 tallies need x y z R0 for each point: " + card);
+        deck.tallies.push_back(tally);
+    }
+    else if (std::regex_match(name, m, energyCard))
+    {
+        deck.energyBins[std::stoi(m[1].str())] = expandNumbers(tokens, 1, card);
+    }
+    else if (std::regex_match(name, m, divisorCard))
+    {
+        deck.segmentDivisors[std::stoi(m[1].str())] = expandNumbers(tokens, 1, card);
+    }
+}
+
+/**
+ * @brief Turn a vertical-format card ("# SI1 SP1" followed by rows) into horizontal cards
+ */
+std::vector<std::string> transposeVertical(const std::vector<std::string>& lines)
+{
+    std::vector<std::string> names = split(lines[0].substr(lines[0].find('#') + 1));
+    std::vector<std::string> cards(names);
+    for (std::size_t i = 1; i < lines.size(); i++)
+    {
+        std::vector<std::string> row = split(lines[i]);
+        if (row.size() != names.size())
+            throw std::runtime_error("row size doesn't match the header of vertical card: " + lines[0]);
+        for (std::size_t j = 0; j < row.size(); j++)
+            cards[j] += ' ' + row[j];
+    }
+    return cards;
+}
+}
+
+McnpDeck McnpDeck::parse(std::istream& input)
+{
+    static const std::regex commentLine("^ {0,4}[cC]( .*)?$");
+    McnpDeck deck;
+    // logical cards of each block, each card is a list of physical lines
+    std::vector<std::vector<std::string>> blocks[3];
+    int block(0);
+    bool continued(false);
+    std::string line;
+    std::getline(input, deck.title);
+    while (block < 3 && std::getline(input, line))
+    {
+        line.erase(std::remove(line.begin(), line.end(), '\r'), line.end());
+        std::replace(line.begin(), line.end(), '\t', ' ');
+        if (line.find_first_not_of(' ') == std::string::npos)
+        {
+            // blank line delimiter
+            block++;
+            continued = false;
+            continue;
+        }
+        if (std::regex_match(line, commentLine))
+            continue;
+        line = line.substr(0, line.find('$'));
+        const bool continuation = continued || line.compare(0, 5, "     ") == 0;
+        continued = false;
+        const std::size_t amp = line.find('&');
+        if (amp != std::string::npos)
+        {
+            line = line.substr(0, amp);
+            continued = true;
+        }
+        std::vector<std::vector<std::string>>& cards = blocks[block];
+        if (continuation && !cards.empty())
+            cards.back().push_back(line);
+        else
+            cards.push_back({line});
+    }
+
+    auto join = [](const std::vector<std::string>& lines) {
+        std::string card;
+        for (auto &&l : lines)
+            card += l + ' ';
+        return card;
+    };
+    for (auto &&card : blocks[0])
+        parseCell(deck, join(card));
+    for (auto &&card : blocks[1])
+        parseSurface(deck, join(card));
+    for (auto &&card : blocks[2])
+    {
+        if (card[0].find_first_not_of(' ') == card[0].find('#'))
+        {
+            for (auto &&c : transposeVertical(card))
+                parseData(deck, c);
+        }
+        else
+        {
+            parseData(deck, join(card));
+        }
+    }
+    return deck;
+}
+
+McnpDeck McnpDeck::parseFile(const std::string& fpath)
+{
+    std::ifstream fileptr(fpath);
+    if (!fileptr.is_open())
+    {
+        std::string errMessage = "can't open file: " + fpath;
+        throw std::runtime_error(errMessage);
+    }
+    return parse(fileptr);
+}
+
+const Nuclide& NuclideLibrary::getNuclide(const int zaid) const
+{
+    auto it = nuclides.find(zaid);
+    if (it == nuclides.end())
+        throw std::runtime_error("no data for nuclide " + std::to_string(zaid));
+    return it->second;
+}
+
+NuclideLibrary NuclideLibrary::loadDefault(const std::string& rootdir)
+{
+    const PhotonCrossSection photonCrossSection(rootdir+"/DATA/H2O.csv");
+    const NeutronCrossSection H1NeutronCrossSection(rootdir+"/DATA/H1-total-cross-section.txt",
+                                                    rootdir+"/DATA/H1-elastic-scattering-cross-section.txt");
+    const NeutronCrossSection O16NeutronCrossSection(rootdir+"/DATA/O16-total-cross-section.txt",
+                                                     rootdir+"/DATA/O16-elastic-scattering-cross-section.txt",
+                                                     rootdir+"/DATA/O16-elastic-scattering-PDF.txt",
+                                                     rootdir+"/DATA/O16-elastic-scattering-CDF.txt");
+    NuclideLibrary lib;
+    lib.addNuclide(1001, Nuclide(1, 1, H1NeutronCrossSection, photonCrossSection));
+    lib.addNuclide(8016, Nuclide(8, 16, O16NeutronCrossSection, photonCrossSection));
+    return lib;
+}
+
+std::shared_ptr<const Shape> McnpImporter::buildShape(const McnpDeck& deck, const int id)
+{
+    auto it = deck.surfaces.find(id);
+    if (it == deck.surfaces.end())
+        throw std::runtime_error("surface " + std::to_string(id) + " not found");
+    const McnpDeck::SurfaceCard& surface = it->second;
+    Transform tr;
+    if (surface.transform != 0)
+    {
+        auto t = deck.transforms.find(surface.transform);
+        if (t == deck.transforms.end())
+            throw std::runtime_error("transformation " + std::to_string(surface.transform) + " not found");
+        tr = t->second;
+    }
+    const std::vector<double>& p = surface.params;
+    auto requireParams = [&](const std::size_t n) {
+        if (p.size() != n)
+            throw std::runtime_error("surface " + std::to_string(id) + ": " + surface.type + " needs " + std::to_string(n) + " entries");
+    };
+    if (surface.type == "RCC")
+    {
+        requireParams(7);
+        return std::make_shared<Cylinder>(tr.toWorld(Vec3d(p[0], p[1], p[2])), tr.toWorldDirection(Vec3d(p[3], p[4], p[5])), p[6]);
+    }
+    if (surface.type == "RPP")
+    {
+        requireParams(6);
+        const Vec3d lower(p[0], p[2], p[4]);
+        const Vec3d upper(p[1], p[3], p[5]);
+        if (tr.isTranslation())
+            return std::make_shared<Box>(tr.toWorld(lower), tr.toWorld(upper));
+        return std::make_shared<Box>(Transform(tr.getLinear(), tr.toWorld(0.5 * (lower + upper))), 0.5 * (upper - lower));
+    }
+    if (surface.type == "BOX")
+    {
+        requireParams(12);
+        const Vec3d corner(p[0], p[1], p[2]);
+        const Vec3d a[3] = {Vec3d(p[3], p[4], p[5]), Vec3d(p[6], p[7], p[8]), Vec3d(p[9], p[10], p[11])};
+        const Mat3 frame = tr.getLinear() * Mat3(a[0].normalized(), a[1].normalized(), a[2].normalized());
+        return std::make_shared<Box>(Transform(frame, tr.toWorld(corner + 0.5 * (a[0] + a[1] + a[2]))),
+                                     0.5 * Vec3d(a[0].length(), a[1].length(), a[2].length()));
+    }
+    if (surface.type == "S" || surface.type == "SPH")
+    {
+        requireParams(4);
+        return std::make_shared<Sphere>(tr.toWorld(Vec3d(p[0], p[1], p[2])), p[3]);
+    }
+    if (surface.type == "SO")
+    {
+        requireParams(1);
+        return std::make_shared<Sphere>(tr.toWorld(Vec3d(0, 0, 0)), p[0]);
+    }
+    throw std::runtime_error("surface " + std::to_string(id) + ": " + surface.type +
+                             " is not supported, use the macrobodies RCC, RPP, BOX or the spheres S, SO, SPH");
+}
+
+std::shared_ptr<const Material> McnpImporter::getMaterial(const McnpDeck& deck, const int id, const double density, double& massDensity)
+{
+    auto it = deck.materials.find(id);
+    if (it == deck.materials.end())
+        throw std::runtime_error("material " + std::to_string(id) + " not found");
+    const auto& components = it->second.components;
+    // number of atoms of each nuclide per "molecule", Material derives the molecular mass from them
+    std::vector<std::pair<double, Nuclide>> comp;
+    double atoms(0);
+    double mass(0);
+    std::ostringstream key;
+    key.precision(17);
+    for (auto &&c : components)
+    {
+        if ((c.second < 0) != (components[0].second < 0))
+            throw std::runtime_error("material " + std::to_string(id) + " mixes atom and weight fractions");
+        const Nuclide& nuclide = library.getNuclide(c.first);
+        const double n = c.second < 0 ? -c.second / nuclide.getAtomicWeight() : c.second;
+        comp.push_back({n, nuclide});
+        atoms += n;
+        mass += n * nuclide.getAtomicWeight();
+        key << c.first << ':' << c.second << ' ';
+    }
+    if (comp.empty())
+        throw std::runtime_error("material " + std::to_string(id) + " is empty");
+    // atom density (atoms/b-cm) to mass density
+    massDensity = density < 0 ? -density : density * mass / atoms / avogadro;
+    key << "rho " << massDensity;
+
+    auto cached = materials.find(key.str());
+    if (cached != materials.end())
+        return cached->second;
+    auto material = std::make_shared<const Material>(massDensity, id, comp);
+    materials[key.str()] = material;
+    return material;
+}
+
+std::shared_ptr<const McnpDeck> McnpImporter::getDeck(const std::string& fpath)
+{
+    const std::string path = std::filesystem::absolute(fpath).lexically_normal().string();
+    std::error_code ec;
+    const auto writeTime = std::filesystem::last_write_time(path, ec);
+    if (ec)
+        throw std::runtime_error("can't open file: " + fpath);
+    auto it = decks.find(path);
+    if (it != decks.end() && it->second.writeTime == writeTime)
+        return it->second.deck;
+    auto deck = std::make_shared<const McnpDeck>(McnpDeck::parseFile(path));
+    decks[path] = CachedDeck{writeTime, deck};
+    return deck;
+}
+
+McnpProblem McnpImporter::import(const std::string& fpath, const McnpImportOptions& options)
+{
+    return build(*getDeck(fpath), options);
+}
+
+namespace
+{
+/**
+ * @brief Get the distribution referenced by an SDEF value "Dn"
+ */
+const McnpDeck::Distribution* getDistribution(const McnpDeck& deck, const std::string& key)
+{
+    auto it = deck.source.find(key);
+    if (it == deck.source.end() || it->second.empty())
+        return nullptr;
+    const std::string& value = it->second[0];
+    if (value[0] != 'D' || !isNumber(value.substr(1)))
+        throw std::runtime_error("SDEF " + key + " must refer to a distribution, Dn");
+    auto dist = deck.distributions.find(std::stoi(value.substr(1)));
+    if (dist == deck.distributions.end())
+        throw std::runtime_error("SDEF " + key + ": distribution " + value.substr(1) + " not found");
+    return &dist->second;
+}
+
+/**
+ * @brief Range [lower, upper] of a power-law distribution SP -21 a, checking the exponent a
+ */
+void getPowerLawRange(const McnpDeck::Distribution& dist, const std::string& key, const double exponent, double& lower, double& upper)
+{
+    const double a = dist.sp.empty() ? exponent : dist.sp[0];
+    if ((!dist.spOption.empty() && dist.spOption != "-21") || a != exponent || dist.si.size() != 2)
+        throw std::runtime_error("SDEF " + key + ": only SI a b with SP -21 " + std::to_string(int(exponent)) + " is supported here");
+    lower = dist.si[0];
+    upper = dist.si[1];
+}
+
+Vec3d getSourceVector(const McnpDeck& deck, const std::string& key, const Vec3d& def)
+{
+    auto it = deck.source.find(key);
+    if (it == deck.source.end())
+        return def;
+    if (it->second.size() != 3)
+        throw std::runtime_error("SDEF " + key + " needs 3 entries");
+    return Vec3d(toDouble(it->second[0], "SDEF"), toDouble(it->second[1], "SDEF"), toDouble(it->second[2], "SDEF"));
+}
+
+std::shared_ptr<const Shape> buildSourceShape(const McnpDeck& deck)
+{
+    const Vec3d pos = getSourceVector(deck, "POS", Vec3d(0, 0, 0));
+    const McnpDeck::Distribution* rad = getDistribution(deck, "RAD");
+    const McnpDeck::Distribution* ext = getDistribution(deck, "EXT");
+    if (!rad)
+    {
+        if (ext)
+            throw std::runtime_error("SDEF EXT without RAD is not supported");
+        // point source
+        return std::make_shared<Sphere>(pos, 0);
+    }
+    double rLower, rUpper;
+    if (deck.source.count("AXS") == 0)
+    {
+        if (ext)
+            throw std::runtime_error("SDEF EXT needs AXS");
+        getPowerLawRange(*rad, "RAD", 2, rLower, rUpper);
+        if (rLower != 0)
+            throw std::runtime_error("spherical shell sources are not supported");
+        return std::make_shared<Sphere>(pos, rUpper);
+    }
+    if (!ext)
+        throw std::runtime_error("SDEF disk sources (AXS and RAD without EXT) are not supported");
+    getPowerLawRange(*rad, "RAD", 1, rLower, rUpper);
+    if (rLower != 0)
+        throw std::runtime_error("annular cylinder sources are not supported");
+    double zLower, zUpper;
+    getPowerLawRange(*ext, "EXT", 0, zLower, zUpper);
+    const Vec3d axis = getSourceVector(deck, "AXS", Vec3d(0, 0, 1)).normalized();
+    return std::make_shared<Cylinder>(pos + zLower * axis, (zUpper - zLower) * axis, rUpper);
+}
+
+/**
+ * @brief Inverse CDF of the source energy with equal-probable bins, as required by Source
+ */
+std::vector<double> buildSourceEnergies(const McnpDeck& deck, const double scale)
+{
+    auto it = deck.source.find("ERG");
+    if (it == deck.source.end() || it->second.empty())
+        return {14 * scale}; // MCNP default
+    if (isNumber(it->second[0]))
+        return {toDouble(it->second[0], "SDEF") * scale};
+    const McnpDeck::Distribution& dist = *getDistribution(deck, "ERG");
+    if (dist.siOption == "L")
+    {
+        if (dist.si.size() != 1)
+            throw std::runtime_error("SDEF ERG: only a single discrete line is supported");
+        return {dist.si[0] * scale};
+    }
+    if ((!dist.siOption.empty() && dist.siOption != "H") || (!dist.spOption.empty() && dist.spOption != "D"))
+        throw std::runtime_error("SDEF ERG: only SI H / SP D histograms are supported");
+    const std::vector<double>& edges = dist.si;
+    if (edges.size() < 2 || dist.sp.size() != edges.size())
+        throw std::runtime_error("SDEF ERG: SI and SP must have the same number of entries");
+    // first SP entry of a histogram is ignored
+    std::vector<double> cdf{0};
+    for (std::size_t i = 1; i < dist.sp.size(); i++)
+        cdf.push_back(cdf.back() + dist.sp[i]);
+    bool equal = true;
+    for (std::size_t i = 2; i < dist.sp.size(); i++)
+        equal = equal && std::abs(dist.sp[i] - dist.sp[1]) <= 1e-9 * dist.sp[1];
+    std::vector<double> invCDF;
+    if (equal)
+    {
+        for (auto &&e : edges)
+            invCDF.push_back(e * scale);
+        return invCDF;
+    }
+    // resample the piecewise-linear CDF on an equal-probable grid
+    const int nbins = 1000;
+    std::size_t bin = 0;
+    for (int i = 0; i <= nbins; i++)
+    {
+        const double c = cdf.back() * i / nbins;
+        while (bin + 2 < cdf.size() && cdf[bin + 1] < c)
+            bin++;
+        const double width = cdf[bin + 1] - cdf[bin];
+        const double f = width > 0 ? (c - cdf[bin]) / width : 0;
+        invCDF.push_back((edges[bin] + f * (edges[bin + 1] - edges[bin])) * scale);
+    }
+    return invCDF;
+}
+
+/**
+ * @brief Build a tally with the energy bins of an E card, the first MCNP bin starts at 0
+ */
+Tally buildTally(const Detector& detector, const std::vector<double>& bounds, const double maxE)
+{
+    if (bounds.empty())
+        return Tally(detector, 1, 0, std::nextafter(maxE, std::numeric_limits<double>::infinity()));
+    std::vector<double> edges;
+    if (bounds[0] > 0)
+        edges.push_back(0);
+    edges.insert(edges.end(), bounds.begin(), bounds.end());
+    for (std::size_t i = 1; i < edges.size(); i++)
+    {
+        if (!(edges[i] > edges[i - 1]))
+            throw std::runtime_error("energy bounds must be increasing");
+    }
+    // shown on a log energy axis if the bounds after the first bin are evenly spaced in log
+    bool logarithmic = bounds.size() > 2 && bounds[0] > 0;
+    if (logarithmic)
+    {
+        const std::size_t n = bounds.size();
+        const double logSpacing = std::log(bounds[n - 1] / bounds[0]) / (n - 1);
+        for (std::size_t i = 0; i < n; i++)
+            logarithmic = logarithmic && std::abs(std::log(bounds[i] / bounds[0]) - i * logSpacing) <= 1e-6 * std::abs(logSpacing) * n;
+    }
+    return Tally(detector, edges, logarithmic);
+}
+}
+
+McnpProblem McnpImporter::build(const McnpDeck& deck, const McnpImportOptions& options)
+{
+    // particle type and energy unit
+    char particle = deck.mode;
+    auto par = deck.source.find("PAR");
+    if (par != deck.source.end() && !par->second.empty())
+    {
+        const std::string& p = par->second[0];
+        particle = p == "1" ? 'N' : p == "2" ? 'P' : p[0];
+    }
+    if (particle != 'N' && particle != 'P')
+        throw std::runtime_error(std::string("source particle ") + particle + " is not supported");
+    const Particle::ParticleType type = particle == 'N' ? Particle::Neutron : Particle::Photon;
+    // MeV for photons, eV for neutrons
+    const double scale = particle == 'N' ? 1e6 : 1;
+
+    // cells with a material, a cell excluding another of the same material is merged with it
+    std::vector<const McnpDeck::CellCard*> filled;
+    for (auto &&c : deck.cells)
+    {
+        if (c.material != 0)
+            filled.push_back(&c);
+    }
+    std::vector<bool> merged(filled.size(), false);
+    for (auto &&c : filled)
+    {
+        if (c->complexGeometry)
+            throw std::runtime_error("cell " + std::to_string(c->id) + ": only intersections of surfaces are supported");
+        if (std::count_if(c->surfaces.begin(), c->surfaces.end(), [](int s) {return s < 0;}) != 1)
+            throw std::runtime_error("cell " + std::to_string(c->id) + " must be inside exactly one body");
+        for (auto &&s : c->surfaces)
+        {
+            if (s < 0)
+                continue;
+            bool found = false;
+            for (std::size_t j = 0; j < filled.size(); j++)
+            {
+                const McnpDeck::CellCard* other = filled[j];
+                if (other->surfaces == std::vector<int>{-s} && other->material == c->material && other->density == c->density)
+                {
+                    merged[j] = true;
+                    found = true;
+                }
+            }
+            if (!found)
+                throw std::runtime_error("cell " + std::to_string(c->id) + ": excluding body " + std::to_string(s) +
+                                         " is only supported when it is filled with the same material");
+        }
+    }
+    std::vector<const McnpDeck::CellCard*> regions;
+    for (std::size_t i = 0; i < filled.size(); i++)
+    {
+        if (!merged[i])
+            regions.push_back(filled[i]);
+    }
+    if (regions.size() != 1)
+        throw std::runtime_error("tracking supports a single material region, found " + std::to_string(regions.size()));
+    const McnpDeck::CellCard& region = *regions[0];
+    int body(0);
+    for (auto &&s : region.surfaces)
+    {
+        if (s < 0)
+            body = -s;
+    }
+    std::shared_ptr<const Shape> roi = buildShape(deck, body);
+    double massDensity;
+    std::shared_ptr<const Material> material = getMaterial(deck, region.material, region.density, massDensity);
+    const Cell cell(*material, massDensity, roi);
+
+    // source
+    const std::vector<double> energies = buildSourceEnergies(deck, scale);
+    const Source source(buildSourceShape(deck), energies, type);
+
+    // settings
+    long long maxN = options.maxN > 0 ? options.maxN : deck.nps;
+    if (maxN <= 0)
+        throw std::runtime_error("number of histories not given, use an NPS card or McnpImportOptions::maxN");
+    if (maxN > std::numeric_limits<int>::max())
+        throw std::runtime_error("NPS is too large: " + std::to_string(maxN));
+    auto cut = deck.cutoffEnergies.find(particle);
+    // MCNP default cutoffs, 1 keV for photons and 0 for neutrons
+    const double minE = (cut != deck.cutoffEnergies.end() ? cut->second : (particle == 'P' ? 1e-3 : 0)) * scale;
+
+    McnpProblem problem;
+    problem.config = std::make_shared<const MCSettings>(roi, std::vector<Cell>{cell}, source, int(maxN),
+                                                        options.maxScatterN, options.minW, minE);
+
+    // F4 tallies on spheres, cylinders and boxes, F5 tallies on points
+    const double maxE = *std::max_element(energies.begin(), energies.end());
+    for (auto &&t : deck.tallies)
+    {
+        if (t.number % 10 != 4 && t.number % 10 != 5)
+            throw std::runtime_error("F" + std::to_string(t.number) + ": only F4 and F5 tallies are supported");
+        if (t.particle != particle)
+            throw std::runtime_error("F" + std::to_string(t.number) + ": tally particle doesn't match the source particle");
+        std::vector<double> bounds;
+        auto e = deck.energyBins.find(t.number);
+        if (e == deck.energyBins.end())
+            e = deck.energyBins.find(0);
+        if (e != deck.energyBins.end())
+        {
+            for (auto &&b : e->second)
+                bounds.push_back(b * scale);
+        }
+        for (std::size_t i = 0; i < t.points.size(); i += 4)
+        {
+            const double* p = &t.points[i];
+            if (p[3] < 0)
+                throw std::runtime_error("F" + std::to_string(t.number) + ": exclusion radii in mean free paths are not supported");
+            problem.tallies.push_back(buildTally(Detector(Vec3d(p[0], p[1], p[2]), p[3]), bounds, maxE));
+            problem.tallyNumbers.push_back(t.number);
+        }
+        auto sd = deck.segmentDivisors.find(t.number);
+        for (std::size_t i = 0; i < t.cells.size(); i++)
+        {
+            auto c = std::find_if(deck.cells.begin(), deck.cells.end(), [&](const McnpDeck::CellCard& cc) {return cc.id == t.cells[i];});
+            if (c == deck.cells.end())
+                throw std::runtime_error("F" + std::to_string(t.number) + ": cell " + std::to_string(t.cells[i]) + " not found");
+            std::shared_ptr<const Shape> shape;
+            if (!c->complexGeometry && c->surfaces.size() == 1 && c->surfaces[0] < 0)
+                shape = buildShape(deck, -c->surfaces[0]);
+            std::unique_ptr<Detector> detector;
+            if (auto sphere = std::dynamic_pointer_cast<const Sphere>(shape))
+                detector = std::make_unique<Detector>(*sphere);
+            else if (auto cylinder = std::dynamic_pointer_cast<const Cylinder>(shape))
+                detector = std::make_unique<Detector>(*cylinder);
+            else if (auto box = std::dynamic_pointer_cast<const Box>(shape))
+                detector = std::make_unique<Detector>(*box);
+            else
+                throw std::runtime_error("F" + std::to_string(t.number) + ": cell " + std::to_string(c->id) + 
+                                         " must be the inside of a sphere, an RCC, an RPP or a BOX");
+            problem.tallies.push_back(buildTally(*detector, bounds, maxE));
+            problem.tallyNumbers.push_back(t.number);
+            // the flux is divided by the detector volume unless the SD card gives another value
+            if (sd != deck.segmentDivisors.end() && i < sd->second.size() && !std::isnan(sd->second[i]))
+                problem.tallies.back().setVolume(sd->second[i]);
+        }
+    }
+    return problem;
+}
@@ -0,0 +1,112 @@
+#include "pathfield.h"
+#include <algorithm>
+
+PathLengthField::PathLengthField(const MCSettings& config, const Vec3d& t, const int nx, const int ny, const int nz)
+    : target(t), nodes{nx, ny, nz}, cellsNum(config.cells.size())
+{
+    // bounding box of the ROI
+    Vec3d upperCorner;
+    config.ROI->getBoundingBox(lowerCorner, upperCorner);
+    const Vec3d extent = upperCorner - lowerCorner;
+    for (int i = 0; i < 3; i++)
+    {
+        spacing[i] = extent[i] / std::max(nodes[i] - 1, 1);
+    }
+
+    lengths.resize(std::size_t(nx) * ny * nz * cellsNum);
+    std::vector<double> nodeLengths;
+    for (int i = 0; i < nx; i++)
+    {
+        for (int j = 0; j < ny; j++)
+        {
+            for (int k = 0; k < nz; k++)
+            {
+                Vec3d node = lowerCorner + Vec3d(i * spacing[0], j * spacing[1], k * spacing[2]);
+                config.getCellPathLengths(node, target, nodeLengths);
+                std::copy(nodeLengths.begin(), nodeLengths.end(), 
+                          lengths.begin() + ((std::size_t(i) * ny + j) * nz + k) * cellsNum);
+            }
+        }
+    }
+}
+
+void PathLengthField::getPathLengths(const Vec3d& pos, std::vector<double>& lengthsOut) const
+{
+    // index of the lower node and fractional position in the grid cell
+    int idx[3];
+    double frac[3];
+    const Vec3d rel = pos - lowerCorner;
+    for (int i = 0; i < 3; i++)
+    {
+        if (nodes[i] < 2)
+        {
+            idx[i] = 0;
+            frac[i] = 0;
+            continue;
+        }
+        double x = std::min(std::max(rel[i] / spacing[i], 0.0), double(nodes[i] - 1));
+        idx[i] = std::min(static_cast<int>(x), nodes[i] - 2);
+        frac[i] = x - idx[i];
+    }
+    const int stride[3] = {nodes[1] * nodes[2] * cellsNum, nodes[2] * cellsNum, cellsNum};
+    const double* base = lengths.data() + idx[0] * stride[0] + idx[1] * stride[1] + idx[2] * stride[2];
+
+    lengthsOut.assign(cellsNum, 0);
+    for (int corner = 0; corner < 8; corner++)
+    {
+        double w = 1;
+        std::size_t offset = 0;
+        for (int i = 0; i < 3; i++)
+        {
+            if (corner & (1 << i))
+            {
+                if (nodes[i] < 2)
+                {
+                    w = 0;
+                    break;
+                }
+                w *= frac[i];
+                offset += stride[i];
+            }
+            else
+            {
+                w *= 1 - frac[i];
+            }
+        }
+        if (w == 0)
+            continue;
+        for (int c = 0; c < cellsNum; c++)
+        {
+            lengthsOut[c] += w * base[offset + c];
+        }
+    }
+}
+
+double PathLengthField::getMaxError(const MCSettings& config, const int samples) const
+{
+    const Shape& roi = *config.ROI;
+    Vec3d lower, upper;
+    roi.getBoundingBox(lower, upper);
+    const Vec3d extent = upper - lower;
+    std::vector<double> exact;
+    std::vector<double> interpolated;
+    double maxError(0);
+    int n(0);
+    while (n < samples)
+    {
+        Vec3d pos = lower + Vec3d(
+            GlobalUniformRandNumGenerator::GetInstance().generateDouble() * extent.x(),
+            GlobalUniformRandNumGenerator::GetInstance().generateDouble() * extent.y(),
+            GlobalUniformRandNumGenerator::GetInstance().generateDouble() * extent.z());
+        if (!roi.contain(pos))
+            continue;
+        n++;
+        config.getCellPathLengths(pos, target, exact);
+        getPathLengths(pos, interpolated);
+        for (int c = 0; c < cellsNum; c++)
+        {
+            maxError = std::max(maxError, std::abs(exact[c] - interpolated[c]));
+        }
+    }
+    return maxError;
+}
@@ -0,0 +1,275 @@
+#include "perturbation.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+static double parseNumber(const std::string& field, const std::string& entry)
+{
+    std::size_t end(0);
+    double value(0);
+    try
+    {
+        value = std::stod(field, &end);
+    }
+    catch (const std::exception&)
+    {
+        end = 0;
+    }
+    if (end == 0 || end != field.size())
+        throw std::runtime_error("Invalid number in material perturbation: " + entry);
+    return value;
+}
+
+/**
+ * @brief Sum over all bins of all tallies
+ */
+static double getTotal(const std::vector<Tally>& tallies)
+{
+    double total(0);
+    for (auto &&tally : tallies)
+    {
+        for (int i = 0; i < tally.getNBins(); i++)
+            total += tally.getBinContent(i);
+    }
+    return total;
+}
+
+static double getTotalAtten(const Material& material, const double energy, const Particle::ParticleType type)
+{
+    return type == Particle::Photon ? material.getPhotonTotalAtten(energy) : material.getNeutronTotalAtten(energy);
+}
+
+MaterialPerturbation::MaterialPerturbation(const double densityFactor_, const std::vector<double>& fractionFactors_)
+    : densityFactor(densityFactor_), fractionFactors(fractionFactors_)
+{
+    if (!(densityFactor > 0))
+        throw std::runtime_error("The density factor of a material perturbation must be positive.");
+    if (std::any_of(fractionFactors.begin(), fractionFactors.end(), [](double f) {return !(f >= 0);}))
+        throw std::runtime_error("The fraction factors of a material perturbation must not be negative.");
+}
+
+std::vector<MaterialPerturbation> MaterialPerturbation::parse(const std::string& spec)
+{
+    std::vector<MaterialPerturbation> perturbations;
+    std::istringstream entries(spec);
+    std::string entry;
+    while (std::getline(entries, entry, ','))
+    {
+        double density(1);
+        std::vector<double> fractions;
+        std::istringstream changes(entry);
+        std::string change;
+        while (std::getline(changes, change, '+'))
+        {
+            std::istringstream fields(change);
+            std::string name, field;
+            std::getline(fields, name, ':');
+            std::vector<std::string> values;
+            while (std::getline(fields, field, ':'))
+                values.push_back(field);
+            if (name == "density" && values.size() == 1)
+            {
+                density *= parseNumber(values[0], entry);
+            }
+            else if (name == "fraction" && values.size() == 2)
+            {
+                const double index = parseNumber(values[0], entry);
+                if (index < 0 || index != std::floor(index))
+                    throw std::runtime_error("Invalid nuclide index in material perturbation: " + entry);
+                if (fractions.size() <= index)
+                    fractions.resize(index + 1, 1);
+                fractions[index] *= parseNumber(values[1], entry);
+            }
+            else
+            {
+                throw std::runtime_error("Expected density:<factor> or fraction:<nuclide index>:<factor> in material perturbation: " + entry);
+            }
+        }
+        perturbations.emplace_back(density, fractions);
+    }
+    return perturbations;
+}
+
+Material MaterialPerturbation::apply(const Material& material) const
+{
+    std::vector<std::pair<double, Nuclide>> compositions = material.getNuclideComposition();
+    if (fractionFactors.size() > compositions.size())
+        throw std::runtime_error("The material of a perturbation has " + std::to_string(compositions.size()) + " nuclides only.");
+    for (std::size_t i = 0; i < fractionFactors.size(); i++)
+        compositions[i].first *= fractionFactors[i];
+    return Material(material.getDensity() * densityFactor, material.getID(), compositions);
+}
+
+std::unique_ptr<MCSettings> MaterialPerturbation::apply(const MCSettings& config) const
+{
+    std::vector<Cell> cells{Cell(config.cells[0], apply(config.cells[0].material))};
+    for (std::size_t i = 1; i < config.cells.size(); i++)
+        cells.push_back(config.cells[i]);
+    return std::make_unique<MCSettings>(config.ROI, cells, config.source, config.maxN, config.maxScatterN, config.minW, config.minE);
+}
+
+std::string MaterialPerturbation::getName() const
+{
+    std::ostringstream name;
+    if (densityFactor != 1 || fractionFactors.empty())
+        name << "density:" << densityFactor;
+    for (std::size_t i = 0; i < fractionFactors.size(); i++)
+    {
+        if (fractionFactors[i] == 1)
+            continue;
+        if (name.tellp() > 0)
+            name << '+';
+        name << "fraction:" << i << ':' << fractionFactors[i];
+    }
+    return name.str();
+}
+
+PerturbationTallies::PerturbationTallies(const MCSettings& config_, const std::vector<Tally>& tallies, const std::vector<MaterialPerturbation>& perturbations_)
+    : config(config_), perturbations(perturbations_), perturbedTallies(perturbations_.size(), tallies),
+      historyTallies(perturbations_.size() + 1, tallies), ratios(perturbations_.size(), 1),
+      perturbedSums(perturbations_.size(), 0), perturbedSquaredSums(perturbations_.size(), 0),
+      differenceSums(perturbations_.size(), 0), differenceSquaredSums(perturbations_.size(), 0)
+{
+    for (auto &&perturbation : perturbations)
+        configs.push_back(perturbation.apply(config));
+    for (auto &&group : perturbedTallies)
+    {
+        for (auto &&tally : group)
+            tally.reset();
+    }
+    for (auto &&group : historyTallies)
+    {
+        for (auto &&tally : group)
+            tally.reset();
+    }
+}
+
+void PerturbationTallies::runHistory(Particle source, std::vector<Tally>& tallies, const ExponentialTransform* transform, const bool scoreSource)
+{
+    if (tallies.size() != historyTallies[0].size())
+        throw std::runtime_error("Perturbation tallies were constructed with other tallies.");
+    Particle& prtl = source;
+    std::fill(ratios.begin(), ratios.end(), 1.0);
+    // one subsampling decision per event for all materials, like forceDetection
+    auto score = [this, &prtl]() {
+        if (!sampleEventScoring(prtl))
+            return;
+        forceDetectionSampled(prtl, config, historyTallies[0]);
+        for (std::size_t k = 0; k < ratios.size(); k++)
+        {
+            if (ratios[k] == 0)
+                continue;
+            Particle perturbed(prtl);
+            perturbed.weight *= ratios[k];
+            forceDetectionSampled(perturbed, *configs[k], historyTallies[k + 1]);
+        }
+    };
+    if (scoreSource)
+        score();
+    const Material& material = config.cells[0].material;
+    while (prtl.scatterN < config.maxScatterN && prtl.ergE > config.minE && prtl.weight > config.minW)
+    {
+        const Vec3d start = prtl.pos;
+        if (!deltaTracking(prtl, config, transform))
+            break;
+        // flight to the collision, whose distance is distributed as mu exp(-mu s) whatever the majorant,
+        // the virtual collisions rejected on the way are not part of the ratio
+        const double distance = (prtl.pos - start).length();
+        const double mu = getTotalAtten(material, prtl.ergE, prtl.particleType);
+        for (std::size_t k = 0; k < ratios.size(); k++)
+        {
+            const double ratio = getTotalAtten(configs[k]->cells[0].material, prtl.ergE, prtl.particleType) / mu;
+            ratios[k] *= ratio * std::exp(-(ratio - 1) * mu * distance);
+        }
+        prtl.scatterN += 1;
+        score();
+        const double energy = prtl.ergE;
+        const int nuclide = scattering(prtl, config);
+        // choice of the target nuclide
+        if (prtl.particleType != Particle::Neutron)
+            continue;
+        for (std::size_t k = 0; k < ratios.size(); k++)
+        {
+            ratios[k] *= configs[k]->cells[0].material.getInteractionProbability(energy, nuclide)
+                         / material.getInteractionProbability(energy, nuclide);
+        }
+    }
+
+    histories++;
+    const double total = ::getTotal(historyTallies[0]);
+    sum += total;
+    squaredSum += total * total;
+    for (std::size_t t = 0; t < tallies.size(); t++)
+    {
+        tallies[t].add(historyTallies[0][t]);
+        historyTallies[0][t].reset();
+    }
+    for (std::size_t k = 0; k < perturbations.size(); k++)
+    {
+        const double perturbedTotal = ::getTotal(historyTallies[k + 1]);
+        perturbedSums[k] += perturbedTotal;
+        perturbedSquaredSums[k] += perturbedTotal * perturbedTotal;
+        differenceSums[k] += perturbedTotal - total;
+        differenceSquaredSums[k] += (perturbedTotal - total) * (perturbedTotal - total);
+        for (std::size_t t = 0; t < tallies.size(); t++)
+        {
+            perturbedTallies[k][t].add(historyTallies[k + 1][t]);
+            historyTallies[k + 1][t].reset();
+        }
+    }
+}
+
+double PerturbationTallies::getVarianceOfMean(const double sum, const double squaredSum, const long long n)
+{
+    if (n < 2)
+        return 0;
+    const double mean = sum / n;
+    return std::max(0.0, squaredSum / n - mean * mean) / (n - 1);
+}
+
+double PerturbationTallies::getTotal() const
+{
+    return histories > 0 ? sum / histories : 0;
+}
+
+double PerturbationTallies::getTotal(const int k) const
+{
+    return histories > 0 ? perturbedSums[k] / histories : 0;
+}
+
+double PerturbationTallies::getTotalError(const int k) const
+{
+    return std::sqrt(getVarianceOfMean(perturbedSums[k], perturbedSquaredSums[k], histories));
+}
+
+double PerturbationTallies::getDifference(const int k) const
+{
+    return histories > 0 ? differenceSums[k] / histories : 0;
+}
+
+double PerturbationTallies::getDifferenceError(const int k) const
+{
+    return std::sqrt(getVarianceOfMean(differenceSums[k], differenceSquaredSums[k], histories));
+}
+
+double PerturbationTallies::getIndependentDifferenceError(const int k) const
+{
+    return std::sqrt(getVarianceOfMean(sum, squaredSum, histories) + getVarianceOfMean(perturbedSums[k], perturbedSquaredSums[k], histories));
+}
+
+void PerturbationTallies::reset()
+{
+    for (auto &&group : perturbedTallies)
+    {
+        for (auto &&tally : group)
+            tally.reset();
+    }
+    histories = 0;
+    sum = 0;
+    squaredSum = 0;
+    std::fill(perturbedSums.begin(), perturbedSums.end(), 0);
+    std::fill(perturbedSquaredSums.begin(), perturbedSquaredSums.end(), 0);
+    std::fill(differenceSums.begin(), differenceSums.end(), 0);
+    std::fill(differenceSquaredSums.begin(), differenceSquaredSums.end(), 0);
+}
@@ -0,0 +1,123 @@
+#include "qmc.h"
+#include <stdexcept>
+#include <string>
+
+// primitive polynomials and initial direction numbers of dimensions 2 to 16, Joe and Kuo (2008):
+// degree s, coefficients a, odd m_1, ..., m_s
+struct SobolPolynomial
+{
+    int degree;
+    std::uint32_t coefficients;
+    std::uint32_t initial[6];
+};
+static const SobolPolynomial polynomials[ScrambledSobol::maxDimensions - 1] = {
+    {1, 0, {1}},
+    {2, 1, {1, 3}},
+    {3, 1, {1, 3, 1}},
+    {3, 2, {1, 1, 1}},
+    {4, 1, {1, 1, 3, 3}},
+    {4, 4, {1, 3, 5, 13}},
+    {5, 2, {1, 1, 5, 5, 17}},
+    {5, 4, {1, 1, 5, 5, 5}},
+    {5, 7, {1, 1, 7, 11, 19}},
+    {5, 11, {1, 1, 5, 1, 1}},
+    {5, 13, {1, 1, 1, 3, 11}},
+    {5, 14, {1, 3, 5, 5, 31}},
+    {6, 1, {1, 3, 3, 9, 7, 49}},
+    {6, 13, {1, 1, 1, 15, 21, 21}},
+    {6, 16, {1, 3, 1, 13, 27, 49}}
+};
+
+/**
+ * @brief 64-bit mixing function of splitmix64, maps different inputs to unrelated outputs
+ */
+static std::uint64_t mix(std::uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static std::uint32_t reverseBits(std::uint32_t x)
+{
+    x = ((x >> 1) & 0x55555555u) | ((x & 0x55555555u) << 1);
+    x = ((x >> 2) & 0x33333333u) | ((x & 0x33333333u) << 2);
+    x = ((x >> 4) & 0x0f0f0f0fu) | ((x & 0x0f0f0f0fu) << 4);
+    x = ((x >> 8) & 0x00ff00ffu) | ((x & 0x00ff00ffu) << 8);
+    return (x >> 16) | (x << 16);
+}
+
+/**
+ * @brief Nested uniform (Owen) scrambling, hashed as in Burley (2020): with the bits reversed, the Laine-Karras
+ *        permutation flips each bit depending only on the seed and the bits below it, i.e. above it in the point
+ */
+static std::uint32_t owenScramble(std::uint32_t x, const std::uint32_t seed)
+{
+    x = reverseBits(x);
+    x += seed;
+    x ^= x * 0x6c50b47cu;
+    x ^= x * 0xb82f1e52u;
+    x ^= x * 0xc7afe638u;
+    x ^= x * 0x8d22f6e6u;
+    return reverseBits(x);
+}
+
+ScrambledSobol::ScrambledSobol(const int dimensions_, const std::uint64_t seed_)
+    : dimensions(dimensions_), seed(seed_), directions(dimensions_ > 0 ? dimensions_ : 0), buffer(directions.size())
+{
+    if (dimensions < 1 || dimensions > maxDimensions)
+        throw std::runtime_error("Sobol sequences are available for 1 to " + std::to_string(maxDimensions) + " dimensions.");
+    // first dimension, van der Corput sequence
+    for (int k = 0; k < 32; k++)
+        directions[0][k] = std::uint32_t(1) << (31 - k);
+    for (int d = 1; d < dimensions; d++)
+    {
+        const SobolPolynomial& polynomial = polynomials[d - 1];
+        const int s = polynomial.degree;
+        std::array<std::uint32_t, 32>& v = directions[d];
+        for (int k = 0; k < 32; k++)
+        {
+            if (k < s)
+            {
+                v[k] = polynomial.initial[k] << (31 - k);
+                continue;
+            }
+            v[k] = v[k - s] ^ (v[k - s] >> s);
+            for (int l = 1; l < s; l++)
+            {
+                if ((polynomial.coefficients >> (s - 1 - l)) & 1)
+                    v[k] ^= v[k - l];
+            }
+        }
+    }
+    for (int d = 0; d < dimensions; d++)
+        dimensionSeeds.push_back(mix(mix(seed) ^ static_cast<std::uint64_t>(d)));
+}
+
+void ScrambledSobol::getPoint(const std::uint32_t index, std::vector<double>& point) const
+{
+    point.resize(dimensions);
+    for (int d = 0; d < dimensions; d++)
+    {
+        std::uint32_t x(0);
+        for (int k = 0; k < 32 && (index >> k); k++)
+        {
+            if ((index >> k) & 1)
+                x ^= directions[d][k];
+        }
+        // center of the 2^-32 cell, never 0 or 1
+        point[d] = (owenScramble(x, static_cast<std::uint32_t>(dimensionSeeds[d])) + 0.5) / 4294967296.0;
+    }
+}
+
+void ScrambledSobol::startHistory(const std::uint32_t index)
+{
+    getPoint(index, buffer);
+    GlobalUniformRandNumGenerator::GetInstance().setLeadingValues(buffer);
+}
+
+void ScrambledSobol::stopHistory()
+{
+    GlobalUniformRandNumGenerator::GetInstance().setLeadingValues({});
+}
@@ -0,0 +1,242 @@
+#include "response.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <tuple>
+
+/**
+ * @brief Check that bin edges are increasing
+ */
+static void checkEdges(const std::vector<double>& edges, const std::string& name)
+{
+    if (edges.size() < 2)
+        throw std::runtime_error(name + " bins need at least 2 edges.");
+    for (std::size_t i = 1; i < edges.size(); i++)
+    {
+        if (!(edges[i] > edges[i - 1]))
+            throw std::runtime_error(name + " bin edges must be increasing.");
+    }
+}
+
+ResponseMatrix::ResponseMatrix(const std::vector<double>& incidentEdges_, const std::vector<double>& pulseHeightEdges_,
+                               const std::vector<Entry>& entries, const int blockSize_)
+    : incidentEdges(incidentEdges_), pulseHeightEdges(pulseHeightEdges_), blockSize(blockSize_)
+{
+    checkEdges(incidentEdges, "Incident energy");
+    checkEdges(pulseHeightEdges, "Pulse-height");
+    if (blockSize < 1)
+        throw std::runtime_error("Response matrix blocks need at least 1 incident bin.");
+    const int ncols = getNIncidentBins();
+    const int nrows = getNPulseHeightBins();
+    for (auto &&entry : entries)
+    {
+        if (entry.incidentIdx < 0 || entry.incidentIdx >= ncols || entry.pulseHeightIdx < 0 || entry.pulseHeightIdx >= nrows)
+            throw std::runtime_error("Response matrix entry out of range: " + std::to_string(entry.incidentIdx) + " " + std::to_string(entry.pulseHeightIdx));
+    }
+
+    // order by block, row and column, then merge duplicated entries
+    std::vector<Entry> sorted(entries);
+    auto key = [this](const Entry& e) {return std::make_tuple(e.incidentIdx / blockSize, e.pulseHeightIdx, e.incidentIdx);};
+    std::stable_sort(sorted.begin(), sorted.end(), [&key](const Entry& a, const Entry& b) {return key(a) < key(b);});
+    const int nblocks = (ncols + blockSize - 1) / blockSize;
+    rowStarts.assign(static_cast<std::size_t>(nblocks) * (nrows + 1), 0);
+    std::vector<std::size_t> rowCounts(rowStarts.size(), 0);
+    for (std::size_t k = 0; k < sorted.size(); k++)
+    {
+        const Entry& e = sorted[k];
+        if (k > 0 && e.incidentIdx == sorted[k - 1].incidentIdx && e.pulseHeightIdx == sorted[k - 1].pulseHeightIdx)
+        {
+            values.back() += e.value;
+            continue;
+        }
+        columns.push_back(e.incidentIdx);
+        values.push_back(e.value);
+        rowCounts[static_cast<std::size_t>(e.incidentIdx / blockSize) * (nrows + 1) + e.pulseHeightIdx + 1]++;
+    }
+    // row starts of all blocks, one after the other
+    std::size_t start(0);
+    for (int b = 0; b < nblocks; b++)
+    {
+        const std::size_t offset = static_cast<std::size_t>(b) * (nrows + 1);
+        rowStarts[offset] = start;
+        for (int j = 0; j < nrows; j++)
+        {
+            start += rowCounts[offset + j + 1];
+            rowStarts[offset + j + 1] = start;
+        }
+    }
+}
+
+ResponseMatrix ResponseMatrix::load(const std::string& fpath, const int blockSize_)
+{
+    std::ifstream fileptr(fpath, std::ios::in);
+    if (!fileptr.is_open())
+    {
+        std::string errMessage = "can't open file: " + fpath;
+        throw std::runtime_error(errMessage);
+    }
+    std::vector<double> edges[2];
+    std::vector<Entry> entries;
+    int nEdgeLines(0);
+    std::string line;
+    int lineNumber(0);
+    while (std::getline(fileptr, line))
+    {
+        lineNumber++;
+        const std::size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+        std::istringstream iss(line);
+        if (nEdgeLines < 2)
+        {
+            double edge;
+            while (iss >> edge)
+                edges[nEdgeLines].push_back(edge);
+            nEdgeLines++;
+        }
+        else
+        {
+            Entry entry;
+            if (!(iss >> entry.incidentIdx >> entry.pulseHeightIdx >> entry.value))
+                throw std::runtime_error(fpath + ": invalid entry on line " + std::to_string(lineNumber));
+            entries.push_back(entry);
+            iss >> std::ws;
+        }
+        if (!iss.eof())
+            throw std::runtime_error(fpath + ": invalid number on line " + std::to_string(lineNumber));
+    }
+    if (nEdgeLines < 2)
+        throw std::runtime_error(fpath + " has no bin edges.");
+    return ResponseMatrix(edges[0], edges[1], entries, blockSize_);
+}
+
+bool ResponseMatrix::matches(const Tally& tally) const
+{
+    const std::vector<double>& edges = tally.getBinEdges();
+    if (edges.size() != incidentEdges.size())
+        return false;
+    for (std::size_t i = 0; i < edges.size(); i++)
+    {
+        if (std::abs(edges[i] - incidentEdges[i]) > 1e-6 * std::max(std::abs(edges[i]), std::abs(incidentEdges[i])))
+            return false;
+    }
+    return true;
+}
+
+void ResponseMatrix::multiply(const std::vector<double>& x, const int n, std::vector<double>& y) const
+{
+    const int nrows = getNPulseHeightBins();
+    const int nblocks = static_cast<int>(rowStarts.size()) / (nrows + 1);
+    for (int b = 0; b < nblocks; b++)
+    {
+        const std::size_t* starts = &rowStarts[static_cast<std::size_t>(b) * (nrows + 1)];
+        for (int j = 0; j < nrows; j++)
+        {
+            double* yj = &y[static_cast<std::size_t>(j) * n];
+            for (std::size_t k = starts[j]; k < starts[j + 1]; k++)
+            {
+                const double value = values[k];
+                const double* xi = &x[static_cast<std::size_t>(columns[k]) * n];
+                for (int s = 0; s < n; s++)
+                    yj[s] += value * xi[s];
+            }
+        }
+    }
+}
+
+std::vector<double> ResponseMatrix::fold(const std::vector<double>& spectrum) const
+{
+    if (static_cast<int>(spectrum.size()) != getNIncidentBins())
+        throw std::runtime_error("Spectrum size does not match the response matrix.");
+    std::vector<double> folded(getNPulseHeightBins(), 0);
+    multiply(spectrum, 1, folded);
+    return folded;
+}
+
+std::vector<std::vector<double>> ResponseMatrix::fold(const std::vector<std::vector<double>>& spectra) const
+{
+    const int n = spectra.size();
+    const int ncols = getNIncidentBins();
+    const int nrows = getNPulseHeightBins();
+    // interleave the spectra, so that each matrix entry updates all of them at once
+    std::vector<double> x(static_cast<std::size_t>(ncols) * n);
+    for (int s = 0; s < n; s++)
+    {
+        if (static_cast<int>(spectra[s].size()) != ncols)
+            throw std::runtime_error("Spectrum size does not match the response matrix.");
+        for (int i = 0; i < ncols; i++)
+            x[static_cast<std::size_t>(i) * n + s] = spectra[s][i];
+    }
+    std::vector<double> y(static_cast<std::size_t>(nrows) * n, 0);
+    multiply(x, n, y);
+    std::vector<std::vector<double>> folded(n, std::vector<double>(nrows));
+    for (int s = 0; s < n; s++)
+    {
+        for (int j = 0; j < nrows; j++)
+            folded[s][j] = y[static_cast<std::size_t>(j) * n + s];
+    }
+    return folded;
+}
+
+std::vector<std::vector<double>> ResponseMatrix::fold(const std::vector<Tally>& tallies) const
+{
+    std::vector<std::vector<double>> spectra;
+    spectra.reserve(tallies.size());
+    for (std::size_t t = 0; t < tallies.size(); t++)
+    {
+        if (!matches(tallies[t]))
+            throw std::runtime_error("Energy bins of tally " + std::to_string(t) + " do not match the response matrix.");
+        spectra.push_back(tallies[t].getBinContents());
+    }
+    return fold(spectra);
+}
+
+void PulseHeightFolder::addBatch(const std::vector<Tally>& tallies, const int nps)
+{
+    if (nps <= 0)
+        throw std::runtime_error("A batch needs at least 1 history.");
+    if (nBatches > 0 && tallies.size() != sums.size())
+        throw std::runtime_error("Every batch must fold the same tallies.");
+    const std::vector<std::vector<double>> folded = response->fold(tallies);
+    if (nBatches == 0)
+    {
+        sums.assign(tallies.size(), std::vector<double>(response->getNPulseHeightBins(), 0));
+        squaredSums = sums;
+    }
+    for (std::size_t t = 0; t < folded.size(); t++)
+    {
+        for (std::size_t j = 0; j < folded[t].size(); j++)
+        {
+            sums[t][j] += folded[t][j];
+            squaredSums[t][j] += (folded[t][j] / nps) * (folded[t][j] / nps);
+        }
+    }
+    nBatches++;
+    NPS += nps;
+}
+
+std::vector<double> PulseHeightFolder::getSpectrum(const int tallyIdx) const
+{
+    std::vector<double> spectrum(sums.at(tallyIdx));
+    for (auto &&count : spectrum)
+        count /= NPS;
+    return spectrum;
+}
+
+std::vector<double> PulseHeightFolder::getStdError(const int tallyIdx) const
+{
+    std::vector<double> errors(sums.at(tallyIdx).size(), 0);
+    if (nBatches < 2)
+        return errors;
+    const double meanNPS = static_cast<double>(NPS) / nBatches;
+    for (std::size_t j = 0; j < errors.size(); j++)
+    {
+        // mean of the batch spectra per history, and their variance
+        const double mean = sums[tallyIdx][j] / meanNPS / nBatches;
+        const double variance = std::max(0.0, squaredSums[tallyIdx][j] / nBatches - mean * mean);
+        errors[j] = std::sqrt(variance / (nBatches - 1));
+    }
+    return errors;
+}
@@ -0,0 +1,126 @@
+#include "scan.h"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+
+// file signature and layout version of saved maps
+static const char scanMagic[8] = {'C', 'F', 'D', 'S', 'C', 'A', 'N', '1'};
+
+DetectorScan::DetectorScan(const Tally& prototype, const Vec3d& lower, const Vec3d& upper,
+                           const int nx, const int ny, const int nz, const int detectorsPerBlock_)
+    : lowerCorner(lower), nodes{nx, ny, nz}, detectorsPerBlock(detectorsPerBlock_)
+{
+    if (nx < 1 || ny < 1 || nz < 1 || detectorsPerBlock < 1)
+        throw std::runtime_error("Detector scan needs at least one grid node and one detector per block.");
+    const Vec3d extent = upper - lower;
+    for (int i = 0; i < 3; i++)
+    {
+        spacing[i] = extent[i] / std::max(nodes[i] - 1, 1);
+    }
+
+    Tally tally(prototype);
+    tally.reset();
+    // path lengths precomputed for the prototype center are not valid at other nodes
+    tally.setPathLengthField(nullptr);
+    const int nodesNum = getNumberOfNodes();
+    blocks.resize((nodesNum + detectorsPerBlock - 1) / detectorsPerBlock);
+    for (int i = 0; i < nx; i++)
+    {
+        for (int j = 0; j < ny; j++)
+        {
+            for (int k = 0; k < nz; k++)
+            {
+                const int nodeIdx = (i * ny + j) * nz + k;
+                tally.setCenter(getNodeCenter(i, j, k));
+                blocks[nodeIdx / detectorsPerBlock].push_back(tally);
+            }
+        }
+    }
+}
+
+void DetectorScan::run(const MCSettings& config, const CollisionBank& bank, const int eventsPerBlock)
+{
+    const std::vector<BankedEvent>& events = bank.getEvents();
+    const long long eventsNum = events.size();
+    const long long blocksNum = blocks.size();
+    std::vector<Particle> particles;
+    std::vector<CollisionContext> contexts;
+    particles.reserve(eventsPerBlock);
+    contexts.reserve(eventsPerBlock);
+    for (long long first = 0; first < eventsNum; first += eventsPerBlock)
+    {
+        const long long last = std::min(first + eventsPerBlock, eventsNum);
+        // detector-independent quantities, computed once for all grid nodes
+        particles.clear();
+        contexts.clear();
+        for (long long e = first; e < last; e++)
+        {
+            particles.push_back(events[e].toParticle());
+            contexts.emplace_back(particles.back(), config);
+            // trace the primary ray through the cells now, so that the contexts are read-only when shared by threads
+            if (particles.back().scatterN == 0)
+                contexts.back().getPrimaryTransmission(particles.back(), config);
+        }
+        // every tally block is updated by one thread only
+        #pragma omp parallel for schedule(dynamic)
+        for (long long b = 0; b < blocksNum; b++)
+        {
+            for (std::size_t e = 0; e < particles.size(); e++)
+                forceDetectionSampled(particles[e], config, contexts[e], blocks[b]);
+        }
+    }
+    NPS += bank.getNPS();
+}
+
+std::vector<double> DetectorScan::getSpectrum(const int i, const int j, const int k) const
+{
+    std::vector<double> spectrum = getTally(i, j, k).getBinContents();
+    if (NPS > 0)
+    {
+        for (auto &&count : spectrum)
+            count /= NPS;
+    }
+    return spectrum;
+}
+
+double DetectorScan::getIntegral(const int i, const int j, const int k) const
+{
+    const std::vector<double> spectrum = getSpectrum(i, j, k);
+    return std::accumulate(spectrum.begin(), spectrum.end(), 0.0);
+}
+
+void DetectorScan::save(const std::string& fpath) const
+{
+    std::ofstream fileptr(fpath, std::ios::out | std::ios::binary);
+    if (!fileptr.is_open())
+    {
+        std::string errMessage = "can't open file: " + fpath;
+        throw std::runtime_error(errMessage);
+    }
+    const std::vector<double> binCenters = blocks[0][0].getBinCenters();
+    const std::int32_t header[5] = {nodes[0], nodes[1], nodes[2], static_cast<std::int32_t>(binCenters.size()), NPS};
+    const double grid[6] = {lowerCorner.x(), lowerCorner.y(), lowerCorner.z(), spacing[0], spacing[1], spacing[2]};
+    fileptr.write(scanMagic, sizeof(scanMagic));
+    fileptr.write(reinterpret_cast<const char*>(header), sizeof(header));
+    fileptr.write(reinterpret_cast<const char*>(grid), sizeof(grid));
+    fileptr.write(reinterpret_cast<const char*>(binCenters.data()), binCenters.size() * sizeof(double));
+
+    std::vector<double> integrals;
+    for (int i = 0; i < nodes[0]; i++)
+    {
+        for (int j = 0; j < nodes[1]; j++)
+        {
+            for (int k = 0; k < nodes[2]; k++)
+            {
+                const std::vector<double> spectrum = getSpectrum(i, j, k);
+                fileptr.write(reinterpret_cast<const char*>(spectrum.data()), spectrum.size() * sizeof(double));
+                integrals.push_back(std::accumulate(spectrum.begin(), spectrum.end(), 0.0));
+            }
+        }
+    }
+    fileptr.write(reinterpret_cast<const char*>(integrals.data()), integrals.size() * sizeof(double));
+    if (!fileptr)
+        throw std::runtime_error("can't write file: " + fpath);
+}
@@ -0,0 +1,87 @@
+#include "sharedtally.h"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <stdexcept>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+// doubles per cache line
+static const std::size_t cacheLineDoubles = 64 / sizeof(double);
+
+SharedTallyStorage::SharedTallyStorage(const int nbins_, const int nThreads_, const std::vector<int>& hotBins)
+    : nbins(nbins_), nThreads(nThreads_), nHotBins(0), slots(nbins_, -1)
+{
+    if (nbins < 1 || nThreads < 1)
+        throw std::runtime_error("Shared tally storage needs at least 1 bin and 1 thread.");
+    for (auto &&binIdx : hotBins)
+    {
+        if (binIdx < 0 || binIdx >= nbins)
+            throw std::runtime_error("Hot bin " + std::to_string(binIdx) + " out of range.");
+        if (slots[binIdx] < 0)
+            slots[binIdx] = nHotBins++;
+    }
+    stripeSize = (nHotBins + cacheLineDoubles - 1) / cacheLineDoubles * cacheLineDoubles;
+    // one more line to align the first stripe
+    const std::size_t bufferSize = stripeSize * nThreads + cacheLineDoubles;
+    stripeBuffer.reset(new double[bufferSize]);
+    const std::size_t misalignment = reinterpret_cast<std::uintptr_t>(stripeBuffer.get()) % 64;
+    stripes = stripeBuffer.get() + (misalignment == 0 ? 0 : (64 - misalignment) / sizeof(double));
+    shared.reset(new std::atomic<double>[nbins]);
+    clear();
+}
+
+int SharedTallyStorage::threadIndex()
+{
+#ifdef _OPENMP
+    return omp_get_thread_num();
+#else
+    return 0;
+#endif
+}
+
+std::vector<int> SharedTallyStorage::hottestBins(const std::vector<double>& counts, const int maxBins)
+{
+    std::vector<int> order(counts.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&counts](int a, int b) {return counts[a] > counts[b];});
+    std::vector<int> hot;
+    for (int i = 0; i < static_cast<int>(order.size()) && i < maxBins && counts[order[i]] > 0; i++)
+        hot.push_back(order[i]);
+    std::sort(hot.begin(), hot.end());
+    return hot;
+}
+
+double SharedTallyStorage::getBinContent(const int binIdx) const
+{
+    const int slot = slots[binIdx];
+    double sum = shared[binIdx].load(std::memory_order_relaxed);
+    if (slot < 0)
+        return sum;
+    // Kahan summation of the stripes in thread order
+    double compensation(0);
+    for (int thread = 0; thread < nThreads; thread++)
+    {
+        const double y = stripes[static_cast<std::size_t>(thread) * stripeSize + slot] - compensation;
+        const double t = sum + y;
+        compensation = (t - sum) - y;
+        sum = t;
+    }
+    return sum;
+}
+
+std::vector<double> SharedTallyStorage::getBinContents() const
+{
+    std::vector<double> counts(nbins);
+    for (int i = 0; i < nbins; i++)
+        counts[i] = getBinContent(i);
+    return counts;
+}
+
+void SharedTallyStorage::clear()
+{
+    std::fill(stripes, stripes + stripeSize * nThreads, 0.0);
+    for (int i = 0; i < nbins; i++)
+        shared[i].store(0, std::memory_order_relaxed);
+}
@@ -0,0 +1,175 @@
+#include "sourcebias.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include "rng.h"
+#include "weightwindow.h"
+
+// exponents tried by the pilot tuning, k of exp(k mu) and b s.d.(s) of exp(b s)
+static const int nDirectionExponents = 41;
+static const double directionExponentStep = 0.25;
+static const int nPositionExponents = 13;
+static const double positionExponentStep = 0.25;
+
+BiasedSource::BiasedSource(const Source& source_, const Vec3d& target_)
+    : source(source_), target(target_)
+{
+    Vec3d lower, upper;
+    source.getShape().getBoundingBox(lower, upper);
+    sourceCenter = 0.5 * (lower + upper);
+    axis = (target - sourceCenter).normalized();
+}
+
+void BiasedSource::setCone(const double cosine, const double probability)
+{
+    if (!(cosine >= -1 && cosine < 1) || !(probability >= 0 && probability <= 1))
+        throw std::runtime_error("Invalid source cone.");
+    directionBias = Cone;
+    coneCosine = cosine;
+    coneProbability = probability;
+}
+
+void BiasedSource::setExponential(const double k)
+{
+    if (!(k >= 0))
+        throw std::runtime_error("The exponent of the source direction biasing must be >= 0.");
+    directionBias = k > 0 ? Exponential : Isotropic;
+    exponent = k;
+}
+
+void BiasedSource::setPositionExponent(const double b, const int candidates)
+{
+    if (!std::isfinite(b) || candidates < 1)
+        throw std::runtime_error("Invalid source position biasing.");
+    positionExponent = b;
+    positionCandidates = b == 0 ? 1 : candidates;
+}
+
+double BiasedSource::directionWeight(const double mu) const
+{
+    if (directionBias == Exponential)
+    {
+        // density k exp(k (mu - 1)) / (1 - exp(-2k))
+        return -std::expm1(-2 * exponent) / (2 * exponent) * std::exp(exponent * (1 - mu));
+    }
+    if (directionBias == Cone)
+    {
+        const double density = 0.5 * (1 - coneProbability) + (mu >= coneCosine ? coneProbability / (1 - coneCosine) : 0);
+        return 0.5 / density;
+    }
+    return 1;
+}
+
+double BiasedSource::sampleCosine(double& weight) const
+{
+    GlobalUniformRandNumGenerator& rng = GlobalUniformRandNumGenerator::GetInstance();
+    double mu;
+    if (directionBias == Exponential)
+        mu = 1 + std::log1p(rng.generateDouble() * std::expm1(-2 * exponent)) / exponent;
+    else if (rng.generateDouble() < coneProbability)
+        mu = coneCosine + (1 - coneCosine) * rng.generateDouble();
+    else
+        mu = 1 - 2 * rng.generateDouble();
+    mu = std::min(1.0, std::max(-1.0, mu));
+    weight *= directionWeight(mu);
+    return mu;
+}
+
+Particle BiasedSource::createParticle() const
+{
+    Particle prtl = source.createParticle();
+    if (positionCandidates > 1)
+    {
+        // resampled importance sampling: choose among candidates by exp(b s),
+        // the weight mean(exp(b s)) / exp(b s) of the chosen one keeps the expectation
+        std::vector<Particle> candidates(positionCandidates, prtl);
+        std::vector<double> factors(positionCandidates);
+        for (int i = 1; i < positionCandidates; i++)
+            candidates[i] = source.createParticle();
+        double sum(0);
+        for (int i = 0; i < positionCandidates; i++)
+        {
+            factors[i] = std::exp(positionExponent * axialPosition(candidates[i].pos));
+            sum += factors[i];
+        }
+        double r = GlobalUniformRandNumGenerator::GetInstance().generateDouble() * sum;
+        int chosen(0);
+        while (chosen < positionCandidates - 1 && r >= factors[chosen])
+            r -= factors[chosen++];
+        prtl = candidates[chosen];
+        prtl.weight *= sum / positionCandidates / factors[chosen];
+    }
+    if (directionBias == Isotropic)
+        return prtl;
+    double weight(prtl.weight);
+    const double mu = sampleCosine(weight);
+    prtl.weight = weight;
+    prtl.dir = (target - prtl.pos).normalized();
+    prtl.scatter(mu);
+    return prtl;
+}
+
+BiasedSource BiasedSource::tune(const MCSettings& config, const Tally& tally, const int pilotN)
+{
+    if (pilotN < 1)
+        throw std::runtime_error("The pilot run needs at least 1 history.");
+    BiasedSource biased(config.source, tally.getCenter());
+    // unbiased pilot: cosine to the target, position along the axis and score of each history
+    std::vector<double> mus(pilotN), positions(pilotN), squaredScores(pilotN);
+    Tally pilot(tally);
+    for (int i = 0; i < pilotN; i++)
+    {
+        const Particle prtl = config.source.createParticle();
+        mus[i] = Vec3d::dotProduct(prtl.dir, (biased.target - prtl.pos).normalized());
+        positions[i] = biased.axialPosition(prtl.pos);
+        pilot.reset();
+        transportHistory(prtl, config, nullptr, [&pilot, &config](Particle& p) {forceDetection(p, config, pilot);});
+        const std::vector<double> counts = pilot.getBinContents();
+        const double score = std::accumulate(counts.begin(), counts.end(), 0.0);
+        squaredScores[i] = score * score;
+    }
+    const double meanPosition = std::accumulate(positions.begin(), positions.end(), 0.0) / pilotN;
+    double spread(0);
+    for (int i = 0; i < pilotN; i++)
+        spread += (positions[i] - meanPosition) * (positions[i] - meanPosition);
+    spread = std::sqrt(spread / pilotN);
+
+    // second moment of the biased tally, mean of w x^2 over the unbiased pilot
+    std::vector<double> positionWeights(pilotN);
+    double unbiasedMoment(0), bestMoment(0), bestK(0), bestB(0);
+    for (int ib = 0; ib < (spread > 0 ? nPositionExponents : 1); ib++)
+    {
+        const double b = spread > 0 ? ib * positionExponentStep / spread : 0;
+        double normalization(0);
+        for (int i = 0; i < pilotN; i++)
+        {
+            positionWeights[i] = std::exp(b * (positions[i] - meanPosition));
+            normalization += positionWeights[i];
+        }
+        normalization /= pilotN;
+        for (int ik = 0; ik < nDirectionExponents; ik++)
+        {
+            biased.setExponential(ik * directionExponentStep);
+            double moment(0);
+            for (int i = 0; i < pilotN; i++)
+                moment += biased.directionWeight(mus[i]) * normalization / positionWeights[i] * squaredScores[i];
+            moment /= pilotN;
+            if (ib == 0 && ik == 0)
+            {
+                unbiasedMoment = moment;
+                bestMoment = moment;
+            }
+            else if (moment < bestMoment)
+            {
+                bestMoment = moment;
+                bestK = biased.exponent;
+                bestB = b;
+            }
+        }
+    }
+    biased.setExponential(bestK);
+    biased.setPositionExponent(bestB);
+    biased.predictedGain = bestMoment > 0 ? unbiasedMoment / bestMoment : 1;
+    return biased;
+}
@@ -0,0 +1,279 @@
+#include "stratified.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <sstream>
+#include <stdexcept>
+
+static const std::array<std::string, StratifiedSource::nDimensions> dimensionNames{"radius", "angle", "height", "azimuth", "polar", "energy"};
+
+/**
+ * @brief Split a number of histories proportionally to weights, rounding the largest remainders up
+ */
+static std::vector<int> splitProportionally(const int histories, const std::vector<double>& weights)
+{
+    const double total = std::accumulate(weights.begin(), weights.end(), 0.0);
+    std::vector<int> counts(weights.size(), 0);
+    std::vector<std::pair<double, int>> remainders;
+    int left(histories);
+    for (std::size_t h = 0; h < weights.size(); h++)
+    {
+        const double share = histories * weights[h] / total;
+        counts[h] = static_cast<int>(std::floor(share));
+        left -= counts[h];
+        remainders.emplace_back(share - counts[h], h);
+    }
+    std::stable_sort(remainders.begin(), remainders.end(), [](const std::pair<double, int>& l, const std::pair<double, int>& r) {return l.first > r.first;});
+    for (int k = 0; k < left; k++)
+        counts[remainders[k % remainders.size()].second]++;
+    return counts;
+}
+
+StratifiedSource::StratifiedSource(const Source& source_, const std::array<int, nDimensions>& divisions_, const Mode mode_, const bool optimal_)
+    : source(source_), divisions(divisions_), mode(mode_), optimal(optimal_)
+{
+    for (int d = 0; d < nDimensions; d++)
+    {
+        if (divisions[d] < 1)
+            throw std::runtime_error("The number of strata of the source " + dimensionNames[d] + " must be positive.");
+        if (d >= source.getDimensions() && divisions[d] > 1)
+            throw std::runtime_error("The energy of a monoenergetic source can't be stratified.");
+        if (mode == Stratified)
+            nStrata *= divisions[d];
+    }
+    if (mode == LatinHypercube && optimal)
+        throw std::runtime_error("Histories are allocated optimally to strata, not to a Latin hypercube.");
+    cylinder = dynamic_cast<const Cylinder*>(&source.getShape()) != nullptr && (divisions[Radius] > 1 || divisions[Angle] > 1);
+    batchWeights.assign(nStrata, 1);
+    reset();
+}
+
+StratifiedSource StratifiedSource::parse(const Source& source, const std::string& spec)
+{
+    std::array<int, nDimensions> divisions;
+    divisions.fill(1);
+    Mode mode(Stratified);
+    bool optimal(false);
+    // dimensions listed without a number of strata
+    std::vector<int> listed;
+    std::istringstream entries(spec);
+    std::string entry;
+    while (std::getline(entries, entry, ','))
+    {
+        if (entry == "lhs")
+        {
+            mode = LatinHypercube;
+            continue;
+        }
+        if (entry == "optimal")
+        {
+            optimal = true;
+            continue;
+        }
+        const std::size_t colon = entry.find(':');
+        const std::string name = entry.substr(0, colon);
+        const auto found = std::find(dimensionNames.begin(), dimensionNames.end(), name);
+        if (found == dimensionNames.end())
+            throw std::runtime_error("Expected lhs, optimal or <dimension>:<strata> with the dimension one of radius, angle, height, azimuth, polar and energy in source stratification: " + entry);
+        const int d = found - dimensionNames.begin();
+        if (colon == std::string::npos)
+        {
+            listed.push_back(d);
+            continue;
+        }
+        const std::string field = entry.substr(colon + 1);
+        std::size_t end(0);
+        int strata(0);
+        try
+        {
+            strata = std::stoi(field, &end);
+        }
+        catch (const std::exception&)
+        {
+            end = 0;
+        }
+        if (end == 0 || end != field.size() || strata < 1)
+            throw std::runtime_error("Invalid number of strata in source stratification: " + entry);
+        divisions[d] = strata;
+    }
+    for (auto &&d : listed)
+    {
+        if (mode != LatinHypercube)
+            throw std::runtime_error("Missing number of strata of the source " + dimensionNames[d] + " in source stratification: " + spec);
+        divisions[d] = 2;
+    }
+    return StratifiedSource(source, divisions, mode, optimal);
+}
+
+int StratifiedSource::getStratumIndex(const int stratum, const Dimension d) const
+{
+    if (mode != Stratified)
+        return 0;
+    int index(stratum);
+    for (int k = nDimensions - 1; k > d; k--)
+        index /= divisions[k];
+    return index % divisions[d];
+}
+
+std::string StratifiedSource::getStratumName(const int stratum) const
+{
+    std::ostringstream name;
+    for (int d = 0; d < nDimensions; d++)
+    {
+        if (mode != Stratified || divisions[d] == 1)
+            continue;
+        if (name.tellp() > 0)
+            name << ' ';
+        name << dimensionNames[d] << ' ' << getStratumIndex(stratum, static_cast<Dimension>(d)) + 1 << '/' << divisions[d];
+    }
+    return name.tellp() > 0 ? name.str() : "all";
+}
+
+std::vector<int> StratifiedSource::allocate(const int histories) const
+{
+    if (histories < nStrata)
+        throw std::runtime_error("A batch of " + std::to_string(histories) + " histories can't sample " + std::to_string(nStrata) + " source strata.");
+    std::vector<double> weights(nStrata);
+    for (int h = 0; h < nStrata; h++)
+        weights[h] = getProbability(h);
+    if (optimal && *std::min_element(counts.begin(), counts.end()) >= 2)
+    {
+        std::vector<double> deviations(nStrata);
+        for (int h = 0; h < nStrata; h++)
+            deviations[h] = getProbability(h) * std::sqrt(getVariance(h));
+        if (std::accumulate(deviations.begin(), deviations.end(), 0.0) > 0)
+            weights = deviations;
+    }
+    std::vector<int> allocation = splitProportionally(histories - nStrata, weights);
+    for (auto &&n : allocation)
+        n++;
+    return allocation;
+}
+
+void StratifiedSource::startBatch(const int histories)
+{
+    batchHistories = histories;
+    historyStrata.clear();
+    if (mode == Stratified)
+    {
+        const std::vector<int> allocation = allocate(histories);
+        for (int h = 0; h < nStrata; h++)
+        {
+            historyStrata.insert(historyStrata.end(), allocation[h], h);
+            batchWeights[h] = histories * getProbability(h) / allocation[h];
+            allocationSums[h] += static_cast<double>(histories) * histories / allocation[h];
+        }
+        totalHistories += histories;
+        return;
+    }
+    historyStrata.assign(histories, 0);
+    allocationSums[0] += histories;
+    totalHistories += histories;
+    GlobalUniformRandNumGenerator& rng = GlobalUniformRandNumGenerator::GetInstance();
+    for (int d = 0; d < nDimensions; d++)
+    {
+        if (divisions[d] == 1)
+            continue;
+        // Fisher-Yates shuffle of the intervals
+        std::vector<int>& permutation = permutations[d];
+        permutation.resize(histories);
+        std::iota(permutation.begin(), permutation.end(), 0);
+        for (int k = histories - 1; k > 0; k--)
+            std::swap(permutation[k], permutation[std::min(k, static_cast<int>(rng.generateDouble() * (k + 1)))]);
+    }
+}
+
+Particle StratifiedSource::createParticle(const int history) const
+{
+    GlobalUniformRandNumGenerator& rng = GlobalUniformRandNumGenerator::GetInstance();
+    const int stratum = historyStrata[history];
+    std::vector<double> values(source.getDimensions());
+    for (std::size_t d = 0; d < values.size(); d++)
+    {
+        values[d] = rng.generateDouble();
+        if (divisions[d] == 1)
+            continue;
+        if (mode == Stratified)
+            values[d] = (getStratumIndex(stratum, static_cast<Dimension>(d)) + values[d]) / divisions[d];
+        else
+            values[d] = (permutations[d][history] + values[d]) / batchHistories;
+    }
+    if (cylinder)
+    {
+        // Cylinder::samplePoint takes the radius over the radius of the cylinder as the larger number
+        // and the angle over 2 pi as the smaller one over the larger; the square of the radius is uniform
+        const double radius = std::sqrt(values[Radius]);
+        values[Radius] = values[Angle] * radius;
+        values[Angle] = radius;
+    }
+    rng.setLeadingValues(values);
+    Particle prtl = source.createParticle();
+    prtl.weight *= batchWeights[stratum];
+    return prtl;
+}
+
+void StratifiedSource::addScore(const int history, const double score)
+{
+    const int stratum = historyStrata[history];
+    const double value = score / batchWeights[stratum];
+    counts[stratum]++;
+    weightedSum += score;
+    sums[stratum] += value;
+    squaredSums[stratum] += value * value;
+}
+
+double StratifiedSource::getMean(const int stratum) const
+{
+    return counts[stratum] > 0 ? sums[stratum] / counts[stratum] : 0;
+}
+
+double StratifiedSource::getVariance(const int stratum) const
+{
+    const long long n = counts[stratum];
+    if (n < 2)
+        return 0;
+    const double mean = sums[stratum] / n;
+    return std::max(0.0, squaredSums[stratum] / n - mean * mean) * n / (n - 1);
+}
+
+double StratifiedSource::getVarianceContribution(const int stratum) const
+{
+    if (totalHistories == 0)
+        return 0;
+    return getProbability(stratum) * getProbability(stratum) * getVariance(stratum) * allocationSums[stratum] / totalHistories / totalHistories;
+}
+
+double StratifiedSource::getMean() const
+{
+    return totalHistories > 0 ? weightedSum / totalHistories : 0;
+}
+
+double StratifiedSource::getVarianceOfMean() const
+{
+    double variance(0);
+    for (int h = 0; h < nStrata; h++)
+        variance += getVarianceContribution(h);
+    return variance;
+}
+
+double StratifiedSource::getUnstratifiedVarianceOfMean() const
+{
+    if (totalHistories == 0)
+        return 0;
+    // variance within the strata plus variance of the stratum means
+    const double mean = getMean();
+    double variance(0);
+    for (int h = 0; h < nStrata; h++)
+        variance += getProbability(h) * (getVariance(h) + (getMean(h) - mean) * (getMean(h) - mean));
+    return variance / totalHistories;
+}
+
+void StratifiedSource::reset()
+{
+    counts.assign(nStrata, 0);
+    sums.assign(nStrata, 0);
+    squaredSums.assign(nStrata, 0);
+    totalHistories = 0;
+    weightedSum = 0;
+    allocationSums.assign(nStrata, 0);
+}
@@ -0,0 +1,161 @@
+#include "subsampling.h"
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+
+// rounds over the bands when optimizing the probabilities
+static const int optimizationRounds = 100;
+
+SubsamplingPolicy::SubsamplingPolicy()
+{
+    for (int e = 0; e < nEstimators; e++)
+        probabilities[e] = {1};
+    // thermal neutron CFD is expensive, 1% of the collisions is enough for a large NPS
+    probabilities[ThermalNeutronScatter] = {0.01};
+}
+
+SubsamplingPolicy::Estimator SubsamplingPolicy::classify(const Particle& particle)
+{
+    if (particle.scatterN == 0)
+        return Primary;
+    if (particle.particleType == Particle::Photon)
+        return PhotonScatter;
+    return particle.ergE < 1 ? ThermalNeutronScatter : FastNeutronScatter;
+}
+
+std::string SubsamplingPolicy::getName(const Estimator estimator)
+{
+    static const char* names[nEstimators] = {"primary", "photon", "fast", "thermal"};
+    return names[estimator];
+}
+
+SubsamplingPolicy SubsamplingPolicy::parse(const std::string& spec)
+{
+    SubsamplingPolicy policy;
+    std::istringstream entries(spec);
+    std::string entry;
+    while (std::getline(entries, entry, ','))
+    {
+        std::istringstream fields(entry);
+        std::string name, field;
+        std::getline(fields, name, ':');
+        int estimator(0);
+        while (estimator < nEstimators && getName(static_cast<Estimator>(estimator)) != name)
+            estimator++;
+        if (estimator == nEstimators)
+            throw std::runtime_error("Unknown estimator in subsampling policy: " + name);
+        std::vector<double> values;
+        while (std::getline(fields, field, ':'))
+        {
+            std::size_t end(0);
+            try
+            {
+                values.push_back(std::stod(field, &end));
+            }
+            catch (const std::exception&)
+            {
+                end = 0;
+            }
+            if (end == 0 || end != field.size())
+                throw std::runtime_error("Invalid number in subsampling policy: " + entry);
+        }
+        if (values.size() % 2 == 0)
+            throw std::runtime_error("Expected <p0>:<E1>:<p1>:... in subsampling policy: " + entry);
+        std::vector<double> boundaries, p;
+        for (std::size_t i = 0; i < values.size(); i++)
+            (i % 2 == 0 ? p : boundaries).push_back(values[i]);
+        policy.setBands(static_cast<Estimator>(estimator), boundaries, p);
+    }
+    return policy;
+}
+
+void SubsamplingPolicy::setProbability(const Estimator estimator, const double probability)
+{
+    setBands(estimator, {}, {probability});
+}
+
+void SubsamplingPolicy::setBands(const Estimator estimator, const std::vector<double>& boundaries, const std::vector<double>& probabilities_)
+{
+    if (probabilities_.size() != boundaries.size() + 1)
+        throw std::runtime_error("Subsampling needs one probability more than band boundaries.");
+    for (std::size_t i = 1; i < boundaries.size(); i++)
+    {
+        if (!(boundaries[i] > boundaries[i - 1]))
+            throw std::runtime_error("Subsampling band boundaries must be increasing.");
+    }
+    if (std::any_of(probabilities_.begin(), probabilities_.end(), [](double p) {return !(p > 0 && p <= 1);}))
+        throw std::runtime_error("Subsampling probabilities must be in (0, 1].");
+    bandBoundaries[estimator] = boundaries;
+    probabilities[estimator] = probabilities_;
+}
+
+int SubsamplingPolicy::findBand(const Estimator estimator, const double ergE) const
+{
+    const std::vector<double>& boundaries = bandBoundaries[estimator];
+    return std::upper_bound(boundaries.begin(), boundaries.end(), ergE) - boundaries.begin();
+}
+
+SubsamplingPolicy::Tradeoff SubsamplingPolicy::predict(const Pilot& pilot) const
+{
+    Tradeoff tradeoff;
+    double variance(pilot.variance), seconds(pilot.transportSeconds), allSeconds(pilot.transportSeconds);
+    for (int e = 0; e < nEstimators; e++)
+    {
+        if (pilot.squaredScores[e].size() != probabilities[e].size())
+            throw std::runtime_error("The pilot run has other subsampling bands.");
+        for (std::size_t b = 0; b < probabilities[e].size(); b++)
+        {
+            variance += (1 / probabilities[e][b] - 1) * pilot.squaredScores[e][b];
+            seconds += probabilities[e][b] * pilot.seconds[e][b];
+            allSeconds += pilot.seconds[e][b];
+        }
+    }
+    tradeoff.varianceRatio = pilot.variance > 0 ? variance / pilot.variance : 1;
+    tradeoff.timeRatio = allSeconds > 0 ? seconds / allSeconds : 1;
+    return tradeoff;
+}
+
+SubsamplingPolicy::Tradeoff SubsamplingPolicy::optimize(const Pilot& pilot, const double minProbability)
+{
+    if (!(minProbability > 0 && minProbability <= 1))
+        throw std::runtime_error("The smallest subsampling probability must be in (0, 1].");
+    // variance and time as functions of each probability: (A + B / p) (C + p D)
+    double variance(pilot.variance), seconds(pilot.transportSeconds);
+    for (int e = 0; e < nEstimators; e++)
+    {
+        if (pilot.squaredScores[e].size() != probabilities[e].size())
+            throw std::runtime_error("The pilot run has other subsampling bands.");
+        for (std::size_t b = 0; b < probabilities[e].size(); b++)
+        {
+            variance += (1 / probabilities[e][b] - 1) * pilot.squaredScores[e][b];
+            seconds += probabilities[e][b] * pilot.seconds[e][b];
+        }
+    }
+    for (int round = 0; round < optimizationRounds; round++)
+    {
+        double maxChange(0);
+        for (int e = 0; e < nEstimators; e++)
+        {
+            for (std::size_t b = 0; b < probabilities[e].size(); b++)
+            {
+                double& p = probabilities[e][b];
+                const double squaredScore = pilot.squaredScores[e][b];
+                const double cost = pilot.seconds[e][b];
+                const double A = variance - squaredScore / p;
+                const double C = seconds - p * cost;
+                double optimum(1);
+                if (cost > 0 && A > 0)
+                    optimum = squaredScore > 0 ? std::sqrt(squaredScore * C / (A * cost)) : minProbability;
+                optimum = std::min(1.0, std::max(minProbability, optimum));
+                variance = A + squaredScore / optimum;
+                seconds = C + optimum * cost;
+                maxChange = std::max(maxChange, std::abs(optimum - p) / p);
+                p = optimum;
+            }
+        }
+        if (maxChange < 1e-6)
+            break;
+    }
+    return predict(pilot);
+}
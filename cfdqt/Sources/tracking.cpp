@@ -1,11 +1,84 @@
 #include "tracking.h"
+#include <algorithm>
+#include <stdexcept>
 
-bool deltaTracking(Particle& particle, const MCSettings& config)
+ExponentialTransform::ExponentialTransform(const Vec3d& target_, const std::vector<double>& energyEdges_, const std::vector<double>& stretching_)
+    : target(target_), energyEdges(energyEdges_), stretching(stretching_)
+{
+    if (energyEdges.size() < 2 || stretching.size() != energyEdges.size() - 1)
+        throw std::runtime_error("The exponential transform needs one stretching parameter per energy bin.");
+    for (std::size_t i = 1; i < energyEdges.size(); i++)
+    {
+        if (!(energyEdges[i] > energyEdges[i - 1]))
+            throw std::runtime_error("Exponential transform energy bin edges must be increasing.");
+    }
+    if (std::any_of(stretching.begin(), stretching.end(), [](double p) {return !(p >= 0 && p < 1);}))
+        throw std::runtime_error("Exponential transform stretching parameters must be in [0, 1).");
+}
+
+ExponentialTransform ExponentialTransform::fromDiffusion(const MCSettings& config, const Vec3d& target_,
+                                                         const std::vector<double>& energyEdges_, const double maxStretching)
+{
+    if (!(maxStretching >= 0 && maxStretching < 1))
+        throw std::runtime_error("The largest stretching parameter must be in [0, 1).");
+    const Particle::ParticleType type = config.source.createParticle().particleType;
+    std::vector<double> p(energyEdges_.size() > 1 ? energyEdges_.size() - 1 : 0);
+    for (std::size_t i = 0; i < p.size(); i++)
+    {
+        const double ergE = 0.5 * (energyEdges_[i] + energyEdges_[i + 1]);
+        const double c = scatteringProbability(config.cells[0].material, ergE, type);
+        p[i] = std::min(maxStretching, std::max(0.0, 1 - std::sqrt(3 * (1 - c))));
+    }
+    return ExponentialTransform(target_, energyEdges_, p);
+}
+
+double ExponentialTransform::getStretching(const double ergE) const
+{
+    if (!(ergE >= energyEdges.front() && ergE < energyEdges.back()))
+        return 0;
+    return stretching[std::upper_bound(energyEdges.begin(), energyEdges.end(), ergE) - energyEdges.begin() - 1];
+}
+
+double ExponentialTransform::getStretching(const Particle& particle) const
+{
+    const double p = getStretching(particle.ergE);
+    if (p == 0)
+        return 0;
+    return p * Vec3d::dotProduct(particle.dir, (target - particle.pos).normalized());
+}
+
+double scatteringProbability(const Material& material, const double ergE, const Particle::ParticleType type)
+{
+    if (type == Particle::Photon)
+        return material.getPhotonCrossSection().getComptonOverTotal(ergE);
+    double elastic(0);
+    for (auto &&composition : material.getNuclideComposition())
+        elastic += composition.first * composition.second.getNeutronCrossSection().getElasticMicroscopicCrossSectionAt(ergE);
+    const double total = material.getNeutronTotalMicroscopicCrossSection(ergE);
+    return total > 0 ? std::min(1.0, elastic / total) : 0;
+}
+
+/**
+ * @brief Sample the distance to the next tentative collision, from the majorant stretched by the exponential transform.
+ *        The weight is multiplied by the unbiased over the stretched density of the distance.
+ */
+static double sampleFlightDistance(Particle& particle, const double muMax, const ExponentialTransform* transform)
+{
+    const double randReal = GlobalUniformRandNumGenerator::GetInstance().generateDouble();
+    if (!transform)
+        return - std::log(randReal) / muMax; // cm
+    const double stretching = transform->getStretching(particle);
+    const double distance = - std::log(randReal) / (muMax * (1 - stretching));
+    particle.weight *= std::exp(- muMax * stretching * distance) / (1 - stretching);
+    return distance;
+}
+
+bool deltaTracking(Particle& particle, const MCSettings& config, const ExponentialTransform* transform)
 {
     if (particle.particleType == Particle::Photon)
-        return deltaTrackingPhoton(particle, config);
+        return deltaTrackingPhoton(particle, config, transform);
     else if (particle.particleType == Particle::Neutron)
-        return deltaTrackingNeutron(particle, config);
+        return deltaTrackingNeutron(particle, config, transform);
     return false;
 }
 
@@ -15,18 +88,18 @@ int scattering(Particle& particle, const MCSettings& config)
         return ComptonScattering(particle, config);
     else if (particle.particleType == Particle::Neutron)
         return neutronElasticScattering(particle, config);
+    return 0;
 }
 
-bool deltaTrackingPhoton(Particle& particle, const MCSettings& config)
+bool deltaTrackingPhoton(Particle& particle, const MCSettings& config, const ExponentialTransform* transform)
 {
     const double muMax = config.getMuMax(particle.ergE);
     while (!particle.escaped)
     {
         // randomly select a distance
-        double randReal = GlobalUniformRandNumGenerator::GetInstance().generateDouble();
-        double distance = - std::log(randReal) / muMax; // cm
+        double distance = sampleFlightDistance(particle, muMax, transform);
         particle.move(distance);
-        if(!config.ROI.contain(particle.pos))
+        if(!config.ROI->contain(particle.pos))
         {
             // escaped
             particle.escaped = true;
@@ -35,10 +108,10 @@ bool deltaTrackingPhoton(Particle& particle, const MCSettings& config)
 
         // virtual collision
         // check if randReal < u(x,E) / u_max
-        randReal = GlobalUniformRandNumGenerator::GetInstance().generateDouble();
+        double randReal = GlobalUniformRandNumGenerator::GetInstance().generateDouble();
         // const Cell& currentCell = config.getCell(particle);
         const Cell& currentCell = config.cells[0];
-        if (randReal * currentCell.material.getPhotonTotalAtten(particle.ergE) < muMax)
+        if (randReal * muMax < currentCell.material.getPhotonTotalAtten(particle.ergE))
         {
             // update the wieght, w = w * P(interaction is Compton scattering)
             particle.weight *= currentCell.material.getPhotonCrossSection().getComptonOverTotal(particle.ergE);
@@ -100,17 +173,16 @@ int ComptonScattering(Particle& particle, const MCSettings& config)
 }
 
 
-bool deltaTrackingNeutron(Particle& particle, const MCSettings& config)
+bool deltaTrackingNeutron(Particle& particle, const MCSettings& config, const ExponentialTransform* transform)
 {
     // only one material
     const double muMax = config.cells[0].material.getNeutronTotalAtten(particle.ergE); // cm^-1
     while (!particle.escaped)
     {
         // randomly select a distance
-        double randReal = GlobalUniformRandNumGenerator::GetInstance().generateDouble();
-        double distance = - std::log(randReal) / muMax; // cm
+        double distance = sampleFlightDistance(particle, muMax, transform);
         particle.move(distance);
-        if(!config.ROI.contain(particle.pos))
+        if(!config.ROI->contain(particle.pos))
         {
             // escaped
             particle.escaped = true;
@@ -130,7 +202,8 @@ int neutronElasticScattering(Particle& particle, const MCSettings& config)
     const Cell& currentCell = config.cells[0];
     // decide which nuclide the neutron will interacts with
     double randReal = GlobalUniformRandNumGenerator::GetInstance().generateDouble();
-    const Nuclide& nuclide = currentCell.material.selectInteractionTarget(particle.ergE, randReal);
+    const int nuclideIndex = currentCell.material.selectInteractionTargetIndex(particle.ergE, randReal);
+    const Nuclide& nuclide = currentCell.material.getNuclideComposition()[nuclideIndex].second;
     double A = nuclide.getAtomicWeight();
     // update the wieght, w = w * P(interaction is Elastic scattering)
     particle.weight *= nuclide.getNeutronCrossSection().getElasticMicroscopicCrossSectionAt(particle.ergE) 
@@ -171,7 +244,7 @@ int neutronElasticScattering(Particle& particle, const MCSettings& config)
     // update particle's moving direction
     particle.scatter(mu_lab);
 
-    return 0;
+    return nuclideIndex;
 }
 
 // int fastNeutronElasticScatterSampling(const double A, double& E_lab, double& mu_lab)
@@ -0,0 +1,147 @@
+#include "weightwindow.h"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include "rng.h"
+
+WeightWindowMesh::WeightWindowMesh(const Vec3d& lower_, const Vec3d& upper_, const int nx, const int ny, const int nz,
+                                   const std::vector<double>& energyEdges_, const std::vector<double>& lowerBounds_,
+                                   const double upperRatio_, const double survivalRatio_, const int maxSplit_)
+    : lowerCorner(lower_), upperCorner(upper_), nodes{nx, ny, nz}, energyEdges(energyEdges_), lowerBounds(lowerBounds_),
+      upperRatio(upperRatio_), survivalRatio(survivalRatio_), maxSplit(maxSplit_)
+{
+    for (int d = 0; d < 3; d++)
+    {
+        if (nodes[d] < 1 || !(upperCorner[d] > lowerCorner[d]))
+            throw std::runtime_error("Invalid weight window mesh.");
+        spacing[d] = (upperCorner[d] - lowerCorner[d]) / nodes[d];
+    }
+    if (energyEdges.size() < 2)
+        throw std::runtime_error("Weight windows need at least 2 energy bin edges.");
+    for (std::size_t i = 1; i < energyEdges.size(); i++)
+    {
+        if (!(energyEdges[i] > energyEdges[i - 1]))
+            throw std::runtime_error("Weight window energy bin edges must be increasing.");
+    }
+    if (lowerBounds.size() != static_cast<std::size_t>(getNumberOfElements()) * getNEnergyBins())
+        throw std::runtime_error("Expected " + std::to_string(getNumberOfElements() * getNEnergyBins()) +
+                                 " weight window lower bounds, got " + std::to_string(lowerBounds.size()));
+    if (std::any_of(lowerBounds.begin(), lowerBounds.end(), [](double w) {return !(w >= 0);}))
+        throw std::runtime_error("Weight window lower bounds must be >= 0.");
+    if (!(survivalRatio >= 1 && upperRatio >= survivalRatio) || maxSplit < 2)
+        throw std::runtime_error("Invalid weight window ratios.");
+}
+
+WeightWindowMesh WeightWindowMesh::load(const std::string& fpath)
+{
+    std::ifstream fileptr(fpath, std::ios::in);
+    if (!fileptr.is_open())
+    {
+        std::string errMessage = "can't open file: " + fpath;
+        throw std::runtime_error(errMessage);
+    }
+    std::vector<double> lines[2];
+    std::vector<double> bounds;
+    int nHeaderLines(0);
+    std::string line;
+    while (std::getline(fileptr, line))
+    {
+        const std::size_t first = line.find_first_not_of(" \t\r");
+        if (first == std::string::npos || line[first] == '#')
+            continue;
+        std::istringstream iss(line);
+        std::vector<double>& values = nHeaderLines < 2 ? lines[nHeaderLines++] : bounds;
+        double value;
+        while (iss >> value)
+            values.push_back(value);
+        if (!iss.eof())
+            throw std::runtime_error(fpath + ": invalid number in " + line);
+    }
+    if (nHeaderLines < 2 || lines[0].size() != 9)
+        throw std::runtime_error(fpath + " is not a weight window file.");
+    const std::vector<double>& h = lines[0];
+    return WeightWindowMesh(Vec3d(h[0], h[1], h[2]), Vec3d(h[3], h[4], h[5]), h[6], h[7], h[8], lines[1], bounds);
+}
+
+void WeightWindowMesh::save(const std::string& fpath) const
+{
+    std::ofstream fileptr(fpath, std::ios::out);
+    if (!fileptr.is_open())
+    {
+        std::string errMessage = "can't open file: " + fpath;
+        throw std::runtime_error(errMessage);
+    }
+    fileptr << std::setprecision(std::numeric_limits<double>::max_digits10);
+    fileptr << "# lower corner, upper corner, number of elements along x, y, z\n";
+    fileptr << lowerCorner.x() << ' ' << lowerCorner.y() << ' ' << lowerCorner.z() << ' '
+            << upperCorner.x() << ' ' << upperCorner.y() << ' ' << upperCorner.z() << ' '
+            << nodes[0] << ' ' << nodes[1] << ' ' << nodes[2] << '\n';
+    fileptr << "# energy bin edges\n";
+    for (std::size_t i = 0; i < energyEdges.size(); i++)
+        fileptr << energyEdges[i] << (i + 1 < energyEdges.size() ? ' ' : '\n');
+    fileptr << "# lower bounds, one line per energy bin and x\n";
+    for (std::size_t i = 0; i < lowerBounds.size(); i++)
+        fileptr << lowerBounds[i] << ((i + 1) % (nodes[1] * nodes[2]) == 0 ? '\n' : ' ');
+    if (!fileptr)
+        throw std::runtime_error("can't write file: " + fpath);
+}
+
+Vec3d WeightWindowMesh::getElementCenter(const int i, const int j, const int k) const
+{
+    return lowerCorner + Vec3d((i + 0.5) * spacing[0], (j + 0.5) * spacing[1], (k + 0.5) * spacing[2]);
+}
+
+int WeightWindowMesh::findWindow(const Vec3d& pos, const double ergE) const
+{
+    if (!(ergE >= energyEdges.front() && ergE < energyEdges.back()))
+        return -1;
+    int idx[3];
+    for (int d = 0; d < 3; d++)
+    {
+        const double t = (pos[d] - lowerCorner[d]) / spacing[d];
+        if (!(t >= 0 && t < nodes[d]))
+            return -1;
+        idx[d] = std::min(static_cast<int>(t), nodes[d] - 1);
+    }
+    const int e = std::upper_bound(energyEdges.begin(), energyEdges.end(), ergE) - energyEdges.begin() - 1;
+    return ((e * nodes[0] + idx[0]) * nodes[1] + idx[1]) * nodes[2] + idx[2];
+}
+
+double WeightWindowMesh::getLowerBound(const Vec3d& pos, const double ergE) const
+{
+    const int window = findWindow(pos, ergE);
+    return window < 0 ? 0 : lowerBounds[window];
+}
+
+int WeightWindowMesh::apply(Particle& particle, std::vector<Particle>& bank) const
+{
+    const double lowerBound = getLowerBound(particle.pos, particle.ergE);
+    if (lowerBound <= 0)
+        return 1;
+    if (particle.weight > upperRatio * lowerBound)
+    {
+        // split into particles within the window
+        const int n = std::min(maxSplit, static_cast<int>(std::ceil(particle.weight / (upperRatio * lowerBound))));
+        particle.weight /= n;
+        for (int i = 1; i < n; i++)
+            bank.push_back(particle);
+        return n;
+    }
+    if (particle.weight < lowerBound)
+    {
+        // Russian roulette, survivors take the survival weight
+        const double survivalWeight = survivalRatio * lowerBound;
+        if (GlobalUniformRandNumGenerator::GetInstance().generateDouble() * survivalWeight < particle.weight)
+        {
+            particle.weight = survivalWeight;
+            return 1;
+        }
+        particle.weight = 0;
+        return 0;
+    }
+    return 1;
+}
@@ -0,0 +1,198 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <algorithm>
+#include "bank.h"
+#include "watersettings.h"
+
+class BankTest : public ::testing::Test
+{
+protected:
+    static MCSettings createSettings(const Source& source, const int maxScatterN, const double minE)
+    {
+        return createWaterSettings(source, 1000, maxScatterN, minE, 0.01);
+    }
+};
+
+TEST_F(BankTest, replayMatchesLiveScoring)
+{
+    const Cylinder sourceCylinder = createSourceCylinder();
+    const MCSettings config = createSettings(Source(sourceCylinder, std::vector<double>{0.661}, Particle::Photon), 5, 0.1);
+    std::vector<Tally> live{Tally(Sphere(Vec3d(100, 100, 10), 2.54), 100, 0, 1.0, false),
+                            Tally(Sphere(Vec3d(25, -20, 30), 5), 100, 0, 1.0, false)};
+    std::vector<Tally> replayed(live);
+
+    // photons draw no random numbers for scoring, so recording and live scoring see the same histories
+    CollisionBank bank;
+    for (int i = 0; i < config.maxN; i++)
+    {
+        Particle prtl = config.source.createParticle();
+        bank.record(prtl);
+        forceDetection(prtl, config, live);
+        while (prtl.scatterN < config.maxScatterN &&
+               prtl.ergE > config.minE &&
+               prtl.weight > config.minW &&
+               deltaTracking(prtl, config))
+        {
+            prtl.scatterN += 1;
+            bank.record(prtl);
+            forceDetection(prtl, config, live);
+            scattering(prtl, config);
+        }
+        bank.endHistory();
+    }
+    EXPECT_EQ(bank.getNPS(), config.maxN);
+    EXPECT_GT(bank.size(), config.maxN);
+
+    bank.replay(config, replayed);
+    for (std::size_t t = 0; t < live.size(); t++)
+    {
+        for (int i = 0; i < live[t].getNBins(); i++)
+            EXPECT_NEAR(replayed[t].getBinContent(i), live[t].getBinContent(i), 1e-12 * live[t].getBinContent(i));
+    }
+
+    // moved detector, no transport
+    Tally moved(Sphere(Vec3d(-30, 25, 10), 3), 100, 0, 1.0, false);
+    Tally reference(moved);
+    bank.replay(config, moved);
+    for (auto &&event : bank.getEvents())
+    {
+        Particle prtl(event.pos, event.dir, event.ergE, event.weight, event.particleType, event.scatterN, false);
+        prtl.dir = event.dir;
+        forceDetection(prtl, config, reference);
+    }
+    for (int i = 0; i < moved.getNBins(); i++)
+        EXPECT_NEAR(moved.getBinContent(i), reference.getBinContent(i), 1e-12 * reference.getBinContent(i));
+}
+
+TEST_F(BankTest, thermalNeutronsSubsampledOnRecord)
+{
+    const std::shared_ptr<const Shape> sourceSphere = std::make_shared<Sphere>(Vec3d(25, 25, 10), 1);
+    const MCSettings config = createSettings(Source(sourceSphere, std::vector<double>{0.5}, Particle::Neutron), 3, 1e-4);
+    CollisionBank bank;
+    bank.transport(config, config.maxN);
+    EXPECT_EQ(bank.getNPS(), config.maxN);
+    int primaries(0);
+    for (auto &&event : bank.getEvents())
+        primaries += event.scatterN == 0;
+    // all source events, about 1% of the collisions
+    EXPECT_EQ(primaries, config.maxN);
+    EXPECT_LT(bank.size() - primaries, 0.05 * config.maxN * config.maxScatterN);
+
+    // replay is deterministic
+    Tally first(Sphere(Vec3d(75, 75, 10), 2.54), 110, 1e-3, 1e8, true);
+    Tally second(first);
+    bank.replay(config, first);
+    bank.replay(config, second);
+    for (int i = 0; i < first.getNBins(); i++)
+        EXPECT_DOUBLE_EQ(first.getBinContent(i), second.getBinContent(i));
+}
+
+TEST_F(BankTest, saveAndLoad)
+{
+    const Cylinder sourceCylinder = createSourceCylinder();
+    const MCSettings config = createSettings(Source(sourceCylinder, std::vector<double>{0.661}, Particle::Photon), 5, 0.1);
+    CollisionBank bank;
+    bank.transport(config, 100);
+    const std::string fpath = (std::filesystem::temp_directory_path() / "cfdqt_bankTest.bin").string();
+    bank.save(fpath);
+    CollisionBank loaded = CollisionBank::load(fpath);
+    std::filesystem::remove(fpath);
+
+    EXPECT_EQ(loaded.getNPS(), bank.getNPS());
+    ASSERT_EQ(loaded.size(), bank.size());
+    for (std::size_t i = 0; i < bank.size(); i++)
+    {
+        const BankedEvent& a = bank.getEvents()[i];
+        const BankedEvent& b = loaded.getEvents()[i];
+        EXPECT_EQ(a.pos, b.pos);
+        EXPECT_EQ(a.dir, b.dir);
+        EXPECT_EQ(a.ergE, b.ergE);
+        EXPECT_EQ(a.weight, b.weight);
+        EXPECT_EQ(a.time, b.time);
+        EXPECT_EQ(a.scatterN, b.scatterN);
+        EXPECT_EQ(a.particleType, b.particleType);
+    }
+    EXPECT_THROW(CollisionBank::load(getRootDir() + "DATA/H2O.csv"), std::runtime_error);
+}
+
+// mean and standard error per history of the total over all bins of the tallies, run with the source of config
+static void runTotals(const MCSettings& config, std::vector<Tally> tallies, const int nps, double& mean, double& error)
+{
+    double sum(0), squaredSum(0);
+    for (int i = 0; i < nps; i++)
+    {
+        for (auto &&tally : tallies)
+            tally.reset();
+        transportHistory(config.source.createParticle(), config, nullptr, [&config, &tallies](Particle& prtl) {forceDetection(prtl, config, tallies);});
+        double total(0);
+        for (auto &&tally : tallies)
+        {
+            for (int b = 0; b < tally.getNBins(); b++)
+                total += tally.getBinContent(b);
+        }
+        sum += total;
+        squaredSum += total * total;
+    }
+    mean = sum / nps;
+    error = std::sqrt((squaredSum / nps - mean * mean) / nps);
+}
+
+TEST_F(BankTest, sourceReweighting)
+{
+    EXPECT_DOUBLE_EQ(HistoryBank::getEnergyDensity({0.1, 0.5, 1.5}, 0.3, 0.01), 0.5 / 0.4);
+    EXPECT_DOUBLE_EQ(HistoryBank::getEnergyDensity({0.1, 0.5, 1.5}, 1.5, 0.01), 0.5);
+    EXPECT_DOUBLE_EQ(HistoryBank::getEnergyDensity({0.1, 0.5, 1.5}, 1.6, 0.01), 0);
+    EXPECT_DOUBLE_EQ(HistoryBank::getEnergyDensity({0.661}, 0.663, 0.01), 1 / 0.00661);
+    EXPECT_DOUBLE_EQ(HistoryBank::getEnergyDensity({0.661}, 0.665, 0.01), 0);
+
+    const Cylinder sourceCylinder = createSourceCylinder();
+    const int nps = 20000;
+    const MCSettings config = createSettings(Source(sourceCylinder, std::vector<double>{0.1, 1.5}, Particle::Photon), 5, 0.01);
+    const std::vector<Tally> tallies{Tally(Sphere(Vec3d(25, 45, 10), 2.54), 30, 0, 1.5, false)};
+    HistoryBank bank(tallies);
+    EXPECT_THROW(bank.getWeights(config.source), std::runtime_error);
+    bank.transport(config, nps);
+    EXPECT_EQ(bank.getNPS(), nps);
+
+    // the reference itself
+    const std::vector<double> weights = bank.getWeights(config.source);
+    EXPECT_TRUE(std::all_of(weights.begin(), weights.end(), [](double w) {return std::abs(w - 1) < 1e-12;}));
+    const HistoryBank::Diagnostics identity = bank.diagnose(config.source);
+    EXPECT_NEAR(identity.effectiveSampleSize, nps, 1e-6);
+    EXPECT_DOUBLE_EQ(identity.coverage, 1);
+    EXPECT_FALSE(identity.isDegenerate());
+
+    // another spectrum, a smaller source and a line agree with runs of the targets
+    const Cylinder smallerCylinder = Cylinder(Vec3d(25, 25, 8.4478), 3, 1);
+    const std::vector<Source> targets{Source(sourceCylinder, std::vector<double>{0.5, 0.6, 1.2}, Particle::Photon),
+                                      Source(smallerCylinder, std::vector<double>{0.1, 1.5}, Particle::Photon),
+                                      Source(sourceCylinder, std::vector<double>{0.661}, Particle::Photon)};
+    for (std::size_t i = 0; i < targets.size(); i++)
+    {
+        std::vector<Tally> reweighted(tallies);
+        const HistoryBank::Diagnostics diagnostics = bank.reweight(targets[i], reweighted);
+        double sum(0);
+        for (int b = 0; b < reweighted[0].getNBins(); b++)
+            sum += reweighted[0].getBinContent(b);
+        EXPECT_NEAR(diagnostics.total, sum / nps, 1e-12 * sum / nps);
+        EXPECT_NEAR(diagnostics.coverage, 1, 1e-12);
+        EXPECT_NEAR(diagnostics.meanWeight, 1, 5 * std::sqrt(diagnostics.histories / diagnostics.effectiveSampleSize / nps));
+        const MCSettings targetConfig = createSettings(targets[i], 5, 0.01);
+        double mean, error;
+        runTotals(targetConfig, tallies, nps / 4, mean, error);
+        EXPECT_NEAR(diagnostics.total, mean, 4 * std::sqrt(error * error + diagnostics.totalError * diagnostics.totalError));
+    }
+    // few histories are in the 1% wide line
+    const HistoryBank::Diagnostics line = bank.diagnose(targets[2]);
+    EXPECT_TRUE(line.isDegenerate());
+    EXPECT_LT(line.effectiveSampleSize, 0.01 * nps);
+    EXPECT_GT(line.maxWeight, 100);
+    EXPECT_FALSE(bank.diagnose(targets[0]).isDegenerate());
+
+    // targets the reference does not cover
+    EXPECT_NEAR(bank.diagnose(Source(sourceCylinder, std::vector<double>{1, 2}, Particle::Photon)).coverage, 0.5, 1e-12);
+    EXPECT_LT(bank.diagnose(Source(Cylinder(Vec3d(25, 25, 8.4478), 5.63372, 3), std::vector<double>{0.1, 1.5}, Particle::Photon)).coverage, 0.5);
+    EXPECT_THROW(bank.getWeights(Source(sourceCylinder, std::vector<double>{0.1, 1.5}, Particle::Neutron)), std::runtime_error);
+    std::vector<Tally> other{Tally(Sphere(Vec3d(25, 45, 10), 2.54), 10, 0, 1.5, false)};
+    EXPECT_THROW(bank.reweight(targets[0], other), std::runtime_error);
+}
@@ -3,6 +3,9 @@
 #include "cell.h"
 std::string getRootDir()
 {
+#ifdef CFDQT_ROOT_DIR
+    return CFDQT_ROOT_DIR;
+#endif
     std::string cwd = std::filesystem::current_path();
     std::size_t found = cwd.rfind("/build");
     if (found!=std::string::npos)
@@ -15,8 +18,8 @@ std::string getRootDir()
 
 TEST(ParticleTest, constructor)
 {
-    const QVector3D p = QVector3D(0, 0, 0);
-    const QVector3D d = QVector3D(1, 1, 1);
+    const Vec3d p = Vec3d(0, 0, 0);
+    const Vec3d d = Vec3d(1, 1, 1);
     double initE = 0.6617;
     Particle prtl = Particle(p, d, initE, 1.0, Particle::Photon);
 
@@ -24,15 +27,33 @@ TEST(ParticleTest, constructor)
     EXPECT_DOUBLE_EQ(prtl.weight, 1.0);
     EXPECT_EQ(prtl.scatterN, 0);
     EXPECT_FALSE(prtl.escaped);
-    EXPECT_EQ(prtl.pos, QVector3D(0, 0, 0));
-    EXPECT_NEAR(prtl.dir.x(), 1/qSqrt(3), 1e-5);
-    EXPECT_NEAR(prtl.dir.y(), 1/qSqrt(3), 1e-5);
-    EXPECT_NEAR(prtl.dir.z(), 1/qSqrt(3), 1e-5);
+    EXPECT_EQ(prtl.pos, Vec3d(0, 0, 0));
+    EXPECT_NEAR(prtl.dir.x(), 1/std::sqrt(3), 1e-5);
+    EXPECT_NEAR(prtl.dir.y(), 1/std::sqrt(3), 1e-5);
+    EXPECT_NEAR(prtl.dir.z(), 1/std::sqrt(3), 1e-5);
 
-    prtl.move(qSqrt(3));
+    EXPECT_EQ(prtl.time, 0);
+
+    prtl.move(std::sqrt(3));
     EXPECT_NEAR(prtl.pos.x(), 1, 1e-5);
     EXPECT_NEAR(prtl.pos.y(), 1, 1e-5);
     EXPECT_NEAR(prtl.pos.z(), 1, 1e-5);
+    EXPECT_NEAR(prtl.time, std::sqrt(3) / 29.9792458, 1e-12);
+}
+
+TEST(ParticleTest, speed)
+{
+    // 2200 m/s at 0.0253 eV
+    EXPECT_NEAR(Particle::speed(0.0253, Particle::Neutron), 2.2e-4, 1e-6);
+    // 1 MeV, 1.382 cm/ns, slightly below the non-relativistic 1.383 cm/ns
+    EXPECT_NEAR(Particle::speed(1e6, Particle::Neutron), 1.3820, 1e-4);
+    EXPECT_DOUBLE_EQ(Particle::speed(0.6617, Particle::Photon), 29.9792458);
+
+    // 100 cm at 2 MeV
+    Particle prtl(Vec3d(0, 0, 0), Vec3d(0, 0, 1), 2e6, 1.0, Particle::Neutron);
+    prtl.move(60);
+    prtl.move(40);
+    EXPECT_NEAR(prtl.time, 100 / prtl.getSpeed(), 1e-9);
 }
 
 TEST(CellTest, contain)
@@ -41,8 +62,8 @@ TEST(CellTest, contain)
     // std::string rootdir = "/media/ming/DATA/projects/2021_DTRA/cfdneutron/";
     std::string rootdir = getRootDir();
     // initialize gemoetry
-    const Cylinder waterCylinder = Cylinder(QVector3D(25, 25, 0), 52, 21.5);
-    const Cylinder sourceCylinder = Cylinder(QVector3D(25, 25, 8.4478), 5.63372, 1.4097);
+    const Cylinder waterCylinder = Cylinder(Vec3d(25, 25, 0), 52, 21.5);
+    const Cylinder sourceCylinder = Cylinder(Vec3d(25, 25, 8.4478), 5.63372, 1.4097);
     // load cross-section tables
     const PhotonCrossSection photonCrossSection(rootdir+"DATA/H2O.csv");
     const NeutronCrossSection H1NeutronCrossSection(rootdir+"DATA/H1-total-cross-section.txt",
@@ -60,10 +81,10 @@ TEST(CellTest, contain)
     // initialize cell
     const Cell waterCell = Cell(water, waterDensity, waterCylinder);
 
-    Particle prtl = Particle(QVector3D(10, 10, 20), QVector3D(1, 1, 1), 0.6617, 1.0, Particle::Photon);
+    Particle prtl = Particle(Vec3d(10, 10, 20), Vec3d(1, 1, 1), 0.6617, 1.0, Particle::Photon);
     EXPECT_TRUE(waterCell.contains(prtl));
 
-    prtl = Particle(QVector3D(0, 0, 20), QVector3D(1, 1, 1), 0.6617, 1.0, Particle::Photon);
+    prtl = Particle(Vec3d(0, 0, 20), Vec3d(1, 1, 1), 0.6617, 1.0, Particle::Photon);
     EXPECT_FALSE(waterCell.contains(prtl));
 }
 
@@ -71,7 +92,7 @@ TEST(SourceTest, createMonoenergeticParticle)
 {
     // initialize source
     std::vector<double> srcEnergyCDF{0.661}; // eV for neutron, MeV for gamma
-    const Cylinder sourceCylinder = Cylinder(QVector3D(25, 25, 8.4478), 5.63372, 1.4097);
+    const Cylinder sourceCylinder = Cylinder(Vec3d(25, 25, 8.4478), 5.63372, 1.4097);
     const Source source = Source(sourceCylinder, srcEnergyCDF, Particle::Photon);
 
     Particle prtl = source.createParticle();
@@ -86,7 +107,7 @@ TEST(SourceTest, createDistributedParticle)
     std::vector<double> srcEnergyCDF{0, 0.478702, 0.817756, 1.15082,
                                     1.50133,1.88769,2.33337,2.87784,
                                     3.60501,4.77086,10.0}; // eV for neutron, MeV for gamma
-    const Cylinder sourceCylinder = Cylinder(QVector3D(25, 25, 8.4478), 5.63372, 1.4097);
+    const Cylinder sourceCylinder = Cylinder(Vec3d(25, 25, 8.4478), 5.63372, 1.4097);
     const Source source = Source(sourceCylinder, srcEnergyCDF, Particle::Photon);
 
     std::ofstream fileptr;
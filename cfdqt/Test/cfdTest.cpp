@@ -0,0 +1,364 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include "cfd.h"
+#include "watersettings.h"
+
+class CFDTest : public ::testing::Test
+{
+protected:
+    static MCSettings* config;
+    static void SetUpTestSuite()
+    {
+        config = new MCSettings(createWaterSettings({0.661}, Particle::Photon, 1, 5, 0.1, 0.01));
+    }
+    static void TearDownTestSuite()
+    {
+        delete config;
+        config = nullptr;
+    }
+    static std::vector<Tally> createTallies(const double lower, const double upper, const bool letharg)
+    {
+        return {Tally(Sphere(Vec3d(100, 100, 10), 2.54), 100, lower, upper, letharg),
+                Tally(Sphere(Vec3d(-50, 25, 30), 5), 50, lower, upper, letharg),
+                Tally(Sphere(Vec3d(25, 25, 10), 1), 100, lower, upper, letharg)};
+    }
+};
+MCSettings* CFDTest::config = nullptr;
+
+double totalCounts(const Tally& tally)
+{
+    const std::vector<double> counts = tally.getBinContents();
+    return std::accumulate(counts.begin(), counts.end(), 0.0);
+}
+
+TEST_F(CFDTest, photonMultipleTallies)
+{
+    std::vector<Tally> single = createTallies(0, 1, false);
+    std::vector<Tally> multiple = createTallies(0, 1, false);
+    const std::vector<Particle> particles{
+        Particle(Vec3d(25, 25, 9), Vec3d(1, 1, 0), 0.6617, 1.0, Particle::Photon),
+        Particle(Vec3d(30, 20, 12), Vec3d(-1, 0.2, 0.5), 0.6617, 1.0, Particle::Photon),
+        Particle(Vec3d(20, 30, 40), Vec3d(0, 0, -1), 0.3, 0.5, Particle::Photon)};
+    for (int scatterN = 0; scatterN < 2; scatterN++)
+    {
+        for (Particle prtl : particles)
+        {
+            prtl.scatterN = scatterN;
+            for (auto &&tally : single)
+                forceDetection(prtl, *config, tally);
+            forceDetection(prtl, *config, multiple);
+        }
+    }
+    for (std::size_t t = 0; t < single.size(); t++)
+    {
+        EXPECT_GT(totalCounts(multiple[t]), 0);
+        for (int i = 0; i < single[t].getNBins(); i++)
+            EXPECT_DOUBLE_EQ(single[t].getBinContent(i), multiple[t].getBinContent(i));
+    }
+}
+
+TEST_F(CFDTest, neutronMultipleTallies)
+{
+    std::vector<Tally> single = createTallies(1e-3, 1e8, true);
+    std::vector<Tally> multiple = createTallies(1e-3, 1e8, true);
+    Particle prtl(Vec3d(30, 20, 12), Vec3d(-1, 0.2, 0.5), 2e6, 1.0, Particle::Neutron);
+    prtl.scatterN = 1;
+    for (auto &&tally : single)
+        forceDetection(prtl, *config, tally);
+    forceDetection(prtl, *config, multiple);
+    for (std::size_t t = 0; t < single.size(); t++)
+    {
+        EXPECT_GT(totalCounts(multiple[t]), 0);
+        for (int i = 0; i < single[t].getNBins(); i++)
+            EXPECT_DOUBLE_EQ(single[t].getBinContent(i), multiple[t].getBinContent(i));
+    }
+}
+
+TEST_F(CFDTest, thermalNeutronSampledOncePerCollision)
+{
+    // two identical tallies, scored or skipped together
+    std::vector<Tally> tallies(2, Tally(Sphere(Vec3d(100, 100, 10), 2.54), 110, 1e-3, 1e8, true));
+    Particle prtl(Vec3d(30, 20, 12), Vec3d(-1, 0.2, 0.5), 0.05, 1.0, Particle::Neutron);
+    prtl.scatterN = 3;
+    for (int i = 0; i < 1000; i++)
+        forceDetection(prtl, *config, tallies);
+    EXPECT_GT(totalCounts(tallies[0]), 0);
+    for (int i = 0; i < tallies[0].getNBins(); i++)
+        EXPECT_DOUBLE_EQ(tallies[0].getBinContent(i), tallies[1].getBinContent(i));
+}
+
+TEST_F(CFDTest, scoreBins)
+{
+    // scoring by bin index is the same as filling particles at the bin centers
+    Tally filled(Sphere(Vec3d(100, 100, 10), 2.54), 110, 1e-3, 1e8, true);
+    filled.setTimeBins(100, 0, 100);
+    Tally scored(filled);
+    Particle prtl(Vec3d(30, 20, 12), Vec3d(-1, 0.2, 0.5), 0, 0.5, Particle::Neutron);
+    const std::vector<int> bins{0, 3, 3, 50};
+    const std::vector<double> weights{0.1, 0.2, 0.3, 0.4};
+    const std::vector<double> times{1, 2, 3, 40};
+    for (std::size_t i = 0; i < bins.size(); i++)
+    {
+        prtl.ergE = filled.getBinCenter(bins[i]);
+        prtl.time = times[i];
+        filled.Fill(prtl, weights[i] / prtl.weight);
+    }
+    scored.scoreBins(bins, weights, times);
+    for (int i = 0; i < filled.getNBins(); i++)
+        EXPECT_DOUBLE_EQ(scored.getBinContent(i), filled.getBinContent(i));
+    EXPECT_DOUBLE_EQ(scored.getBinContent(3, 3), 0.3);
+    EXPECT_EQ(scored.getTimeHistogram().getNFilledBins(), 4);
+}
+
+TEST_F(CFDTest, thermalNeutronDifferentBinnings)
+{
+    // thermal bins are taken from each tally, not from the first one scored
+    std::vector<Tally> tallies{Tally(Sphere(Vec3d(100, 100, 10), 2.54), 110, 1e-3, 1e8, true),
+                               Tally(Sphere(Vec3d(100, 100, 10), 2.54), 22, 1e-3, 1e8, true)};
+    Particle prtl(Vec3d(30, 20, 12), Vec3d(-1, 0.2, 0.5), 0.05, 1.0, Particle::Neutron);
+    prtl.scatterN = 3;
+    for (int i = 0; i < 1000; i++)
+        forceDetection(prtl, *config, tallies);
+    for (auto &&tally : tallies)
+    {
+        for (int i = 0; i < tally.getNBins(); i++)
+        {
+            if (tally.getBinCenter(i) < 1)
+                EXPECT_GT(tally.getBinContent(i), 0);
+            else
+                EXPECT_EQ(tally.getBinContent(i), 0);
+        }
+    }
+}
+
+TEST_F(CFDTest, timeOfFlight)
+{
+    // uncollided photon emitted at 2 ns, 75 cm from the detector center
+    Tally photonTally(Sphere(Vec3d(100, 25, 9), 2.54), 100, 0, 1);
+    photonTally.setTimeBins(100, 0, 10);
+    Particle photon(Vec3d(25, 25, 9), Vec3d(1, 0, 0), 0.6617, 1.0, Particle::Photon);
+    photon.time = 2;
+    forceDetection(photon, *config, photonTally);
+    EXPECT_GT(totalCounts(photonTally), 0);
+    EXPECT_EQ(photonTally.getTimeHistogram().getNFilledBins(), 1);
+    EXPECT_DOUBLE_EQ(photonTally.getTimeSpectrum()[int((2 + 75 / 29.9792458) / 0.1)], totalCounts(photonTally));
+
+    // neutron scattered towards a detector
+    std::vector<Tally> tallies = createTallies(1e-3, 1e8, true);
+    for (auto &&tally : tallies)
+        tally.setTimeBins(2000, 0, 1000);
+    Particle neutron(Vec3d(30, 20, 12), Vec3d(-1, 0.2, 0.5), 2e6, 1.0, Particle::Neutron);
+    neutron.scatterN = 1;
+    neutron.time = 10;
+    forceDetection(neutron, *config, tallies);
+    const Tally& tally = tallies[0];
+    // same counts as the energy tally when summed over time
+    const std::vector<double> energySpectrum = tally.getTimeHistogram().projectionX();
+    for (int i = 0; i < tally.getNBins(); i++)
+        EXPECT_NEAR(energySpectrum[i], tally.getBinContent(i), 1e-12 * tally.getBinContent(i));
+    // nothing arrives before a 2 MeV neutron would
+    const double earliest = 10 + (tally.getCenter() - neutron.pos).length() / neutron.getSpeed();
+    const std::vector<double> timeSpectrum = tally.getTimeSpectrum();
+    EXPECT_GT(std::accumulate(timeSpectrum.begin(), timeSpectrum.end(), 0.0), 0);
+    for (int i = 0; i < tally.getNTimeBins(); i++)
+    {
+        if (timeSpectrum[i] > 0)
+        {
+            EXPECT_GE(tally.getTimeBinCenter(i) + 0.5 * tally.getTimeBinWidth(), earliest);
+        }
+    }
+    // lower energies arrive later
+    for (int i = 0; i + 1 < tally.getNBins(); i++)
+    {
+        for (int j = 0; j < tally.getNTimeBins(); j++)
+        {
+            if (tally.getBinContent(i, j) > 0)
+            {
+                EXPECT_GT(tally.getTimeBinCenter(j), (tally.getCenter() - neutron.pos).length() / 
+                          Particle::speed(tally.getBinCenter(i + 1), Particle::Neutron));
+            }
+        }
+    }
+}
+
+TEST_F(CFDTest, pointDetector)
+{
+    // a small sphere far away scores like a point
+    const Vec3d center(100, 100, 10);
+    std::vector<Tally> photonTallies{Tally(Sphere(center, 0.2), 100, 0, 1), Tally(Detector(center, 1), 100, 0, 1)};
+    std::vector<Tally> neutronTallies{Tally(Sphere(center, 0.2), 110, 1e-3, 1e8, true), Tally(Detector(center, 1), 110, 1e-3, 1e8, true)};
+    Particle photon(Vec3d(30, 20, 12), Vec3d(-1, 0.2, 0.5), 0.6617, 1.0, Particle::Photon);
+    photon.scatterN = 1;
+    forceDetection(photon, *config, photonTallies);
+    Particle neutron(Vec3d(30, 20, 12), Vec3d(-1, 0.2, 0.5), 2e6, 1.0, Particle::Neutron);
+    neutron.scatterN = 1;
+    forceDetection(neutron, *config, neutronTallies);
+    for (auto &&tallies : {photonTallies, neutronTallies})
+    {
+        EXPECT_GT(totalCounts(tallies[1]), 0);
+        for (int i = 0; i < tallies[0].getNBins(); i++)
+            EXPECT_NEAR(tallies[1].getBinContent(i), tallies[0].getBinContent(i), 1e-5 * tallies[0].getBinContent(i));
+    }
+
+    // uncollided, forced towards the point whatever the source direction, 21.5 cm of water on the way
+    Tally point(Detector(Vec3d(60, 25, 9), 1), 100, 0, 1);
+    Particle source(Vec3d(25, 25, 9), Vec3d(0, 0, 1), 0.6617, 1.0, Particle::Photon);
+    forceDetection(source, *config, point);
+    const double expected = std::exp(-21.5 * config->cells[0].material.getPhotonTotalAtten(0.6617)) / (4 * M_PI * 35 * 35);
+    EXPECT_NEAR(totalCounts(point), expected, 1e-9 * expected);
+
+    // within the exclusion sphere
+    point.reset();
+    point.setRadius(40);
+    forceDetection(source, *config, point);
+    EXPECT_NEAR(totalCounts(point), expected * 3 * 35 * 35 / (40 * 40), 1e-9 * expected);
+}
+
+TEST_F(CFDTest, uncollidedFlux)
+{
+    // sampled primary contributions of the source, a sphere, a box, a cylinder and a point
+    std::vector<Tally> tallies{Tally(Sphere(Vec3d(60, 25, 10), 10), 100, 0, 1),
+                               Tally(Detector(Box(Transform(Vec3d(25, 60, 10)), Vec3d(5, 8, 10))), 100, 0, 1),
+                               Tally(Detector(Cylinder(Vec3d(-10, 25, 0), Vec3d(0, 5, 20), 8)), 100, 0, 1),
+                               Tally(Detector(Vec3d(100, 100, 10), 0), 100, 0, 1)};
+    const int n = 1000000;
+    std::vector<double> sums(tallies.size(), 0), squaredSums(tallies.size(), 0);
+    for (int i = 0; i < n; i++)
+    {
+        std::vector<double> previous(tallies.size());
+        for (std::size_t t = 0; t < tallies.size(); t++)
+            previous[t] = totalCounts(tallies[t]);
+        Particle prtl = config->source.createParticle();
+        forceDetection(prtl, *config, tallies);
+        for (std::size_t t = 0; t < tallies.size(); t++)
+        {
+            const double score = totalCounts(tallies[t]) - previous[t];
+            sums[t] += score;
+            squaredSums[t] += score * score;
+        }
+    }
+    for (std::size_t t = 0; t < tallies.size(); t++)
+    {
+        const UncollidedFlux uncollided(*config, tallies[t], 1e-4);
+        const double mean = sums[t] / n;
+        const double error = std::sqrt((squaredSums[t] / n - mean * mean) / n);
+        EXPECT_GT(uncollided.getTotal(), 0);
+        EXPECT_NEAR(uncollided.getTotal(), mean, 4 * error) << "tally " << t;
+        EXPECT_LT(uncollided.getErrorEstimate(), 1e-4 * uncollided.getTotal());
+        EXPECT_NEAR(totalCounts(uncollided.getFlux()), uncollided.getTotal(), 1e-12 * uncollided.getTotal());
+        // the photopeak bin only
+        EXPECT_DOUBLE_EQ(uncollided.getFlux().getBinContent(66), uncollided.getTotal());
+        Tally added(tallies[t]);
+        added.reset();
+        uncollided.addTo(added, 1000);
+        EXPECT_NEAR(totalCounts(added), 1000 * uncollided.getTotal(), 1e-9 * uncollided.getTotal());
+    }
+
+    // same flux spread over the arrival times
+    Tally timed(tallies[0]);
+    timed.setTimeBins(100, 0, 10);
+    const UncollidedFlux uncollided(*config, timed, 1e-3);
+    const std::vector<double> timeSpectrum = uncollided.getFlux().getTimeSpectrum();
+    EXPECT_NEAR(std::accumulate(timeSpectrum.begin(), timeSpectrum.end(), 0.0), uncollided.getTotal(), 1e-9 * uncollided.getTotal());
+    EXPECT_GT(uncollided.getFlux().getTimeHistogram().getNFilledBins(), 1);
+    EXPECT_THROW(uncollided.addTo(tallies[0], 1), std::runtime_error);
+    EXPECT_THROW(UncollidedFlux(*config, tallies[0], 0), std::runtime_error);
+}
+
+TEST_F(CFDTest, uncollidedFluxTwoMaterials)
+{
+    // the water above z = 26 cm is lighter, and the rays to the detectors cross both cells
+    const Material& water = config->cells[0].material;
+    const Material lightWater(0.2, 18, water.getNuclideComposition());
+    const std::vector<Cell> cells{Cell(water, 0.99, Cylinder(Vec3d(25, 25, 0), 26, 21.5)),
+                                  Cell(lightWater, 0.2, Cylinder(Vec3d(25, 25, 26), 26, 21.5))};
+    const MCSettings twoCells(Cylinder(Vec3d(25, 25, 0), 52, 21.5), cells, config->source, 1, 5, 0.01, 0.1);
+    // small detectors of the sphere, box and cylinder rules, whose flux is that at their common center
+    const Vec3d center(60, 25, 60);
+    const UncollidedFlux point(twoCells, Tally(Detector(center, 0), 100, 0, 1), 1e-4);
+    const UncollidedFlux uniform(*config, Tally(Detector(center, 0), 100, 0, 1), 1e-4);
+    EXPECT_GT(point.getTotal(), 2 * uniform.getTotal());
+    const std::vector<Tally> tallies{Tally(Sphere(center, 0.5), 100, 0, 1),
+                                     Tally(Detector(Box(Transform(center), Vec3d(0.5, 0.5, 0.5))), 100, 0, 1),
+                                     Tally(Detector(Cylinder(center - Vec3d(0, 0, 0.5), Vec3d(0, 0, 1), 0.5)), 100, 0, 1)};
+    for (std::size_t t = 0; t < tallies.size(); t++)
+    {
+        const UncollidedFlux uncollided(twoCells, tallies[t], 1e-4);
+        EXPECT_NEAR(uncollided.getTotal(), point.getTotal(), 1e-2 * point.getTotal()) << "tally " << t;
+    }
+
+    // the sampled primary contributions attenuate through both cells too
+    std::vector<Tally> large{Tally(Sphere(center, 5), 100, 0, 1),
+                             Tally(Detector(Box(Transform(center), Vec3d(4, 4, 4))), 100, 0, 1)};
+    const int n = 400000;
+    std::vector<double> sums(large.size(), 0), squaredSums(large.size(), 0);
+    for (int i = 0; i < n; i++)
+    {
+        std::vector<double> previous(large.size());
+        for (std::size_t t = 0; t < large.size(); t++)
+            previous[t] = totalCounts(large[t]);
+        Particle prtl = twoCells.source.createParticle();
+        forceDetection(prtl, twoCells, large);
+        for (std::size_t t = 0; t < large.size(); t++)
+        {
+            const double score = totalCounts(large[t]) - previous[t];
+            sums[t] += score;
+            squaredSums[t] += score * score;
+        }
+    }
+    for (std::size_t t = 0; t < large.size(); t++)
+    {
+        const UncollidedFlux uncollided(twoCells, large[t], 1e-4);
+        const double mean = sums[t] / n;
+        const double error = std::sqrt((squaredSums[t] / n - mean * mean) / n);
+        EXPECT_NEAR(uncollided.getTotal(), mean, 4 * error) << "tally " << t;
+        EXPECT_LT(error, 0.05 * mean) << "tally " << t;
+    }
+}
+
+TEST(HistogramTest, findBin)
+{
+    // every x falls in the bin whose edges contain it, whatever the spacing
+    const std::vector<Histogram> hists{Histogram(100, 0, 1), Histogram::logarithmic(110, 1e-3, 1e8),
+                                       Histogram({0, 1e-3, 1e-2, 1e-1, 1, 10}), Histogram({0.01, 0.02, 0.1, 0.662, 0.7})};
+    EXPECT_EQ(hists[0].getSpacing(), Histogram::Uniform);
+    EXPECT_EQ(hists[1].getSpacing(), Histogram::Logarithmic);
+    // log bins after a first bin from 0, as on MCNP E cards
+    EXPECT_EQ(hists[2].getSpacing(), Histogram::Logarithmic);
+    EXPECT_EQ(hists[3].getSpacing(), Histogram::Irregular);
+    for (auto &&hist : hists)
+    {
+        const std::vector<double>& edges = hist.getBinEdges();
+        ASSERT_EQ(edges.size(), hist.getNBins() + 1);
+        EXPECT_EQ(hist.findBin(std::nextafter(edges[0], -1.0)), -1);
+        EXPECT_EQ(hist.findBin(edges.back()), -1);
+        for (int i = 0; i < hist.getNBins(); i++)
+        {
+            EXPECT_EQ(hist.findBin(edges[i]), i);
+            EXPECT_EQ(hist.findBin(std::nextafter(edges[i + 1], edges[i])), i);
+            EXPECT_EQ(hist.findBin(0.5 * (edges[i] + edges[i + 1])), i);
+            EXPECT_NEAR(hist.getBinWidth(i), edges[i + 1] - edges[i], 1e-12 * edges[i + 1]);
+        }
+    }
+    // geometric centers for log bins
+    EXPECT_NEAR(hists[1].getBinCenter(0), std::pow(10, -3 + 0.05), 1e-12);
+    EXPECT_NEAR(hists[2].getBinCenter(2), std::sqrt(1e-3), 1e-12);
+    EXPECT_DOUBLE_EQ(hists[2].getBinCenter(0), 5e-4);
+
+    Histogram hist({0.01, 0.02, 0.1, 0.662, 0.7});
+    EXPECT_TRUE(hist.fill(0.5, 2));
+    EXPECT_FALSE(hist.fill(0.7));
+    EXPECT_DOUBLE_EQ(hist.getBinContent(2), 2);
+    EXPECT_THROW(Histogram({1, 0.5}), std::runtime_error);
+
+    // counts are added only between the same bin edges, and are part of the total
+    Histogram other({0.01, 0.02, 0.1, 0.662, 0.7});
+    other.fill(0.05, 3);
+    hist.add(other);
+    EXPECT_DOUBLE_EQ(hist.getBinContent(1), 3);
+    EXPECT_EQ(hist.getTotalCounts(), 5);
+    EXPECT_THROW(hist.add(Histogram({0.01, 0.03, 0.1, 0.662, 0.7})), std::runtime_error);
+    hist.addBinContents({1, 0, 0, 4});
+    EXPECT_DOUBLE_EQ(hist.getBinContent(3), 4);
+    EXPECT_EQ(hist.getTotalCounts(), 10);
+}
@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include "detector.h"
+
+/**
+ * @brief Integral of 1/r^2 over a box centered at the origin, in the box frame, by the midpoint rule
+ */
+double boxIntegral(const Vec3d& halfWidths, const Vec3d& p, const int n)
+{
+    double sum(0);
+    const Vec3d h = 2.0 / n * halfWidths;
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < n; j++)
+            for (int k = 0; k < n; k++)
+            {
+                const Vec3d x(-halfWidths.x() + (i + 0.5) * h.x(), -halfWidths.y() + (j + 0.5) * h.y(), -halfWidths.z() + (k + 0.5) * h.z());
+                sum += 1 / (x - p).lengthSquared();
+            }
+    return sum * h.x() * h.y() * h.z();
+}
+
+/**
+ * @brief Integral of 1/r^2 over a cylinder centered at the origin along z, by the midpoint rule
+ */
+double cylinderIntegral(const double radius, const double height, const Vec3d& p, const int n)
+{
+    double sum(0);
+    const double dr = radius / n, dphi = 2 * M_PI / (2 * n), dz = height / n;
+    for (int i = 0; i < n; i++)
+        for (int j = 0; j < 2 * n; j++)
+            for (int k = 0; k < n; k++)
+            {
+                const double r = (i + 0.5) * dr, phi = (j + 0.5) * dphi;
+                const Vec3d x(r * std::cos(phi), r * std::sin(phi), -height / 2 + (k + 0.5) * dz);
+                sum += r / (x - p).lengthSquared();
+            }
+    return sum * dr * dphi * dz;
+}
+
+TEST(GeometryFactorTableTest, sphereChordIntegral)
+{
+    const Detector detector(Sphere(Vec3d(1, 2, 3), 2));
+    const Sphere sphere(Vec3d(1, 2, 3), 2);
+    for (const Vec3d& p : {Vec3d(10, 2, 3), Vec3d(1, 5, 3), Vec3d(-20, 30, 3)})
+    {
+        const double G = GeometryFactorTable::integrateChordLengths(sphere, p, Vec3d(1, 2, 3), 2);
+        EXPECT_NEAR(G / (2 * M_PI), detector.chordIntegral(p), 1e-6 * G);
+    }
+}
+
+TEST(DetectorTest, cylinder)
+{
+    // EJ-309 cell along x, 5.08 cm diameter and 5.08 cm long
+    const Cylinder cylinder(Vec3d(100, 0, 0), Vec3d(5.08, 0, 0), 2.54);
+    const Detector detector(cylinder);
+    EXPECT_EQ(detector.getCenter(), Vec3d(102.54, 0, 0));
+    EXPECT_NEAR(detector.getVolume(), M_PI * 2.54 * 2.54 * 5.08, 1e-9);
+    EXPECT_NEAR(detector.getRadius(), std::sqrt(2) * 2.54, 1e-12);
+
+    // points in the cylinder frame (z along the axis) relative to the center
+    for (const Vec3d& local : {Vec3d(0, 0, 100), Vec3d(0, 8, 0), Vec3d(3, 4, 5), Vec3d(0, 3, 3), Vec3d(1, 0, 3.2)})
+    {
+        const Vec3d p = detector.getCenter() + Vec3d(local.z(), local.x(), local.y());
+        const double expected = cylinderIntegral(2.54, 5.08, local, 60) / (2 * M_PI);
+        EXPECT_NEAR(detector.chordIntegral(p), expected, 0.01 * expected) << local.x() << " " << local.y() << " " << local.z();
+    }
+    // point detector limit
+    const Vec3d far = detector.getCenter() + Vec3d(300, 400, 0);
+    EXPECT_NEAR(detector.chordIntegral(far), detector.getVolume() / (2 * M_PI * 500 * 500), 1e-3 * detector.chordIntegral(far));
+
+    // chord along the axis
+    EXPECT_NEAR(detector.chordLength(Ray(Vec3d(0, 1, 1), Vec3d(1, 0, 0))), 5.08, 1e-12);
+    EXPECT_THROW(Detector(detector).setRadius(1), std::runtime_error);
+}
+
+TEST(DetectorTest, rotatedBox)
+{
+    // NaI-like box, 5 x 10 x 40 cm, rotated about z by 30 degrees
+    const Vec3d halfWidths(2.5, 5, 20);
+    const Mat3 rot = Transform::rotation(Vec3d(0, 0, 1), M_PI / 6);
+    const Box box(Transform(rot, Vec3d(50, -20, 10)), halfWidths);
+    const Detector detector(box);
+    EXPECT_EQ(detector.getCenter(), Vec3d(50, -20, 10));
+    EXPECT_NEAR(detector.getVolume(), 2000, 1e-9);
+
+    for (const Vec3d& local : {Vec3d(30, 0, 0), Vec3d(4, 7, 0), Vec3d(-3, 2, 25), Vec3d(10, -10, 10), Vec3d(0, 6, 0)})
+    {
+        const Vec3d p = detector.getCenter() + rot * local;
+        const double expected = boxIntegral(halfWidths, local, 80) / (2 * M_PI);
+        EXPECT_NEAR(detector.chordIntegral(p), expected, 0.002 * expected) << local.x() << " " << local.y() << " " << local.z();
+    }
+    // moving the detector moves the table with it
+    Detector moved(detector);
+    moved.setCenter(Vec3d(0, 0, 0));
+    EXPECT_NEAR(moved.chordIntegral(rot * Vec3d(4, 7, 0)), detector.chordIntegral(detector.getCenter() + rot * Vec3d(4, 7, 0)), 1e-12);
+    EXPECT_NEAR(moved.chordLength(Ray(Vec3d(0, 0, -100), Vec3d(0, 0, 1))), 40, 1e-9);
+
+    EXPECT_THROW(Detector(Box(Transform(Mat3::diagonal(Vec3d(1, 2, 1)), Vec3d(0, 0, 0)), halfWidths)), std::runtime_error);
+}
+
+TEST(DetectorTest, point)
+{
+    Detector detector(Vec3d(10, 0, 0), 2);
+    EXPECT_EQ(detector.getType(), Detector::PointDetector);
+    EXPECT_EQ(detector.getVolume(), 0);
+    EXPECT_EQ(detector.chordLength(Ray(Vec3d(0, 0, 0), Vec3d(1, 0, 0))), 0);
+    EXPECT_DOUBLE_EQ(detector.pointFactor(Vec3d(10, 3, 4)), 1 / (2 * M_PI * 25));
+    // uniform collision density within the exclusion sphere
+    EXPECT_DOUBLE_EQ(detector.pointFactor(Vec3d(10, 1, 1)), 3 / (2 * M_PI * 4));
+    detector.setRadius(0.5);
+    EXPECT_DOUBLE_EQ(detector.pointFactor(Vec3d(10, 1, 1)), 1 / (2 * M_PI * 2));
+
+    // limit of a small sphere far away
+    const Detector sphere(Sphere(Vec3d(10, 0, 0), 0.1));
+    EXPECT_NEAR(sphere.chordIntegral(Vec3d(-90, 0, 0)) / sphere.getVolume(), detector.pointFactor(Vec3d(-90, 0, 0)),
+                1e-5 * detector.pointFactor(Vec3d(-90, 0, 0)));
+}
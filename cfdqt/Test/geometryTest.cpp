@@ -1,25 +1,26 @@
 #include <gtest/gtest.h>
+#include <stdexcept>
 #include "geometry.h"
 
 TEST(RayTest, constructor)
 {
-    QVector3D p = QVector3D(1, 1, 1);
-    QVector3D d = QVector3D(1, 1, 1);
+    Vec3d p = Vec3d(1, 1, 1);
+    Vec3d d = Vec3d(1, 1, 1);
     Ray ray = Ray(p, d);
     EXPECT_EQ(ray.getOrigin(), p);
-    EXPECT_NEAR(ray.getDirection().x(), d.x() / qSqrt(3), 1e-5);
-    EXPECT_NEAR(ray.getDirection().y(), d.y() / qSqrt(3), 1e-5);
-    EXPECT_NEAR(ray.getDirection().z(), d.z() / qSqrt(3), 1e-5);
+    EXPECT_NEAR(ray.getDirection().x(), d.x() / std::sqrt(3), 1e-5);
+    EXPECT_NEAR(ray.getDirection().y(), d.y() / std::sqrt(3), 1e-5);
+    EXPECT_NEAR(ray.getDirection().z(), d.z() / std::sqrt(3), 1e-5);
 }
 
 TEST(CylinderTest, constructor)
 {
-    QVector3D baseP = QVector3D(1, 1, 1);
+    Vec3d baseP = Vec3d(1, 1, 1);
     double h(1);
     double r(1);
     Cylinder cyl = Cylinder(baseP, h, r);
     EXPECT_EQ(cyl.getBaseCenter(), baseP);
-    QVector3D axis = cyl.getAxis();
+    Vec3d axis = cyl.getAxis();
     EXPECT_DOUBLE_EQ(axis.x(), 0);
     EXPECT_DOUBLE_EQ(axis.y(), 0);
     EXPECT_DOUBLE_EQ(axis.z(), h);
@@ -29,44 +30,196 @@ TEST(CylinderTest, constructor)
 
 TEST(CylinderTest, contain)
 {
-    QVector3D baseP = QVector3D(1, 1, 1);
+    Vec3d baseP = Vec3d(1, 1, 1);
     double h(1);
     double r(1);
     Cylinder cyl = Cylinder(baseP, h, r);
 
-    QVector3D p1 = QVector3D(1.5, 1.5, 1.5);
+    Vec3d p1 = Vec3d(1.5, 1.5, 1.5);
     EXPECT_TRUE(cyl.contain(p1));
 
-    QVector3D p2 = QVector3D(1.5, 2.5, 1.5);
+    Vec3d p2 = Vec3d(1.5, 2.5, 1.5);
     EXPECT_FALSE(cyl.contain(p2));
 
-    QVector3D p3 = QVector3D(1.5, 1.5, 1);
+    Vec3d p3 = Vec3d(1.5, 1.5, 1);
     EXPECT_FALSE(cyl.contain(p3));
 }
 
 TEST(CylinderTest, intersection)
 {
-    QVector3D baseP = QVector3D(0, 0, 1);
+    Vec3d baseP = Vec3d(0, 0, 1);
     double h(3);
     double r(1);
     Cylinder cyl = Cylinder(baseP, h, r);
 
-    QVector3D p = QVector3D(0, 0, 1.5);
-    QVector3D d = QVector3D(3, 3, 1.5) - p;
+    Vec3d p = Vec3d(0, 0, 1.5);
+    Vec3d d = Vec3d(3, 3, 1.5) - p;
     Ray ray = Ray(p, d);
     EXPECT_DOUBLE_EQ(cyl.intersection(ray), cyl.getRadius());
 
-    p = QVector3D(0, 0, 2.5);
-    d = QVector3D(3, 3, 1.5) - p;
+    p = Vec3d(0, 0, 2.5);
+    d = Vec3d(3, 3, 1.5) - p;
     ray = Ray(p, d);
-    double t = 1/qSqrt(2) / 3;
+    double t = 1/std::sqrt(2) / 3;
     // EXPECT_DOUBLE_EQ(cyl.intersection(ray), t * d.length() );
     EXPECT_NEAR(cyl.intersection(ray), t * d.length(), 1e-5);
 }
 
+TEST(CylinderTest, segments)
+{
+    Vec3d baseP = Vec3d(0, 0, 1);
+    double h(3);
+    double r(1);
+    Cylinder cyl = Cylinder(baseP, h, r);
+
+    // origin outside, crossing the side surface
+    Ray ray = Ray(Vec3d(-5, 0, 2), Vec3d(1, 0, 0));
+    std::vector<Segment> segs = cyl.segments(ray);
+    ASSERT_EQ(segs.size(), 1);
+    EXPECT_NEAR(segs[0].tIn, 4, 1e-9);
+    EXPECT_NEAR(segs[0].tOut, 6, 1e-9);
+
+    // parallel to the axis, crossing both end caps
+    ray = Ray(Vec3d(0.5, 0, -1), Vec3d(0, 0, 1));
+    segs = cyl.segments(ray);
+    ASSERT_EQ(segs.size(), 1);
+    EXPECT_NEAR(segs[0].tIn, 2, 1e-9);
+    EXPECT_NEAR(segs[0].tOut, 5, 1e-9);
+
+    // parallel to the axis, origin inside
+    ray = Ray(Vec3d(0, 0.5, 2), Vec3d(0, 0, -1));
+    EXPECT_NEAR(cyl.intersection(ray), 1, 1e-9);
+
+    // parallel to the axis, outside the radius
+    ray = Ray(Vec3d(2, 0, -1), Vec3d(0, 0, 1));
+    EXPECT_TRUE(cyl.segments(ray).empty());
+    EXPECT_DOUBLE_EQ(cyl.intersection(ray), 0);
+
+    // origin inside, leaving through the top cap
+    ray = Ray(Vec3d(0, 0, 3), Vec3d(0.1, 0, 1));
+    Segment seg;
+    ASSERT_TRUE(cyl.intersect(ray, seg));
+    EXPECT_DOUBLE_EQ(seg.tIn, 0);
+    EXPECT_NEAR(seg.tOut, std::sqrt(1.01), 1e-6);
+
+    // pointing away from the cylinder
+    ray = Ray(Vec3d(-5, 0, 2), Vec3d(-1, 0, 0));
+    EXPECT_FALSE(cyl.intersect(ray, seg));
+}
+
+TEST(CylinderTest, arbitraryAxis)
+{
+    // cylinder along x, from x = 1 to x = 5
+    Cylinder cyl = Cylinder(Vec3d(1, 0, 0), Vec3d(4, 0, 0), 1);
+    EXPECT_DOUBLE_EQ(cyl.getHeight(), 4);
+    EXPECT_NEAR(cyl.getAxis().x(), 4, 1e-12);
+    EXPECT_NEAR(cyl.getVolume(), 4 * M_PI, 1e-12);
+    EXPECT_TRUE(cyl.contain(Vec3d(4.5, 0.5, 0.5)));
+    EXPECT_FALSE(cyl.contain(Vec3d(0.5, 0, 0)));
+    EXPECT_FALSE(cyl.contain(Vec3d(3, 0, 1.1)));
+
+    Segment seg;
+    ASSERT_TRUE(cyl.intersect(Ray(Vec3d(-1, 0, 0), Vec3d(1, 0, 0)), seg));
+    EXPECT_NEAR(seg.tIn, 2, 1e-9);
+    EXPECT_NEAR(seg.tOut, 6, 1e-9);
+    ASSERT_TRUE(cyl.intersect(Ray(Vec3d(3, 0, -5), Vec3d(0, 0, 1)), seg));
+    EXPECT_NEAR(seg.length(), 2, 1e-9);
+
+    Vec3d lower, upper;
+    cyl.getBoundingBox(lower, upper);
+    EXPECT_NEAR(lower.x(), 1, 1e-12);
+    EXPECT_NEAR(upper.x(), 5, 1e-12);
+    EXPECT_NEAR(lower.y(), -1, 1e-12);
+    EXPECT_NEAR(upper.z(), 1, 1e-12);
+
+    // tilted axis, points sampled from the unit cube stay inside
+    Cylinder tilted = Cylinder(Vec3d(1, 2, 3), Vec3d(1, 1, 1), 0.5);
+    for (double u = 0.05; u < 1; u += 0.1)
+    {
+        EXPECT_TRUE(tilted.contain(tilted.samplePoint(u, 1 - u * 0.9, u)));
+    }
+}
+
+TEST(BoxTest, axisAligned)
+{
+    Box box = Box(Vec3d(0, 0, 0), Vec3d(1, 2, 3));
+    EXPECT_DOUBLE_EQ(box.getVolume(), 6);
+    EXPECT_TRUE(box.contain(Vec3d(0.5, 1.5, 2.5)));
+    EXPECT_FALSE(box.contain(Vec3d(0.5, 2.5, 2.5)));
+
+    Segment seg;
+    ASSERT_TRUE(box.intersect(Ray(Vec3d(0.5, -1, 1), Vec3d(0, 1, 0)), seg));
+    EXPECT_NEAR(seg.tIn, 1, 1e-12);
+    EXPECT_NEAR(seg.tOut, 3, 1e-12);
+    // origin inside
+    EXPECT_NEAR(box.intersection(Ray(Vec3d(0.5, 1, 1), Vec3d(0, 0, -1))), 1, 1e-12);
+    // parallel to a face, outside
+    EXPECT_FALSE(box.intersect(Ray(Vec3d(2, -1, 1), Vec3d(0, 1, 0)), seg));
+
+    Vec3d lower, upper;
+    box.getBoundingBox(lower, upper);
+    EXPECT_EQ(lower, Vec3d(0, 0, 0));
+    EXPECT_EQ(upper, Vec3d(1, 2, 3));
+}
+
+TEST(BoxTest, rotated)
+{
+    // unit cube rotated by 45 degrees around z
+    Box box = Box(Transform(Transform::rotation(Vec3d(0, 0, 1), M_PI / 4), Vec3d(0, 0, 0)), Vec3d(0.5, 0.5, 0.5));
+    EXPECT_NEAR(box.getVolume(), 1, 1e-12);
+    EXPECT_TRUE(box.contain(Vec3d(0.65, 0, 0)));
+    EXPECT_FALSE(box.contain(Vec3d(0.45, 0.45, 0)));
+    // diagonal of the rotated face
+    EXPECT_NEAR(box.intersection(Ray(Vec3d(-5, 0, 0), Vec3d(1, 0, 0))), std::sqrt(2), 1e-9);
+
+    Vec3d lower, upper;
+    box.getBoundingBox(lower, upper);
+    EXPECT_NEAR(upper.x(), std::sqrt(0.5), 1e-12);
+    EXPECT_NEAR(upper.z(), 0.5, 1e-12);
+}
+
+TEST(SlabTest, intersection)
+{
+    // planes x + y = 0 and x + y = sqrt(2)
+    Slab slab = Slab(Vec3d(0, 0, 0), Vec3d(1, 1, 0), 1);
+    EXPECT_TRUE(slab.contain(Vec3d(0.5, 0.5, 100)));
+    EXPECT_FALSE(slab.contain(Vec3d(-0.1, 0, 0)));
+    EXPECT_NEAR(slab.intersection(Ray(Vec3d(-5, 0, 0), Vec3d(1, 0, 0))), std::sqrt(2), 1e-9);
+    Segment seg;
+    EXPECT_FALSE(slab.intersect(Ray(Vec3d(-5, 5, 0), Vec3d(1, -1, 0)), seg));
+    EXPECT_THROW(slab.samplePoint(0.5, 0.5, 0.5), std::runtime_error);
+}
+
+TEST(EllipsoidTest, intersection)
+{
+    Ellipsoid ell = Ellipsoid(Vec3d(1, 1, 1), Vec3d(1, 2, 3));
+    EXPECT_NEAR(ell.getVolume(), 4.0 / 3.0 * M_PI * 6, 1e-9);
+    EXPECT_TRUE(ell.contain(Vec3d(1, 1, 3.9)));
+    EXPECT_FALSE(ell.contain(Vec3d(1.9, 1, 3.9)));
+
+    Segment seg;
+    ASSERT_TRUE(ell.intersect(Ray(Vec3d(1, 1, -10), Vec3d(0, 0, 1)), seg));
+    EXPECT_NEAR(seg.tIn, 8, 1e-9);
+    EXPECT_NEAR(seg.tOut, 14, 1e-9);
+    EXPECT_NEAR(ell.intersection(Ray(Vec3d(1, 1, 1), Vec3d(0, 1, 0))), 2, 1e-9);
+
+    // rotated so that the longest semi-axis is along x
+    Ellipsoid rotated = Ellipsoid(Vec3d(0, 0, 0), Vec3d(1, 2, 3), Transform::rotation(Vec3d(0, 1, 0), M_PI / 2));
+    EXPECT_NEAR(rotated.intersection(Ray(Vec3d(-10, 0, 0), Vec3d(1, 0, 0))), 6, 1e-9);
+    Vec3d lower, upper;
+    rotated.getBoundingBox(lower, upper);
+    EXPECT_NEAR(upper.x(), 3, 1e-9);
+    EXPECT_NEAR(upper.y(), 2, 1e-9);
+    EXPECT_NEAR(upper.z(), 1, 1e-9);
+    for (double u = 0.05; u < 1; u += 0.1)
+    {
+        EXPECT_TRUE(rotated.contain(rotated.samplePoint(u, u, 1 - u)));
+    }
+}
+
 TEST(SphereTest, constructor)
 {
-    QVector3D baseP = QVector3D(1, 1, 1);
+    Vec3d baseP = Vec3d(1, 1, 1);
     double r(1);
     Sphere sph = Sphere(baseP, r);
     EXPECT_EQ(sph.getCenter(), baseP);
@@ -75,29 +228,50 @@ TEST(SphereTest, constructor)
 
 TEST(SphereTest, contain)
 {
-    QVector3D baseP = QVector3D(1, 1, 1);
+    Vec3d baseP = Vec3d(1, 1, 1);
     double r(1);
     Sphere sph = Sphere(baseP, r);
 
-    QVector3D p1 = QVector3D(1.5, 1.5, 1.5);
+    Vec3d p1 = Vec3d(1.5, 1.5, 1.5);
     EXPECT_TRUE(sph.contain(p1));
 
-    QVector3D p2 = QVector3D(1.5, 2.5, 1.5);
+    Vec3d p2 = Vec3d(1.5, 2.5, 1.5);
     EXPECT_FALSE(sph.contain(p2));
 }
 
 TEST(SphereTest, intersection)
 {
-    QVector3D baseP = QVector3D(100, 100, 10);
+    Vec3d baseP = Vec3d(100, 100, 10);
     double r(1);
     Sphere sph = Sphere(baseP, r);
 
-    QVector3D p = QVector3D(25, 25, 10);
-    QVector3D d = baseP - p;
+    Vec3d p = Vec3d(25, 25, 10);
+    Vec3d d = baseP - p;
     Ray ray = Ray(p, d);
     EXPECT_DOUBLE_EQ(sph.intersection(ray), 2 * sph.getRadius());
 
-    d = QVector3D(1, 1, 1);
+    d = Vec3d(1, 1, 1);
     ray = Ray(p, d);
     EXPECT_DOUBLE_EQ(sph.intersection(ray), 0);
-}
\ No newline at end of file
+}
+TEST(SphereTest, segments)
+{
+    Sphere sph = Sphere(Vec3d(0, 0, 0), 2);
+
+    // origin outside
+    Ray ray = Ray(Vec3d(0, 1, -10), Vec3d(0, 0, 1));
+    Segment seg;
+    ASSERT_TRUE(sph.intersect(ray, seg));
+    EXPECT_NEAR(seg.tIn, 10 - std::sqrt(3), 1e-9);
+    EXPECT_NEAR(seg.tOut, 10 + std::sqrt(3), 1e-9);
+
+    // origin inside
+    ray = Ray(Vec3d(0, 0, 1), Vec3d(0, 0, 1));
+    ASSERT_TRUE(sph.intersect(ray, seg));
+    EXPECT_DOUBLE_EQ(seg.tIn, 0);
+    EXPECT_NEAR(seg.tOut, 1, 1e-9);
+
+    // miss
+    ray = Ray(Vec3d(0, 3, -10), Vec3d(0, 0, 1));
+    EXPECT_TRUE(sph.segments(ray).empty());
+}
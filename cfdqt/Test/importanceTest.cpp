@@ -0,0 +1,98 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include "importance.h"
+#include "watersettings.h"
+
+TEST(ImportanceTest, photonImportance)
+{
+    const MCSettings config = createWaterSettings({0.661}, Particle::Photon, 1, 5, 0.1);
+    const Tally tally(Sphere(Vec3d(100, 100, 10), 2.54), 10, 0, 1.0, false);
+    const std::vector<double> edges = ImportanceMap::defaultEnergyEdges(config, 5);
+    ASSERT_EQ(edges.size(), 6);
+    EXPECT_DOUBLE_EQ(edges.front(), 0.1);
+    EXPECT_GT(edges.back(), 0.661);
+    const ImportanceMap map(config, tally, edges, 10, 10, 10);
+
+    // Compton scattering only loses energy
+    for (int g = 0; g < map.getNGroups(); g++)
+    {
+        double sum(0);
+        for (int h = 0; h < map.getNGroups(); h++)
+        {
+            EXPECT_GE(map.getTransferProbability(g, h), 0);
+            if (h > g)
+            {
+                EXPECT_EQ(map.getTransferProbability(g, h), 0);
+            }
+            sum += map.getTransferProbability(g, h);
+        }
+        EXPECT_LE(sum, 1 + 1e-9);
+    }
+    EXPECT_GT(map.getTransferProbability(4, 4), 0);
+
+    // more important towards the detector, nothing outside the ROI
+    const double near = map.getImportance(Vec3d(40, 40, 10), 0.6);
+    const double far = map.getImportance(Vec3d(10, 10, 10), 0.6);
+    EXPECT_GT(near, 2 * far);
+    EXPECT_GT(far, 0);
+    EXPECT_EQ(map.getImportance(Vec3d(6, 6, 10), 0.6), 0);
+    EXPECT_EQ(map.getImportance(Vec3d(25, 25, 10), 1), 0);
+    EXPECT_GT(map.getResponse(), 0);
+}
+
+TEST(ImportanceTest, neutronUpscattering)
+{
+    const MCSettings config = createWaterSettings({2e6}, Particle::Neutron, 1, 5, 0);
+    const Tally tally(Sphere(Vec3d(100, 100, 10), 2.54), 110, 1e-3, 1e8, true);
+    const std::vector<double> edges = ImportanceMap::defaultEnergyEdges(config, 10);
+    EXPECT_DOUBLE_EQ(edges.front(), 1e-3);
+    const ImportanceMap map(config, tally, edges, 8, 8, 8, 500);
+    // free-gas scattering of the thermal group
+    EXPECT_GT(map.getTransferProbability(0, 1), 0);
+    EXPECT_GT(map.getImportance(Vec3d(40, 40, 10), 1e6), map.getImportance(Vec3d(10, 10, 10), 1e6));
+    EXPECT_GT(map.getResponse(), 0);
+}
+
+TEST(ImportanceTest, weightWindows)
+{
+    const MCSettings config = createWaterSettings({0.661}, Particle::Photon, 2000, 5, 0.1);
+    const Tally detector(Sphere(Vec3d(100, 100, 10), 2.54), 10, 0, 1.0, false);
+    const ImportanceMap map(config, detector, ImportanceMap::defaultEnergyEdges(config, 5), 10, 10, 10);
+    const WeightWindowMesh windows = map.toWeightWindows();
+    EXPECT_EQ(windows.getNumberOfElements(), 1000);
+    EXPECT_EQ(windows.getEnergyEdges(), map.getEnergyEdges());
+    // source particles start around the survival weight
+    const Vec3d sourceCenter(25, 25, 8.4478);
+    const double survivalWeight = windows.getSurvivalRatio() * windows.getLowerBound(sourceCenter, 0.661);
+    EXPECT_GT(survivalWeight, 0.3);
+    EXPECT_LT(survivalWeight, 3);
+    EXPECT_EQ(windows.getLowerBound(Vec3d(6, 6, 10), 0.6), 0);
+    EXPECT_GT(windows.getLowerBound(Vec3d(10, 10, 10), 0.6), windows.getLowerBound(Vec3d(40, 40, 10), 0.6));
+
+    // generated windows do not bias the tally
+    double results[2][2];
+    for (int run = 0; run < 2; run++)
+    {
+        const WeightWindowMesh* ww = run == 0 ? nullptr : &windows;
+        double sum(0), squaredSum(0);
+        for (int i = 0; i < config.maxN; i++)
+        {
+            Tally tally(detector);
+            transportHistory(config.source.createParticle(), config, ww, [&](Particle& prtl)
+            {
+                if (prtl.scatterN > 0)
+                    forceDetection(prtl, config, tally);
+            });
+            const std::vector<double> counts = tally.getBinContents();
+            const double total = std::accumulate(counts.begin(), counts.end(), 0.0);
+            sum += total;
+            squaredSum += total * total;
+        }
+        const double mean = sum / config.maxN;
+        results[run][0] = mean;
+        results[run][1] = (squaredSum / config.maxN - mean * mean) / config.maxN;
+    }
+    EXPECT_GT(results[0][0], 0);
+    EXPECT_NEAR(results[1][0], results[0][0], 4 * std::sqrt(results[0][1] + results[1][1]));
+    EXPECT_THROW(ImportanceMap(config, detector, {0.5, 0.4}, 2, 2, 2), std::runtime_error);
+}
@@ -4,6 +4,9 @@
 #include "material.h"
 std::string getRootDir()
 {
+#ifdef CFDQT_ROOT_DIR
+    return CFDQT_ROOT_DIR;
+#endif
     std::string cwd = std::filesystem::current_path();
     std::size_t found = cwd.rfind("/build");
     if (found!=std::string::npos)
@@ -0,0 +1,304 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <sstream>
+#include "mcnpimport.h"
+std::string getRootDir()
+{
+#ifdef CFDQT_ROOT_DIR
+    return CFDQT_ROOT_DIR;
+#endif
+    std::string cwd = std::filesystem::current_path();
+    std::size_t found = cwd.rfind("/build");
+    if (found!=std::string::npos)
+        cwd.replace (found, std::string::npos,"/");
+    else
+        throw std::runtime_error("Projetc root directory not found.");
+    // std::cout << cwd << std::endl;
+    return cwd;
+}
+
+class McnpImportTest : public ::testing::Test
+{
+protected:
+    static McnpImporter* importer;
+    static void SetUpTestSuite()
+    {
+        importer = new McnpImporter(NuclideLibrary::loadDefault(getRootDir()));
+    }
+    static void TearDownTestSuite()
+    {
+        delete importer;
+        importer = nullptr;
+    }
+};
+McnpImporter* McnpImportTest::importer = nullptr;
+
+const char* simpleDeck =
+"test deck\n"
+"1 1 -1.0 -10 imp:p=1\n"
+"2 0 -20 imp:p=1\n"
+"c comment\n"
+"3 0 10 20 imp:p=0\n"
+"\n"
+"10 1 RPP 0 10 0 10 0 10 $ water box\n"
+"20 S 50 5 5 1\n"
+"\n"
+"mode p\n"
+"TR1 1 2 3 9j\n"
+"m1 1001 2\n"
+"     8016 1\n"
+"sdef pos=5 5 5 erg=d1\n"
+"si1 h 0 1 2\n"
+"sp1 d 0 1 3\n"
+"f4:p 2\n"
+"e4 0.1 3i 0.5\n";
+
+TEST_F(McnpImportTest, parseShortcuts)
+{
+    std::istringstream input(std::string(simpleDeck) + "e14 1 2r 4m 1e-3 1ilog 1e-1 2j\n");
+    McnpDeck deck = McnpDeck::parse(input);
+    EXPECT_EQ(deck.title, "test deck");
+    ASSERT_EQ(deck.cells.size(), 3);
+    EXPECT_EQ(deck.cells[1].surfaces, std::vector<int>{-20});
+    EXPECT_EQ(deck.surfaces.at(10).transform, 1);
+    EXPECT_EQ(deck.surfaces.at(10).type, "RPP");
+    ASSERT_EQ(deck.materials.at(1).components.size(), 2);
+    EXPECT_EQ(deck.materials.at(1).components[1].first, 8016);
+    EXPECT_EQ(deck.distributions.at(1).siOption, "H");
+    EXPECT_EQ(deck.distributions.at(1).sp, (std::vector<double>{0, 1, 3}));
+
+    const std::vector<double>& e4 = deck.energyBins.at(4);
+    ASSERT_EQ(e4.size(), 5);
+    EXPECT_NEAR(e4[2], 0.3, 1e-12);
+    const std::vector<double>& e14 = deck.energyBins.at(14);
+    ASSERT_EQ(e14.size(), 9);
+    EXPECT_DOUBLE_EQ(e14[2], 1);
+    EXPECT_DOUBLE_EQ(e14[3], 4);
+    EXPECT_NEAR(e14[5], 1e-2, 1e-15);
+    EXPECT_TRUE(std::isnan(e14[8]));
+}
+
+TEST_F(McnpImportTest, buildSimpleDeck)
+{
+    std::istringstream input(simpleDeck);
+    McnpDeck deck = McnpDeck::parse(input);
+    McnpImportOptions options;
+    options.maxN = 10;
+    McnpProblem problem = importer->build(deck, options);
+
+    // box translated by TR1
+    EXPECT_TRUE(problem.config->ROI->contain(Vec3d(10.5, 11.5, 12.5)));
+    EXPECT_FALSE(problem.config->ROI->contain(Vec3d(0.5, 0.5, 0.5)));
+    EXPECT_DOUBLE_EQ(problem.config->cells[0].material.getDensity(), 1);
+    EXPECT_EQ(problem.config->maxN, 10);
+    // MCNP default photon cutoff
+    EXPECT_DOUBLE_EQ(problem.config->minE, 1e-3);
+
+    ASSERT_EQ(problem.tallies.size(), 1);
+    EXPECT_EQ(problem.tallyNumbers[0], 4);
+    EXPECT_EQ(problem.tallies[0].getCenter(), Vec3d(50, 5, 5));
+    // bin below 0.1 kept
+    EXPECT_EQ(problem.tallies[0].getNBins(), 5);
+    EXPECT_NEAR(problem.tallies[0].getBinCenter(0), 0.05, 1e-12);
+    EXPECT_NEAR(problem.tallies[0].getVolume(), 4.0 / 3.0 * M_PI, 1e-12);
+
+    // 1/4 of the source energies in [0, 1], 3/4 in [1, 2]
+    int low(0);
+    const int n(4000);
+    for (int i = 0; i < n; i++)
+    {
+        Particle p = problem.config->source.createParticle();
+        EXPECT_EQ(p.pos, Vec3d(5, 5, 5));
+        EXPECT_LE(p.ergE, 2);
+        low += p.ergE < 1;
+    }
+    EXPECT_NEAR(double(low) / n, 0.25, 0.03);
+}
+
+TEST_F(McnpImportTest, cylinderAndBoxTallies)
+{
+    std::string deckText(simpleDeck);
+    deckText.replace(deckText.find("20 S 50 5 5 1"), 13, "20 RCC 50 5 0 0 0 4 2\n21 RPP 60 62 0 3 0 4");
+    deckText.replace(deckText.find("3 0 10 20 imp:p=0"), 17, "4 0 -21 imp:p=1\n3 0 10 20 21 imp:p=0");
+    std::istringstream input(deckText + "f14:p 4\nsd14 2\n");
+    McnpDeck deck = McnpDeck::parse(input);
+    McnpImportOptions options;
+    options.maxN = 10;
+    McnpProblem problem = importer->build(deck, options);
+
+    ASSERT_EQ(problem.tallies.size(), 2);
+    EXPECT_EQ(problem.tallies[0].getDetector().getType(), Detector::CylinderDetector);
+    EXPECT_EQ(problem.tallies[0].getCenter(), Vec3d(50, 5, 2));
+    EXPECT_NEAR(problem.tallies[0].getVolume(), 16 * M_PI, 1e-12);
+    EXPECT_EQ(problem.tallies[1].getDetector().getType(), Detector::BoxDetector);
+    EXPECT_EQ(problem.tallies[1].getCenter(), Vec3d(61, 1.5, 2));
+    // SD card
+    EXPECT_DOUBLE_EQ(problem.tallies[1].getVolume(), 2);
+}
+
+TEST_F(McnpImportTest, pointTallies)
+{
+    std::istringstream input(std::string(simpleDeck) + "f15:p 60 5 5 0.5\n     70 0 1 0\n");
+    McnpDeck deck = McnpDeck::parse(input);
+    McnpImportOptions options;
+    options.maxN = 10;
+    McnpProblem problem = importer->build(deck, options);
+    ASSERT_EQ(problem.tallies.size(), 3);
+    EXPECT_EQ(problem.tallyNumbers[1], 15);
+    EXPECT_EQ(problem.tallyNumbers[2], 15);
+    EXPECT_TRUE(problem.tallies[1].isPointDetector());
+    EXPECT_EQ(problem.tallies[1].getCenter(), Vec3d(60, 5, 5));
+    EXPECT_DOUBLE_EQ(problem.tallies[1].getRadius(), 0.5);
+    EXPECT_EQ(problem.tallies[2].getCenter(), Vec3d(70, 0, 1));
+    EXPECT_DOUBLE_EQ(problem.tallies[2].getRadius(), 0);
+    // no E15 card, one bin
+    EXPECT_EQ(problem.tallies[1].getNBins(), 1);
+
+    std::istringstream input2(std::string(simpleDeck) + "f5:p 60 5 5\n");
+    EXPECT_THROW(McnpDeck::parse(input2), std::runtime_error);
+    std::istringstream input3(std::string(simpleDeck) + "f5:p 60 5 5 -1\n");
+    deck = McnpDeck::parse(input3);
+    EXPECT_THROW(importer->build(deck, options), std::runtime_error);
+}
+
+TEST_F(McnpImportTest, irregularEnergyBins)
+{
+    std::string deckText(simpleDeck);
+    deckText.replace(deckText.find("e4 0.1 3i 0.5"), 13, "e4 0.01 0.02 0.1 0.662 0.7");
+    std::istringstream input(deckText);
+    McnpDeck deck = McnpDeck::parse(input);
+    McnpImportOptions options;
+    options.maxN = 10;
+    McnpProblem problem = importer->build(deck, options);
+    const Tally& tally = problem.tallies[0];
+    EXPECT_FALSE(tally.isLethargyBin());
+    EXPECT_EQ(tally.getNBins(), 5);
+    EXPECT_DOUBLE_EQ(tally.getBinWidth(0), 0.01);
+    EXPECT_DOUBLE_EQ(tally.getBinWidth(3), 0.662 - 0.1);
+    EXPECT_DOUBLE_EQ(tally.getMinE(), 0);
+    EXPECT_DOUBLE_EQ(tally.getMaxE(), 0.7);
+
+    deckText.replace(deckText.find("e4 0.01 0.02 0.1 0.662 0.7"), 26, "e4 0.2 0.1");
+    std::istringstream input2(deckText);
+    deck = McnpDeck::parse(input2);
+    EXPECT_THROW(importer->build(deck, options), std::runtime_error);
+}
+
+TEST_F(McnpImportTest, tallyWithoutEnergyCard)
+{
+    std::string deckText(simpleDeck);
+    deckText.erase(deckText.find("e4 0.1 3i 0.5"));
+    std::istringstream input(deckText);
+    McnpDeck deck = McnpDeck::parse(input);
+    McnpImportOptions options;
+    options.maxN = 200;
+    McnpProblem problem = importer->build(deck, options);
+    const MCSettings& config = *problem.config;
+    // one bin over all source energies, every scattered photon is scored
+    ASSERT_EQ(problem.tallies[0].getNBins(), 1);
+    EXPECT_DOUBLE_EQ(problem.tallies[0].getMinE(), 0);
+    EXPECT_GE(problem.tallies[0].getMaxE(), 2);
+    std::vector<Tally> tallies{problem.tallies[0]};
+    for (int i = 0; i < config.maxN; i++)
+    {
+        Particle prtl = config.source.createParticle();
+        while (prtl.scatterN < config.maxScatterN && deltaTracking(prtl, config))
+        {
+            prtl.scatterN += 1;
+            forceDetection(prtl, config, tallies);
+            scattering(prtl, config);
+        }
+    }
+    EXPECT_GT(tallies[0].getBinContent(0), 0);
+}
+
+TEST_F(McnpImportTest, unsupportedCards)
+{
+    std::string deckText(simpleDeck);
+    deckText.replace(deckText.find("RPP 0 10 0 10 0 10"), 18, "PZ 10");
+    std::istringstream input(deckText);
+    McnpDeck deck = McnpDeck::parse(input);
+    EXPECT_THROW(importer->build(deck), std::runtime_error);
+
+    std::istringstream input2(std::string(simpleDeck) + "f2:p 2\n");
+    deck = McnpDeck::parse(input2);
+    EXPECT_THROW(importer->build(deck), std::runtime_error);
+}
+
+TEST_F(McnpImportTest, gammaDeck)
+{
+    const std::string path = getRootDir() + "Examples/output_gamma/singleDet.i";
+    std::shared_ptr<const McnpDeck> deck = importer->getDeck(path);
+    EXPECT_EQ(deck->mode, 'P');
+    EXPECT_EQ(deck->nps, 100000000);
+    EXPECT_DOUBLE_EQ(deck->cutoffEnergies.at('P'), 0.02);
+    // parsed decks are cached
+    EXPECT_EQ(importer->getDeck(path).get(), deck.get());
+
+    McnpProblem problem = importer->import(path);
+    const MCSettings& config = *problem.config;
+    // cell 222 is merged into cell 230, the water barrel
+    ASSERT_EQ(config.cells.size(), 1);
+    const Cylinder* barrel = dynamic_cast<const Cylinder*>(config.ROI.get());
+    ASSERT_NE(barrel, nullptr);
+    EXPECT_EQ(barrel->getBaseCenter(), Vec3d(25, 25, 0));
+    EXPECT_DOUBLE_EQ(barrel->getHeight(), 52);
+    EXPECT_DOUBLE_EQ(barrel->getRadius(), 21.5);
+    EXPECT_DOUBLE_EQ(config.cells[0].material.getDensity(), 0.99);
+    EXPECT_DOUBLE_EQ(config.minE, 0.02);
+
+    // source cylinder, same as in gamma.cpp
+    const Cylinder sourceCylinder = Cylinder(Vec3d(25, 25, 8.4478), 5.63372, 1.4097);
+    for (int i = 0; i < 100; i++)
+    {
+        Particle p = config.source.createParticle();
+        EXPECT_TRUE(sourceCylinder.contain(p.pos));
+        EXPECT_DOUBLE_EQ(p.ergE, 0.6617);
+        EXPECT_EQ(p.particleType, Particle::Photon);
+    }
+
+    ASSERT_EQ(problem.tallies.size(), 1);
+    const Tally& tally = problem.tallies[0];
+    EXPECT_EQ(tally.getCenter(), Vec3d(100, 100, 10));
+    EXPECT_DOUBLE_EQ(tally.getRadius(), 2.54);
+    EXPECT_EQ(tally.getNBins(), 100);
+    EXPECT_FALSE(tally.isLethargyBin());
+    EXPECT_NEAR(tally.getBinCenter(0), 0.005, 1e-9);
+    EXPECT_DOUBLE_EQ(tally.getVolume(), 1);
+}
+
+TEST_F(McnpImportTest, neutronDeck)
+{
+    McnpImportOptions options;
+    options.maxN = 1000;
+    McnpProblem problem = importer->import(getRootDir() + "Examples/output_neutron/Cf252.i", options);
+    const MCSettings& config = *problem.config;
+    EXPECT_EQ(config.maxN, 1000);
+    const Cylinder* barrel = dynamic_cast<const Cylinder*>(config.ROI.get());
+    ASSERT_NE(barrel, nullptr);
+    EXPECT_DOUBLE_EQ(barrel->getRadius(), 5);
+
+    // Cf-252 spectrum from the vertical SI1/SP1 card, in eV
+    double meanE(0);
+    const int n(10000);
+    for (int i = 0; i < n; i++)
+    {
+        Particle p = config.source.createParticle();
+        EXPECT_EQ(p.particleType, Particle::Neutron);
+        EXPECT_LE(p.ergE, 1e7);
+        meanE += p.ergE / n;
+    }
+    EXPECT_GT(meanE, 1.5e6);
+    EXPECT_LT(meanE, 3e6);
+
+    ASSERT_EQ(problem.tallies.size(), 1);
+    const Tally& tally = problem.tallies[0];
+    EXPECT_EQ(tally.getCenter(), Vec3d(75, 75, 10));
+    EXPECT_TRUE(tally.isLethargyBin());
+    // the MCNP bin from 0 to 1e-9 MeV, then 1e-9 MeV to 10 MeV in eV, 10 bins per decade
+    EXPECT_EQ(tally.getNBins(), 101);
+    EXPECT_DOUBLE_EQ(tally.getBinEdges()[0], 0);
+    EXPECT_NEAR(tally.getBinEdges()[1], 1e-3, 1e-12);
+    EXPECT_NEAR(tally.getBinCenter(1), std::pow(10, -3 + 0.05), 1e-6);
+    EXPECT_NEAR(tally.getBinEdges().back(), 1e7, 1e-3);
+}
@@ -0,0 +1,54 @@
+#include <gtest/gtest.h>
+#include "pathfield.h"
+#include "watersettings.h"
+
+class PathLengthFieldTest : public ::testing::Test
+{
+public:
+    MCSettings* config;
+    void SetUp() override
+    {
+        config = new MCSettings(createWaterSettings({0.661}, Particle::Photon, 1000, 5, 0.1, 0.01));
+    }
+    void TearDown() override
+    {
+        delete config;
+    }
+};
+
+TEST_F(PathLengthFieldTest, cellPathLengths)
+{
+    std::vector<double> lengths;
+    // from the axis to a detector outside the barrel, along x
+    config->getCellPathLengths(Vec3d(25, 25, 10), Vec3d(100, 25, 10), lengths);
+    ASSERT_EQ(lengths.size(), 1);
+    EXPECT_NEAR(lengths[0], 21.5, 1e-4);
+
+    // detector inside the barrel
+    config->getCellPathLengths(Vec3d(25, 25, 10), Vec3d(35, 25, 10), lengths);
+    EXPECT_NEAR(lengths[0], 10, 1e-4);
+}
+
+TEST_F(PathLengthFieldTest, interpolation)
+{
+    const Vec3d target(100, 100, 10);
+    PathLengthField field(*config, target, 44, 44, 53);
+    EXPECT_EQ(field.getNumberOfCells(), 1);
+    EXPECT_EQ(field.getTarget(), target);
+
+    std::vector<double> exact;
+    std::vector<double> interpolated;
+    // grid nodes are exact
+    Vec3d node(24.5, 24.5, 10);
+    config->getCellPathLengths(node, target, exact);
+    field.getPathLengths(node, interpolated);
+    EXPECT_NEAR(interpolated[0], exact[0], 1e-4);
+
+    // documented error bound for rays grazing the barrel, R = 21.5 cm, d = sqrt(3) cm
+    const double coarseError = field.getMaxError(*config, 10000);
+    EXPECT_LT(coarseError, 2 * std::sqrt(2 * 21.5 * std::sqrt(3.0)));
+
+    // converges with a finer grid
+    PathLengthField fineField(*config, target, 87, 87, 105);
+    EXPECT_LT(fineField.getMaxError(*config, 10000), coarseError);
+}
@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include "perturbation.h"
+#include "watersettings.h"
+
+// mean and variance of the mean of the tally total of independent histories
+static void runIndependent(const MCSettings& config, const Tally& detector, double& mean, double& variance)
+{
+    double sum(0), squaredSum(0);
+    std::vector<Tally> tallies{detector};
+    for (int i = 0; i < config.maxN; i++)
+    {
+        tallies[0].reset();
+        Particle prtl = config.source.createParticle();
+        forceDetection(prtl, config, tallies);
+        while (prtl.scatterN < config.maxScatterN && deltaTracking(prtl, config))
+        {
+            prtl.scatterN += 1;
+            forceDetection(prtl, config, tallies);
+            scattering(prtl, config);
+        }
+        const std::vector<double> counts = tallies[0].getBinContents();
+        const double total = std::accumulate(counts.begin(), counts.end(), 0.0);
+        sum += total;
+        squaredSum += total * total;
+    }
+    mean = sum / config.maxN;
+    variance = (squaredSum / config.maxN - mean * mean) / config.maxN;
+}
+
+TEST(PerturbationTest, perturbation)
+{
+    const std::vector<MaterialPerturbation> perturbations = MaterialPerturbation::parse("density:1.01,fraction:0:1.1+density:0.98,fraction:1:0.5");
+    ASSERT_EQ(perturbations.size(), 3);
+    EXPECT_DOUBLE_EQ(perturbations[0].getDensityFactor(), 1.01);
+    EXPECT_TRUE(perturbations[0].getFractionFactors().empty());
+    EXPECT_DOUBLE_EQ(perturbations[1].getDensityFactor(), 0.98);
+    EXPECT_EQ(perturbations[1].getFractionFactors(), std::vector<double>{1.1});
+    EXPECT_EQ(perturbations[2].getFractionFactors(), (std::vector<double>{1, 0.5}));
+    EXPECT_EQ(perturbations[1].getName(), "density:0.98+fraction:0:1.1");
+    EXPECT_EQ(perturbations[2].getName(), "fraction:1:0.5");
+    EXPECT_THROW(MaterialPerturbation::parse("density:-1"), std::runtime_error);
+    EXPECT_THROW(MaterialPerturbation::parse("density:1x"), std::runtime_error);
+    EXPECT_THROW(MaterialPerturbation::parse("fraction:0.5:2"), std::runtime_error);
+    EXPECT_THROW(MaterialPerturbation::parse("temperature:300"), std::runtime_error);
+
+    const MCSettings config = createWaterSettings({2e6}, Particle::Neutron, 1);
+    const Material& water = config.cells[0].material;
+    const Material denser = perturbations[0].apply(water);
+    EXPECT_DOUBLE_EQ(denser.getDensity(), 0.99 * 1.01);
+    EXPECT_NEAR(denser.getNeutronTotalAtten(1e6), 1.01 * water.getNeutronTotalAtten(1e6), 1e-12);
+    EXPECT_NEAR(denser.getPhotonTotalAtten(0.661), 1.01 * water.getPhotonTotalAtten(0.661), 1e-12);
+    // less oxygen, same mass density
+    const Material lessOxygen = perturbations[2].apply(water);
+    EXPECT_DOUBLE_EQ(lessOxygen.getNuclideComposition()[1].first, 0.5);
+    EXPECT_DOUBLE_EQ(lessOxygen.getPhotonTotalAtten(0.661), water.getPhotonTotalAtten(0.661));
+    EXPECT_GT(lessOxygen.getInteractionProbability(1e6, 0), water.getInteractionProbability(1e6, 0));
+    for (auto &&energy : {0.1, 1e3, 1e6})
+    {
+        EXPECT_NEAR(water.getInteractionProbability(energy, 0) + water.getInteractionProbability(energy, 1), 1, 1e-12);
+        EXPECT_EQ(water.selectInteractionTargetIndex(energy, 0), 0);
+        EXPECT_EQ(water.selectInteractionTargetIndex(energy, 1 - 1e-12), 1);
+        EXPECT_EQ(water.selectInteractionTargetIndex(energy, 0.999 * water.getInteractionProbability(energy, 0)), 0);
+    }
+    EXPECT_THROW(MaterialPerturbation(1, {1, 1, 1}).apply(water), std::runtime_error);
+
+    const std::unique_ptr<MCSettings> perturbed = perturbations[0].apply(config);
+    EXPECT_DOUBLE_EQ(perturbed->cells[0].material.getDensity(), 0.99 * 1.01);
+    EXPECT_NEAR(perturbed->getMuMax(0.661), 1.01 * config.getMuMax(0.661), 1e-12);
+    EXPECT_EQ(perturbed->maxN, config.maxN);
+}
+
+TEST(PerturbationTest, correlatedSampling)
+{
+    for (auto &&type : {Particle::Photon, Particle::Neutron})
+    {
+        const MCSettings config = createWaterSettings({type == Particle::Photon ? 0.661 : 2e6}, type, type == Particle::Photon ? 100000 : 20000);
+        const Tally detector = type == Particle::Photon ? Tally(Sphere(Vec3d(25, 45, 10), 2.54), 10, 0, 1.0, false)
+                                                        : Tally(Sphere(Vec3d(25, 45, 10), 2.54), 100, 1e-3, 2e6, true);
+        const std::vector<MaterialPerturbation> perturbations{MaterialPerturbation(1.1), MaterialPerturbation(1, {1.2}), MaterialPerturbation(1.02)};
+        PerturbationTallies perturbation(config, {detector}, perturbations);
+        std::vector<Tally> tallies{detector};
+        for (int i = 0; i < config.maxN; i++)
+            perturbation.runHistory(config.source.createParticle(), tallies);
+        EXPECT_EQ(perturbation.getHistories(), config.maxN);
+        const std::vector<double> counts = tallies[0].getBinContents();
+        EXPECT_NEAR(std::accumulate(counts.begin(), counts.end(), 0.0) / config.maxN, perturbation.getTotal(), 1e-12 * perturbation.getTotal());
+        for (int k = 0; k < perturbation.getNPerturbations(); k++)
+        {
+            const std::vector<double> perturbedCounts = perturbation.getTallies(k)[0].getBinContents();
+            EXPECT_NEAR(std::accumulate(perturbedCounts.begin(), perturbedCounts.end(), 0.0) / config.maxN, perturbation.getTotal(k), 1e-12 * perturbation.getTotal(k));
+            EXPECT_NEAR(perturbation.getDifference(k), perturbation.getTotal(k) - perturbation.getTotal(), 1e-12 * perturbation.getTotal());
+            // correlated histories resolve the difference better than independent runs
+            EXPECT_LT(perturbation.getDifferenceError(k), perturbation.getIndependentDifferenceError(k) / 2);
+        }
+        // photon cross sections are tabulated for water, the composition does not change them
+        if (type == Particle::Photon)
+        {
+            EXPECT_DOUBLE_EQ(perturbation.getDifference(1), 0);
+        }
+
+        // perturbed tallies agree with independent runs in the perturbed materials
+        for (int k = 0; k < 2; k++)
+        {
+            double mean, variance;
+            runIndependent(perturbation.getSettings(k), detector, mean, variance);
+            EXPECT_NEAR(perturbation.getTotal(k), mean, 4 * std::sqrt(variance + std::pow(perturbation.getTotalError(k), 2)));
+        }
+        // denser water shields the detector
+        EXPECT_LT(perturbation.getDifference(0), 0);
+        EXPECT_LT(perturbation.getDifference(2), 0);
+
+        perturbation.reset();
+        EXPECT_EQ(perturbation.getHistories(), 0);
+        EXPECT_DOUBLE_EQ(perturbation.getTotal(0), 0);
+        EXPECT_DOUBLE_EQ(perturbation.getTallies(0)[0].getBinContent(0), 0);
+    }
+}
+
+TEST(PerturbationTest, nonMajorantCell)
+{
+    // a denser cell away from the source raises the majorant of photon delta tracking, most virtual collisions in the water are rejected
+    const MCSettings water = createWaterSettings({0.661}, Particle::Photon, 200000);
+    const Material& material = water.cells[0].material;
+    const Material dense(5 * 0.99, 18, material.getNuclideComposition());
+    const MCSettings config(water.ROI, {water.cells[0], Cell(dense, 5 * 0.99, Cylinder(Vec3d(25, 8, 40), 5, 2))},
+                           water.source, water.maxN, water.maxScatterN, water.minW, water.minE);
+    ASSERT_GT(config.getMuMax(0.661), 4 * material.getPhotonTotalAtten(0.661));
+    const Tally detector(Sphere(Vec3d(25, 45, 10), 2.54), 10, 0, 1.0, false);
+    PerturbationTallies perturbation(config, {detector}, {MaterialPerturbation(1.5), MaterialPerturbation(0.5)});
+    std::vector<Tally> tallies{detector};
+    for (int i = 0; i < config.maxN; i++)
+        perturbation.runHistory(config.source.createParticle(), tallies);
+    for (int k = 0; k < perturbation.getNPerturbations(); k++)
+    {
+        double mean, variance;
+        runIndependent(perturbation.getSettings(k), detector, mean, variance);
+        EXPECT_NEAR(perturbation.getTotal(k), mean, 4 * std::sqrt(variance + std::pow(perturbation.getTotalError(k), 2))) << "perturbation " << k;
+    }
+}
@@ -0,0 +1,100 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include "cfd.h"
+#include "qmc.h"
+#include "watersettings.h"
+
+TEST(QmcTest, stratification)
+{
+    const int m = 8;
+    const int n = 1 << m;
+    for (std::uint64_t seed = 1; seed < 4; seed++)
+    {
+        const ScrambledSobol sobol(ScrambledSobol::maxDimensions, seed);
+        std::vector<std::vector<double>> points(n);
+        for (int i = 0; i < n; i++)
+            sobol.getPoint(i, points[i]);
+        // one point in each of the n intervals of every dimension
+        for (int d = 0; d < sobol.getDimensions(); d++)
+        {
+            std::vector<int> counts(n, 0);
+            for (auto &&point : points)
+            {
+                EXPECT_GT(point[d], 0);
+                EXPECT_LT(point[d], 1);
+                counts[static_cast<int>(point[d] * n)]++;
+            }
+            EXPECT_EQ(*std::min_element(counts.begin(), counts.end()), 1) << "dimension " << d;
+        }
+        // the first two dimensions are a (0, 2)-sequence: one point in each elementary interval of area 1 / n
+        for (int a = 0; a <= m; a++)
+        {
+            std::vector<int> counts(n, 0);
+            for (auto &&point : points)
+                counts[(static_cast<int>(point[0] * (1 << a)) << (m - a)) + static_cast<int>(point[1] * (1 << (m - a)))]++;
+            EXPECT_EQ(*std::min_element(counts.begin(), counts.end()), 1) << "intervals " << (1 << a) << " x " << (1 << (m - a));
+        }
+    }
+    // replicates differ
+    std::vector<double> first, second;
+    ScrambledSobol(2, 1).getPoint(5, first);
+    ScrambledSobol(2, 2).getPoint(5, second);
+    EXPECT_NE(first[0], second[0]);
+    EXPECT_THROW(ScrambledSobol(0, 1), std::runtime_error);
+    EXPECT_THROW(ScrambledSobol(ScrambledSobol::maxDimensions + 1, 1), std::runtime_error);
+}
+
+TEST(QmcTest, leadingValues)
+{
+    ScrambledSobol sobol(3, 7);
+    std::vector<double> point;
+    sobol.getPoint(9, point);
+    sobol.startHistory(9);
+    GlobalUniformRandNumGenerator& rng = GlobalUniformRandNumGenerator::GetInstance();
+    for (int d = 0; d < 3; d++)
+        EXPECT_DOUBLE_EQ(rng.generateDouble(), point[d]);
+    const double next = rng.generateDouble();
+    EXPECT_GE(next, 0);
+    EXPECT_LT(next, 1);
+    sobol.startHistory(9);
+    ScrambledSobol::stopHistory();
+    EXPECT_NE(rng.generateDouble(), point[0]);
+}
+
+TEST(QmcTest, uncollidedFlux)
+{
+    const MCSettings config = createWaterSettings({0.661}, Particle::Photon, 1024, 5, 0.1);
+    // F5 tally, the uncollided flux is a smooth function of the source position
+    const Tally detector(Detector(Vec3d(100, 100, 10), 0), 10, 0, 1.0, false);
+
+    // replicates of the uncollided flux, pseudo-random and quasi-random
+    const int replicates = 16;
+    double results[2][2];
+    for (int run = 0; run < 2; run++)
+    {
+        double sum(0), squaredSum(0);
+        for (int r = 0; r < replicates; r++)
+        {
+            Tally tally(detector);
+            ScrambledSobol sobol(ScrambledSobol::defaultDimensions(config.source), r + 1);
+            for (int i = 0; i < config.maxN; i++)
+            {
+                if (run == 1)
+                    sobol.startHistory(i);
+                Particle prtl = config.source.createParticle();
+                forceDetection(prtl, config, tally);
+            }
+            ScrambledSobol::stopHistory();
+            const std::vector<double> counts = tally.getBinContents();
+            const double total = std::accumulate(counts.begin(), counts.end(), 0.0) / config.maxN;
+            sum += total;
+            squaredSum += total * total;
+        }
+        const double mean = sum / replicates;
+        results[run][0] = mean;
+        results[run][1] = (squaredSum / replicates - mean * mean) / (replicates - 1);
+    }
+    EXPECT_GT(results[0][0], 0);
+    EXPECT_NEAR(results[1][0], results[0][0], 4 * std::sqrt(results[0][1] + results[1][1]));
+    EXPECT_LT(results[1][1], results[0][1] / 10);
+}
@@ -0,0 +1,133 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include "response.h"
+
+// dense matrix with a few zeros, pulse-height bin j, incident bin i
+static double responseValue(const int j, const int i)
+{
+    return (i + j) % 3 == 0 ? 0 : 0.01 * (i + 1) / (j + 2);
+}
+
+static ResponseMatrix createResponse(const std::vector<double>& incidentEdges, const int nPulseHeightBins, const int blockSize)
+{
+    std::vector<double> pulseHeightEdges(nPulseHeightBins + 1);
+    for (int j = 0; j <= nPulseHeightBins; j++)
+        pulseHeightEdges[j] = 0.01 * j;
+    std::vector<ResponseMatrix::Entry> entries;
+    for (std::size_t i = 0; i + 1 < incidentEdges.size(); i++)
+    {
+        for (int j = 0; j < nPulseHeightBins; j++)
+        {
+            if (responseValue(j, i) != 0)
+                entries.push_back({static_cast<int>(i), j, responseValue(j, i)});
+        }
+    }
+    return ResponseMatrix(incidentEdges, pulseHeightEdges, entries, blockSize);
+}
+
+TEST(ResponseTest, fold)
+{
+    const Tally prototype(Sphere(Vec3d(0, 0, 0), 1), 100, 0, 1);
+    const std::vector<double> spectrum = [] {
+        std::vector<double> x(100);
+        for (int i = 0; i < 100; i++)
+            x[i] = std::sin(0.1 * i) + 1.5;
+        return x;
+    }();
+    // same result for any block size
+    for (int blockSize : {1, 7, 100, 256})
+    {
+        const ResponseMatrix response = createResponse(prototype.getBinEdges(), 30, blockSize);
+        EXPECT_EQ(response.getNNonZeros(), 2000);
+        const std::vector<double> folded = response.fold(spectrum);
+        ASSERT_EQ(folded.size(), 30);
+        for (int j = 0; j < 30; j++)
+        {
+            double expected(0);
+            for (int i = 0; i < 100; i++)
+                expected += responseValue(j, i) * spectrum[i];
+            EXPECT_NEAR(folded[j], expected, 1e-12 * expected);
+        }
+        // several spectra at once
+        const std::vector<std::vector<double>> spectra{spectrum, std::vector<double>(100, 0), std::vector<double>(100, 2)};
+        const std::vector<std::vector<double>> foldedAll = response.fold(spectra);
+        for (int j = 0; j < 30; j++)
+        {
+            EXPECT_DOUBLE_EQ(foldedAll[0][j], folded[j]);
+            EXPECT_DOUBLE_EQ(foldedAll[1][j], 0);
+        }
+        EXPECT_THROW(response.fold(std::vector<double>(99, 1)), std::runtime_error);
+    }
+}
+
+TEST(ResponseTest, duplicatedEntries)
+{
+    const ResponseMatrix response({0, 1, 2}, {0, 1}, {{0, 0, 0.5}, {1, 0, 1}, {0, 0, 0.25}});
+    EXPECT_EQ(response.getNNonZeros(), 2);
+    EXPECT_DOUBLE_EQ(response.fold({1, 2})[0], 2.75);
+    EXPECT_THROW(ResponseMatrix({0, 1, 2}, {0, 1}, {{2, 0, 1}}), std::runtime_error);
+    EXPECT_THROW(ResponseMatrix({0, 2, 1}, {0, 1}, {}), std::runtime_error);
+}
+
+TEST(ResponseTest, load)
+{
+    const std::string fpath = (std::filesystem::temp_directory_path() / "cfdqt_responseTest.txt").string();
+    {
+        std::ofstream fileptr(fpath);
+        fileptr << "# incident energy edges, MeV\n"
+                << "0 0.5 1\n"
+                << "# pulse-height edges, MeVee\n"
+                << "0 0.1 0.2 0.3\n"
+                << "0 0 0.2\n"
+                << "1 2 0.4 \n"
+                << "\n"
+                << "1 0 0.1\n";
+    }
+    const ResponseMatrix response = ResponseMatrix::load(fpath);
+    EXPECT_EQ(response.getNIncidentBins(), 2);
+    EXPECT_EQ(response.getNPulseHeightBins(), 3);
+    const std::vector<double> folded = response.fold({1, 10});
+    EXPECT_DOUBLE_EQ(folded[0], 1.2);
+    EXPECT_DOUBLE_EQ(folded[1], 0);
+    EXPECT_DOUBLE_EQ(folded[2], 4);
+    // matches the tallies with the same energy bins
+    EXPECT_TRUE(response.matches(Tally(Sphere(Vec3d(0, 0, 0), 1), 2, 0, 1)));
+    EXPECT_FALSE(response.matches(Tally(Sphere(Vec3d(0, 0, 0), 1), 2, 0, 2)));
+    EXPECT_FALSE(response.matches(Tally(Sphere(Vec3d(0, 0, 0), 1), 4, 0, 1)));
+
+    {
+        std::ofstream fileptr(fpath);
+        fileptr << "0 0.5 1\n0 0.1\n0 0 x\n";
+    }
+    EXPECT_THROW(ResponseMatrix::load(fpath), std::runtime_error);
+    std::filesystem::remove(fpath);
+    EXPECT_THROW(ResponseMatrix::load(fpath), std::runtime_error);
+}
+
+TEST(ResponseTest, batches)
+{
+    std::vector<Tally> tallies{Tally(Sphere(Vec3d(0, 0, 0), 1), 2, 0, 1), Tally(Sphere(Vec3d(10, 0, 0), 1), 2, 0, 1)};
+    PulseHeightFolder folder(std::make_shared<const ResponseMatrix>(ResponseMatrix({0, 0.5, 1}, {0, 1}, {{0, 0, 1}, {1, 0, 0.5}})));
+    Particle prtl(Vec3d(0, 0, 0), Vec3d(1, 0, 0), 0.25, 1, Particle::Photon);
+    // batch spectra per history 1, 2 and 3 in the first tally
+    for (int batch = 1; batch <= 3; batch++)
+    {
+        for (auto &&tally : tallies)
+            tally.reset();
+        tallies[0].Fill(prtl, batch * 10);
+        prtl.ergE = 0.75;
+        tallies[1].Fill(prtl, 10);
+        prtl.ergE = 0.25;
+        folder.addBatch(tallies, 10);
+    }
+    EXPECT_EQ(folder.getNBatches(), 3);
+    EXPECT_EQ(folder.getNPS(), 30);
+    EXPECT_DOUBLE_EQ(folder.getSpectrum(0)[0], 2);
+    EXPECT_NEAR(folder.getStdError(0)[0], std::sqrt(1.0 / 3), 1e-12);
+    EXPECT_DOUBLE_EQ(folder.getSpectrum(1)[0], 0.5);
+    EXPECT_NEAR(folder.getStdError(1)[0], 0, 1e-12);
+    // tallies must match the matrix
+    tallies.push_back(Tally(Sphere(Vec3d(0, 0, 0), 1), 3, 0, 1));
+    EXPECT_THROW(folder.addBatch(tallies, 10), std::runtime_error);
+}
@@ -0,0 +1,90 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include "scan.h"
+#include "watersettings.h"
+
+class ScanTest : public ::testing::Test
+{
+protected:
+    static MCSettings createSettings(const Source& source, const int maxScatterN, const double minE)
+    {
+        return createWaterSettings(source, 1000, maxScatterN, minE, 0.01);
+    }
+};
+
+TEST_F(ScanTest, matchesReplayAtEachNode)
+{
+    const Cylinder sourceCylinder = createSourceCylinder();
+    const MCSettings config = createSettings(Source(sourceCylinder, std::vector<double>{0.661}, Particle::Photon), 5, 0.1);
+    CollisionBank bank;
+    bank.transport(config, 500);
+
+    const Tally prototype = Tally(Sphere(Vec3d(0, 0, 0), 2.54), 50, 0, 1.0, false);
+    // 3 detectors per block and 7 events per block, so that both loops have partial blocks
+    DetectorScan scan(prototype, Vec3d(50, 0, 0), Vec3d(90, 50, 30), 3, 4, 2, 3);
+    scan.run(config, bank, 7);
+    EXPECT_EQ(scan.getNumberOfNodes(), 24);
+    EXPECT_EQ(scan.getNPS(), 500);
+    EXPECT_EQ(scan.getNodeCenter(1, 2, 1), Vec3d(70, 100.0 / 3, 30));
+
+    for (int i = 0; i < 3; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            for (int k = 0; k < 2; k++)
+            {
+                Tally reference(prototype);
+                reference.setCenter(scan.getNodeCenter(i, j, k));
+                bank.replay(config, reference);
+                EXPECT_EQ(scan.getTally(i, j, k).getCenter(), reference.getCenter());
+                const std::vector<double> spectrum = scan.getSpectrum(i, j, k);
+                double integral(0);
+                for (int b = 0; b < reference.getNBins(); b++)
+                {
+                    EXPECT_NEAR(spectrum[b], reference.getBinContent(b) / 500, 1e-12 * reference.getBinContent(b));
+                    integral += reference.getBinContent(b) / 500;
+                }
+                EXPECT_GT(integral, 0);
+                EXPECT_NEAR(scan.getIntegral(i, j, k), integral, 1e-12 * integral);
+            }
+        }
+    }
+}
+
+TEST_F(ScanTest, save)
+{
+    const Cylinder sourceCylinder = createSourceCylinder();
+    const MCSettings config = createSettings(Source(sourceCylinder, std::vector<double>{0.661}, Particle::Photon), 5, 0.1);
+    CollisionBank bank;
+    bank.transport(config, 50);
+    DetectorScan scan(Tally(Sphere(Vec3d(0, 0, 0), 2.54), 10, 0, 1.0, false), Vec3d(50, 0, 0), Vec3d(60, 10, 0), 2, 3, 1);
+    scan.run(config, bank);
+
+    const std::string fpath = (std::filesystem::temp_directory_path() / "cfdqt_scanTest.bin").string();
+    scan.save(fpath);
+    std::ifstream fileptr(fpath, std::ios::in | std::ios::binary);
+    char magic[8];
+    std::int32_t header[5];
+    double grid[6];
+    fileptr.read(magic, sizeof(magic));
+    fileptr.read(reinterpret_cast<char*>(header), sizeof(header));
+    fileptr.read(reinterpret_cast<char*>(grid), sizeof(grid));
+    EXPECT_EQ(std::string(magic, 8), "CFDSCAN1");
+    EXPECT_EQ(header[0], 2);
+    EXPECT_EQ(header[1], 3);
+    EXPECT_EQ(header[2], 1);
+    EXPECT_EQ(header[3], 10);
+    EXPECT_EQ(header[4], 50);
+    EXPECT_DOUBLE_EQ(grid[3], 10);
+    EXPECT_DOUBLE_EQ(grid[4], 5);
+    std::vector<double> values(10 + 6 * 10 + 6);
+    fileptr.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(double));
+    EXPECT_TRUE(fileptr);
+    // spectrum of node (1, 2, 0) and the integral of node (0, 1, 0)
+    EXPECT_DOUBLE_EQ(values[10 + 5 * 10 + 3], scan.getSpectrum(1, 2, 0)[3]);
+    EXPECT_DOUBLE_EQ(values[10 + 60 + 1], scan.getIntegral(0, 1, 0));
+    EXPECT_EQ(fileptr.peek(), EOF);
+    fileptr.close();
+    std::filesystem::remove(fpath);
+}
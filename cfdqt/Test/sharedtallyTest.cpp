@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include "sharedtally.h"
+#include "cfd.h"
+
+TEST(SharedTallyTest, stripedAndAtomicBins)
+{
+    SharedTallyStorage storage(5, 4, {3, 1, 3});
+    EXPECT_EQ(storage.getNHotBins(), 2);
+    for (int thread = 0; thread < 6; thread++)
+    {
+        for (int i = 0; i < 5; i++)
+            storage.add(thread, i, i + 0.5);
+    }
+    for (int i = 0; i < 5; i++)
+        EXPECT_DOUBLE_EQ(storage.getBinContent(i), 6 * (i + 0.5));
+    storage.clear();
+    EXPECT_EQ(storage.getBinContents(), std::vector<double>(5, 0));
+    EXPECT_THROW(SharedTallyStorage(5, 4, {5}), std::runtime_error);
+}
+
+TEST(SharedTallyTest, compensatedMerge)
+{
+    // small counts of the other threads are not lost against a large one
+    SharedTallyStorage storage(1, 4, {0});
+    storage.add(0, 0, 1);
+    for (int thread = 1; thread < 4; thread++)
+        storage.add(thread, 0, 1e-16);
+    EXPECT_GT(storage.getBinContent(0), 1);
+}
+
+TEST(SharedTallyTest, concurrentFills)
+{
+    const int nThreads = 4;
+    SharedTallyStorage storage(100, nThreads, SharedTallyStorage::hottestBins(std::vector<double>(100, 1), 10));
+    EXPECT_EQ(storage.getNHotBins(), 10);
+    #pragma omp parallel for num_threads(nThreads) schedule(static)
+    for (int i = 0; i < 100000; i++)
+        storage.add(i % 100, 0.25);
+    for (int i = 0; i < 100; i++)
+        EXPECT_DOUBLE_EQ(storage.getBinContent(i), 250);
+}
+
+TEST(SharedTallyTest, hottestBins)
+{
+    EXPECT_EQ(SharedTallyStorage::hottestBins({0, 3, 1, 5, 0, 2}, 3), std::vector<int>({1, 3, 5}));
+    EXPECT_EQ(SharedTallyStorage::hottestBins({0, 3, 0}, 3), std::vector<int>({1}));
+}
+
+TEST(SharedTallyTest, tally)
+{
+    Tally tally(Sphere(Vec3d(100, 0, 0), 1), 10, 0, 1);
+    Particle prtl(Vec3d(0, 0, 0), Vec3d(1, 0, 0), 0.25, 0.5, Particle::Photon);
+    tally.Fill(prtl, 1);
+    tally.shareCounts(std::make_shared<SharedTallyStorage>(10, 1, std::vector<int>{2}));
+    EXPECT_TRUE(tally.hasSharedCounts());
+    tally.Fill(prtl, 2);
+    tally.scoreBins({2, 7}, {1, 3});
+    // the same counts while shared and once collected
+    const std::vector<double> sharedContents = tally.getBinContents();
+    EXPECT_DOUBLE_EQ(tally.getBinContent(2), 2.5);
+    EXPECT_DOUBLE_EQ(sharedContents[2], 2.5);
+    EXPECT_DOUBLE_EQ(sharedContents[7], 3);
+    EXPECT_THROW(tally.setTimeBins(10, 0, 10), std::runtime_error);
+    EXPECT_THROW(tally.reset(), std::runtime_error);
+    EXPECT_THROW(tally.scaling(2), std::runtime_error);
+    // the shared counts are merged as well
+    Tally merged(Sphere(Vec3d(100, 0, 0), 1), 10, 0, 1);
+    merged.add(tally);
+    EXPECT_EQ(merged.getBinContents(), sharedContents);
+    tally.collectSharedCounts();
+    EXPECT_FALSE(tally.hasSharedCounts());
+    EXPECT_DOUBLE_EQ(tally.getBinContent(2), 2.5);
+    EXPECT_DOUBLE_EQ(tally.getBinContent(7), 3);
+    EXPECT_EQ(tally.getBinContents(), sharedContents);
+
+    tally.setTimeBins(10, 0, 10);
+    EXPECT_THROW(tally.shareCounts(std::make_shared<SharedTallyStorage>(10, 1, std::vector<int>{})), std::runtime_error);
+    Tally other(Sphere(Vec3d(100, 0, 0), 1), 5, 0, 1);
+    EXPECT_THROW(other.shareCounts(std::make_shared<SharedTallyStorage>(10, 1, std::vector<int>{})), std::runtime_error);
+}
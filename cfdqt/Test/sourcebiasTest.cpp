@@ -0,0 +1,99 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include "sourcebias.h"
+#include "weightwindow.h"
+#include "watersettings.h"
+
+static const Source createSource()
+{
+    return Source(createSourceCylinder(), std::vector<double>{0.661}, Particle::Photon);
+}
+
+TEST(SourceBiasTest, directionWeights)
+{
+    const Vec3d target(100, 100, 10);
+    BiasedSource biased(createSource(), target);
+    const int n = 200000;
+    for (int mode = 0; mode < 2; mode++)
+    {
+        if (mode == 0)
+            biased.setCone(0.9, 0.5);
+        else
+            biased.setExponential(3);
+        // weighted fractions are those of isotropic emission
+        double weights(0), forward(0), backward(0), forwardFraction(0);
+        for (int i = 0; i < n; i++)
+        {
+            const Particle prtl = biased.createParticle();
+            const double mu = Vec3d::dotProduct(prtl.dir, (target - prtl.pos).normalized());
+            EXPECT_NEAR(prtl.dir.length(), 1, 1e-12);
+            EXPECT_NEAR(prtl.weight, biased.directionWeight(mu), 1e-9 * prtl.weight);
+            weights += prtl.weight;
+            forward += mu > 0.9 ? prtl.weight : 0;
+            backward += mu < -0.5 ? prtl.weight : 0;
+            forwardFraction += mu > 0.9;
+        }
+        EXPECT_NEAR(weights / n, 1, 0.03);
+        EXPECT_NEAR(forward / n, 0.05, 0.002);
+        EXPECT_NEAR(backward / n, 0.25, 0.03);
+        // 0.5 + 0.5 x 0.05 into the cone, (1 - exp(-0.3)) / (1 - exp(-6)) with exp(3 mu)
+        EXPECT_NEAR(forwardFraction / n, mode == 0 ? 0.525 : 0.2596, 0.005);
+    }
+    EXPECT_THROW(biased.setExponential(-1), std::runtime_error);
+    EXPECT_THROW(biased.setCone(1, 0.5), std::runtime_error);
+}
+
+TEST(SourceBiasTest, positionWeights)
+{
+    const Source source = createSource();
+    BiasedSource biased(source, Vec3d(25, 25, 100));
+    biased.setPositionExponent(1);
+    const int n = 100000;
+    double weights(0), weightedZ(0), z(0);
+    for (int i = 0; i < n; i++)
+    {
+        const Particle prtl = biased.createParticle();
+        weights += prtl.weight;
+        weightedZ += prtl.weight * prtl.pos.z();
+        z += prtl.pos.z();
+    }
+    // uniform in z from 8.4478 to 14.08152 without biasing
+    EXPECT_NEAR(weights / n, 1, 0.01);
+    EXPECT_NEAR(weightedZ / n, 8.4478 + 5.63372 / 2, 0.1);
+    EXPECT_GT(z / n, 8.4478 + 5.63372 / 2 + 0.5);
+}
+
+TEST(SourceBiasTest, pilotTuning)
+{
+    const MCSettings config = createWaterSettings({0.661}, Particle::Photon, 100000, 5, 0.1);
+    const Tally detector(Sphere(Vec3d(100, 100, 10), 2.54), 10, 0, 1.0, false);
+
+    const BiasedSource biased = BiasedSource::tune(config, detector, 20000);
+    EXPECT_EQ(biased.getDirectionBias(), BiasedSource::Exponential);
+    EXPECT_GT(biased.getExponent(), 0);
+    EXPECT_GT(biased.getPredictedGain(), 1);
+
+    // same tally with and without biasing
+    double results[2][2];
+    for (int run = 0; run < 2; run++)
+    {
+        double sum(0), squaredSum(0);
+        Tally tally(detector);
+        for (int i = 0; i < config.maxN; i++)
+        {
+            tally.reset();
+            transportHistory(run == 0 ? config.source.createParticle() : biased.createParticle(), config, nullptr,
+                             [&](Particle& prtl) {forceDetection(prtl, config, tally);});
+            const std::vector<double> counts = tally.getBinContents();
+            const double total = std::accumulate(counts.begin(), counts.end(), 0.0);
+            sum += total;
+            squaredSum += total * total;
+        }
+        const double mean = sum / config.maxN;
+        results[run][0] = mean;
+        results[run][1] = (squaredSum / config.maxN - mean * mean) / config.maxN;
+    }
+    EXPECT_GT(results[0][0], 0);
+    EXPECT_NEAR(results[1][0], results[0][0], 4 * std::sqrt(results[0][1] + results[1][1]));
+    EXPECT_LT(results[1][1], results[0][1]);
+}
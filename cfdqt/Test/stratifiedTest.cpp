@@ -0,0 +1,176 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include "cfd.h"
+#include "stratified.h"
+#include "watersettings.h"
+
+static const Cylinder sourceCylinder = createSourceCylinder();
+
+// tally total of one history
+static double runHistory(Particle prtl, const MCSettings& config, std::vector<Tally>& tallies)
+{
+    tallies[0].reset();
+    forceDetection(prtl, config, tallies);
+    while (prtl.scatterN < config.maxScatterN && deltaTracking(prtl, config))
+    {
+        prtl.scatterN += 1;
+        forceDetection(prtl, config, tallies);
+        scattering(prtl, config);
+    }
+    const std::vector<double> counts = tallies[0].getBinContents();
+    return std::accumulate(counts.begin(), counts.end(), 0.0);
+}
+
+TEST(StratifiedTest, parse)
+{
+    const Source spectrum(sourceCylinder, std::vector<double>{0.2, 0.5, 1.0}, Particle::Photon);
+    const StratifiedSource stratified = StratifiedSource::parse(spectrum, "height:4,radius:2,energy:3,optimal");
+    EXPECT_EQ(stratified.getMode(), StratifiedSource::Stratified);
+    EXPECT_TRUE(stratified.isOptimal());
+    EXPECT_EQ(stratified.getDivisions(StratifiedSource::Height), 4);
+    EXPECT_EQ(stratified.getDivisions(StratifiedSource::Angle), 1);
+    EXPECT_EQ(stratified.getNStrata(), 24);
+    EXPECT_DOUBLE_EQ(stratified.getProbability(5), 1.0 / 24);
+    EXPECT_EQ(stratified.getStratumIndex(5, StratifiedSource::Radius), 0);
+    EXPECT_EQ(stratified.getStratumIndex(5, StratifiedSource::Height), 1);
+    EXPECT_EQ(stratified.getStratumIndex(5, StratifiedSource::Energy), 2);
+    EXPECT_EQ(stratified.getStratumName(5), "radius 1/2 height 2/4 energy 3/3");
+
+    const StratifiedSource hypercube = StratifiedSource::parse(spectrum, "lhs,height,energy");
+    EXPECT_EQ(hypercube.getMode(), StratifiedSource::LatinHypercube);
+    EXPECT_EQ(hypercube.getNStrata(), 1);
+    EXPECT_GT(hypercube.getDivisions(StratifiedSource::Energy), 1);
+    EXPECT_EQ(hypercube.getDivisions(StratifiedSource::Radius), 1);
+
+    EXPECT_THROW(StratifiedSource::parse(spectrum, "height"), std::runtime_error);
+    EXPECT_THROW(StratifiedSource::parse(spectrum, "width:2"), std::runtime_error);
+    EXPECT_THROW(StratifiedSource::parse(spectrum, "height:0"), std::runtime_error);
+    EXPECT_THROW(StratifiedSource::parse(spectrum, "height:2x"), std::runtime_error);
+    EXPECT_THROW(StratifiedSource::parse(spectrum, "lhs,height,optimal"), std::runtime_error);
+    const Source line(sourceCylinder, std::vector<double>{0.661}, Particle::Photon);
+    EXPECT_THROW(StratifiedSource::parse(line, "energy:2"), std::runtime_error);
+}
+
+TEST(StratifiedTest, strata)
+{
+    // inverse CDF of two equal-probable bins
+    const Source spectrum(sourceCylinder, std::vector<double>{0.2, 0.5, 1.0}, Particle::Photon);
+    auto getEnergy = [](const double u) {return u < 0.5 ? 0.2 + 0.6 * u : u;};
+    StratifiedSource stratified(spectrum, {2, 4, 4, 1, 1, 3});
+    ASSERT_EQ(stratified.getNStrata(), 96);
+    std::vector<int> allocation = stratified.allocate(100);
+    EXPECT_EQ(std::accumulate(allocation.begin(), allocation.end(), 0), 100);
+    EXPECT_EQ(*std::min_element(allocation.begin(), allocation.end()), 1);
+    EXPECT_THROW(stratified.allocate(95), std::runtime_error);
+
+    stratified.startBatch(960);
+    double weights(0);
+    for (int i = 0; i < stratified.getBatchHistories(); i++)
+    {
+        const int h = stratified.getStratum(i);
+        const Particle prtl = stratified.createParticle(i);
+        weights += prtl.weight;
+        const double dx = prtl.pos.x() - 25;
+        const double dy = prtl.pos.y() - 25;
+        const double r2 = (dx * dx + dy * dy) / (1.4097 * 1.4097);
+        const int ring = stratified.getStratumIndex(h, StratifiedSource::Radius);
+        EXPECT_GE(r2, ring / 2.0 - 1e-12);
+        EXPECT_LE(r2, (ring + 1) / 2.0 + 1e-12);
+        double angle = std::atan2(dy, dx) / (2 * M_PI);
+        if (angle < 0)
+            angle += 1;
+        const int sector = stratified.getStratumIndex(h, StratifiedSource::Angle);
+        EXPECT_GE(angle, sector / 4.0 - 1e-9);
+        EXPECT_LE(angle, (sector + 1) / 4.0 + 1e-9);
+        const double z = (prtl.pos.z() - 8.4478) / 5.63372;
+        const int slice = stratified.getStratumIndex(h, StratifiedSource::Height);
+        EXPECT_GE(z, slice / 4.0 - 1e-12);
+        EXPECT_LE(z, (slice + 1) / 4.0 + 1e-12);
+        const int band = stratified.getStratumIndex(h, StratifiedSource::Energy);
+        EXPECT_GE(prtl.ergE, getEnergy(band / 3.0) - 1e-12);
+        EXPECT_LE(prtl.ergE, getEnergy((band + 1) / 3.0) + 1e-12);
+    }
+    EXPECT_NEAR(weights, 960, 1e-9);
+
+    // one history in each interval of every stratified number
+    const Source line(sourceCylinder, std::vector<double>{0.661}, Particle::Photon);
+    StratifiedSource hypercube = StratifiedSource::parse(line, "lhs,height,radius");
+    const int n = 100;
+    hypercube.startBatch(n);
+    std::vector<int> slices(n, 0), rings(n, 0);
+    for (int i = 0; i < n; i++)
+    {
+        const Particle prtl = hypercube.createParticle(i);
+        EXPECT_DOUBLE_EQ(prtl.weight, 1);
+        const double dx = prtl.pos.x() - 25;
+        const double dy = prtl.pos.y() - 25;
+        rings[static_cast<int>((dx * dx + dy * dy) / (1.4097 * 1.4097) * n)]++;
+        slices[static_cast<int>((prtl.pos.z() - 8.4478) / 5.63372 * n)]++;
+    }
+    EXPECT_EQ(*std::min_element(rings.begin(), rings.end()), 1);
+    EXPECT_EQ(*std::min_element(slices.begin(), slices.end()), 1);
+}
+
+TEST(StratifiedTest, varianceReduction)
+{
+    const MCSettings config = createWaterSettings({0.661}, Particle::Photon, 40000);
+    const Tally detector(Sphere(Vec3d(25, 45, 10), 2.54), 10, 0, 1.0, false);
+    std::vector<Tally> tallies{detector};
+
+    // plain histories
+    double sum(0), squaredSum(0);
+    for (int i = 0; i < config.maxN; i++)
+    {
+        const double total = runHistory(config.source.createParticle(), config, tallies);
+        sum += total;
+        squaredSum += total * total;
+    }
+    const double mean = sum / config.maxN;
+    const double variance = (squaredSum / config.maxN - mean * mean) / config.maxN;
+
+    for (auto &&optimal : {false, true})
+    {
+        StratifiedSource stratified(config.source, {2, 4, 4, 1, 1, 1}, StratifiedSource::Stratified, optimal);
+        double weightedSum(0);
+        const int nBatches = 5;
+        for (int batch = 0; batch < nBatches; batch++)
+        {
+            stratified.startBatch(config.maxN / nBatches);
+            for (int i = 0; i < stratified.getBatchHistories(); i++)
+            {
+                const double total = runHistory(stratified.createParticle(i), config, tallies);
+                weightedSum += total;
+                stratified.addScore(i, total);
+            }
+        }
+        // the estimate of the weighted tallies
+        EXPECT_NEAR(weightedSum / config.maxN, stratified.getMean(), 1e-9 * stratified.getMean());
+        EXPECT_NEAR(weightedSum / config.maxN, mean, 4 * std::sqrt(variance + stratified.getVarianceOfMean()));
+        // the differences between the stratum means are removed from the variance of proportional allocation
+        if (!optimal)
+        {
+            EXPECT_LT(stratified.getVarianceOfMean(), stratified.getUnstratifiedVarianceOfMean());
+        }
+        double contributions(0);
+        for (int h = 0; h < stratified.getNStrata(); h++)
+            contributions += stratified.getVarianceContribution(h);
+        EXPECT_NEAR(contributions, stratified.getVarianceOfMean(), 1e-12 * contributions);
+        if (optimal)
+        {
+            // more histories where the scores vary more
+            int low(0), high(0);
+            for (int h = 0; h < stratified.getNStrata(); h++)
+            {
+                if (stratified.getVariance(h) < stratified.getVariance(low))
+                    low = h;
+                if (stratified.getVariance(h) > stratified.getVariance(high))
+                    high = h;
+            }
+            const std::vector<int> allocation = stratified.allocate(config.maxN);
+            EXPECT_GT(allocation[high], 2 * allocation[low]);
+        }
+        stratified.reset();
+        EXPECT_EQ(stratified.getHistories(0), 0);
+        EXPECT_DOUBLE_EQ(stratified.getMean(), 0);
+    }
+}
@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include "cfd.h"
+#include "watersettings.h"
+
+TEST(SubsamplingTest, policy)
+{
+    const SubsamplingPolicy defaults;
+    EXPECT_DOUBLE_EQ(defaults.getProbability(SubsamplingPolicy::ThermalNeutronScatter, 0.1), 0.01);
+    EXPECT_DOUBLE_EQ(defaults.getProbability(SubsamplingPolicy::FastNeutronScatter, 1e6), 1);
+    Particle prtl(Vec3d(0, 0, 0), Vec3d(1, 0, 0), 0.1, 1, Particle::Neutron);
+    EXPECT_EQ(SubsamplingPolicy::classify(prtl), SubsamplingPolicy::Primary);
+    prtl.scatterN = 1;
+    EXPECT_EQ(SubsamplingPolicy::classify(prtl), SubsamplingPolicy::ThermalNeutronScatter);
+    prtl.ergE = 2;
+    EXPECT_EQ(SubsamplingPolicy::classify(prtl), SubsamplingPolicy::FastNeutronScatter);
+    prtl.particleType = Particle::Photon;
+    EXPECT_EQ(SubsamplingPolicy::classify(prtl), SubsamplingPolicy::PhotonScatter);
+
+    const SubsamplingPolicy parsed = SubsamplingPolicy::parse("thermal:0.001:0.1:0.05,photon:0.5");
+    EXPECT_DOUBLE_EQ(parsed.getProbability(SubsamplingPolicy::ThermalNeutronScatter, 0.05), 0.001);
+    EXPECT_DOUBLE_EQ(parsed.getProbability(SubsamplingPolicy::ThermalNeutronScatter, 0.5), 0.05);
+    EXPECT_DOUBLE_EQ(parsed.getProbability(prtl), 0.5);
+    EXPECT_DOUBLE_EQ(parsed.getProbability(SubsamplingPolicy::Primary, 1), 1);
+    EXPECT_THROW(SubsamplingPolicy::parse("epithermal:0.5"), std::runtime_error);
+    EXPECT_THROW(SubsamplingPolicy::parse("thermal:0.5:0.1"), std::runtime_error);
+    EXPECT_THROW(SubsamplingPolicy::parse("thermal:0"), std::runtime_error);
+    EXPECT_THROW(SubsamplingPolicy::parse("thermal:0.1x"), std::runtime_error);
+}
+
+TEST(SubsamplingTest, optimize)
+{
+    // one expensive estimator: variance (1 - B) + B / p, time C + p D
+    SubsamplingPolicy::Pilot pilot;
+    pilot.variance = 1;
+    pilot.transportSeconds = 1;
+    for (int e = 0; e < SubsamplingPolicy::nEstimators; e++)
+    {
+        pilot.events[e] = {0};
+        pilot.squaredScores[e] = {0};
+        pilot.seconds[e] = {0};
+    }
+    pilot.events[SubsamplingPolicy::ThermalNeutronScatter] = {10};
+    pilot.squaredScores[SubsamplingPolicy::ThermalNeutronScatter] = {0.01};
+    pilot.seconds[SubsamplingPolicy::ThermalNeutronScatter] = {9};
+
+    SubsamplingPolicy policy;
+    const SubsamplingPolicy::Tradeoff current = policy.predict(pilot);
+    EXPECT_NEAR(current.varianceRatio, 1 + 0.01 * 99, 1e-12);
+    EXPECT_NEAR(current.timeRatio, (1 + 0.09) / 10, 1e-12);
+    const SubsamplingPolicy::Tradeoff optimized = policy.optimize(pilot);
+    const double p = std::sqrt(0.01 * 1 / (0.99 * 9));
+    EXPECT_NEAR(policy.getProbability(SubsamplingPolicy::ThermalNeutronScatter, 0.1), p, 1e-9);
+    EXPECT_DOUBLE_EQ(policy.getProbability(SubsamplingPolicy::PhotonScatter, 0.1), 1);
+    EXPECT_NEAR(optimized.varianceRatio, 0.99 + 0.01 / p, 1e-9);
+    EXPECT_NEAR(optimized.timeRatio, (1 + 9 * p) / 10, 1e-9);
+    EXPECT_GT(optimized.getEfficiency(), current.getEfficiency());
+    EXPECT_GT(optimized.getEfficiency(), 1);
+
+    // bands must match
+    policy.setBands(SubsamplingPolicy::ThermalNeutronScatter, {0.1}, {0.01, 0.1});
+    EXPECT_THROW(policy.predict(pilot), std::runtime_error);
+}
+
+TEST(SubsamplingTest, unbiasedThermalScores)
+{
+    const MCSettings config = createWaterSettings({0.1}, Particle::Neutron, 1000, 10);
+    const Tally detector(Sphere(Vec3d(100, 100, 10), 2.54), 110, 1e-3, 1e8, true);
+    const SubsamplingPolicy defaults = SubsamplingPolicy::GetInstance();
+    std::vector<SubsamplingPolicy> policies(3, defaults);
+    policies[0].setProbability(SubsamplingPolicy::ThermalNeutronScatter, 1);
+    policies[2] = SubsamplingPolicy::parse("thermal:0.05:0.05:0.2");
+    double results[3][2];
+    for (std::size_t run = 0; run < policies.size(); run++)
+    {
+        SubsamplingPolicy::GetInstance() = policies[run];
+        double sum(0), squaredSum(0);
+        Tally tally(detector);
+        for (int i = 0; i < config.maxN; i++)
+        {
+            tally.reset();
+            Particle prtl = config.source.createParticle();
+            forceDetection(prtl, config, tally);
+            while (prtl.scatterN < config.maxScatterN && deltaTracking(prtl, config))
+            {
+                prtl.scatterN += 1;
+                forceDetection(prtl, config, tally);
+                scattering(prtl, config);
+            }
+            const std::vector<double> counts = tally.getBinContents();
+            const double total = std::accumulate(counts.begin(), counts.end(), 0.0);
+            sum += total;
+            squaredSum += total * total;
+        }
+        const double mean = sum / config.maxN;
+        results[run][0] = mean;
+        results[run][1] = (squaredSum / config.maxN - mean * mean) / config.maxN;
+    }
+    SubsamplingPolicy::GetInstance() = defaults;
+    EXPECT_GT(results[0][0], 0);
+    for (int run = 1; run < 3; run++)
+    {
+        EXPECT_NEAR(results[run][0], results[0][0], 4 * std::sqrt(results[0][1] + results[run][1]));
+        EXPECT_GT(results[run][1], results[0][1]);
+    }
+}
+
+TEST(SubsamplingTest, pilot)
+{
+    const MCSettings config = createWaterSettings({0.1}, Particle::Neutron, 200, 10);
+    const std::vector<Tally> tallies{Tally(Sphere(Vec3d(100, 100, 10), 2.54), 110, 1e-3, 1e8, true)};
+    SubsamplingPolicy& policy = SubsamplingPolicy::GetInstance();
+    const SubsamplingPolicy defaults = policy;
+    const SubsamplingPolicy::Pilot pilot = runSubsamplingPilot(config, tallies, config.maxN);
+    // the policy is restored
+    EXPECT_DOUBLE_EQ(policy.getProbability(SubsamplingPolicy::ThermalNeutronScatter, 0.1), 0.01);
+    EXPECT_EQ(pilot.histories, 200);
+    EXPECT_GT(pilot.mean, 0);
+    EXPECT_GT(pilot.variance, 0);
+    EXPECT_DOUBLE_EQ(pilot.events[SubsamplingPolicy::Primary][0], 1);
+    EXPECT_GT(pilot.events[SubsamplingPolicy::ThermalNeutronScatter][0], 1);
+    EXPECT_GT(pilot.squaredScores[SubsamplingPolicy::ThermalNeutronScatter][0], 0);
+    EXPECT_GT(pilot.seconds[SubsamplingPolicy::ThermalNeutronScatter][0], 0);
+    EXPECT_EQ(pilot.events[SubsamplingPolicy::PhotonScatter][0], 0);
+
+    const SubsamplingPolicy::Tradeoff tradeoff = policy.optimize(pilot);
+    const double p = policy.getProbability(SubsamplingPolicy::ThermalNeutronScatter, 0.1);
+    EXPECT_GT(p, 0);
+    EXPECT_LE(p, 1);
+    EXPECT_GE(tradeoff.getEfficiency(), defaults.predict(pilot).getEfficiency() * (1 - 1e-9));
+    policy = defaults;
+
+    // the policy is restored when the pilot throws, here from a source that cannot be sampled
+    const Source slab(std::make_shared<Slab>(Vec3d(25, 25, 10), Vec3d(0, 0, 1), 1), {0.1}, Particle::Neutron);
+    EXPECT_THROW(runSubsamplingPilot(createWaterSettings(slab, 10, 10), tallies, 10), std::runtime_error);
+    EXPECT_DOUBLE_EQ(policy.getProbability(SubsamplingPolicy::ThermalNeutronScatter, 0.1), 0.01);
+}
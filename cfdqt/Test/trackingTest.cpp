@@ -0,0 +1,66 @@
+#include <gtest/gtest.h>
+#include <numeric>
+#include "cfd.h"
+#include "weightwindow.h"
+#include "watersettings.h"
+
+TEST(TrackingTest, stretching)
+{
+    const Vec3d target(100, 100, 10);
+    const ExponentialTransform transform(target, {0.1, 0.5, 1}, {0.2, 0.6});
+    EXPECT_DOUBLE_EQ(transform.getStretching(0.05), 0);
+    EXPECT_DOUBLE_EQ(transform.getStretching(0.3), 0.2);
+    EXPECT_DOUBLE_EQ(transform.getStretching(0.5), 0.6);
+    EXPECT_DOUBLE_EQ(transform.getStretching(1), 0);
+    Particle prtl(Vec3d(100, 0, 10), Vec3d(0, 1, 0), 0.661, 1, Particle::Photon);
+    EXPECT_NEAR(transform.getStretching(prtl), 0.6, 1e-12);
+    prtl.dir = Vec3d(1, 0, 0);
+    EXPECT_NEAR(transform.getStretching(prtl), 0, 1e-12);
+    prtl.dir = Vec3d(0, -1, 0);
+    EXPECT_NEAR(transform.getStretching(prtl), -0.6, 1e-12);
+
+    EXPECT_THROW(ExponentialTransform(target, {0.1, 1}, {1}), std::runtime_error);
+    EXPECT_THROW(ExponentialTransform(target, {0.1, 1}, {-0.1}), std::runtime_error);
+    EXPECT_THROW(ExponentialTransform(target, {1, 0.1}, {0.5}), std::runtime_error);
+    EXPECT_THROW(ExponentialTransform(target, {0.1, 0.5, 1}, {0.5}), std::runtime_error);
+
+    // photons scatter in almost every collision in water, the stretching is limited by the largest allowed
+    const MCSettings config = createWaterSettings({0.661}, Particle::Photon, 1, 5, 0.1);
+    const ExponentialTransform diffusion = ExponentialTransform::fromDiffusion(config, target, {0.01, 0.1, 0.7}, 0.5);
+    for (auto &&p : diffusion.getStretchingParameters())
+    {
+        EXPECT_GE(p, 0);
+        EXPECT_LE(p, 0.5);
+    }
+    EXPECT_DOUBLE_EQ(diffusion.getStretchingParameters()[1], 0.5);
+    EXPECT_THROW(ExponentialTransform::fromDiffusion(config, target, {0.01, 0.7}, 1), std::runtime_error);
+}
+
+TEST(TrackingTest, unbiasedTransform)
+{
+    const MCSettings config = createWaterSettings({0.661}, Particle::Photon, 40000, 5, 0.1);
+    const Tally detector(Sphere(Vec3d(100, 100, 10), 2.54), 10, 0, 1.0, false);
+    const ExponentialTransform transform = ExponentialTransform::fromDiffusion(config, detector.getCenter(), {0, 0.7}, 0.5);
+    // same tally with and without the transform
+    double results[2][2];
+    for (int run = 0; run < 2; run++)
+    {
+        double sum(0), squaredSum(0);
+        Tally tally(detector);
+        for (int i = 0; i < config.maxN; i++)
+        {
+            tally.reset();
+            transportHistory(config.source.createParticle(), config, nullptr, run == 0 ? nullptr : &transform,
+                             [&](Particle& prtl) {forceDetection(prtl, config, tally);});
+            const std::vector<double> counts = tally.getBinContents();
+            const double total = std::accumulate(counts.begin(), counts.end(), 0.0);
+            sum += total;
+            squaredSum += total * total;
+        }
+        const double mean = sum / config.maxN;
+        results[run][0] = mean;
+        results[run][1] = (squaredSum / config.maxN - mean * mean) / config.maxN;
+    }
+    EXPECT_GT(results[0][0], 0);
+    EXPECT_NEAR(results[1][0], results[0][0], 4 * std::sqrt(results[0][1] + results[1][1]));
+}
@@ -1,13 +1,34 @@
 #include <gtest/gtest.h>
-#include <QVector3D>
-#include <QtMath>
+#include "vec3d.h"
 #include <iostream>
 
 TEST(Vector3D, point2LineDist)
 {
-    QVector3D point(10, 10, 10);
-    QVector3D origin(0, 0 ,0);
-    QVector3D direction(0, 0, 1);
+    Vec3d point(10, 10, 10);
+    Vec3d origin(0, 0 ,0);
+    Vec3d direction(0, 0, 1);
     EXPECT_NEAR(point.distanceToLine(origin, direction), 
                 M_SQRT2 * 10, 1e-8);
 }
+
+TEST(Vector3D, arithmetic)
+{
+    Vec3d a(1, 2, 3);
+    Vec3d b(4, 5, 6);
+    EXPECT_EQ(a + b, Vec3d(5, 7, 9));
+    EXPECT_EQ(b - a, Vec3d(3, 3, 3));
+    EXPECT_EQ(2 * a, Vec3d(2, 4, 6));
+    EXPECT_EQ(b / 2, Vec3d(2, 2.5, 3));
+    EXPECT_DOUBLE_EQ(Vec3d::dotProduct(a, b), 32);
+    EXPECT_EQ(Vec3d::crossProduct(Vec3d(1, 0, 0), Vec3d(0, 1, 0)), Vec3d(0, 0, 1));
+    EXPECT_DOUBLE_EQ(Vec3d(3, 4, 0).length(), 5);
+    EXPECT_DOUBLE_EQ(Vec3d(3, 4, 0).normalized().x(), 0.6);
+}
+
+TEST(Vector3D, precisionFarFromOrigin)
+{
+    // single-precision floats can't resolve 1 um at 1 km
+    Vec3d far(1e5, 1e5, 1e5);
+    Vec3d moved = far + Vec3d(1e-4, 0, 0);
+    EXPECT_NEAR((moved - far).x(), 1e-4, 1e-10);
+}
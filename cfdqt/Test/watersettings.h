@@ -0,0 +1,99 @@
+/**
+ * @file watersettings.h
+ * @brief water cylinder with a small source cylinder inside, the run settings shared by the transport tests
+ * @version 0.1
+ * @date 2026-10-19
+ *
+ * @author Ming Fang
+ *
+ */
+#pragma once
+
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "cell.h"
+
+inline std::string getRootDir()
+{
+#ifdef CFDQT_ROOT_DIR
+    return CFDQT_ROOT_DIR;
+#endif
+    std::string cwd = std::filesystem::current_path();
+    std::size_t found = cwd.rfind("/build");
+    if (found!=std::string::npos)
+        cwd.replace (found, std::string::npos,"/");
+    else
+        throw std::runtime_error("Projetc root directory not found.");
+    return cwd;
+}
+
+/**
+ * @brief Get the source cylinder, 5.6 cm high and 1.4 cm in radius, inside the water cylinder
+ */
+inline Cylinder createSourceCylinder()
+{
+    return Cylinder(Vec3d(25, 25, 8.4478), 5.63372, 1.4097);
+}
+
+/**
+ * @brief Get water of H-1 and O-16, 0.99 g/cm3, with the cross sections of DATA
+ */
+inline Material createWater()
+{
+    std::string rootdir = getRootDir();
+    const PhotonCrossSection photonCrossSection(rootdir+"DATA/H2O.csv");
+    const NeutronCrossSection H1NeutronCrossSection(rootdir+"DATA/H1-total-cross-section.txt",
+                                                    rootdir+"DATA/H1-elastic-scattering-cross-section.txt");
+    const NeutronCrossSection O16NeutronCrossSection(rootdir+"DATA/O16-total-cross-section.txt",
+                                                     rootdir+"DATA/O16-elastic-scattering-cross-section.txt",
+                                                     rootdir+"DATA/O16-elastic-scattering-PDF.txt",
+                                                     rootdir+"DATA/O16-elastic-scattering-CDF.txt");
+    const Nuclide H1(1, 1, H1NeutronCrossSection, photonCrossSection);
+    const Nuclide O16(8, 16, O16NeutronCrossSection, photonCrossSection);
+    return Material(0.99, 18, {{2, H1}, {1, O16}});
+}
+
+/**
+ * @brief Get the water cylinder, 52 cm high and 21.5 cm in radius
+ */
+inline Cylinder createWaterCylinder()
+{
+    return Cylinder(Vec3d(25, 25, 0), 52, 21.5);
+}
+
+/**
+ * @brief Get the settings of the water cylinder with any source
+ *
+ * @param source Source
+ * @param maxN Number of histories
+ * @param maxScatterN Largest number of collisions of a history
+ * @param minE Energy cutoff, eV for neutrons, MeV for photons
+ * @param minW Weight cutoff
+ * @return MCSettings
+ */
+inline MCSettings createWaterSettings(const Source& source, const int maxN, const int maxScatterN=5,
+                                      const double minE=0, const double minW=0)
+{
+    const Cylinder waterCylinder = createWaterCylinder();
+    return MCSettings(waterCylinder, std::vector<Cell>{Cell(createWater(), 0.99, waterCylinder)}, source, maxN, maxScatterN, minW, minE);
+}
+
+/**
+ * @brief Get the settings of the water cylinder with the source cylinder inside
+ *
+ * @param sourceEnergies Inverse of the cumulative energy distribution of the source, see Source
+ * @param type Source particle type
+ * @param maxN Number of histories
+ * @param maxScatterN Largest number of collisions of a history
+ * @param minE Energy cutoff, eV for neutrons, MeV for photons
+ * @param minW Weight cutoff
+ * @return MCSettings
+ */
+inline MCSettings createWaterSettings(const std::vector<double>& sourceEnergies, const Particle::ParticleType type,
+                                      const int maxN, const int maxScatterN=5, const double minE=0, const double minW=0)
+{
+    return createWaterSettings(Source(createSourceCylinder(), sourceEnergies, type), maxN, maxScatterN, minE, minW);
+}
@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <numeric>
+#include "weightwindow.h"
+#include "cfd.h"
+#include "watersettings.h"
+
+// 2 x 1 x 1 mesh, 2 energy bins
+static WeightWindowMesh createWindows(const double left, const double right)
+{
+    return WeightWindowMesh(Vec3d(-30, -30, -60), Vec3d(80, 80, 60), 2, 1, 1, {0, 0.2, 1}, {left, right, left, right});
+}
+
+TEST(WeightWindowTest, findWindow)
+{
+    const WeightWindowMesh windows(Vec3d(0, 0, 0), Vec3d(2, 3, 4), 2, 3, 4, {0, 1, 10}, std::vector<double>(48, 1));
+    EXPECT_EQ(windows.findWindow(Vec3d(0.5, 0.5, 0.5), 0.5), 0);
+    EXPECT_EQ(windows.findWindow(Vec3d(1.5, 2.5, 3.5), 0.5), 23);
+    EXPECT_EQ(windows.findWindow(Vec3d(1.5, 2.5, 3.5), 5), 47);
+    EXPECT_EQ(windows.findWindow(Vec3d(0.5, 1.5, 0.5), 1), 24 + 4);
+    EXPECT_EQ(windows.findWindow(Vec3d(-0.5, 0.5, 0.5), 0.5), -1);
+    EXPECT_EQ(windows.findWindow(Vec3d(0.5, 0.5, 0.5), 10), -1);
+    EXPECT_DOUBLE_EQ(windows.getLowerBound(Vec3d(2.5, 0.5, 0.5), 0.5), 0);
+    EXPECT_EQ(windows.getElementCenter(1, 2, 3), Vec3d(1.5, 2.5, 3.5));
+    EXPECT_THROW(WeightWindowMesh(Vec3d(0, 0, 0), Vec3d(2, 3, 4), 2, 3, 4, {0, 1, 10}, std::vector<double>(47, 1)), std::runtime_error);
+}
+
+TEST(WeightWindowTest, splitAndRoulette)
+{
+    const WeightWindowMesh windows = createWindows(1, 0);
+    std::vector<Particle> bank;
+    Particle prtl(Vec3d(0, 0, 0), Vec3d(1, 0, 0), 0.5, 10, Particle::Photon);
+    // above the window: split into particles of the same state
+    EXPECT_EQ(windows.apply(prtl, bank), 2);
+    EXPECT_DOUBLE_EQ(prtl.weight, 5);
+    ASSERT_EQ(bank.size(), 1);
+    EXPECT_DOUBLE_EQ(bank[0].weight, 5);
+    EXPECT_EQ(bank[0].pos, prtl.pos);
+    // at most 5 particles at once
+    prtl.weight = 100;
+    EXPECT_EQ(windows.apply(prtl, bank), 5);
+    EXPECT_DOUBLE_EQ(prtl.weight, 20);
+    EXPECT_EQ(bank.size(), 5);
+    // within the window, or not controlled
+    prtl.weight = 2;
+    EXPECT_EQ(windows.apply(prtl, bank), 1);
+    EXPECT_DOUBLE_EQ(prtl.weight, 2);
+    prtl.pos = Vec3d(50, 0, 0);
+    prtl.weight = 1e-3;
+    EXPECT_EQ(windows.apply(prtl, bank), 1);
+    EXPECT_DOUBLE_EQ(prtl.weight, 1e-3);
+
+    // below the window: roulette keeps the expected weight
+    double sum(0);
+    int survivors(0);
+    const int n = 100000;
+    for (int i = 0; i < n; i++)
+    {
+        Particle light(Vec3d(0, 0, 0), Vec3d(1, 0, 0), 0.5, 0.3, Particle::Photon);
+        survivors += windows.apply(light, bank);
+        EXPECT_TRUE(light.weight == 0 || light.weight == 3);
+        sum += light.weight;
+    }
+    EXPECT_NEAR(survivors, n * 0.1, 5 * std::sqrt(n * 0.1 * 0.9));
+    EXPECT_NEAR(sum / n, 0.3, 5 * 3 * std::sqrt(0.1 * 0.9 / n));
+    EXPECT_EQ(bank.size(), 5);
+}
+
+TEST(WeightWindowTest, saveAndLoad)
+{
+    const WeightWindowMesh windows = createWindows(0.25, 1.0 / 3);
+    const std::string fpath = (std::filesystem::temp_directory_path() / "cfdqt_weightwindowTest.txt").string();
+    windows.save(fpath);
+    const WeightWindowMesh loaded = WeightWindowMesh::load(fpath);
+    std::filesystem::remove(fpath);
+    EXPECT_EQ(loaded.getLowerBounds(), windows.getLowerBounds());
+    EXPECT_EQ(loaded.getEnergyEdges(), windows.getEnergyEdges());
+    EXPECT_EQ(loaded.getNumberOfElements(), 2);
+    EXPECT_EQ(loaded.findWindow(Vec3d(30, 0, 0), 0.5), windows.findWindow(Vec3d(30, 0, 0), 0.5));
+    EXPECT_THROW(WeightWindowMesh::load(fpath), std::runtime_error);
+}
+
+TEST(WeightWindowTest, unbiasedTallies)
+{
+    const MCSettings config = createWaterSettings({0.661}, Particle::Photon, 2000, 5, 0.1);
+
+    // split towards the detector, roulette away from it
+    const WeightWindowMesh windows = createWindows(0.5, 0.05);
+    double results[2][2];
+    for (int run = 0; run < 2; run++)
+    {
+        const WeightWindowMesh* ww = run == 0 ? nullptr : &windows;
+        double sum(0), squaredSum(0);
+        for (int i = 0; i < config.maxN; i++)
+        {
+            Tally tally(Sphere(Vec3d(100, 100, 10), 2.54), 10, 0, 1.0, false);
+            int scored(0);
+            transportHistory(config.source.createParticle(), config, ww, [&](Particle& prtl)
+            {
+                forceDetection(prtl, config, tally);
+                scored += prtl.scatterN == 0;
+            });
+            const std::vector<double> counts = tally.getBinContents();
+            const double total = std::accumulate(counts.begin(), counts.end(), 0.0);
+            sum += total;
+            squaredSum += total * total;
+            EXPECT_EQ(scored, 1);
+        }
+        const double mean = sum / config.maxN;
+        results[run][0] = mean;
+        results[run][1] = (squaredSum / config.maxN - mean * mean) / config.maxN;
+    }
+    EXPECT_GT(results[0][0], 0);
+    EXPECT_NEAR(results[1][0], results[0][0], 4 * std::sqrt(results[0][1] + results[1][1]));
+}
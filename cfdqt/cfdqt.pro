@@ -25,7 +25,7 @@ DEFINES += QT_DEPRECATED_WARNINGS
 # No debug output
 CONFIG(release, debug|release): DEFINES += QT_NO_DEBUG_OUTPUT
 
-CONFIG += c++11
+CONFIG += c++17
 
 SOURCES += \
         $$PWD/Sources/main.cpp \
@@ -38,7 +38,21 @@ SOURCES += \
     $$PWD/Sources/material.cpp \
     $$PWD/Sources/cell.cpp \
     $$PWD/Sources/tracking.cpp \
+    $$PWD/Sources/pathfield.cpp \
+    $$PWD/Sources/detector.cpp \
+    $$PWD/Sources/sharedtally.cpp \
+    $$PWD/Sources/subsampling.cpp \
+    $$PWD/Sources/qmc.cpp \
+    $$PWD/Sources/perturbation.cpp \
+    $$PWD/Sources/stratified.cpp \
     $$PWD/Sources/cfd.cpp \
+    $$PWD/Sources/mcnpimport.cpp \
+    $$PWD/Sources/weightwindow.cpp \
+    $$PWD/Sources/bank.cpp \
+    $$PWD/Sources/scan.cpp \
+    $$PWD/Sources/response.cpp \
+    $$PWD/Sources/importance.cpp \
+    $$PWD/Sources/sourcebias.cpp \
     cfdworker.cpp
 
 HEADERS += \
@@ -47,12 +61,27 @@ HEADERS += \
     $$PWD/Headers/qcustomplot.h \
     $$PWD/Headers/customplotzoom.h \
     ../include/qt3dwidget.h \
+    $$PWD/Headers/vec3d.h \
     $$PWD/Headers/geometry.h \
     $$PWD/Headers/data.h \
     $$PWD/Headers/material.h \
     $$PWD/Headers/cell.h \
     $$PWD/Headers/tracking.h \
+    $$PWD/Headers/pathfield.h \
+    $$PWD/Headers/detector.h \
+    $$PWD/Headers/sharedtally.h \
+    $$PWD/Headers/subsampling.h \
+    $$PWD/Headers/qmc.h \
+    $$PWD/Headers/perturbation.h \
+    $$PWD/Headers/stratified.h \
     $$PWD/Headers/cfd.h \
+    $$PWD/Headers/mcnpimport.h \
+    $$PWD/Headers/weightwindow.h \
+    $$PWD/Headers/bank.h \
+    $$PWD/Headers/scan.h \
+    $$PWD/Headers/response.h \
+    $$PWD/Headers/importance.h \
+    $$PWD/Headers/sourcebias.h \
     cfdworker.h
 
 FORMS += \
@@ -3,13 +3,14 @@
 #include <QElapsedTimer>
 #include <QCoreApplication>
 #include <QDebug>
+#include <algorithm>
 
 CFDWorker::CFDWorker(QObject *parent)
     : QObject(parent)
 {
     initSetup();
 //    // initialize tally F2
-//    const Sphere detector = Sphere(QVector3D(100, 100, 10), 2.54);
+//    const Sphere detector = Sphere(Vec3d(100, 100, 10), 2.54);
 //    tally = Tally(detector, 100, 0, 1.0);
 
 //    stop=false;
@@ -24,9 +25,9 @@ CFDWorker::~CFDWorker()
 void CFDWorker::initSetup()
 {
     // initialize gemoetry
-    const Cylinder sourceCylinder = Cylinder(QVector3D(25, 25, 8.4478), 5.63372, 1.4097);
-    const Sphere detectorSphere = Sphere(QVector3D(100, 100, 10), 2.54);
-    const Cylinder waterCylinder = Cylinder(QVector3D(25, 25, 0), 52, 21.5);
+    const Cylinder sourceCylinder = Cylinder(Vec3d(25, 25, 8.4478), 5.63372, 1.4097);
+    const Sphere detectorSphere = Sphere(Vec3d(100, 100, 10), 2.54);
+    const Cylinder waterCylinder = Cylinder(Vec3d(25, 25, 0), 52, 21.5);
     // initialize source, eV for neutron, MeV for gamma
     std::vector<double> srcEnergyCDF{0.661}; // Cs137
     const Source source = Source(sourceCylinder, srcEnergyCDF, Particle::Photon);
@@ -37,9 +38,10 @@ void CFDWorker::initSetup()
     const double minW = 0.01;
     // initialize tally
     tally = Tally(detectorSphere, 100, 0, 1.0, false);
+    tally.setVolume(1.0); // same as SD4 1 in the MCNP deck
 
-//    const Cylinder waterCylinder = Cylinder(QVector3D(25, 25, 0), 52, 5);
-//    const Sphere detectorSphere = Sphere(QVector3D(75, 75, 10), 2.54);
+//    const Cylinder waterCylinder = Cylinder(Vec3d(25, 25, 0), 52, 5);
+//    const Sphere detectorSphere = Sphere(Vec3d(75, 75, 10), 2.54);
 //    // initialize source, eV for neutron, MeV for gamma
 //    std::vector<double> srcEnergyCDF{0, 478702, 817756, 1.15082e6,
 //                                    1.50133e6,1.88769e6,2.33337e6,2.87784e6,
@@ -72,6 +74,7 @@ void CFDWorker::initSetup()
     const Cell waterCell = Cell(water, waterDensity, waterCylinder);
 
     config = new MCSettings(waterCylinder, std::vector<Cell>{waterCell}, source, maxN, maxScatterN, minW, minE);
+    // the bank is filled by getSpectrum on the worker thread, detector changes only re-score the recorded events
 }
 
 void CFDWorker::work()
@@ -79,6 +82,9 @@ void CFDWorker::work()
     QTimer timer;
     connect(&timer, &QTimer::timeout, this, &CFDWorker::getSpectrum);
     timer.start(500);
+    // start filling the bank
+    changed=true;
+    getSpectrum();
 }
 
 void CFDWorker::getSpectrum()
@@ -87,43 +93,29 @@ void CFDWorker::getSpectrum()
         return;
 
     const int maxTime=800; //ms
+    const int chunkN=1000;
     QElapsedTimer timer;
     timer.start();
+    // transport more histories into the bank until the time is up
+    while (bank.getNPS() < config->maxN && !timer.hasExpired(maxTime))
+        bank.transport(*config, std::min(chunkN, config->maxN - bank.getNPS()));
 
-    for (int i=0;i<config->maxN;i++)
-    {
-        if(timer.hasExpired(maxTime))
-        {
-            tally.setNPS(i);
-            changed=false;
-//            qDebug() << i;
-            break;
-        }
-        // CFD
-        // create a new particle from source
-        Particle prtl = config->source.createParticle();
-        assert(config->ROI.contain(prtl.pos));
-
-        // primary contribution
-        forceDetection(prtl, *config, tally);
-
-        // transport
-        while (prtl.scatterN < config->maxScatterN &&
-               prtl.ergE > config->minE &&
-               prtl.weight > config->minW &&
-               deltaTracking(prtl, *config))
-        {
-            prtl.scatterN += 1;
-            forceDetection(prtl, *config, tally);
-            scattering(prtl, *config);
-        }
-    }
-    if(changed)
-        tally.setNPS(config->maxN);
-    tally.scaling(1.0/config->maxN);
+    // CFD of the recorded source and collision events of the histories so far
+    bank.replay(*config, tally);
+    tally.setNPS(bank.getNPS());
+    tally.scaling(1.0/bank.getNPS());
     emit spectrumChanged(tally);
-    changed=false;
     tally.reset();
+    // refine the spectrum as long as the bank is not full, after the queued detector changes
+    changed = bank.getNPS() < config->maxN;
+    if (changed && !fillScheduled)
+    {
+        fillScheduled=true;
+        QTimer::singleShot(0, this, [this]() {
+            fillScheduled=false;
+            getSpectrum();
+        });
+    }
 }
 
 void CFDWorker::stopWorker()
@@ -134,7 +126,7 @@ void CFDWorker::stopWorker()
 void CFDWorker::onCenterChanged(QVector3D newCenter)
 {
 //    qDebug() << newCenter;
-    tally.setCenter(newCenter);
+    tally.setCenter(toVec3d(newCenter));
     changed=true;
     getSpectrum();
 }
@@ -2,14 +2,21 @@
 #define CFDWORKER_H
 
 #include <QObject>
+#include <QVector3D>
 #include "geometry.h"
 #include "data.h"
 #include "material.h"
 #include "cell.h"
 #include "tracking.h"
 #include "cfd.h"
+#include "bank.h"
 #include <atomic>
 
+/**
+ * @brief Convert a GUI vector to the vector type used by the physics libraries
+ */
+inline Vec3d toVec3d(const QVector3D& v) {return Vec3d(v.x(), v.y(), v.z());}
+
 class CFDWorker : public QObject
 {
     Q_OBJECT
@@ -19,6 +26,11 @@ public:
 private:
     Tally tally;
     MCSettings* config;
+    // events of the transport run, filled a time slice at a time on the worker thread
+    // and re-scored whenever the detector changes
+    CollisionBank bank;
+    // whether getSpectrum is queued to go on filling the bank
+    bool fillScheduled=false;
     void initSetup();
     std::atomic<bool> stop;
     std::atomic<bool> changed;